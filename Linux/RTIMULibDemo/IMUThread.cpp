@@ -58,8 +58,10 @@ void IMUThread::newIMU()
     if (m_imu == NULL)
         return;
 
-    //  set up IMU
+    //  set up IMU. It writes its samples into m_data so the pressure and humidity
+    //  can be added without copying them.
 
+    m_imu->IMUSetDataStorage(&m_data);
     m_imu->IMUInit();
 
     m_timer = startTimer(m_imu->IMUGetPollInterval());
@@ -111,8 +113,10 @@ void IMUThread::initThread()
         return;
     }
 
-    //  set up IMU
+    //  set up IMU. It writes its samples into m_data so the pressure and humidity
+    //  can be added without copying them.
 
+    m_imu->IMUSetDataStorage(&m_data);
     m_imu->IMUInit();
 
     //  create pressure sensor. There's a special function call for this
@@ -173,13 +177,12 @@ void IMUThread::timerEvent(QTimerEvent * /* event */)
         if (m_calibrationMode) {
             emit newCalData(m_imu->getCompass());
         } else {
-            RTIMU_DATA data = m_imu->getIMUData();
             if (m_pressure != NULL)
-                m_pressure->pressureRead(data);
+                m_pressure->pressureRead(m_data);
             if (m_humidity != NULL)
-                m_humidity->humidityRead(data);
+                m_humidity->humidityRead(m_data);
 
-            emit newIMUData(data);
+            emit newIMUData(m_data);
         }
     }
 }
@@ -80,6 +80,7 @@ private:
     RTIMUSettings *m_settings;
 
     RTIMU *m_imu;
+    RTIMU_DATA m_data;                                      // the IMU's samples
     RTPressure *m_pressure;
     RTHumidity *m_humidity;
     bool m_calibrationMode;
@@ -24,6 +24,17 @@
 
 #include "RTIMULib.h"
 
+#include <signal.h>
+
+//  set by Ctrl-C so the loop can stop and save the gyro bias table
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void stopHandler(int)
+{
+    stopRequested = 1;
+}
+
 int main()
 {
     int sampleCount = 0;
@@ -65,10 +76,15 @@ int main()
 
     //  now just process data
 
-    while (1) {
-        //  poll at the rate recommended by the IMU
+    signal(SIGINT, stopHandler);
+    signal(SIGTERM, stopHandler);
+
+    while (!stopRequested) {
+        //  wait for the IMU's data ready interrupt if there is one, otherwise
+        //  this sleeps until the IMU's FIFO should be at the FifoPollTarget level,
+        //  or to the next poll interval on a fixed schedule for IMUs without one
 
-        usleep(imu->IMUGetPollInterval() * 1000);
+        imu->IMUWaitForData(100);
 
         while (imu->IMURead()) {
             RTIMU_DATA imuData = imu->getIMUData();
@@ -93,6 +109,7 @@ int main()
                 static int c = 0;
                 if(c==10){
                     settings->m_compassCalEllipsoidValid = !settings->m_compassCalEllipsoidValid;
+                    imu->setCalibrationData();
                     c=0;
                     //printf("value %d\n", settings->m_compassCalEllipsoidValid);
                 }
@@ -100,5 +117,10 @@ int main()
             }
         }
     }
-}
 
+    //  the gyro bias recorded at each die temperature is only kept in memory until it's saved
+
+    printf("\n");
+    imu->saveGyroBiasTable();
+    return 0;
+}
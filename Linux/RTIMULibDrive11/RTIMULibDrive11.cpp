@@ -24,6 +24,17 @@
 
 #include "RTIMULib.h"
 
+#include <signal.h>
+
+//  set by Ctrl-C so the loop can stop and save the gyro bias table
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void stopHandler(int)
+{
+    stopRequested = 1;
+}
+
 int main()
 {
     int sampleCount = 0;
@@ -31,6 +42,7 @@ int main()
     uint64_t rateTimer;
     uint64_t displayTimer;
     uint64_t now;
+    RTIMU_DATA imuData;
 
     //  using RTIMULib here allows it to use the .ini file generated by RTIMULibDemo.
 
@@ -47,8 +59,10 @@ int main()
 
     //  This is an opportunity to manually override any settings before the call IMUInit
 
-    //  set up IMU
+    //  set up IMU. It writes its samples into imuData so the pressure and humidity
+    //  can be added without copying them.
 
+    imu->IMUSetDataStorage(&imuData);
     imu->IMUInit();
 
     //  this is a convenient place to change fusion parameters
@@ -74,14 +88,17 @@ int main()
 
     //  now just process data
 
-    while (1) {
-        //  poll at the rate recommended by the IMU
+    signal(SIGINT, stopHandler);
+    signal(SIGTERM, stopHandler);
 
-        usleep(imu->IMUGetPollInterval() * 1000);
+    while (!stopRequested) {
+        //  wait for the IMU's data ready interrupt if there is one, otherwise
+        //  this sleeps until the IMU's FIFO should be at the FifoPollTarget level,
+        //  or to the next poll interval on a fixed schedule for IMUs without one
 
-        while (imu->IMURead()) {
-            RTIMU_DATA imuData = imu->getIMUData();
+        imu->IMUWaitForData(100);
 
+        while (imu->IMURead()) {
             //  add the pressure data to the structure
 
             if (pressure != NULL)
@@ -124,5 +141,10 @@ int main()
             }
         }
     }
-}
 
+    //  the gyro bias recorded at each die temperature is only kept in memory until it's saved
+
+    printf("\n");
+    imu->saveGyroBiasTable();
+    return 0;
+}
@@ -0,0 +1,659 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+//  RTIMULibSimCheck runs the library against the simulated IMUs in RTIMUSimTransport
+//  so that no hardware is needed. It's built with the other apps and ctest runs it:
+//
+//      RTIMULibSimCheck poll   - reads an MPU-925x and an ICM-20948 at 1kHz for ten seconds
+//                                of simulated time, polling on a fixed schedule and then at
+//                                FIFO poll targets of 25, 50 and 75%. No sample may be dropped
+//                                and the FIFO schedules must wake up far less often.
+//      RTIMULibSimCheck ring   - one thread pushes into an RTIMURing while a second reads it
+//                                as it goes and the main thread reads only once it's finished,
+//                                so has overrun. Every sample must be read or counted as lost,
+//                                in order and never torn.
+//      RTIMULibSimCheck acquisition - runs an acquisition thread on a simulated MPU-925x into
+//                                a ring and a callback, stops and restarts it and deletes the
+//                                IMU with it running.
+//      RTIMULibSimCheck simd <scalar check> - runs the SIMD math and fusion on fixed inputs
+//                                and compares the results with RTIMULibSimCheckScalar, which
+//                                uses plain C++ throughout.
+//      RTIMULibSimCheck simdvalues - prints the results the simd check compares.
+//
+//  It prints what it measured and exits with 1 if any check fails.
+
+#include "RTIMULib.h"
+
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <atomic>
+
+#define SIMCHECK_SETTINGS       "RTIMULibSimCheck"
+
+static int failures;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+//  The poll check
+
+#define POLL_RATE               1000                        // samples per second
+#define POLL_RUN                10000000                    // uS of simulated time
+
+typedef struct
+{
+    int target;                                             // FifoPollTarget, 0 polls on a fixed schedule
+    unsigned long samples;
+    unsigned long wakeups;
+    unsigned long dropped;
+} POLL_RESULT;
+
+static void pollRun(int imuType, unsigned char slaveAddress, POLL_RESULT& result)
+{
+    RTIMUSettings settings(SIMCHECK_SETTINGS);
+    RTIMUSimTransport sim;
+
+    sim.addIMU(imuType);
+    settings.setTransport(&sim);
+    settings.m_imuType = imuType;
+    settings.m_busIsI2C = true;
+    settings.m_I2CSlaveAddress = slaveAddress;
+    settings.m_MPU925xGyroAccelSampleRate = POLL_RATE;
+    settings.m_ICM20948GyroAccelSampleRate = POLL_RATE;
+    settings.m_fifoPollTarget = result.target;
+
+    RTIMU *imu = RTIMU::createIMU(&settings);
+
+    imu->IMUInit();
+
+    uint64_t start = sim.getTime();
+
+    result.samples = 0;
+    result.wakeups = 0;
+
+    while (sim.getTime() - start < POLL_RUN) {
+        imu->IMUWaitForData(100);
+        result.wakeups++;
+        while (imu->IMURead())
+            result.samples++;
+    }
+    result.dropped = imu->IMUGetDroppedSamples();
+
+    delete imu;
+    settings.setTransport(NULL);
+}
+
+static void pollCheck(int imuType, unsigned char slaveAddress, const char *name)
+{
+    POLL_RESULT results[] = {{0, 0, 0, 0}, {25, 0, 0, 0}, {50, 0, 0, 0}, {75, 0, 0, 0}};
+    int count = sizeof(results) / sizeof(POLL_RESULT);
+    char what[128];
+
+    for (int i = 0; i < count; i++) {
+        POLL_RESULT& result = results[i];
+
+        pollRun(imuType, slaveAddress, result);
+        printf("%s target %d%%: samples %lu wakeups %lu dropped %lu\n", name, result.target,
+               result.samples, result.wakeups, result.dropped);
+
+        sprintf(what, "%s target %d%% dropped samples", name, result.target);
+        check(result.dropped == 0, what);
+
+        //  everything the fixed schedule read should have been read, give or take what's
+        //  still in the FIFO at the end
+
+        sprintf(what, "%s target %d%% read too few samples", name, result.target);
+        check(result.samples + result.samples / 100 >= results[0].samples, what);
+    }
+
+    //  the fixed schedule wakes for every sample while the FIFO schedules wait for it to fill
+
+    sprintf(what, "%s fixed schedule missed polls", name);
+    check(results[0].wakeups >= POLL_RUN / (1000000 / POLL_RATE) - 1, what);
+    for (int i = 1; i < count; i++) {
+        sprintf(what, "%s target %d%% woke up too often", name, results[i].target);
+        check(results[i].wakeups * 5 < results[0].wakeups, what);
+        if (i > 1) {
+            sprintf(what, "%s target %d%% woke up more than %d%%", name, results[i].target, results[i - 1].target);
+            check(results[i].wakeups <= results[i - 1].wakeups, what);
+        }
+    }
+    sprintf(what, "%s target 50%% woke up too often", name);
+    check(results[2].wakeups * 10 < results[0].wakeups, what);
+}
+
+static void poll()
+{
+    pollCheck(RTIMU_TYPE_MPU925x, MPU9150_ADDRESS0, "MPU-925x");
+    pollCheck(RTIMU_TYPE_ICM20948, ICM20948_ADDRESS0, "ICM-20948");
+}
+
+//  The ring check
+
+#define RING_SIZE               64
+#define RING_SAMPLES            100000
+
+typedef struct
+{
+    RTIMURing *ring;
+    RTIMURingReader *reader;
+    std::atomic<bool> done;                                 // set by the writer after its last push
+    unsigned long torn;                                     // samples whose fields don't match
+    unsigned long disorder;                                 // samples not after the one before
+} RING_CONTEXT;
+
+//  every field of a sample is worked out from its timestamp so a torn read shows up
+
+static void ringSample(uint64_t position, RTIMU_DATA& data)
+{
+    data.timestamp = position;
+    data.gyro.setX(position % 1000);
+    data.accel.setZ(position % 777);
+    data.compass.setY(position % 555);
+    data.fusionQPose.setScalar(position % 333);
+    data.setValidMask(position % 256);
+}
+
+static bool ringSampleOk(const RTIMU_DATA& data)
+{
+    RTIMU_DATA expected;
+
+    ringSample(data.timestamp, expected);
+    return (data.gyro.x() == expected.gyro.x()) && (data.accel.z() == expected.accel.z()) &&
+           (data.compass.y() == expected.compass.y()) &&
+           (data.fusionQPose.scalar() == expected.fusionQPose.scalar()) &&
+           (data.validMask() == expected.validMask());
+}
+
+static void ringDrain(RTIMURingReader *reader, uint64_t& last, RING_CONTEXT *context)
+{
+    RTIMU_DATA data;
+
+    while (reader->read(data)) {
+        if (!ringSampleOk(data))
+            context->torn++;
+        if ((reader->getRead() > 1) && (data.timestamp <= last))
+            context->disorder++;
+        last = data.timestamp;
+    }
+}
+
+static void *ringWriter(void *arg)
+{
+    RING_CONTEXT *context = (RING_CONTEXT *)arg;
+    RTIMU_DATA data;
+
+    for (uint64_t position = 0; position < RING_SAMPLES; position++) {
+        ringSample(position, data);
+        context->ring->push(data);
+        if ((position % 64) == 0)
+            sched_yield();
+    }
+    context->done = true;
+    return NULL;
+}
+
+static void *ringReader(void *arg)
+{
+    RING_CONTEXT *context = (RING_CONTEXT *)arg;
+    uint64_t last = 0;
+    bool done;
+
+    do {
+        done = context->done;
+        ringDrain(context->reader, last, context);
+    } while (!done);
+    return NULL;
+}
+
+static void ring()
+{
+    RTIMURing ring(RING_SIZE);
+    RTIMURingReader fast(&ring);
+    RTIMURingReader slow(&ring);
+    RING_CONTEXT context;
+    pthread_t writer, reader;
+    uint64_t last = 0;
+
+    context.ring = &ring;
+    context.reader = &fast;
+    context.done = false;
+    context.torn = 0;
+    context.disorder = 0;
+
+    pthread_create(&reader, NULL, ringReader, &context);
+    pthread_create(&writer, NULL, ringWriter, &context);
+    pthread_join(writer, NULL);
+    pthread_join(reader, NULL);
+
+    //  the slow reader starts now, so all but the newest RING_SIZE - 1 samples have gone
+
+    check(slow.getLag() == RING_SAMPLES, "slow reader lag");
+    ringDrain(&slow, last, &context);
+
+    printf("pushed %lu\n", (unsigned long)ring.getPushed());
+    printf("fast reader: read %lu overruns %lu max lag %lu\n", (unsigned long)fast.getRead(),
+           (unsigned long)fast.getOverruns(), (unsigned long)fast.getMaxLag());
+    printf("slow reader: read %lu overruns %lu max lag %lu\n", (unsigned long)slow.getRead(),
+           (unsigned long)slow.getOverruns(), (unsigned long)slow.getMaxLag());
+    printf("torn %lu out of order %lu\n", context.torn, context.disorder);
+
+    check(ring.getPushed() == RING_SAMPLES, "samples pushed");
+    check(fast.getRead() + fast.getOverruns() == RING_SAMPLES, "fast reader lost count");
+    check(fast.getLag() == 0, "fast reader lag");
+    check(slow.getRead() == RING_SIZE - 1, "slow reader samples read");
+    check(slow.getOverruns() == RING_SAMPLES - (RING_SIZE - 1), "slow reader overruns");
+    check(last == RING_SAMPLES - 1, "slow reader last sample");
+    check(context.torn == 0, "torn samples");
+    check(context.disorder == 0, "samples out of order");
+
+    //  skip() and resetStats() start a reader afresh
+
+    RTIMU_DATA data;
+
+    ringSample(RING_SAMPLES, data);
+    ring.push(data);
+    slow.resetStats();
+    slow.skip();
+    check(slow.getLag() == 0, "lag after skip");
+    check(!slow.read(data), "read after skip");
+    check(slow.getRead() == 0 && slow.getOverruns() == 0 && slow.getMaxLag() == 0, "stats after reset");
+}
+
+//  The acquisition check
+
+#define ACQUISITION_SAMPLES     2000                        // samples to wait for each run
+#define ACQUISITION_TIMEOUT     5000                        // mS
+
+typedef struct
+{
+    std::atomic<unsigned long> count;
+    uint64_t last;
+    unsigned long disorder;
+} ACQUISITION_CONTEXT;
+
+static void acquisitionCallback(const RTIMU_DATA& data, void *arg)
+{
+    ACQUISITION_CONTEXT *context = (ACQUISITION_CONTEXT *)arg;
+
+    if ((context->count > 0) && (data.timestamp <= context->last))
+        context->disorder++;
+    if (!data.gyroValid || !data.accelValid)
+        context->disorder++;
+    context->last = data.timestamp;
+    context->count++;
+}
+
+static bool acquisitionWait(ACQUISITION_CONTEXT& context, unsigned long count)
+{
+    for (int i = 0; i < ACQUISITION_TIMEOUT; i++) {
+        if (context.count >= count)
+            return true;
+        usleep(1000);
+    }
+    return false;
+}
+
+static void acquisition()
+{
+    RTIMUSettings settings(SIMCHECK_SETTINGS);
+    RTIMUSimTransport sim;
+    ACQUISITION_CONTEXT context;
+    RTIMU_DATA data;
+    uint64_t last = 0;
+    unsigned long count;
+
+    sim.addIMU(RTIMU_TYPE_MPU925x);
+    settings.setTransport(&sim);
+    settings.m_imuType = RTIMU_TYPE_MPU925x;
+    settings.m_busIsI2C = true;
+    settings.m_I2CSlaveAddress = MPU9150_ADDRESS0;
+    settings.m_MPU925xGyroAccelSampleRate = POLL_RATE;
+    settings.m_fifoPollTarget = 50;
+    settings.m_acquisitionPolicy = RTIMU_ACQUISITION_NORMAL;
+
+    RTIMU *imu = RTIMU::createIMU(&settings);
+    RTIMURing ring;
+    RTIMURingReader reader(&ring);
+
+    imu->IMUInit();
+
+    context.count = 0;
+    context.last = 0;
+    context.disorder = 0;
+
+    //  the first run feeds the ring and the callback
+
+    check(imu->startAcquisition(&ring, acquisitionCallback, &context), "start");
+    check(imu->acquisitionRunning(), "running after start");
+    check(!imu->startAcquisition(&ring), "second start");
+    check(acquisitionWait(context, ACQUISITION_SAMPLES), "samples from the first run");
+
+    imu->stopAcquisition();
+    check(!imu->acquisitionRunning(), "running after stop");
+    count = context.count;
+    usleep(10000);
+    check(context.count == count, "callbacks after stop");
+    check(ring.getPushed() == count, "ring and callback counts");
+
+    //  the simulated IMU runs faster than real time, so the ring has overrun
+
+    while (reader.read(data)) {
+        if (data.timestamp <= last)
+            context.disorder++;
+        last = data.timestamp;
+    }
+    check(reader.getRead() + reader.getOverruns() == ring.getPushed(), "ring reader lost count");
+    check(last == context.last, "last sample in the ring");
+    check(imu->IMUGetDroppedSamples() == 0, "dropped samples");
+
+    printf("first run: callbacks %lu ring read %lu overruns %lu\n", count,
+           (unsigned long)reader.getRead(), (unsigned long)reader.getOverruns());
+
+    //  the second run has just a callback and is still going when the IMU is deleted
+
+    check(imu->startAcquisition(NULL, acquisitionCallback, &context), "restart");
+    check(acquisitionWait(context, count + ACQUISITION_SAMPLES), "samples from the second run");
+    check(ring.getPushed() == count, "ring used by the second run");
+
+    delete imu;
+    count = context.count;
+    usleep(10000);
+    check(context.count == count, "callbacks after delete");
+    check(context.disorder == 0, "samples out of order or invalid");
+
+    printf("second run: callbacks %lu\n", count - (unsigned long)ring.getPushed());
+    settings.setTransport(NULL);
+}
+
+//  The SIMD check
+//
+//  simdValues() works out the math and fusion results from a fixed sequence of inputs.
+//  RTIMULibSimCheckScalar is this program built with the library sources and
+//  RTMATH_NO_SIMD and RTMATH_NO_DISPATCH so it gives the plain C++ results to compare with,
+//  and with HAL_QUIET so that the library prints nothing else.
+
+#define SIMD_ROUNDS             64                          // random inputs for each operation
+#define SIMD_SAMPLES            40                          // raw samples to convert
+#define SIMD_FUSION_SAMPLES     3000                        // 30 seconds at 100 samples per second
+#define SIMD_MATH_TOLERANCE     1e-5
+#define SIMD_FUSION_TOLERANCE   1e-3
+#define SIMD_LINE               1024
+
+static uint32_t simdSeed;
+
+static RTFLOAT simdRandom()
+{
+    simdSeed = simdSeed * 1664525 + 1013904223;
+    return (RTFLOAT)(simdSeed >> 8) / (RTFLOAT)(1 << 23) - 1;
+}
+
+static void simdQuaternion(RTQuaternion& q)
+{
+    for (int i = 0; i < 4; i++)
+        q.setData(i, simdRandom());
+}
+
+static void simdMatrix(RTMatrix4x4& m)
+{
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            m.setVal(row, col, simdRandom());
+}
+
+static void simdPrintQuaternion(FILE *out, const char *label, const RTQuaternion& q)
+{
+    fprintf(out, "%s %.9g %.9g %.9g %.9g\n", label, q.scalar(), q.x(), q.y(), q.z());
+}
+
+static void simdPrintMatrix(FILE *out, const char *label, const RTMatrix4x4& m)
+{
+    fprintf(out, "%s", label);
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            fprintf(out, " %.9g", m.val(row, col));
+    fprintf(out, "\n");
+}
+
+static void simdFusion(FILE *out, int fusionType, const char *label)
+{
+    RTIMUSettings settings(SIMCHECK_SETTINGS);
+
+    settings.setDefaults();
+    settings.m_imuType = RTIMU_TYPE_NULL;
+    settings.m_fusionType = fusionType;
+
+    RTIMU *imu = RTIMU::createIMU(&settings);
+
+    imu->IMUInit();
+
+    //  a slow tumble with gravity and the magnetic field following it roughly
+
+    for (int i = 0; i < SIMD_FUSION_SAMPLES; i++) {
+        RTFLOAT t = (RTFLOAT)i / 100;
+
+        imu->setExtIMUData(0.5 * sin(0.7 * t), 0.3 * cos(0.5 * t), 0.2,
+                           0.3 * sin(0.1 * t), 0.2 * cos(0.13 * t), 1,
+                           0.3 * cos(0.05 * t), 0.3 * sin(0.05 * t), -0.4,
+                           (uint64_t)i * 10000);
+    }
+    simdPrintQuaternion(out, label, imu->getIMUData().fusionQPose);
+    delete imu;
+}
+
+static void simdValues(FILE *out)
+{
+    RTQuaternion qa, qb, q;
+    RTMatrix4x4 ma, mb;
+
+    fprintf(out, "path %s\n", RTMath::simdPath());
+
+    simdSeed = 1;
+    for (int i = 0; i < SIMD_ROUNDS; i++) {
+        simdQuaternion(qa);
+        simdQuaternion(qb);
+        simdMatrix(ma);
+        simdMatrix(mb);
+
+        simdPrintQuaternion(out, "qmul", qa * qb);
+        q = qa;
+        q *= qb;
+        simdPrintQuaternion(out, "qmulassign", q);
+        q.normalize();
+        simdPrintQuaternion(out, "qnormalize", q);
+        simdPrintMatrix(out, "mmul", ma * mb);
+        simdPrintQuaternion(out, "mqmul", ma * qa);
+        simdPrintMatrix(out, "mtransposed", ma.transposed());
+
+        //  keep the matrix well away from singular
+
+        for (int j = 0; j < 4; j++)
+            ma.setVal(j, j, ma.val(j, j) + 4);
+        simdPrintMatrix(out, "minverted", ma.inverted());
+    }
+
+    //  raw samples with a big endian triple, a little endian remapped one and a triple
+    //  at the end of the sample
+
+    unsigned char samples[SIMD_SAMPLES * 14];
+    RTMATH_RAW_TRIPLE triples[3];
+    RTFLOAT converted[9 * SIMD_SAMPLES];
+    RTVector3 vec;
+
+    for (unsigned int i = 0; i < sizeof(samples); i++)
+        samples[i] = simdRandom() * 128 + 128;
+
+    RTMath::setRawTriple(triples[0], 0, 0.001, true);
+    RTMath::setRawTriple(triples[1], 6, 0.25, false);
+    triples[1].axis[0] = 2;
+    triples[1].axis[2] = 0;
+    triples[1].scale[1] = -0.25;
+    RTMath::setRawTriple(triples[2], 8, 1.0 / 3, false);
+
+    RTMath::convertBatch(samples, 14, SIMD_SAMPLES, triples, 3, converted, SIMD_SAMPLES);
+    for (int n = 0; n < SIMD_SAMPLES; n++) {
+        fprintf(out, "batch");
+        for (int i = 0; i < 9; i++)
+            fprintf(out, " %.9g", converted[i * SIMD_SAMPLES + n]);
+        fprintf(out, "\n");
+        RTMath::convertToVector(samples + n * 14, vec, 0.001, true);
+        fprintf(out, "vector %.9g %.9g %.9g\n", vec.x(), vec.y(), vec.z());
+    }
+
+    simdFusion(out, RTFUSION_TYPE_KALMANSTATE4, "kalman4");
+    simdFusion(out, RTFUSION_TYPE_RTQF, "rtqf");
+    simdFusion(out, RTFUSION_TYPE_MADGWICK, "madgwick");
+    simdFusion(out, RTFUSION_TYPE_MAHONY, "mahony");
+}
+
+//  simdCompare() checks one line of results against the scalar ones
+
+static void simdCompare(char *line, char *scalarLine, unsigned long& differences, double& maxError)
+{
+    char *save, *scalarSave;
+    char *label = strtok_r(line, " \n", &save);
+    char *scalarLabel = strtok_r(scalarLine, " \n", &scalarSave);
+    char what[128];
+
+    if ((label == NULL) || (scalarLabel == NULL) || (strcmp(label, scalarLabel) != 0)) {
+        check(false, "scalar results don't match up");
+        return;
+    }
+
+    double tolerance = SIMD_MATH_TOLERANCE;
+
+    if ((strcmp(label, "kalman4") == 0) || (strcmp(label, "rtqf") == 0) ||
+            (strcmp(label, "madgwick") == 0) || (strcmp(label, "mahony") == 0)) {
+        tolerance = SIMD_FUSION_TOLERANCE;
+    }
+
+    char *value, *scalarValue;
+
+    while (true) {
+        value = strtok_r(NULL, " \n", &save);
+        scalarValue = strtok_r(NULL, " \n", &scalarSave);
+        if ((value == NULL) || (scalarValue == NULL))
+            break;
+
+        double a = strtod(value, NULL);
+        double b = strtod(scalarValue, NULL);
+        double error = fabs(a - b) / (1 + fabs(b));
+
+        if (error > maxError)
+            maxError = error;
+        if (error > tolerance) {
+            if (differences++ == 0) {
+                sprintf(what, "%s %s against scalar %s", label, value, scalarValue);
+                check(false, what);
+            }
+        }
+    }
+    sprintf(what, "%s value count", label);
+    check((value == NULL) && (scalarValue == NULL), what);
+}
+
+static void simd(const char *scalarCheck)
+{
+    char command[SIMD_LINE];
+    char line[SIMD_LINE];
+    char scalarLine[SIMD_LINE];
+    unsigned long lines = 0;
+    unsigned long differences = 0;
+    double maxError = 0;
+
+    FILE *results = tmpfile();
+    snprintf(command, sizeof(command), "%s simdvalues", scalarCheck);
+    FILE *scalarResults = popen(command, "r");
+
+    if ((results == NULL) || (scalarResults == NULL)) {
+        check(false, "running the scalar check");
+        return;
+    }
+    simdValues(results);
+    rewind(results);
+
+    //  the first line of each says which path it used
+
+    if ((fgets(line, SIMD_LINE, results) == NULL) || (fgets(scalarLine, SIMD_LINE, scalarResults) == NULL)) {
+        check(false, "reading the results");
+    } else {
+        line[strcspn(line, "\n")] = 0;
+        scalarLine[strcspn(scalarLine, "\n")] = 0;
+        printf("%s against scalar %s\n", line, scalarLine);
+        check(strcmp(scalarLine, "path none") == 0, "scalar check uses SIMD");
+    }
+
+    while (fgets(line, SIMD_LINE, results) != NULL) {
+        if (fgets(scalarLine, SIMD_LINE, scalarResults) == NULL) {
+            check(false, "scalar results too short");
+            break;
+        }
+        simdCompare(line, scalarLine, differences, maxError);
+        lines++;
+    }
+    check(fgets(scalarLine, SIMD_LINE, scalarResults) == NULL, "scalar results too long");
+
+    fclose(results);
+    check(pclose(scalarResults) == 0, "scalar check exit status");
+
+    printf("compared %lu results: %lu out of tolerance, max relative error %g\n", lines, differences, maxError);
+    check(lines > 0, "results compared");
+}
+
+int main(int argc, char **argv)
+{
+    if ((argc < 2) || (argc > 3) || ((argc == 3) != (strcmp(argv[1], "simd") == 0))) {
+        printf("Usage: RTIMULibSimCheck poll|ring|acquisition|simdvalues|simd <scalar check>\n");
+        return 1;
+    }
+
+    if (strcmp(argv[1], "poll") == 0) {
+        poll();
+    } else if (strcmp(argv[1], "ring") == 0) {
+        ring();
+    } else if (strcmp(argv[1], "acquisition") == 0) {
+        acquisition();
+    } else if (strcmp(argv[1], "simdvalues") == 0) {
+        simdValues(stdout);
+        return 0;
+    } else if (strcmp(argv[1], "simd") == 0) {
+        simd(argv[2]);
+    } else {
+        printf("Unknown check %s\n", argv[1]);
+        return 1;
+    }
+
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
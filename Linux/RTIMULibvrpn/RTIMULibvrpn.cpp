@@ -62,9 +62,11 @@ int main()
     //  now just process data
 
     while (1) {
-        //  poll at the rate recommended by the IMU
+        //  wait for the IMU's data ready interrupt if there is one, otherwise
+        //  this sleeps until the IMU's FIFO should be at the FifoPollTarget level,
+        //  or to the next poll interval on a fixed schedule for IMUs without one
 
-        usleep(imu->IMUGetPollInterval() * 1000);
+        imu->IMUWaitForData(100);
 
         //  call the vrpn main loop
 
@@ -84,6 +84,16 @@ static PyMethodDef RTIMU_RTIMU_methods[] = {
         METH_NOARGS,
     "Set up the IMU" },
 
+    //////// IMUReconfigure
+    {"IMUReconfigure", (PyCFunction)([] (PyObject *self, PyObject* args) -> PyObject* {
+        if (((RTIMU_RTIMU*)self)->val == NULL)
+            return PyBool_FromLong(0);
+        else
+            return PyBool_FromLong(((RTIMU_RTIMU*)self)->val->IMUReconfigure());
+        }),
+        METH_NOARGS,
+    "Apply changed rates, ranges and filters without a full init" },
+
   //////// IMUGetPollInterval
   {"IMUGetPollInterval", (PyCFunction)([] (PyObject *self, PyObject* args) -> PyObject* {
 #if PY_MAJOR_VERSION >= 3
@@ -145,6 +155,35 @@ static PyMethodDef RTIMU_RTIMU_methods[] = {
     METH_NOARGS,
     "Return true if valid bias" },
 
+    //////// saveFusionState
+    {"saveFusionState", (PyCFunction)([] (PyObject *self, PyObject* args) -> PyObject* {
+        unsigned char buffer[RTFUSION_STATE_MAX_LEN];
+        int length = ((RTIMU_RTIMU*)self)->val->saveFusionState(buffer, sizeof(buffer));
+#if PY_MAJOR_VERSION >= 3
+        return PyBytes_FromStringAndSize((const char *)buffer, length);
+#else
+        return PyString_FromStringAndSize((const char *)buffer, length);
+#endif
+        }),
+    METH_NOARGS,
+    "Return a checkpoint of the fusion state" },
+
+    //////// restoreFusionState
+    {"restoreFusionState", (PyCFunction)([] (PyObject *self, PyObject* args) -> PyObject* {
+        Py_buffer state;
+#if PY_MAJOR_VERSION >= 3
+        if (!PyArg_ParseTuple(args, "y*", &state))
+#else
+        if (!PyArg_ParseTuple(args, "s*", &state))
+#endif
+            return NULL;
+        bool ok = ((RTIMU_RTIMU*)self)->val->restoreFusionState((const unsigned char *)state.buf, (int)state.len);
+        PyBuffer_Release(&state);
+        return PyBool_FromLong(ok);
+        }),
+    METH_VARARGS,
+    "Restore a checkpoint from saveFusionState" },
+
     //////// setSlerpPower
     {"setSlerpPower", (PyCFunction)([] (PyObject *self, PyObject* args) -> PyObject* {
         double power;
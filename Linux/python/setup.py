@@ -31,6 +31,15 @@ import os.path
 RTIMU_sources = [
     "RTMath.cpp",
     "RTIMUHal.cpp",
+    "RTIMUTransport.cpp",
+    "RTIMUSimTransport.cpp",
+    "RTIMUBusLog.cpp",
+    "RTIMUBusRegistry.cpp",
+    "RTIMUDataReady.cpp",
+    "RTIMUFifo.cpp",
+    "RTIMURing.cpp",
+    "RTIMURegInit.cpp",
+    "RTIMUTimestamp.cpp",
     "RTFusion.cpp",
     "RTFusionKalman4.cpp",
     "RTFusionRTQF.cpp",
@@ -67,6 +76,7 @@ mod = Extension('RTIMU',
                 'PyRTIMU_RTPressure.cpp', 'PyRTIMU_RTHumidity.cpp'] +
                 [ os.path.join(RTIMU_sourcedir, sr) for sr in RTIMU_sources],
                 include_dirs = [RTIMU_sourcedir],
+                libraries = ['pthread'],
                 extra_compile_args = ['-std=c++0x'],
 #                define_macros = [("HAL_QUIET", None)]
                 )
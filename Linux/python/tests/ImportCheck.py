@@ -0,0 +1,31 @@
+# Checks that the RTIMU extension imports and that its bindings reach the
+# library. It uses the null IMU so no hardware is needed. ctest runs it after
+# building the extension, with the build directory passed as the only argument.
+
+import sys, glob, os
+
+sys.path[:0] = glob.glob(os.path.join(sys.argv[1], "lib*"))
+import RTIMU
+
+s = RTIMU.Settings("ImportCheck")
+s.IMUType = 1                                   # RTIMU_TYPE_NULL
+imu = RTIMU.RTIMU(s)
+
+failed = False
+
+def check(ok, what):
+    global failed
+    if not ok:
+        print("FAILED: " + what)
+        failed = True
+
+check(imu.IMUInit(), "IMUInit")
+check(imu.IMUReconfigure() == False, "IMUReconfigure")             # the null IMU can't
+state = imu.saveFusionState()
+check(len(state) > 0, "saveFusionState")
+check(imu.restoreFusionState(state), "restoreFusionState")
+check("fusionPoseValid" in imu.getIMUData(), "getIMUData")
+
+if failed:
+    sys.exit(1)
+print("RTIMU imported from " + RTIMU.__file__)
@@ -55,10 +55,28 @@ void FusionMadgwick::reset()
     m_measuredQPose.fromEuler(m_measuredPose);
 }
 
+void FusionMadgwick::saveFusionState(RTFusionState& state)
+{
+    state.putReal(q0);
+    state.putReal(q1);
+    state.putReal(q2);
+    state.putReal(q3);
+}
+
+void FusionMadgwick::restoreFusionState(RTFusionState& state)
+{
+    q0 = state.getReal();
+    q1 = state.getReal();
+    q2 = state.getReal();
+    q3 = state.getReal();
+}
+
 void FusionMadgwick::newIMUData(RTIMU_DATA& data, const RTIMUSettings *settings)
 {
     if (!m_enableGyro)
         data.gyro = RTVector3();
+
+    m_compassValid = data.compassValid;
         
     if (m_firstTime) {
         m_lastFusionTime = data.timestamp;
@@ -72,15 +90,21 @@ void FusionMadgwick::newIMUData(RTIMU_DATA& data, const RTIMUSettings *settings)
 
         m_firstTime = false;
     } else {
-        RTFLOAT timeDelta = (RTFLOAT)(data.timestamp - m_lastFusionTime) / (RTFLOAT)1000000;
-        m_lastFusionTime = data.timestamp;
+        RTFLOAT timeDelta = fusionTimeDelta(data.timestamp);
         if (timeDelta <= 0)
             return;
 
-        MadgwickAHRSupdate(data.gyro.x(), data.gyro.y(), data.gyro.z(),
-                           data.accel.x(), data.accel.y(), data.accel.z(),
-                           data.compass.x(), data.compass.y(), data.compass.z(),
-            timeDelta);
+        //  samples without a new compass reading only correct for the accels
+
+        if (m_compassValid)
+            MadgwickAHRSupdate(data.gyro.x(), data.gyro.y(), data.gyro.z(),
+                               data.accel.x(), data.accel.y(), data.accel.z(),
+                               data.compass.x(), data.compass.y(), data.compass.z(),
+                timeDelta);
+        else
+            MadgwickAHRSupdateIMU(data.gyro.x(), data.gyro.y(), data.gyro.z(),
+                               data.accel.x(), data.accel.y(), data.accel.z(),
+                timeDelta);
     }
 
     RTQuaternion stateQ(q0, q1, q2, q3);
@@ -132,7 +156,7 @@ static float invSqrt(float x);
 //---------------------------------------------------------------------------------------------------
 // AHRS algorithm update
 
-void FusionMadgwick::MadgwickAHRSupdate(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt) {
+RTMATH_DISPATCH void FusionMadgwick::MadgwickAHRSupdate(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt) {
         float beta = 10*m_slerpPower;
 	float recipNorm;
 	float s0, s1, s2, s3;
@@ -232,7 +256,7 @@ void FusionMadgwick::MadgwickAHRSupdate(float gx, float gy, float gz, float ax,
 //---------------------------------------------------------------------------------------------------
 // IMU algorithm update
 
-void FusionMadgwick::MadgwickAHRSupdateIMU(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+RTMATH_DISPATCH void FusionMadgwick::MadgwickAHRSupdateIMU(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
         float beta = 10*m_slerpPower;
 	float recipNorm;
 	float s0, s1, s2, s3;
@@ -308,9 +332,10 @@ void FusionMadgwick::MadgwickAHRSupdateIMU(float gx, float gy, float gz, float a
 static float invSqrt(float x) {
 	float halfx = 0.5f * x;
 	float y = x;
-	long i = *(long*)&y;
+	int32_t i;
+	memcpy(&i, &y, sizeof(i));
 	i = 0x5f3759df - (i>>1);
-	y = *(float*)&i;
+	memcpy(&y, &i, sizeof(y));
 	y = y * (1.5f - (halfx * y * y));
 	return y;
 }
@@ -50,10 +50,34 @@ void FusionMahony::reset()
     m_measuredQPose.fromEuler(m_measuredPose);
 }
 
+void FusionMahony::saveFusionState(RTFusionState& state)
+{
+    state.putReal(q0);
+    state.putReal(q1);
+    state.putReal(q2);
+    state.putReal(q3);
+    state.putReal(integralFBx);
+    state.putReal(integralFBy);
+    state.putReal(integralFBz);
+}
+
+void FusionMahony::restoreFusionState(RTFusionState& state)
+{
+    q0 = state.getReal();
+    q1 = state.getReal();
+    q2 = state.getReal();
+    q3 = state.getReal();
+    integralFBx = state.getReal();
+    integralFBy = state.getReal();
+    integralFBz = state.getReal();
+}
+
 void FusionMahony::newIMUData(RTIMU_DATA& data, const RTIMUSettings *settings)
 {
     if (!m_enableGyro)
         data.gyro = RTVector3();
+
+    m_compassValid = data.compassValid;
         
     if (m_firstTime) {
         m_lastFusionTime = data.timestamp;
@@ -67,15 +91,21 @@ void FusionMahony::newIMUData(RTIMU_DATA& data, const RTIMUSettings *settings)
 
         m_firstTime = false;
     } else {
-        RTFLOAT timeDelta = (RTFLOAT)(data.timestamp - m_lastFusionTime) / (RTFLOAT)1000000;
-        m_lastFusionTime = data.timestamp;
+        RTFLOAT timeDelta = fusionTimeDelta(data.timestamp);
         if (timeDelta <= 0)
             return;
 
-        MahonyAHRSupdate(data.gyro.x(), data.gyro.y(), data.gyro.z(),
-                           data.accel.x(), data.accel.y(), data.accel.z(),
-                           data.compass.x(), data.compass.y(), data.compass.z(),
-            timeDelta);
+        //  samples without a new compass reading only correct for the accels
+
+        if (m_compassValid)
+            MahonyAHRSupdate(data.gyro.x(), data.gyro.y(), data.gyro.z(),
+                               data.accel.x(), data.accel.y(), data.accel.z(),
+                               data.compass.x(), data.compass.y(), data.compass.z(),
+                timeDelta);
+        else
+            MahonyAHRSupdateIMU(data.gyro.x(), data.gyro.y(), data.gyro.z(),
+                               data.accel.x(), data.accel.y(), data.accel.z(),
+                timeDelta);
     }
 
     RTQuaternion stateQ(q0, q1, q2, q3);
@@ -142,7 +172,7 @@ static float invSqrt(float x);
 //---------------------------------------------------------------------------------------------------
 // AHRS algorithm update
 
-void FusionMahony::MahonyAHRSupdate(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt) {
+RTMATH_DISPATCH void FusionMahony::MahonyAHRSupdate(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt) {
 	float recipNorm;
     float q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;  
 	float hx, hy, bx, bz;
@@ -246,7 +276,7 @@ void FusionMahony::MahonyAHRSupdate(float gx, float gy, float gz, float ax, floa
 //---------------------------------------------------------------------------------------------------
 // IMU algorithm update
 
-void FusionMahony::MahonyAHRSupdateIMU(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+RTMATH_DISPATCH void FusionMahony::MahonyAHRSupdateIMU(float gx, float gy, float gz, float ax, float ay, float az, float dt) {
 	float recipNorm;
 	float halfvx, halfvy, halfvz;
 	float halfex, halfey, halfez;
@@ -318,9 +348,10 @@ void FusionMahony::MahonyAHRSupdateIMU(float gx, float gy, float gz, float ax, f
 static float invSqrt(float x) {
 	float halfx = 0.5f * x;
 	float y = x;
-	long i = *(long*)&y;
+	int32_t i;
+	memcpy(&i, &y, sizeof(i));
 	i = 0x5f3759df - (i>>1);
-	y = *(float*)&i;
+	memcpy(&y, &i, sizeof(y));
 	y = y * (1.5f - (halfx * y * y));
 	return y;
 }
@@ -46,6 +46,10 @@ public:
 
     void newIMUData(RTIMU_DATA& data, const RTIMUSettings *settings);
 
+protected:
+    virtual void saveFusionState(RTFusionState& state);
+    virtual void restoreFusionState(RTFusionState& state);
+
 private:
 
     void MahonyAHRSupdate(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt);
@@ -41,6 +41,15 @@
 #include "RTIMUBNO055.h"
 #include "RTIMULSM6DS33LIS3MDL.h"
 #include "RTIMUHMC5883LADXL345.h"
+#include "RTIMUDataReady.h"
+
+#if !defined(WIN32)
+#include <string.h>
+#include <alloca.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 //  this sets the learning rate for compass running average calculation
 
@@ -150,7 +159,19 @@ RTIMU::RTIMU(RTIMUSettings *settings)
     for (int i = 0; i < 3; i++) {
         m_runtimeMagCalMax[i] = -1000;
         m_runtimeMagCalMin[i] = 1000;
+        m_compassCalOffset[i] = 0;
+        m_compassCalScale[i] = 1;
     }
+    m_compassCalSet = false;
+
+    m_imuData = &m_imuDataStorage;
+    m_imuData->setValidMask(0);
+    m_fusionData.setValidMask(0);
+
+    //  not every driver calls setCalibrationData()
+
+    m_calibrationSequence = 0;
+    buildCalibration();
 
     switch (m_settings->m_fusionType) {
     case RTFUSION_TYPE_KALMANSTATE4:
@@ -174,19 +195,306 @@ RTIMU::RTIMU(RTIMUSettings *settings)
         break;
     }
 
+    m_dataReady = NULL;
+    m_dataReadyOwned = false;
+    m_dataReadyOpen = false;
+    m_dataReadyFailed = false;
+    m_dataReadyConfigured = false;
+    m_dataReadyActiveLow = false;
+    m_pollNext = 0;
+
+    m_gyroBiasTempValid = false;
+    m_gyroBiasTemp = 0;
+    m_gyroBiasRecordCount = 0;
+
+    m_savedSampleRate = 0;
+    m_savedSampleInterval = 0;
+    m_savedCompassInterval = 0;
+
+    m_compassInterval = 0;
+    m_compassNext = 0;
+    m_compassCheckTime = 0;
+    m_compassMissed = false;
+
+    m_acquisitionRunning = false;
+    m_acquisitionStop = false;
+    m_acquisitionRing = NULL;
+    m_acquisitionCallback = NULL;
+    m_acquisitionContext = NULL;
+
     static bool once;
     if(!once) {
         once = true;
         HAL_INFO1("Using fusion algorithm %s\n", RTFusion::fusionName(m_settings->m_fusionType));
+        HAL_INFO1("Using %s math kernels\n", RTMath::simdPath());
     }
 }
 
 RTIMU::~RTIMU()
 {
+    //  each driver's destructor stops the acquisition thread - if it's still running here
+    //  the driver didn't, and the thread could be calling into a subclass that has already
+    //  gone, so stop it before anything else goes
+
+    if (m_acquisitionRunning) {
+        HAL_ERROR("RTIMU destroyed with acquisition thread running - stopping it now\n");
+        stopAcquisition();
+    }
     delete m_fusion;
     m_fusion = NULL;
+    IMUSetDataReady(NULL);
+}
+
+void RTIMU::IMUSetDataStorage(RTIMU_DATA *data)
+{
+    if (data == NULL)
+        data = &m_imuDataStorage;
+
+    //  the sample carries on from where it was
+
+    if (data != m_imuData) {
+        *data = *m_imuData;
+        m_imuData = data;
+    }
+}
+
+void RTIMU::IMUSetDataReady(RTIMUDataReady *dataReady)
+{
+    if (m_dataReadyOpen)
+        m_dataReady->close();
+    if (m_dataReadyOwned)
+        delete m_dataReady;
+
+    m_dataReady = dataReady;
+    m_dataReadyOwned = false;
+    m_dataReadyOpen = false;
+    m_dataReadyFailed = false;
+}
+
+bool RTIMU::dataReadyEnabled()
+{
+    return (m_dataReady != NULL) || (m_settings->m_dataReadyGPIOChip >= 0);
+}
+
+RTIMUDataReady *RTIMU::dataReadySource()
+{
+    if (!m_dataReadyConfigured || m_dataReadyFailed)
+        return NULL;
+
+    if (m_dataReadyOpen)
+        return m_dataReady;
+
+#if !defined(WIN32) && !defined(__APPLE__)
+    if ((m_dataReady == NULL) && (m_settings->m_dataReadyGPIOChip >= 0)) {
+        m_dataReady = new RTIMUGPIODataReady(m_settings->m_dataReadyGPIOChip, m_settings->m_dataReadyGPIOLine);
+        m_dataReadyOwned = true;
+    }
+#endif
+
+    //  if the source can't be opened carry on by polling
+
+    if ((m_dataReady == NULL) || !m_dataReady->open(m_dataReadyActiveLow)) {
+        m_dataReadyFailed = true;
+        return NULL;
+    }
+    m_dataReadyOpen = true;
+    return m_dataReady;
+}
+
+bool RTIMU::IMUWaitForData(int timeoutMs)
+{
+    RTIMUDataReady *dataReady = dataReadySource();
+    uint64_t interval;
+    uint64_t deadline;
+    uint64_t now;
+
+    if (dataReady != NULL)
+        return dataReady->wait(timeoutMs);
+
+    now = m_settings->HALTimestamp();
+    deadline = m_fifo.nextRead(m_timestamp.getSampleInterval(), m_settings->m_fifoPollTarget,
+                               now + (uint64_t)timeoutMs * 1000);
+
+    if (deadline == 0) {
+        //  the intervals are kept on a fixed schedule so that they don't drift but if the
+        //  caller has fallen more than one behind it starts again from now
+
+        interval = (uint64_t)IMUGetPollInterval() * 1000;
+        m_pollNext += interval;
+        if ((m_pollNext + interval < now) || (m_pollNext > now + interval))
+            m_pollNext = now + interval;
+        deadline = m_pollNext;
+    }
+
+    if (deadline > now + (uint64_t)timeoutMs * 1000)
+        deadline = now + (uint64_t)timeoutMs * 1000;
+    m_settings->delayUntil(deadline);
+    return true;
+}
+
+int RTIMU::IMUGetDataReadyFd()
+{
+    RTIMUDataReady *dataReady = dataReadySource();
+
+    return dataReady != NULL ? dataReady->getFd() : -1;
+}
+
+bool RTIMU::startAcquisition(RTIMURing *ring, RTIMUSampleCallback callback, void *context)
+{
+#if !defined(WIN32)
+    if (m_acquisitionRunning) {
+        HAL_ERROR("Acquisition thread already running\n");
+        return false;
+    }
+    m_acquisitionRing = ring;
+    m_acquisitionCallback = callback;
+    m_acquisitionContext = context;
+    m_acquisitionStop = false;
+
+    if (pthread_create(&m_acquisitionThread, NULL, acquisitionThread, this) != 0) {
+        HAL_ERROR("Failed to start acquisition thread\n");
+        return false;
+    }
+    m_acquisitionRunning = true;
+    return true;
+#else
+    (void)ring;
+    (void)callback;
+    (void)context;
+    HAL_ERROR("Acquisition thread not supported on this platform\n");
+    return false;
+#endif
+}
+
+void RTIMU::stopAcquisition()
+{
+    if (!m_acquisitionRunning)
+        return;
+
+#if !defined(WIN32)
+    m_acquisitionStop = true;
+    pthread_join(m_acquisitionThread, NULL);
+#endif
+    m_acquisitionRunning = false;
 }
 
+#if !defined(WIN32)
+
+#if defined(__linux__)
+
+//  glibc has no wrapper for sched_setattr() so this is the kernel's structure
+
+typedef struct
+{
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;                                 // in nS
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+} RTIMU_SCHED_ATTR;
+
+#define RTIMU_SCHED_DEADLINE                6
+
+#endif
+
+void RTIMU::acquisitionSetup()
+{
+    struct sched_param param;
+    int err;
+
+    switch (m_settings->m_acquisitionPolicy) {
+    case RTIMU_ACQUISITION_NORMAL:
+        break;
+
+    case RTIMU_ACQUISITION_FIFO:
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = m_settings->m_acquisitionPriority;
+        if ((err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) != 0)
+            HAL_ERROR2("Failed to set acquisition thread to SCHED_FIFO priority %d - error %d\n",
+                       m_settings->m_acquisitionPriority, err);
+        break;
+
+    case RTIMU_ACQUISITION_DEADLINE:
+#if defined(__linux__) && defined(SYS_sched_setattr)
+    {
+        RTIMU_SCHED_ATTR attr;
+        uint64_t period = (uint64_t)IMUGetPollInterval() * 1000000;
+
+        if (period == 0)
+            period = 1000000;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.sched_policy = RTIMU_SCHED_DEADLINE;
+        attr.sched_runtime = (uint64_t)m_settings->m_acquisitionRuntime * 1000;
+        attr.sched_deadline = period;
+        attr.sched_period = period;
+        if (syscall(SYS_sched_setattr, 0, &attr, 0) != 0)
+            HAL_ERROR2("Failed to set acquisition thread to SCHED_DEADLINE %duS every %dmS\n",
+                       m_settings->m_acquisitionRuntime, IMUGetPollInterval());
+    }
+#else
+        HAL_ERROR("SCHED_DEADLINE not supported on this platform\n");
+#endif
+        break;
+
+    default:
+        HAL_ERROR1("Invalid acquisition policy %d\n", m_settings->m_acquisitionPolicy);
+        break;
+    }
+
+    if (m_settings->m_acquisitionCPU >= 0) {
+#if defined(__linux__)
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+        CPU_SET(m_settings->m_acquisitionCPU, &cpus);
+        if ((err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)) != 0)
+            HAL_ERROR2("Failed to pin acquisition thread to CPU %d - error %d\n",
+                       m_settings->m_acquisitionCPU, err);
+#else
+        HAL_ERROR("Acquisition CPU not supported on this platform\n");
+#endif
+    }
+
+    if (m_settings->m_acquisitionLockMemory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+            HAL_ERROR("Failed to lock memory for acquisition thread\n");
+    }
+
+    //  touching the stack now means its pages are there (and locked) before the first sample
+
+    if (m_settings->m_acquisitionStackPrefault > 0) {
+        size_t size = (size_t)m_settings->m_acquisitionStackPrefault * 1024;
+        volatile unsigned char *stack = (volatile unsigned char *)alloca(size);
+
+        for (size_t i = 0; i < size; i += 4096)
+            stack[i] = 0;
+    }
+}
+
+void *RTIMU::acquisitionThread(void *arg)
+{
+    RTIMU *imu = (RTIMU *)arg;
+
+    imu->acquisitionSetup();
+
+    while (!imu->m_acquisitionStop) {
+        imu->IMUWaitForData(100);
+        while (!imu->m_acquisitionStop && imu->IMURead()) {
+            if (imu->m_acquisitionRing != NULL)
+                imu->m_acquisitionRing->push(*imu->m_imuData);
+            if (imu->m_acquisitionCallback != NULL)
+                imu->m_acquisitionCallback(*imu->m_imuData, imu->m_acquisitionContext);
+        }
+    }
+    return NULL;
+}
+
+#endif
+
 void RTIMU::setCalibrationData()
 {
     float maxDelta = -1;
@@ -201,6 +509,8 @@ void RTIMU::setCalibrationData()
         }
         if (maxDelta < 0) {
             HAL_ERROR("Error in compass calibration data\n");
+            m_compassCalSet = false;
+            buildCalibration();
             return;
         }
         maxDelta /= 2.0f;                                       // this is the max +/- range
@@ -210,8 +520,11 @@ void RTIMU::setCalibrationData()
             m_compassCalScale[i] = maxDelta / delta;            // makes everything the same range
             m_compassCalOffset[i] = (m_settings->m_compassCalMax.data(i) + m_settings->m_compassCalMin.data(i)) / 2.0f;
         }
+        m_compassCalSet = true;
     }
 
+    buildCalibration();
+
     if (m_settings->m_compassCalValid) {
         HAL_INFO("Using min/max compass calibration\n");
     } else {
@@ -232,17 +545,183 @@ void RTIMU::setCalibrationData()
 }
 
 
+void RTIMU::buildCalibration()
+{
+    RTIMU_CALIBRATION cal;
+    RTFLOAT rotation[3][3];
+    RTFLOAT ellipsoid[3][3];
+    RTFLOAT compassScale[3];
+    RTFLOAT compassOffset[3];
+    RTFLOAT compassMatrix[3][3];
+    RTFLOAT compassBias[3];
+    bool minMax = (getCompassCalibrationValid() || getRuntimeCompassCalibrationValid()) && m_compassCalSet;
+    bool useEllipsoid = m_settings->m_compassCalEllipsoidValid;
+
+    //  the axis rotation has a single +/-1 in each row
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            rotation[i][j] = (i == j) ? 1 : 0;
+
+    if ((m_settings->m_axisRotation > 0) && (m_settings->m_axisRotation < RTIMU_AXIS_ROTATION_COUNT)) {
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                rotation[i][j] = m_axisRotation[m_settings->m_axisRotation][3 * i + j];
+    }
+
+    //  the gyro is only rotated
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++)
+            cal.gyro.matrix[i][j] = rotation[i][j];
+        cal.gyro.offset[i] = 0;
+    }
+
+    //  the accel calibration maps min..max to -1..1 on each axis
+
+    for (int i = 0; i < 3; i++) {
+        cal.accelCalScale[i] = 1;
+        cal.accelCalOffset[i] = 0;
+    }
+
+    if (getAccelCalibrationValid()) {
+        for (int i = 0; i < 3; i++) {
+            RTFLOAT b = (m_settings->m_accelCalMin.data(i) + m_settings->m_accelCalMax.data(i)) / 2;
+            RTFLOAT s = (m_settings->m_accelCalMax.data(i) - m_settings->m_accelCalMin.data(i)) / 2;
+            cal.accelCalScale[i] = 1 / s;
+            cal.accelCalOffset[i] = -b / s;
+        }
+    }
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++)
+            cal.accel.matrix[i][j] = rotation[i][j] * cal.accelCalScale[j];
+        cal.accel.offset[i] = 0;
+        for (int j = 0; j < 3; j++)
+            cal.accel.offset[i] += rotation[i][j] * cal.accelCalOffset[j];
+    }
+
+    //  the compass is (c - offset) * scale from the min/max calibration, then
+    //  ellipsoidCorr * (c - ellipsoidOffset), then rotated
+
+    for (int i = 0; i < 3; i++) {
+        compassScale[i] = minMax ? m_compassCalScale[i] : 1;
+        compassOffset[i] = minMax ? m_compassCalOffset[i] : 0;
+        for (int j = 0; j < 3; j++)
+            ellipsoid[i][j] = useEllipsoid ? m_settings->m_compassCalEllipsoidCorr[i][j] : ((i == j) ? 1 : 0);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        compassBias[i] = -compassOffset[i] * compassScale[i];
+        if (useEllipsoid)
+            compassBias[i] -= m_settings->m_compassCalEllipsoidOffset.data(i);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            compassMatrix[i][j] = 0;
+            for (int k = 0; k < 3; k++)
+                compassMatrix[i][j] += rotation[i][k] * ellipsoid[k][j];
+        }
+    }
+
+    for (int i = 0; i < 3; i++) {
+        cal.compass.offset[i] = 0;
+        for (int j = 0; j < 3; j++) {
+            cal.compass.matrix[i][j] = compassMatrix[i][j] * compassScale[j];
+            cal.compass.offset[i] += compassMatrix[i][j] * compassBias[j];
+        }
+    }
+
+    //  an even sequence is taken to odd to keep other writers out while it's copied in
+
+    unsigned int sequence;
+
+    do {
+        sequence = m_calibrationSequence.load(std::memory_order_relaxed) & ~1u;
+    } while (!m_calibrationSequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire));
+    std::atomic_thread_fence(std::memory_order_release);
+    m_calibration = cal;
+    m_calibrationSequence.store(sequence + 2, std::memory_order_release);
+}
+
+void RTIMU::getCalibration(RTIMU_CALIBRATION& cal)
+{
+    unsigned int sequence;
+
+    do {
+        while ((sequence = m_calibrationSequence.load(std::memory_order_acquire)) & 1)
+            ;
+        cal = m_calibration;
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while (m_calibrationSequence.load(std::memory_order_relaxed) != sequence);
+}
+
 void RTIMU::gyroBiasInit()
 {
     m_fusion->gyroBiasInit(m_sampleRate);
 }
 
+void RTIMU::gyroBiasSeed(RTFLOAT temperature)
+{
+    RTVector3 bias;
+
+    m_gyroBiasTempValid = true;
+    m_gyroBiasTemp = temperature;
+    m_gyroBiasRecordCount = 0;
+
+    if (!m_settings->getGyroBiasAt(temperature, bias))
+        return;
+
+    m_settings->m_gyroBias = bias;
+    m_settings->m_gyroBiasValid = true;
+    m_fusion->gyroBiasSkipStartup();
+    HAL_INFO1("Using gyro bias recorded at %.1fC\n", temperature);
+}
+
 //  Note - code assumes that this is the first thing called after axis swapping
 //  for each specific IMU chip has occurred.
 
 void RTIMU::handleGyroBias()
 {
-    m_fusion->handleGyroBias(m_imuData, m_settings);
+    m_fusion->handleGyroBias(*m_imuData, m_settings);
+
+    //  record the bias for the current die temperature about once a second, as the
+    //  part warms up the bias changes with it
+
+    if (m_gyroBiasTempValid && m_settings->m_gyroBiasValid && !m_fusion->gyroBiasStartup() &&
+            (++m_gyroBiasRecordCount >= m_sampleRate)) {
+        m_gyroBiasRecordCount = 0;
+        if (readTemperature(m_gyroBiasTemp))
+            m_settings->setGyroBiasAt(m_gyroBiasTemp, m_settings->m_gyroBias);
+    }
+}
+
+void RTIMU::reconfigureBegin()
+{
+    m_savedSampleRate = m_sampleRate;
+    m_savedSampleInterval = m_sampleInterval;
+    m_savedCompassInterval = m_compassInterval;
+}
+
+void RTIMU::reconfigureAbandon()
+{
+    m_sampleRate = m_savedSampleRate;
+    m_sampleInterval = m_savedSampleInterval;
+    compassSetInterval(m_savedCompassInterval);
+    m_regInit.discard();
+}
+
+void RTIMU::reconfigureEnd(bool changed)
+{
+    if (!changed)
+        return;
+
+    //  the gyro bias is in radians/sec so only the learning rates depend on the sample rate
+
+    if (m_sampleRate != m_savedSampleRate)
+        m_fusion->gyroBiasSetRate(m_sampleRate);
+    m_timestamp.reset(m_sampleInterval);
 }
 
 void RTIMU::calibrateAverageCompass()
@@ -255,29 +734,29 @@ void RTIMU::calibrateAverageCompass()
 
         // see if there is a new max or min
 
-        if (m_runtimeMagCalMax[0] < m_imuData.compass.x()) {
-            m_runtimeMagCalMax[0] = m_imuData.compass.x();
+        if (m_runtimeMagCalMax[0] < m_imuData->compass.x()) {
+            m_runtimeMagCalMax[0] = m_imuData->compass.x();
             changed = true;
         }
-        if (m_runtimeMagCalMax[1] < m_imuData.compass.y()) {
-            m_runtimeMagCalMax[1] = m_imuData.compass.y();
+        if (m_runtimeMagCalMax[1] < m_imuData->compass.y()) {
+            m_runtimeMagCalMax[1] = m_imuData->compass.y();
             changed = true;
         }
-        if (m_runtimeMagCalMax[2] < m_imuData.compass.z()) {
-            m_runtimeMagCalMax[2] = m_imuData.compass.z();
+        if (m_runtimeMagCalMax[2] < m_imuData->compass.z()) {
+            m_runtimeMagCalMax[2] = m_imuData->compass.z();
             changed = true;
         }
 
-        if (m_runtimeMagCalMin[0] > m_imuData.compass.x()) {
-            m_runtimeMagCalMin[0] = m_imuData.compass.x();
+        if (m_runtimeMagCalMin[0] > m_imuData->compass.x()) {
+            m_runtimeMagCalMin[0] = m_imuData->compass.x();
             changed = true;
         }
-        if (m_runtimeMagCalMin[1] > m_imuData.compass.y()) {
-            m_runtimeMagCalMin[1] = m_imuData.compass.y();
+        if (m_runtimeMagCalMin[1] > m_imuData->compass.y()) {
+            m_runtimeMagCalMin[1] = m_imuData->compass.y();
             changed = true;
         }
-        if (m_runtimeMagCalMin[2] > m_imuData.compass.z()) {
-            m_runtimeMagCalMin[2] = m_imuData.compass.z();
+        if (m_runtimeMagCalMin[2] > m_imuData->compass.z()) {
+            m_runtimeMagCalMin[2] = m_imuData->compass.z();
             changed = true;
         }
 
@@ -331,13 +810,55 @@ void RTIMU::calibrateAverageCompass()
 
 #if 0 // this doesn't work, fit ellipsoid to sigma points instead
     //  update running average
-    m_compassAverage.setX(m_imuData.compass.x() * COMPASS_ALPHA + m_compassAverage.x() * (1.0 - COMPASS_ALPHA));
-    m_compassAverage.setY(m_imuData.compass.y() * COMPASS_ALPHA + m_compassAverage.y() * (1.0 - COMPASS_ALPHA));
-    m_compassAverage.setZ(m_imuData.compass.z() * COMPASS_ALPHA + m_compassAverage.z() * (1.0 - COMPASS_ALPHA));
-    m_imuData.compass = m_compassAverage;
+    m_compassAverage.setX(m_imuData->compass.x() * COMPASS_ALPHA + m_compassAverage.x() * (1.0 - COMPASS_ALPHA));
+    m_compassAverage.setY(m_imuData->compass.y() * COMPASS_ALPHA + m_compassAverage.y() * (1.0 - COMPASS_ALPHA));
+    m_compassAverage.setZ(m_imuData->compass.z() * COMPASS_ALPHA + m_compassAverage.z() * (1.0 - COMPASS_ALPHA));
+    m_imuData->compass = m_compassAverage;
 #endif
 }
 
+void RTIMU::compassSetInterval(uint64_t interval)
+{
+    m_compassInterval = interval;
+    m_compassNext = 0;
+    m_compassMissed = false;
+}
+
+bool RTIMU::compassDue()
+{
+    m_compassCheckTime = m_settings->HALTimestamp();
+    if ((m_compassInterval == 0) || (m_compassCheckTime >= m_compassNext))
+        return true;
+
+    m_imuData->compassValid = false;
+    return false;
+}
+
+void RTIMU::compassRead(bool newData)
+{
+    m_imuData->compassValid = newData;
+
+    if (m_compassInterval == 0)
+        return;
+
+    //  if there wasn't a new sample try again next time
+
+    if (!newData) {
+        m_compassMissed = true;
+        return;
+    }
+
+    //  The schedule steps by the interval so that poll jitter doesn't build up. It's
+    //  restarted from now after a miss, when the sample has only just arrived, or if
+    //  it has fallen behind.
+
+    if (m_compassMissed || (m_compassNext + m_compassInterval <= m_compassCheckTime))
+        m_compassNext = m_compassCheckTime + m_compassInterval;
+    else
+        m_compassNext += m_compassInterval;
+    m_compassMissed = false;
+}
+
 void RTIMU::calibrateAccel()
 {
     return; // unreliable method
@@ -345,125 +866,62 @@ void RTIMU::calibrateAccel()
     if (!getAccelCalibrationValid())
         return;
 
-    if (m_imuData.accel.x() >= 0)
-        m_imuData.accel.setX(m_imuData.accel.x() / m_settings->m_accelCalMax.x());
+    if (m_imuData->accel.x() >= 0)
+        m_imuData->accel.setX(m_imuData->accel.x() / m_settings->m_accelCalMax.x());
     else
-        m_imuData.accel.setX(m_imuData.accel.x() / -m_settings->m_accelCalMin.x());
+        m_imuData->accel.setX(m_imuData->accel.x() / -m_settings->m_accelCalMin.x());
 
-    if (m_imuData.accel.y() >= 0)
-        m_imuData.accel.setY(m_imuData.accel.y() / m_settings->m_accelCalMax.y());
+    if (m_imuData->accel.y() >= 0)
+        m_imuData->accel.setY(m_imuData->accel.y() / m_settings->m_accelCalMax.y());
     else
-        m_imuData.accel.setY(m_imuData.accel.y() / -m_settings->m_accelCalMin.y());
+        m_imuData->accel.setY(m_imuData->accel.y() / -m_settings->m_accelCalMin.y());
 
-    if (m_imuData.accel.z() >= 0)
-        m_imuData.accel.setZ(m_imuData.accel.z() / m_settings->m_accelCalMax.z());
+    if (m_imuData->accel.z() >= 0)
+        m_imuData->accel.setZ(m_imuData->accel.z() / m_settings->m_accelCalMax.z());
     else
-        m_imuData.accel.setZ(m_imuData.accel.z() / -m_settings->m_accelCalMin.z());
+        m_imuData->accel.setZ(m_imuData->accel.z() / -m_settings->m_accelCalMin.z());
 }
 
 RTVector3 RTIMU::CalibratedAccel()
 {
-    RTVector3 accel = m_imuData.accel;
-    // apply accelerometer calibration
-    if (getAccelCalibrationValid()) {
-        RTVector3 min = m_settings->m_accelCalMin, max = m_settings->m_accelCalMax;
-        float b[3] = {(min.x() + max.x()) / 2, (min.y() + max.y()) / 2, (min.z() + max.z()) / 2};
-        float s[3] = {(max.x() - min.x()) / 2, (max.y() - min.y()) / 2, (max.z() - min.z()) / 2};
-        RTVector3 a = accel;
-        accel.setX((accel.x() - b[0]) / s[0]);
-        accel.setY((accel.y() - b[1]) / s[1]);
-        accel.setZ((accel.z() - b[2]) / s[2]);
-        //printf("applied accel %f %f %f %f %f %f \n", a.x(), a.y(), a.z(), accel.x(), accel.y(), accel.z());
-    }
+    RTIMU_CALIBRATION cal;
+    RTVector3 accel;
+
+    getCalibration(cal);
+    for (int i = 0; i < 3; i++)
+        accel.setData(i, m_imuData->accel.data(i) * cal.accelCalScale[i] + cal.accelCalOffset[i]);
     return accel;
 }
 
-void RTIMU::updateFusion()
+static inline void applyTransform(const RTIMU_TRANSFORM& transform, const RTVector3& in, RTVector3& out)
 {
-    RTIMU_DATA imuData = m_imuData;
-
-    imuData.accel = CalibratedAccel();
-    
-        // apply ellipsoid parameters
-    if (getCompassCalibrationValid() || getRuntimeCompassCalibrationValid()) {
-        imuData.compass.setX((imuData.compass.x() - m_compassCalOffset[0]) * m_compassCalScale[0]);
-        imuData.compass.setY((imuData.compass.y() - m_compassCalOffset[1]) * m_compassCalScale[1]);
-        imuData.compass.setZ((imuData.compass.z() - m_compassCalOffset[2]) * m_compassCalScale[2]);
-    }
-    if (m_settings->m_compassCalEllipsoidValid) {
-        RTVector3 ev = imuData.compass;
-        ev -= m_settings->m_compassCalEllipsoidOffset;
+    RTFLOAT x = in.x(), y = in.y(), z = in.z();
 
-        imuData.compass.setX(ev.x() * m_settings->m_compassCalEllipsoidCorr[0][0] +
-                             ev.y() * m_settings->m_compassCalEllipsoidCorr[0][1] +
-                             ev.z() * m_settings->m_compassCalEllipsoidCorr[0][2]);
+    for (int i = 0; i < 3; i++)
+        out.setData(i, transform.matrix[i][0] * x + transform.matrix[i][1] * y + transform.matrix[i][2] * z + transform.offset[i]);
+}
 
-        imuData.compass.setY(ev.x() * m_settings->m_compassCalEllipsoidCorr[1][0] +
-                             ev.y() * m_settings->m_compassCalEllipsoidCorr[1][1] +
-                             ev.z() * m_settings->m_compassCalEllipsoidCorr[1][2]);
+void RTIMU::updateFusion()
+{
+    RTIMU_CALIBRATION cal;
 
-        imuData.compass.setZ(ev.x() * m_settings->m_compassCalEllipsoidCorr[2][0] +
-                             ev.y() * m_settings->m_compassCalEllipsoidCorr[2][1] +
-                             ev.z() * m_settings->m_compassCalEllipsoidCorr[2][2]);
-    }
+    getCalibration(cal);
 
-    if ((m_settings->m_axisRotation > 0) && (m_settings->m_axisRotation < RTIMU_AXIS_ROTATION_COUNT)) {
-        // need to do an axis rotation
-        float *matrix = m_axisRotation[m_settings->m_axisRotation];
-        RTIMU_DATA tempIMU = imuData;
-
-        // do new x value
-        if (matrix[0] != 0) {
-            imuData.gyro.setX(tempIMU.gyro.x() * matrix[0]);
-            imuData.accel.setX(tempIMU.accel.x() * matrix[0]);
-            imuData.compass.setX(tempIMU.compass.x() * matrix[0]);
-        } else if (matrix[1] != 0) {
-            imuData.gyro.setX(tempIMU.gyro.y() * matrix[1]);
-            imuData.accel.setX(tempIMU.accel.y() * matrix[1]);
-            imuData.compass.setX(tempIMU.compass.y() * matrix[1]);
-        } else if (matrix[2] != 0) {
-            imuData.gyro.setX(tempIMU.gyro.z() * matrix[2]);
-            imuData.accel.setX(tempIMU.accel.z() * matrix[2]);
-            imuData.compass.setX(tempIMU.compass.z() * matrix[2]);
-        }
+    //  the fusion works on the calibrated data in m_fusionData so that the sample
+    //  keeps the sensor values
 
-        // do new y value
-        if (matrix[3] != 0) {
-            imuData.gyro.setY(tempIMU.gyro.x() * matrix[3]);
-            imuData.accel.setY(tempIMU.accel.x() * matrix[3]);
-            imuData.compass.setY(tempIMU.compass.x() * matrix[3]);
-        } else if (matrix[4] != 0) {
-            imuData.gyro.setY(tempIMU.gyro.y() * matrix[4]);
-            imuData.accel.setY(tempIMU.accel.y() * matrix[4]);
-            imuData.compass.setY(tempIMU.compass.y() * matrix[4]);
-        } else if (matrix[5] != 0) {
-            imuData.gyro.setY(tempIMU.gyro.z() * matrix[5]);
-            imuData.accel.setY(tempIMU.accel.z() * matrix[5]);
-            imuData.compass.setY(tempIMU.compass.z() * matrix[5]);
-        }
+    m_fusionData.timestamp = m_imuData->timestamp;
+    m_fusionData.setValidMask(m_imuData->validMask());
+    applyTransform(cal.gyro, m_imuData->gyro, m_fusionData.gyro);
+    applyTransform(cal.accel, m_imuData->accel, m_fusionData.accel);
+    applyTransform(cal.compass, m_imuData->compass, m_fusionData.compass);
 
-        // do new z value
-        if (matrix[6] != 0) {
-            imuData.gyro.setZ(tempIMU.gyro.x() * matrix[6]);
-            imuData.accel.setZ(tempIMU.accel.x() * matrix[6]);
-            imuData.compass.setZ(tempIMU.compass.x() * matrix[6]);
-        } else if (matrix[7] != 0) {
-            imuData.gyro.setZ(tempIMU.gyro.y() * matrix[7]);
-            imuData.accel.setZ(tempIMU.accel.y() * matrix[7]);
-            imuData.compass.setZ(tempIMU.compass.y() * matrix[7]);
-        } else if (matrix[8] != 0) {
-            imuData.gyro.setZ(tempIMU.gyro.z() * matrix[8]);
-            imuData.accel.setZ(tempIMU.accel.z() * matrix[8]);
-            imuData.compass.setZ(tempIMU.compass.z() * matrix[8]);
-        }
-    }
-    
-    m_fusion->newIMUData(imuData, m_settings);
+    m_fusion->newIMUData(m_fusionData, m_settings);
 
-    m_imuData.fusionPoseValid = imuData.fusionPoseValid;
-    m_imuData.fusionQPoseValid = imuData.fusionQPoseValid;
-    m_imuData.fusionPose = imuData.fusionPose;
-    m_imuData.fusionQPose = imuData.fusionQPose;
+    m_imuData->fusionPoseValid = m_fusionData.fusionPoseValid;
+    m_imuData->fusionQPoseValid = m_fusionData.fusionQPoseValid;
+    m_imuData->fusionPose = m_fusionData.fusionPose;
+    m_imuData->fusionQPose = m_fusionData.fusionQPose;
 }
 
 bool RTIMU::IMUGyroBiasValid()
@@ -471,18 +929,23 @@ bool RTIMU::IMUGyroBiasValid()
     return m_settings->m_gyroBiasValid;
 }
 
+bool RTIMU::saveGyroBiasTable()
+{
+    return m_settings->saveSettings();
+}
+
 void RTIMU::setExtIMUData(RTFLOAT gx, RTFLOAT gy, RTFLOAT gz, RTFLOAT ax, RTFLOAT ay, RTFLOAT az,
                           RTFLOAT mx, RTFLOAT my, RTFLOAT mz, uint64_t timestamp)
 {
-     m_imuData.gyro.setX(gx);
-     m_imuData.gyro.setY(gy);
-     m_imuData.gyro.setZ(gz);
-     m_imuData.accel.setX(ax);
-     m_imuData.accel.setY(ay);
-     m_imuData.accel.setZ(az);
-     m_imuData.compass.setX(mx);
-     m_imuData.compass.setY(my);
-     m_imuData.compass.setZ(mz);
-     m_imuData.timestamp = timestamp;
+     m_imuData->gyro.setX(gx);
+     m_imuData->gyro.setY(gy);
+     m_imuData->gyro.setZ(gz);
+     m_imuData->accel.setX(ax);
+     m_imuData->accel.setY(ay);
+     m_imuData->accel.setZ(az);
+     m_imuData->compass.setX(mx);
+     m_imuData->compass.setY(my);
+     m_imuData->compass.setZ(mz);
+     m_imuData->timestamp = timestamp;
      updateFusion();
 }
@@ -28,6 +28,16 @@
 #include "RTFusion.h"
 #include "RTIMULibDefs.h"
 #include "RTIMUSettings.h"
+#include "RTIMUTimestamp.h"
+#include "RTIMUFifo.h"
+#include "RTIMURegInit.h"
+#include "RTIMURing.h"
+
+#include <atomic>
+
+#if !defined(WIN32)
+#include <pthread.h>
+#endif
 
 //  Axis rotation defs
 //
@@ -63,6 +73,31 @@
 
 #define RTIMU_AXIS_ROTATION_COUNT       24
 
+//  RTIMU_TRANSFORM is a sensor's calibration and axis rotation folded into one affine
+//  transform, out = matrix * in + offset.
+
+typedef struct
+{
+    RTFLOAT matrix[3][3];
+    RTFLOAT offset[3];
+} RTIMU_TRANSFORM;
+
+typedef struct
+{
+    RTIMU_TRANSFORM gyro;
+    RTIMU_TRANSFORM accel;
+    RTIMU_TRANSFORM compass;
+    RTFLOAT accelCalScale[3];                               // the accel calibration alone, for CalibratedAccel()
+    RTFLOAT accelCalOffset[3];
+} RTIMU_CALIBRATION;
+
+class RTIMUDataReady;
+
+//  The callback for samples from the acquisition thread. It runs on that thread, so it
+//  should return quickly and not call back into the RTIMU.
+
+typedef void (*RTIMUSampleCallback)(const RTIMU_DATA& data, void *context);
+
 class RTIMU
 {
 public:
@@ -83,6 +118,41 @@ public:
     virtual int IMUGetPollInterval() = 0;                   // returns the recommended poll interval in mS
     virtual bool IMURead() = 0;                             // get a sample
 
+    //  IMUReconfigure() applies changed sample rates, full scale ranges and filters in the
+    //  settings to a running IMU. Only the registers that change are written and any samples
+    //  buffered in the IMU are discarded, but the fusion state and gyro bias are kept. It
+    //  returns false if the driver can't do this or the new settings are invalid, and then
+    //  the IMU has to be created again.
+
+    virtual bool IMUReconfigure() { return false; }
+
+    //  IMUWaitForData() blocks until the IMU signals data ready or timeoutMs passes and
+    //  returns true if there may be data for IMURead(). The source is the GPIO line in the
+    //  settings or one set with IMUSetDataReady() before IMUInit(). If there isn't one, or
+    //  the driver can't drive its interrupt pin, it sleeps until the FIFO is expected to be
+    //  at the FifoPollTarget level, or to the next poll interval for IMUs without one.
+    //  IMUGetDataReadyFd() returns a descriptor for poll()/select() or -1 if there is none.
+
+    void IMUSetDataReady(RTIMUDataReady *dataReady);        // caller keeps ownership
+    bool IMUWaitForData(int timeoutMs);
+    int IMUGetDataReadyFd();
+
+    //  IMUGetDroppedSamples() is the number of samples the driver knows it has lost from its
+    //  FIFO through overflows and resynchronization. It is always 0 for IMUs read without one.
+
+    unsigned long IMUGetDroppedSamples() { return m_fifo.getDropped(); }
+
+    //  startAcquisition() starts a thread that waits for data with IMUWaitForData() and reads
+    //  every sample after IMUInit(), pushing each into ring and passing it to callback. Either
+    //  can be NULL. The thread is scheduled, pinned and its memory locked as the Acquisition
+    //  settings say; failures there are logged and the thread runs anyway. Only the thread
+    //  may call IMURead() until stopAcquisition(), which returns once it has exited. Driver
+    //  destructors stop it, so subclasses of a driver must call stopAcquisition() in theirs.
+
+    bool startAcquisition(RTIMURing *ring, RTIMUSampleCallback callback = NULL, void *context = NULL);
+    void stopAcquisition();
+    bool acquisitionRunning() { return m_acquisitionRunning; }
+
     // setGyroContinuousALearninglpha allows the continuous learning rate to be over-ridden
     // The value must be between 0.0 and 1.0 and will generally be close to 0
 
@@ -92,6 +162,12 @@ public:
 
     virtual bool IMUGyroBiasValid();
 
+    //  saveGyroBiasTable() saves the gyro bias recorded at each die temperature to the
+    //  settings file. The IMU only records it in memory, so apps should call this before
+    //  they exit to start with the right bias next time. It returns false if the save fails.
+
+    bool saveGyroBiasTable();
+
     //  the following function can be called to set the SLERP power
 
     void setSlerpPower(RTFLOAT power) { m_fusion->setSlerpPower(power); }
@@ -100,6 +176,14 @@ public:
 
     void resetFusion() { m_fusion->reset(); }
 
+    //  saveFusionState() writes a checkpoint of the fusion state and gyro bias to buffer and
+    //  returns its length (at most RTFUSION_STATE_MAX_LEN), or 0 if the buffer is too small.
+    //  restoreFusionState() loads one after IMUInit() so that a restarted process carries on
+    //  without the fusion having to converge again.
+
+    int saveFusionState(unsigned char *buffer, int length) { return m_fusion->saveState(buffer, length, m_settings); }
+    bool restoreFusionState(const unsigned char *buffer, int length) { return m_fusion->restoreState(buffer, length, m_settings); }
+
     //  the following three functions control the influence of the gyro, accel and compass sensors
 
     void setGyroEnable(bool enable) { m_fusion->setGyroEnable(enable);}
@@ -112,7 +196,14 @@ public:
 
     //  getIMUData returns the standard outputs of the IMU and fusion filter
 
-    const RTIMU_DATA& getIMUData() { return m_imuData; }
+    const RTIMU_DATA& getIMUData() { return *m_imuData; }
+
+    //  IMUSetDataStorage() has the driver write its samples straight into data, so that
+    //  the caller can add the pressure and humidity to it or keep it without copying the
+    //  sample. The caller keeps ownership and NULL goes back to the IMU's own copy. The
+    //  current sample is copied into data first as the driver carries some values over.
+
+    void IMUSetDataStorage(RTIMU_DATA *data);
 
     //  setExtIMUData allows data from some external IMU to be injected to the fusion algorithm
 
@@ -127,14 +218,15 @@ public:
     //  setCompassCalibrationMode() turns off use of cal data so that raw data can be accumulated
     //  to derive calibration data
 
-    void setCompassCalibrationMode(bool enable) { m_compassCalibrationMode = enable; }
+    void setCompassCalibrationMode(bool enable) { m_compassCalibrationMode = enable; buildCalibration(); }
 
     //  setAccelCalibrationMode() turns off use of cal data so that raw data can be accumulated
     //  to derive calibration data
 
-    void setAccelCalibrationMode(bool enable) { m_accelCalibrationMode = enable; }
+    void setAccelCalibrationMode(bool enable) { m_accelCalibrationMode = enable; buildCalibration(); }
 
-    //  setCalibrationData configures the cal data from settings and also enables use if valid
+    //  setCalibrationData configures the cal data from settings and also enables use if valid.
+    //  Changes to the calibration or axis rotation in the settings take effect when it's called.
 
     void setCalibrationData();
 
@@ -154,35 +246,95 @@ public:
 
     bool getAccelCalibrationValid() { return !m_accelCalibrationMode && m_settings->m_accelCalValid; }
 
-    const RTVector3& getGyro() { return m_imuData.gyro; }   // gets gyro rates in radians/sec
-    const RTVector3& getAccel() { return m_imuData.accel; } // get accel data in gs
-    const RTVector3& getCompass() { return m_imuData.compass; } // gets compass data in uT
+    const RTVector3& getGyro() { return m_imuData->gyro; }   // gets gyro rates in radians/sec
+    const RTVector3& getAccel() { return m_imuData->accel; } // get accel data in gs
+    const RTVector3& getCompass() { return m_imuData->compass; } // gets compass data in uT
 
-    RTVector3 getAccelResiduals() { return m_fusion->getAccelResiduals(CalibratedAccel()); }
+    virtual RTVector3 getAccelResiduals() { return m_fusion->getAccelResiduals(CalibratedAccel()); }
     RTVector3 getAccelGlobalFrame() { return m_fusion->getAccelGlobalFrame(CalibratedAccel()); }
 
 protected:
     void gyroBiasInit();                                    // sets up gyro bias calculation
     void handleGyroBias();                                  // adjust gyro for bias
+
+    //  Drivers that can read their die temperature call gyroBiasSeed() after gyroBiasInit().
+    //  If a bias was recorded near that temperature it is used from the first sample instead
+    //  of being learnt again. Once the bias is known it is recorded about once a second for
+    //  the die temperature readTemperature() gives at the time, so they must override that too.
+
+    void gyroBiasSeed(RTFLOAT temperature);
+    virtual bool readTemperature(RTFLOAT& /* temperature */) { return false; }  // die temperature in degrees C
     void calibrateAverageCompass();                         // calibrate and smooth compass
     void calibrateAccel();                                  // calibrate the accelerometers
     RTVector3 CalibratedAccel();
     void updateFusion();                                    // call when new data to update fusion state
 
+    //  buildCalibration() works out the transforms for the current settings and modes and
+    //  getCalibration() takes a copy of them. The copy is retried if a rebuild happens
+    //  while it's being taken, so a sample is never processed with part of an old
+    //  calibration, even when another thread changes it while samples are being read.
+
+    void buildCalibration();
+    void getCalibration(RTIMU_CALIBRATION& cal);
+
+    //  Drivers that support IMUReconfigure() call reconfigureBegin() before working out the
+    //  new register values, reconfigureAbandon() if the settings turn out to be invalid and
+    //  reconfigureEnd() when the changed registers have been written.
+
+    void reconfigureBegin();
+    void reconfigureAbandon();
+    void reconfigureEnd(bool changed);
+
+    bool dataReadyEnabled();                                // true if the driver should enable its data ready interrupt
+    RTIMUDataReady *dataReadySource();                      // the open data ready source or NULL
+
+    //  Drivers whose compass runs slower than the gyro call compassDue() for each sample
+    //  and only read the compass if it returns true, then compassRead() with whether
+    //  there was a new compass sample. compassValid is false for samples without one
+    //  and the compass keeps its last value.
+
+    void compassSetInterval(uint64_t interval);             // nominal compass sample interval in uS, 0 to read it every sample
+    bool compassDue();
+    void compassRead(bool newData);
+
+    bool m_dataReadyConfigured;                             // set by drivers that have enabled data ready on their interrupt pin
+    bool m_dataReadyActiveLow;                              // set by drivers if that pin is active low
+
+    uint64_t m_compassInterval;                             // nominal compass sample interval
+    uint64_t m_compassNext;                                 // when the next compass sample is due
+    uint64_t m_compassCheckTime;                            // time of the last compassDue()
+    bool m_compassMissed;                                   // true if the last compass read had no new sample
+
     int m_sampleRate;                                       // samples per second
     uint64_t m_sampleInterval;                              // interval between samples in microseonds
+    int m_savedSampleRate;                                  // the values before a reconfigure
+    uint64_t m_savedSampleInterval;
+    uint64_t m_savedCompassInterval;
+    RTIMUTimestamp m_timestamp;                             // works out sample times from the sensor's clock
+    RTIMUFifo m_fifo;                                       // for drivers that read a byte wide FIFO register
+    RTIMURegInit m_regInit;                                 // for drivers with a table driven init sequence
     bool m_compassCalibrationMode;                          // true if cal mode so don't use cal data!
     bool m_accelCalibrationMode;                            // true if cal mode so don't use cal data!
 
-    RTIMU_DATA m_imuData;                                   // the data from the IMU
+    RTIMU_DATA *m_imuData;                                  // the data from the IMU, m_imuDataStorage or the caller's
+    RTIMU_DATA m_imuDataStorage;
+    RTIMU_DATA m_fusionData;                                // the calibrated data for the fusion
 
     RTIMUSettings *m_settings;                              // the settings object pointer
 
+    bool m_gyroBiasTempValid;                               // true if the driver can read the die temperature
+    RTFLOAT m_gyroBiasTemp;                                 // the die temperature last read
+    int m_gyroBiasRecordCount;                              // samples since the bias was last recorded
+
     RTFusion *m_fusion;                                     // the fusion algorithm
 
 
     float m_compassCalOffset[3];
     float m_compassCalScale[3];
+    bool m_compassCalSet;                                   // true if m_compassCalOffset and m_compassCalScale are set
+
+    RTIMU_CALIBRATION m_calibration;
+    std::atomic<unsigned int> m_calibrationSequence;        // odd while m_calibration is being written
     RTVector3 m_compassAverage;                             // a running average to smooth the mag outputs
 
     bool m_runtimeMagCalValid;                              // true if the runtime mag calibration has valid data
@@ -191,6 +343,26 @@ protected:
 
     static float m_axisRotation[RTIMU_AXIS_ROTATION_COUNT][9];    // array of rotation matrices
 
+    RTIMUDataReady *m_dataReady;                            // the data ready source or NULL
+    bool m_dataReadyOwned;                                  // true if m_dataReady was created from the settings
+    bool m_dataReadyOpen;                                   // true if m_dataReady has been opened
+    bool m_dataReadyFailed;                                 // true if m_dataReady could not be opened
+
+    uint64_t m_pollNext;                                    // the end of the current poll interval
+
+private:
+#if !defined(WIN32)
+    static void *acquisitionThread(void *arg);
+    void acquisitionSetup();                                // applies the Acquisition settings on the thread
+
+    pthread_t m_acquisitionThread;
+#endif
+    std::atomic<bool> m_acquisitionRunning;                 // true between startAcquisition() and stopAcquisition()
+    std::atomic<bool> m_acquisitionStop;                    // tells the thread to exit
+    RTIMURing *m_acquisitionRing;
+    RTIMUSampleCallback m_acquisitionCallback;
+    void *m_acquisitionContext;
+
  };
 
 #endif // _RTIMU_H
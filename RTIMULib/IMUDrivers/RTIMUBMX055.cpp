@@ -91,24 +91,23 @@ RTIMUBMX055::RTIMUBMX055(RTIMUSettings *settings) : RTIMU(settings)
 
 RTIMUBMX055::~RTIMUBMX055()
 {
+    stopAcquisition();
 }
 
 bool RTIMUBMX055::IMUInit()
 {
     unsigned char result;
 
-    m_firstTime = true;
-
     // set validity flags
 
-    m_imuData.fusionPoseValid = false;
-    m_imuData.fusionQPoseValid = false;
-    m_imuData.gyroValid = true;
-    m_imuData.accelValid = true;
-    m_imuData.compassValid = true;
-    m_imuData.pressureValid = false;
-    m_imuData.temperatureValid = false;
-    m_imuData.humidityValid = false;
+    m_imuData->fusionPoseValid = false;
+    m_imuData->fusionQPoseValid = false;
+    m_imuData->gyroValid = true;
+    m_imuData->accelValid = true;
+    m_imuData->compassValid = true;
+    m_imuData->pressureValid = false;
+    m_imuData->temperatureValid = false;
+    m_imuData->humidityValid = false;
 
     //  configure IMU
 
@@ -175,6 +174,18 @@ bool RTIMUBMX055::IMUInit()
     if (!setGyroFSR())
             return false;
 
+    //  new data interrupt on INT1, active high push-pull
+
+    if (dataReadyEnabled()) {
+        if (!m_settings->HALWrite(m_gyroSlaveAddr, BMX055_GYRO_INT_EN_1, 0x01, "Failed to set BMX055 gyro INT_EN_1"))
+            return false;
+        if (!m_settings->HALWrite(m_gyroSlaveAddr, BMX055_GYRO_INT_MAP_1, 0x01, "Failed to set BMX055 gyro INT_MAP_1"))
+            return false;
+        if (!m_settings->HALWrite(m_gyroSlaveAddr, BMX055_GYRO_INT_EN_0, 0x80, "Failed to set BMX055 gyro INT_EN_0"))
+            return false;
+        m_dataReadyConfigured = true;
+    }
+
     gyroBiasInit();
 
     //  set up the accel
@@ -191,6 +202,8 @@ bool RTIMUBMX055::IMUInit()
     magInitTrimRegisters();
     setMagPreset();
 
+    m_timestamp.reset(m_sampleInterval);
+
     HAL_INFO("BMX055 init complete\n");
     return true;
 }
@@ -426,23 +439,26 @@ bool RTIMUBMX055::IMURead()
         if (!m_settings->HALWrite(m_gyroSlaveAddr, BMX055_GYRO_FIFO_CONFIG_1, 0x40, "Failed to set BMX055 FIFO config"))
             return false;
 
-        m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();  // try to fix timestamp
+        m_timestamp.reset(m_sampleInterval);
         return false;
     }
 
     if (status == 0)
         return false;
 
-    if (!m_settings->HALRead(m_gyroSlaveAddr, BMX055_GYRO_FIFO_DATA, 6, gyroData, "Failed to read BMX055 gyro data"))
-            return false;
+    //  the frame count is in the bottom 7 bits
 
-    if (!m_settings->HALRead(m_accelSlaveAddr, BMX055_ACCEL_X_LSB, 6, accelData, "Failed to read BMX055 accel data"))
-        return false;
+    m_timestamp.fifoLevel(status & 0x7f, m_settings->HALTimestamp());
 
-    if (!m_settings->HALRead(m_magSlaveAddr, BMX055_MAG_X_LSB, 8, magData, "Failed to read BMX055 mag data"))
+    m_settings->HALBatchBegin();
+    m_settings->HALBatchRead(m_gyroSlaveAddr, BMX055_GYRO_FIFO_DATA, 6, gyroData);
+    m_settings->HALBatchRead(m_accelSlaveAddr, BMX055_ACCEL_X_LSB, 6, accelData);
+    m_settings->HALBatchRead(m_magSlaveAddr, BMX055_MAG_X_LSB, 8, magData);
+
+    if (!m_settings->HALBatchSubmit("Failed to read BMX055 data"))
         return false;
 
-    RTMath::convertToVector(gyroData, m_imuData.gyro, m_gyroScale, false);
+    RTMath::convertToVector(gyroData, m_imuData->gyro, m_gyroScale, false);
 
     //  need to prepare accel data
 
@@ -450,34 +466,34 @@ bool RTIMUBMX055::IMURead()
     accelData[2] &= 0xf0;
     accelData[4] &= 0xf0;
 
-    RTMath::convertToVector(accelData, m_imuData.accel, m_accelScale, false);
+    RTMath::convertToVector(accelData, m_imuData->accel, m_accelScale, false);
 
     float mx, my, mz;
 
     processMagData(magData, mx, my, mz);
-    m_imuData.compass.setX(mx);
-    m_imuData.compass.setY(my);
-    m_imuData.compass.setZ(mz);
+    m_imuData->compass.setX(mx);
+    m_imuData->compass.setY(my);
+    m_imuData->compass.setZ(mz);
 
     //  sort out gyro axes
 
-    m_imuData.gyro.setY(-m_imuData.gyro.y());
-    m_imuData.gyro.setZ(-m_imuData.gyro.z());
+    m_imuData->gyro.setY(-m_imuData->gyro.y());
+    m_imuData->gyro.setZ(-m_imuData->gyro.z());
 
     //  sort out accel axes
 
-    m_imuData.accel.setX(-m_imuData.accel.x());
+    m_imuData->accel.setX(-m_imuData->accel.x());
 
     //  sort out mag axes
 
 #ifdef BMX055_REMAP
-    m_imuData.compass.setY(-m_imuData.compass.y());
-    m_imuData.compass.setZ(-m_imuData.compass.z());
+    m_imuData->compass.setY(-m_imuData->compass.y());
+    m_imuData->compass.setZ(-m_imuData->compass.z());
 #else
-    RTFLOAT temp =  m_imuData.compass.x();
-    m_imuData.compass.setX(-m_imuData.compass.y());
-    m_imuData.compass.setY(-temp);
-    m_imuData.compass.setZ(-m_imuData.compass.z());
+    RTFLOAT temp =  m_imuData->compass.x();
+    m_imuData->compass.setX(-m_imuData->compass.y());
+    m_imuData->compass.setY(-temp);
+    m_imuData->compass.setZ(-m_imuData->compass.z());
 #endif
     //  now do standard processing
 
@@ -485,12 +501,7 @@ bool RTIMUBMX055::IMURead()
     calibrateAverageCompass();
     calibrateAccel();
 
-    if (m_firstTime)
-        m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
-    else
-        m_imuData.timestamp += m_sampleInterval;
-
-    m_firstTime = false;
+    m_imuData->timestamp = m_timestamp.nextTimestamp();
 
     //  now update the filter
 
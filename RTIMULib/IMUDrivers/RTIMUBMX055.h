@@ -55,7 +55,6 @@ private:
     unsigned char m_accelSlaveAddr;                         // I2C address of accel
     unsigned char m_magSlaveAddr;                           // I2C address of mag
 
-    bool m_firstTime;                                       // if first sample
 
     RTFLOAT m_gyroScale;
     RTFLOAT m_accelScale;
@@ -43,10 +43,12 @@ RTIMUBNO055::RTIMUBNO055(RTIMUSettings *settings) : RTIMU(settings)
 {
     m_sampleRate = 100;
     m_sampleInterval = (uint64_t)1000000 / m_sampleRate;
+    m_passthrough = false;
 }
 
 RTIMUBNO055::~RTIMUBNO055()
 {
+    stopAcquisition();
 }
 
 bool RTIMUBNO055::IMUInit()
@@ -54,18 +56,19 @@ bool RTIMUBNO055::IMUInit()
     unsigned char result;
 
     m_slaveAddr = m_settings->m_I2CSlaveAddress;
-    m_lastReadTime = RTMath::currentUSecsSinceEpoch();
+    m_passthrough = m_settings->m_BNO055FusionPassthrough;
+    m_lastReadTime = m_settings->HALTimestamp();
 
     // set validity flags
 
-    m_imuData.fusionPoseValid = true;
-    m_imuData.fusionQPoseValid = true;
-    m_imuData.gyroValid = true;
-    m_imuData.accelValid = true;
-    m_imuData.compassValid = true;
-    m_imuData.pressureValid = false;
-    m_imuData.temperatureValid = false;
-    m_imuData.humidityValid = false;
+    m_imuData->fusionPoseValid = true;
+    m_imuData->fusionQPoseValid = true;
+    m_imuData->gyroValid = true;
+    m_imuData->accelValid = true;
+    m_imuData->compassValid = true;
+    m_imuData->pressureValid = false;
+    m_imuData->temperatureValid = false;
+    m_imuData->humidityValid = false;
 
     if (!m_settings->HALRead(m_slaveAddr, BNO055_WHO_AM_I, 1, &result, "Failed to read BNO055 id"))
         return false;
@@ -100,6 +103,26 @@ bool RTIMUBNO055::IMUInit()
 
     m_settings->delayMs(50);
 
+    //  in passthrough mode reads are paced by the fusion's accel data ready, which can
+    //  also go to the INT pin (active high)
+
+    if (m_passthrough) {
+        if (!m_settings->HALWrite(m_slaveAddr, BNO055_PAGE_ID, 1, "Failed to set BNO055 page 1"))
+            return false;
+
+        if (!m_settings->HALWrite(m_slaveAddr, BNO055_INT_MSK, dataReadyEnabled() ? BNO055_INT_ACC_BSX_DRDY : 0,
+                                  "Failed to set BNO055 interrupt mask"))
+            return false;
+
+        if (!m_settings->HALWrite(m_slaveAddr, BNO055_INT_EN, BNO055_INT_ACC_BSX_DRDY, "Failed to set BNO055 interrupt enable"))
+            return false;
+
+        if (dataReadyEnabled()) {
+            m_dataReadyConfigured = true;
+            m_dataReadyActiveLow = false;
+        }
+    }
+
     if (!m_settings->HALWrite(m_slaveAddr, BNO055_PAGE_ID, 0, "Failed to set BNO055 page 0"))
         return false;
 
@@ -120,6 +143,8 @@ bool RTIMUBNO055::IMUInit()
 
     m_settings->delayMs(50);
 
+    m_timestamp.reset(m_sampleInterval);
+
     HAL_INFO("BNO055 init complete\n");
     return true;
 }
@@ -129,14 +154,30 @@ int RTIMUBNO055::IMUGetPollInterval()
     return (7);
 }
 
+//  BNO055 outputs are little endian
+
+static int16_t getWord(const unsigned char *data)
+{
+    return (int16_t)(((uint16_t)data[1] << 8) | (uint16_t)data[0]);
+}
+
 bool RTIMUBNO055::IMURead()
+{
+    if (m_passthrough)
+        return readPassthrough();
+    return readEuler();
+}
+
+bool RTIMUBNO055::readEuler()
 {
     unsigned char buffer[24];
+    uint64_t now = m_settings->HALTimestamp();
 
-    if ((RTMath::currentUSecsSinceEpoch() - m_lastReadTime) < m_sampleInterval)
+    if ((now - m_lastReadTime) < m_sampleInterval)
         return false;                                       // too soon
 
-    m_lastReadTime = RTMath::currentUSecsSinceEpoch();
+    m_lastReadTime = now;
+    m_timestamp.sampleReady(m_lastReadTime);
     if (!m_settings->HALRead(m_slaveAddr, BNO055_ACCEL_DATA, 24, buffer, "Failed to read BNO055 data"))
         return false;
 
@@ -148,9 +189,9 @@ bool RTIMUBNO055::IMURead()
     y = (((uint16_t)buffer[3]) << 8) | ((uint16_t)buffer[2]);
     z = (((uint16_t)buffer[5]) << 8) | ((uint16_t)buffer[4]);
 
-    m_imuData.accel.setX((RTFLOAT)y / 1000.0);
-    m_imuData.accel.setY((RTFLOAT)x / 1000.0);
-    m_imuData.accel.setZ((RTFLOAT)z / 1000.0);
+    m_imuData->accel.setX((RTFLOAT)y / 1000.0);
+    m_imuData->accel.setY((RTFLOAT)x / 1000.0);
+    m_imuData->accel.setZ((RTFLOAT)z / 1000.0);
 
     // process mag data
 
@@ -158,9 +199,9 @@ bool RTIMUBNO055::IMURead()
     y = (((uint16_t)buffer[9]) << 8) | ((uint16_t)buffer[8]);
     z = (((uint16_t)buffer[11]) << 8) | ((uint16_t)buffer[10]);
 
-    m_imuData.compass.setX(-(RTFLOAT)y / 16.0);
-    m_imuData.compass.setY(-(RTFLOAT)x / 16.0);
-    m_imuData.compass.setZ(-(RTFLOAT)z / 16.0);
+    m_imuData->compass.setX(-(RTFLOAT)y / 16.0);
+    m_imuData->compass.setY(-(RTFLOAT)x / 16.0);
+    m_imuData->compass.setZ(-(RTFLOAT)z / 16.0);
 
     // process gyro data
 
@@ -168,9 +209,9 @@ bool RTIMUBNO055::IMURead()
     y = (((uint16_t)buffer[15]) << 8) | ((uint16_t)buffer[14]);
     z = (((uint16_t)buffer[17]) << 8) | ((uint16_t)buffer[16]);
 
-    m_imuData.gyro.setX(-(RTFLOAT)y / 900.0);
-    m_imuData.gyro.setY(-(RTFLOAT)x / 900.0);
-    m_imuData.gyro.setZ(-(RTFLOAT)z / 900.0);
+    m_imuData->gyro.setX(-(RTFLOAT)y / 900.0);
+    m_imuData->gyro.setY(-(RTFLOAT)x / 900.0);
+    m_imuData->gyro.setZ(-(RTFLOAT)z / 900.0);
 
     // process euler angles
 
@@ -180,12 +221,91 @@ bool RTIMUBNO055::IMURead()
 
     //  put in structure and do axis remap
 
-    m_imuData.fusionPose.setX((RTFLOAT)y / 900.0);
-    m_imuData.fusionPose.setY((RTFLOAT)z / 900.0);
-    m_imuData.fusionPose.setZ((RTFLOAT)x / 900.0);
+    m_imuData->fusionPose.setX((RTFLOAT)y / 900.0);
+    m_imuData->fusionPose.setY((RTFLOAT)z / 900.0);
+    m_imuData->fusionPose.setZ((RTFLOAT)x / 900.0);
 
-    m_imuData.fusionQPose.fromEuler(m_imuData.fusionPose);
+    m_imuData->fusionQPose.fromEuler(m_imuData->fusionPose);
 
-    m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
+    m_imuData->timestamp = m_timestamp.nextTimestamp();
     return true;
 }
+
+bool RTIMUBNO055::readPassthrough()
+{
+    unsigned char status;
+    unsigned char buffer[44];
+    unsigned char *quat = buffer + BNO055_FUSED_QUAT - BNO055_ACCEL_DATA;
+    unsigned char *linear = buffer + BNO055_LINEAR_ACCEL - BNO055_ACCEL_DATA;
+    unsigned char *gravity = buffer + BNO055_GRAVITY - BNO055_ACCEL_DATA;
+
+    //  reading INT_STA clears it
+
+    if (!m_settings->HALRead(m_slaveAddr, BNO055_INT_STA, 1, &status, "Failed to read BNO055 interrupt status"))
+        return false;
+
+    if ((status & BNO055_INT_ACC_BSX_DRDY) == 0)
+        return false;
+
+    m_lastReadTime = m_settings->HALTimestamp();
+    m_timestamp.sampleReady(m_lastReadTime);
+
+    //  accel, mag, gyro, Euler, quaternion, linear accel and gravity are contiguous
+
+    if (!m_settings->HALRead(m_slaveAddr, BNO055_ACCEL_DATA, 44, buffer, "Failed to read BNO055 data"))
+        return false;
+
+    if (m_dataReadyConfigured && !m_settings->HALWrite(m_slaveAddr, BNO055_SYS_TRIGGER, 0x40, "Failed to reset BNO055 interrupt"))
+        return false;
+
+    //  the same axis remap as readEuler()
+
+    m_imuData->accel.setX((RTFLOAT)getWord(buffer + 2) / 1000.0);
+    m_imuData->accel.setY((RTFLOAT)getWord(buffer) / 1000.0);
+    m_imuData->accel.setZ((RTFLOAT)getWord(buffer + 4) / 1000.0);
+
+    m_imuData->compass.setX(-(RTFLOAT)getWord(buffer + 8) / 16.0);
+    m_imuData->compass.setY(-(RTFLOAT)getWord(buffer + 6) / 16.0);
+    m_imuData->compass.setZ(-(RTFLOAT)getWord(buffer + 10) / 16.0);
+
+    m_imuData->gyro.setX(-(RTFLOAT)getWord(buffer + 14) / 900.0);
+    m_imuData->gyro.setY(-(RTFLOAT)getWord(buffer + 12) / 900.0);
+    m_imuData->gyro.setZ(-(RTFLOAT)getWord(buffer + 16) / 900.0);
+
+    //  the quaternion is w, x, y, z with 1.0 = 2^14. Swapping x and y is a reflection
+    //  so the vector part changes sign as well, as it does for the gyro.
+
+    m_imuData->fusionQPose.setScalar((RTFLOAT)getWord(quat) / 16384.0);
+    m_imuData->fusionQPose.setX(-(RTFLOAT)getWord(quat + 4) / 16384.0);
+    m_imuData->fusionQPose.setY(-(RTFLOAT)getWord(quat + 2) / 16384.0);
+    m_imuData->fusionQPose.setZ(-(RTFLOAT)getWord(quat + 6) / 16384.0);
+    m_imuData->fusionQPose.toEuler(m_imuData->fusionPose);
+
+    //  linear accel and gravity are in the accel units (mg)
+
+    m_linearAccel.setX((RTFLOAT)getWord(linear + 2) / 1000.0);
+    m_linearAccel.setY((RTFLOAT)getWord(linear) / 1000.0);
+    m_linearAccel.setZ((RTFLOAT)getWord(linear + 4) / 1000.0);
+
+    m_gravity.setX((RTFLOAT)getWord(gravity + 2) / 1000.0);
+    m_gravity.setY((RTFLOAT)getWord(gravity) / 1000.0);
+    m_gravity.setZ((RTFLOAT)getWord(gravity + 4) / 1000.0);
+
+    m_imuData->timestamp = m_timestamp.nextTimestamp();
+    return true;
+}
+
+RTVector3 RTIMUBNO055::getAccelResiduals()
+{
+    RTVector3 residuals;
+
+    if (!m_passthrough)
+        return RTIMU::getAccelResiduals();
+
+    //  RTFusion's residuals are gravity less the accel
+
+    residuals.setX(-m_linearAccel.x());
+    residuals.setY(-m_linearAccel.y());
+    residuals.setZ(-m_linearAccel.z());
+    return residuals;
+}
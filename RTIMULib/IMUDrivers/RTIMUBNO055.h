@@ -39,10 +39,23 @@ public:
     virtual int IMUGetPollInterval();
     virtual bool IMURead();
 
+    //  In fusion passthrough mode the residuals are the chip's linear acceleration. The
+    //  linear acceleration and gravity are in gs on the same axes as the accel.
+
+    virtual RTVector3 getAccelResiduals();
+    const RTVector3& getLinearAccel() { return m_linearAccel; }
+    const RTVector3& getGravity() { return m_gravity; }
+
 private:
+    bool readEuler();                                       // the pose from the Euler angles
+    bool readPassthrough();                                 // the pose from the quaternion
+
     unsigned char m_slaveAddr;                              // I2C address of BNO055
+    bool m_passthrough;                                     // true if in fusion passthrough mode
 
     uint64_t m_lastReadTime;
+    RTVector3 m_linearAccel;
+    RTVector3 m_gravity;
 };
 
 #endif // _RTIMUBNO055_H
@@ -196,8 +196,10 @@
 #define MPU925x_INT_ENABLE          0x38
 #define MPU925x_INT_STATUS          0x3a
 #define MPU925x_ACCEL_XOUT_H        0x3b
+#define MPU925x_TEMP_OUT_H          0x41
 #define MPU925x_GYRO_XOUT_H         0x43
 #define MPU925x_EXT_SENS_DATA_00    0x49
+#define MPU925x_I2C_SLV0_DO         0x63
 #define MPU925x_I2C_SLV1_DO         0x64
 #define MPU925x_I2C_MST_DELAY_CTRL  0x67
 #define MPU925x_USER_CTRL           0x6a
@@ -317,6 +319,7 @@
 #define ICM20948_INT_STATUS          0x19
 #define ICM20948_ACCEL_XOUT_H        0x2D
 #define ICM20948_GYRO_XOUT_H         0x33
+#define ICM20948_TEMP_OUT_H          0x39
 #define ICM20948_EXT_SLV_SENS_DATA_00    0x3B
 #define ICM20948_EXT_SLV_SENS_DATA_01    0x3C
 #define ICM20948_USER_CTRL           0x03
@@ -1120,6 +1123,8 @@
 #define BMX055_GYRO_RATE_HBW        0x13
 #define BMX055_GYRO_SOFT_RESET      0x14
 #define BMX055_GYRO_INT_EN_0        0x15
+#define BMX055_GYRO_INT_EN_1        0x16
+#define BMX055_GYRO_INT_MAP_1       0x18
 #define BMX055_GYRO_1A              0x1a
 #define BMX055_GYRO_1B              0x1b
 #define BMX055_GYRO_SOC             0x31
@@ -1251,6 +1256,9 @@
 #define BNO055_GYRO_DATA            0x14
 #define BNO055_FUSED_EULER          0x1a
 #define BNO055_FUSED_QUAT           0x20
+#define BNO055_LINEAR_ACCEL         0x28
+#define BNO055_GRAVITY              0x2e
+#define BNO055_INT_STA              0x37
 #define BNO055_UNIT_SEL             0x3b
 #define BNO055_OPER_MODE            0x3d
 #define BNO055_PWR_MODE             0x3e
@@ -1258,6 +1266,15 @@
 #define BNO055_AXIS_MAP_CONFIG      0x41
 #define BNO055_AXIS_MAP_SIGN        0x42
 
+//  Page 1 registers
+
+#define BNO055_INT_MSK              0x0f
+#define BNO055_INT_EN               0x10
+
+//  INT_STA, INT_MSK and INT_EN bits
+
+#define BNO055_INT_ACC_BSX_DRDY     0x01                // new accel sample for the fusion
+
 //  Operation modes
 
 #define BNO055_OPER_MODE_CONFIG     0x00
@@ -29,6 +29,52 @@
 
 #define COMPASS_ALPHA 0.2f
 
+//  slaves and values in the init sequence
+
+#define GD20HM303D_GYRO                 0
+#define GD20HM303D_ACCEL_COMPASS        1
+
+#define GD20HM303D_GYRO_CTRL1           0
+#define GD20HM303D_GYRO_CTRL2           1
+#define GD20HM303D_GYRO_CTRL3           2
+#define GD20HM303D_GYRO_CTRL4           3
+#define GD20HM303D_GYRO_CTRL5           4
+#define GD20HM303D_GYRO_LOW_ODR         5
+#define GD20HM303D_ACCEL_CTRL1          6
+#define GD20HM303D_ACCEL_CTRL2          7
+#define GD20HM303D_COMPASS_CTRL5        8
+#define GD20HM303D_COMPASS_CTRL6        9
+#define GD20HM303D_COMPASS_CTRL7        10
+
+//  Both chips are checked before anything is set up. Registers are in address order
+//  so that they go out as burst writes.
+
+const RTIMU_REG_INIT RTIMUGD20HM303D::m_initSequence[] = {
+    {RTIMUREGINIT_WRITE, GD20HM303D_GYRO, L3GD20H_LOW_ODR, 0x04, 0, "Failed to reset L3GD20H"},
+    {RTIMUREGINIT_WRITE, GD20HM303D_GYRO, L3GD20H_CTRL5, 0x80, 0, "Failed to boot L3GD20H"},
+    {RTIMUREGINIT_VERIFY, GD20HM303D_GYRO, L3GD20H_WHO_AM_I, L3GD20H_ID, 0xff, "Incorrect L3GD20H id"},
+    {RTIMUREGINIT_VERIFY, GD20HM303D_ACCEL_COMPASS, LSM303D_WHO_AM_I, LSM303D_ID, 0xff, "Incorrect LSM303D id"},
+
+#ifdef GD20HM303D_CACHE_MODE
+    //  the gyro fifo mode, the fifo is turned on in CTRL5
+
+    {RTIMUREGINIT_WRITE, GD20HM303D_GYRO, L3GD20H_FIFO_CTRL, 0x3f, 0, "Failed to set L3GD20H FIFO mode"},
+#endif
+
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303D_GYRO, L3GD20H_CTRL1, GD20HM303D_GYRO_CTRL1, 0, "Failed to set L3GD20H CTRL1-5"},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303D_GYRO, L3GD20H_CTRL2, GD20HM303D_GYRO_CTRL2, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303D_GYRO, L3GD20H_CTRL3, GD20HM303D_GYRO_CTRL3, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303D_GYRO, L3GD20H_CTRL4, GD20HM303D_GYRO_CTRL4, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303D_GYRO, L3GD20H_CTRL5, GD20HM303D_GYRO_CTRL5, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303D_GYRO, L3GD20H_LOW_ODR, GD20HM303D_GYRO_LOW_ODR, 0, "Failed to set L3GD20H LOW_ODR"},
+
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303D_ACCEL_COMPASS, LSM303D_CTRL1, GD20HM303D_ACCEL_CTRL1, 0, "Failed to set LSM303D CTRL1-2"},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303D_ACCEL_COMPASS, LSM303D_CTRL2, GD20HM303D_ACCEL_CTRL2, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303D_ACCEL_COMPASS, LSM303D_CTRL5, GD20HM303D_COMPASS_CTRL5, 0, "Failed to set LSM303D CTRL5-7"},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303D_ACCEL_COMPASS, LSM303D_CTRL6, GD20HM303D_COMPASS_CTRL6, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303D_ACCEL_COMPASS, LSM303D_CTRL7, GD20HM303D_COMPASS_CTRL7, 0, ""}
+};
+
 RTIMUGD20HM303D::RTIMUGD20HM303D(RTIMUSettings *settings) : RTIMU(settings)
 {
     m_sampleRate = 100;
@@ -36,6 +82,7 @@ RTIMUGD20HM303D::RTIMUGD20HM303D(RTIMUSettings *settings) : RTIMU(settings)
 
 RTIMUGD20HM303D::~RTIMUGD20HM303D()
 {
+    stopAcquisition();
 }
 
 bool RTIMUGD20HM303D::IMUInit()
@@ -43,19 +90,18 @@ bool RTIMUGD20HM303D::IMUInit()
     unsigned char result;
 
 #ifdef GD20HM303D_CACHE_MODE
-    m_firstTime = true;
     m_cacheIn = m_cacheOut = m_cacheCount = 0;
 #endif
     // set validity flags
 
-    m_imuData.fusionPoseValid = false;
-    m_imuData.fusionQPoseValid = false;
-    m_imuData.gyroValid = true;
-    m_imuData.accelValid = true;
-    m_imuData.compassValid = true;
-    m_imuData.pressureValid = false;
-    m_imuData.temperatureValid = false;
-    m_imuData.humidityValid = false;
+    m_imuData->fusionPoseValid = false;
+    m_imuData->fusionQPoseValid = false;
+    m_imuData->gyroValid = true;
+    m_imuData->accelValid = true;
+    m_imuData->compassValid = true;
+    m_imuData->pressureValid = false;
+    m_imuData->temperatureValid = false;
+    m_imuData->humidityValid = false;
 
     //  configure IMU
 
@@ -78,40 +124,69 @@ bool RTIMUGD20HM303D::IMUInit()
     if (!m_settings->HALOpen())
         return false;
 
-    //  Set up the gyro
+    m_regInit.setSlave(GD20HM303D_GYRO, m_gyroSlaveAddr, true, 0x80);
+    m_regInit.setSlave(GD20HM303D_ACCEL_COMPASS, m_accelCompassSlaveAddr, true, 0x80);
 
-    if (!m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_LOW_ODR, 0x04, "Failed to reset L3GD20H"))
+    if (!setRegisterValues())
         return false;
 
-    if (!m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_CTRL5, 0x80, "Failed to boot L3GD20H"))
+    if (!m_regInit.run(m_settings, RTIMUREGINIT_TABLE(m_initSequence)))
         return false;
 
-    if (!m_settings->HALRead(m_gyroSlaveAddr, L3GD20H_WHO_AM_I, 1, &result, "Failed to read L3GD20H id"))
-        return false;
+    m_dataReadyConfigured = dataReadyEnabled();
+
+    gyroBiasInit();
 
-    if (result != L3GD20H_ID) {
-        HAL_ERROR1("Incorrect L3GD20H id %d\n", result);
+    m_timestamp.reset(m_sampleInterval);
+
+    HAL_INFO("GD20HM303D init complete\n");
+    return true;
+}
+
+bool RTIMUGD20HM303D::IMUReconfigure()
+{
+#ifdef GD20HM303D_CACHE_MODE
+    HAL_ERROR("GD20HM303D can't be reconfigured in cache mode\n");
+    return false;
+#else
+    RTFLOAT gyroScale = m_gyroScale;
+    RTFLOAT accelScale = m_accelScale;
+    RTFLOAT compassScale = m_compassScale;
+    int written;
+
+    reconfigureBegin();
+
+    if (!setRegisterValues()) {
+        m_gyroScale = gyroScale;
+        m_accelScale = accelScale;
+        m_compassScale = compassScale;
+        reconfigureAbandon();
         return false;
     }
 
+    if (!m_regInit.update(m_settings, RTIMUREGINIT_TABLE(m_initSequence), written))
+        return false;
+
+    reconfigureEnd(written > 0);
+
+    HAL_INFO1("GD20HM303D reconfigured, %d registers written\n", written);
+    return true;
+#endif
+}
+
+bool RTIMUGD20HM303D::setRegisterValues()
+{
     if (!setGyroSampleRate())
-            return false;
+        return false;
 
     if (!setGyroCTRL2())
-            return false;
+        return false;
 
     if (!setGyroCTRL4())
-            return false;
-
-    //  Set up the accel/compass
-
-    if (!m_settings->HALRead(m_accelCompassSlaveAddr, LSM303D_WHO_AM_I, 1, &result, "Failed to read LSM303D id"))
         return false;
 
-    if (result != LSM303D_ID) {
-        HAL_ERROR1("Incorrect LSM303D id %d\n", result);
+    if (!setGyroCTRL5())
         return false;
-    }
 
     if (!setAccelCTRL1())
         return false;
@@ -128,20 +203,9 @@ bool RTIMUGD20HM303D::IMUInit()
     if (!setCompassCTRL7())
         return false;
 
-#ifdef GD20HM303D_CACHE_MODE
-
-    //  turn on gyro fifo
+    //  gyro data ready on DRDY/INT2
 
-    if (!m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_FIFO_CTRL, 0x3f, "Failed to set L3GD20H FIFO mode"))
-        return false;
-#endif
-
-    if (!setGyroCTRL5())
-            return false;
-
-    gyroBiasInit();
-
-    HAL_INFO("GD20HM303D init complete\n");
+    m_regInit.setValue(GD20HM303D_GYRO_CTRL3, dataReadyEnabled() ? 0x08 : 0x00);
     return true;
 }
 
@@ -215,10 +279,9 @@ bool RTIMUGD20HM303D::setGyroSampleRate()
 
     }
 
-    if (!m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_LOW_ODR, lowOdr, "Failed to set L3GD20H LOW_ODR"))
-        return false;
-
-    return (m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_CTRL1, ctrl1, "Failed to set L3GD20H CTRL1"));
+    m_regInit.setValue(GD20HM303D_GYRO_LOW_ODR, lowOdr);
+    m_regInit.setValue(GD20HM303D_GYRO_CTRL1, ctrl1);
+    return true;
 }
 
 bool RTIMUGD20HM303D::setGyroCTRL2()
@@ -227,7 +290,8 @@ bool RTIMUGD20HM303D::setGyroCTRL2()
         HAL_ERROR1("Illegal L3GD20H high pass filter code %d\n", m_settings->m_GD20HM303DGyroHpf);
         return false;
     }
-    return m_settings->HALWrite(m_gyroSlaveAddr,  L3GD20H_CTRL2, m_settings->m_GD20HM303DGyroHpf, "Failed to set L3GD20H CTRL2");
+    m_regInit.setValue(GD20HM303D_GYRO_CTRL2, m_settings->m_GD20HM303DGyroHpf);
+    return true;
 }
 
 bool RTIMUGD20HM303D::setGyroCTRL4()
@@ -255,7 +319,8 @@ bool RTIMUGD20HM303D::setGyroCTRL4()
         return false;
     }
 
-    return m_settings->HALWrite(m_gyroSlaveAddr,  L3GD20H_CTRL4, ctrl4, "Failed to set L3GD20H CTRL4");
+    m_regInit.setValue(GD20HM303D_GYRO_CTRL4, ctrl4);
+    return true;
 }
 
 
@@ -273,7 +338,8 @@ bool RTIMUGD20HM303D::setGyroCTRL5()
     ctrl5 |= 0x40;
 #endif
 
-    return m_settings->HALWrite(m_gyroSlaveAddr,  L3GD20H_CTRL5, ctrl5, "Failed to set L3GD20H CTRL5");
+    m_regInit.setValue(GD20HM303D_GYRO_CTRL5, ctrl5);
+    return true;
 }
 
 
@@ -288,7 +354,8 @@ bool RTIMUGD20HM303D::setAccelCTRL1()
 
     ctrl1 = (m_settings->m_GD20HM303DAccelSampleRate << 4) | 0x07;
 
-    return m_settings->HALWrite(m_accelCompassSlaveAddr,  LSM303D_CTRL1, ctrl1, "Failed to set LSM303D CTRL1");
+    m_regInit.setValue(GD20HM303D_ACCEL_CTRL1, ctrl1);
+    return true;
 }
 
 bool RTIMUGD20HM303D::setAccelCTRL2()
@@ -328,7 +395,8 @@ bool RTIMUGD20HM303D::setAccelCTRL2()
 
     ctrl2 = (m_settings->m_GD20HM303DAccelLpf << 6) | (m_settings->m_GD20HM303DAccelFsr << 3);
 
-    return m_settings->HALWrite(m_accelCompassSlaveAddr,  LSM303D_CTRL2, ctrl2, "Failed to set LSM303D CTRL2");
+    m_regInit.setValue(GD20HM303D_ACCEL_CTRL2, ctrl2);
+    return true;
 }
 
 
@@ -343,13 +411,18 @@ bool RTIMUGD20HM303D::setCompassCTRL5()
 
     ctrl5 = (m_settings->m_GD20HM303DCompassSampleRate << 2);
 
+    //  the rates go up in doubles from 3.125Hz
+
+    compassSetInterval(320000 >> m_settings->m_GD20HM303DCompassSampleRate);
+
 #ifdef GD20HM303D_CACHE_MODE
     //  enable fifo
 
     ctrl5 |= 0x40;
 #endif
 
-    return m_settings->HALWrite(m_accelCompassSlaveAddr,  LSM303D_CTRL5, ctrl5, "Failed to set LSM303D CTRL5");
+    m_regInit.setValue(GD20HM303D_COMPASS_CTRL5, ctrl5);
+    return true;
 }
 
 bool RTIMUGD20HM303D::setCompassCTRL6()
@@ -384,12 +457,14 @@ bool RTIMUGD20HM303D::setCompassCTRL6()
         return false;
     }
 
-    return m_settings->HALWrite(m_accelCompassSlaveAddr,  LSM303D_CTRL6, ctrl6, "Failed to set LSM303D CTRL6");
+    m_regInit.setValue(GD20HM303D_COMPASS_CTRL6, ctrl6);
+    return true;
 }
 
 bool RTIMUGD20HM303D::setCompassCTRL7()
 {
-     return m_settings->HALWrite(m_accelCompassSlaveAddr,  LSM303D_CTRL7, 0x60, "Failed to set LSM303D CTRL7");
+    m_regInit.setValue(GD20HM303D_COMPASS_CTRL7, 0x60);
+    return true;
 }
 
 
@@ -403,7 +478,7 @@ bool RTIMUGD20HM303D::IMURead()
     unsigned char status;
     unsigned char gyroData[6];
     unsigned char accelData[6];
-    unsigned char compassData[6];
+    unsigned char compassData[7];                           // status then data
 
 
 #ifdef GD20HM303D_CACHE_MODE
@@ -423,56 +498,58 @@ bool RTIMUGD20HM303D::IMURead()
         if (!m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_FIFO_CTRL, 0x3f, "Failed to set L3GD20H FIFO mode"))
             return false;
 
-        if (!setGyroCTRL5())
+        if (!m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_CTRL5, 0x50, "Failed to set L3GD20H CTRL5"))
             return false;
 
-        m_imuData.timestamp += m_sampleInterval * 32;
+        m_timestamp.reset(m_sampleInterval);
         return false;
     }
 
     // get count of samples in fifo
     count = status & 0x1f;
 
+    //  samples not yet delivered are those in the fifo and in the cache
+
+    int pending = count;
+
+    for (int i = 0, block = m_cacheOut; i < m_cacheCount; i++) {
+        pending += m_cache[block].count;
+        if (++block == GD20HM303D_CACHE_BLOCK_COUNT)
+            block = 0;
+    }
+    m_timestamp.fifoLevel(pending, m_settings->HALTimestamp());
+
     if ((m_cacheCount == 0) && (count > 0) && (count < GD20HM303D_FIFO_THRESH)) {
         // special case of a small fifo and nothing cached - just handle as simple read
 
-        if (!m_settings->HALRead(m_gyroSlaveAddr, 0x80 | L3GD20H_OUT_X_L, 6, gyroData, "Failed to read L3GD20H data"))
-            return false;
-
-        if (!m_settings->HALRead(m_accelCompassSlaveAddr, 0x80 | LSM303D_OUT_X_L_A, 6, accelData, "Failed to read LSM303D accel data"))
-            return false;
+        m_settings->HALBatchBegin();
+        m_settings->HALBatchRead(m_gyroSlaveAddr, 0x80 | L3GD20H_OUT_X_L, 6, gyroData);
+        m_settings->HALBatchRead(m_accelCompassSlaveAddr, 0x80 | LSM303D_OUT_X_L_A, 6, accelData);
+        m_settings->HALBatchRead(m_accelCompassSlaveAddr, 0x80 | LSM303D_OUT_X_L_M, 6, compassData + 1);
 
-        if (!m_settings->HALRead(m_accelCompassSlaveAddr, 0x80 | LSM303D_OUT_X_L_M, 6, compassData, "Failed to read LSM303D compass data"))
+        if (!m_settings->HALBatchSubmit("Failed to read L3GD20H/LSM303D data"))
             return false;
 
-        if (m_firstTime)
-            m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
-        else
-            m_imuData.timestamp += m_sampleInterval;
-
-        m_firstTime = false;
+        m_imuData->timestamp = m_timestamp.nextTimestamp();
     } else {
         if (count >=  GD20HM303D_FIFO_THRESH) {
             // need to create a cache block
 
             if (m_cacheCount == GD20HM303D_CACHE_BLOCK_COUNT) {
                 // all cache blocks are full - discard oldest and update timestamp to account for lost samples
-                m_imuData.timestamp += m_sampleInterval * m_cache[m_cacheOut].count;
+                m_timestamp.discard(m_cache[m_cacheOut].count);
                 if (++m_cacheOut == GD20HM303D_CACHE_BLOCK_COUNT)
                     m_cacheOut = 0;
                 m_cacheCount--;
             }
 
-            if (!m_settings->HALRead(m_gyroSlaveAddr, 0x80 | L3GD20H_OUT_X_L, GD20HM303D_FIFO_CHUNK_SIZE * GD20HM303D_FIFO_THRESH,
-                         m_cache[m_cacheIn].data, "Failed to read L3GD20H fifo data"))
-                return false;
+            m_settings->HALBatchBegin();
+            m_settings->HALBatchRead(m_gyroSlaveAddr, 0x80 | L3GD20H_OUT_X_L, GD20HM303D_FIFO_CHUNK_SIZE * GD20HM303D_FIFO_THRESH,
+                         m_cache[m_cacheIn].data);
+            m_settings->HALBatchRead(m_accelCompassSlaveAddr, 0x80 | LSM303D_OUT_X_L_A, 6, m_cache[m_cacheIn].accel);
+            m_settings->HALBatchRead(m_accelCompassSlaveAddr, 0x80 | LSM303D_OUT_X_L_M, 6, m_cache[m_cacheIn].compass);
 
-            if (!m_settings->HALRead(m_accelCompassSlaveAddr, 0x80 | LSM303D_OUT_X_L_A, 6,
-                         m_cache[m_cacheIn].accel, "Failed to read LSM303D accel data"))
-                return false;
-
-            if (!m_settings->HALRead(m_accelCompassSlaveAddr, 0x80 | LSM303D_OUT_X_L_M, 6,
-                         m_cache[m_cacheIn].compass, "Failed to read LSM303D compass data"))
+            if (!m_settings->HALBatchSubmit("Failed to read L3GD20H/LSM303D fifo data"))
                 return false;
 
             m_cache[m_cacheIn].count = GD20HM303D_FIFO_THRESH;
@@ -491,7 +568,7 @@ bool RTIMUGD20HM303D::IMURead()
 
         memcpy(gyroData, m_cache[m_cacheOut].data + m_cache[m_cacheOut].index, GD20HM303D_FIFO_CHUNK_SIZE);
         memcpy(accelData, m_cache[m_cacheOut].accel, 6);
-        memcpy(compassData, m_cache[m_cacheOut].compass, 6);
+        memcpy(compassData + 1, m_cache[m_cacheOut].compass, 6);
 
         m_cache[m_cacheOut].index += GD20HM303D_FIFO_CHUNK_SIZE;
 
@@ -502,12 +579,7 @@ bool RTIMUGD20HM303D::IMURead()
                 m_cacheOut = 0;
             m_cacheCount--;
         }
-        if (m_firstTime)
-            m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
-        else
-            m_imuData.timestamp += m_sampleInterval;
-
-        m_firstTime = false;
+        m_imuData->timestamp = m_timestamp.nextTimestamp();
     }
 
 #else
@@ -517,37 +589,48 @@ bool RTIMUGD20HM303D::IMURead()
     if ((status & 0x8) == 0)
         return false;
 
-    if (!m_settings->HALRead(m_gyroSlaveAddr, 0x80 | L3GD20H_OUT_X_L, 6, gyroData, "Failed to read L3GD20H data"))
-        return false;
+    m_timestamp.sampleReady(m_settings->HALTimestamp());
 
-    m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
+    //  the compass status is read with its data
 
-    if (!m_settings->HALRead(m_accelCompassSlaveAddr, 0x80 | LSM303D_OUT_X_L_A, 6, accelData, "Failed to read LSM303D accel data"))
-        return false;
+    bool readCompass = compassDue();
 
-    if (!m_settings->HALRead(m_accelCompassSlaveAddr, 0x80 | LSM303D_OUT_X_L_M, 6, compassData, "Failed to read LSM303D compass data"))
+    m_settings->HALBatchBegin();
+    m_settings->HALBatchRead(m_gyroSlaveAddr, 0x80 | L3GD20H_OUT_X_L, 6, gyroData);
+    m_settings->HALBatchRead(m_accelCompassSlaveAddr, 0x80 | LSM303D_OUT_X_L_A, 6, accelData);
+    if (readCompass)
+        m_settings->HALBatchRead(m_accelCompassSlaveAddr, 0x80 | LSM303D_STATUS_M, 7, compassData);
+
+    if (!m_settings->HALBatchSubmit("Failed to read L3GD20H/LSM303D data"))
         return false;
 
+    if (readCompass)
+        compassRead((compassData[0] & 0x08) != 0);
+
+    m_imuData->timestamp = m_timestamp.nextTimestamp();
+
 #endif
 
-    RTMath::convertToVector(gyroData, m_imuData.gyro, m_gyroScale, false);
-    RTMath::convertToVector(accelData, m_imuData.accel, m_accelScale, false);
-    RTMath::convertToVector(compassData, m_imuData.compass, m_compassScale, false);
+    RTMath::convertToVector(gyroData, m_imuData->gyro, m_gyroScale, false);
+    RTMath::convertToVector(accelData, m_imuData->accel, m_accelScale, false);
 
     //  sort out gyro axes
 
-    m_imuData.gyro.setX(m_imuData.gyro.x());
-    m_imuData.gyro.setY(-m_imuData.gyro.y());
-    m_imuData.gyro.setZ(-m_imuData.gyro.z());
+    m_imuData->gyro.setX(m_imuData->gyro.x());
+    m_imuData->gyro.setY(-m_imuData->gyro.y());
+    m_imuData->gyro.setZ(-m_imuData->gyro.z());
 
     //  sort out accel data;
 
-    m_imuData.accel.setX(-m_imuData.accel.x());
+    m_imuData->accel.setX(-m_imuData->accel.x());
 
-    //  sort out compass axes
+    //  sort out compass axes, the compass keeps its last value if there's no new sample
 
-    m_imuData.compass.setY(-m_imuData.compass.y());
-    m_imuData.compass.setZ(-m_imuData.compass.z());
+    if (m_imuData->compassValid) {
+        RTMath::convertToVector(compassData + 1, m_imuData->compass, m_compassScale, false);
+        m_imuData->compass.setY(-m_imuData->compass.y());
+        m_imuData->compass.setZ(-m_imuData->compass.z());
+    }
 
     //  now do standard processing
 
@@ -60,10 +60,12 @@ public:
     virtual const char *IMUName() { return "L3GD20H + LSM303D"; }
     virtual int IMUType() { return RTIMU_TYPE_GD20HM303D; }
     virtual bool IMUInit();
+    virtual bool IMUReconfigure();
     virtual int IMUGetPollInterval();
     virtual bool IMURead();
 
 private:
+    bool setRegisterValues();                               // works out the register values from the settings
     bool setGyroSampleRate();
     bool setGyroCTRL2();
     bool setGyroCTRL4();
@@ -74,6 +76,8 @@ private:
     bool setCompassCTRL6();
     bool setCompassCTRL7();
 
+    static const RTIMU_REG_INIT m_initSequence[];           // the init sequence for both chips
+
     unsigned char m_gyroSlaveAddr;                          // I2C address of L3GD20H
     unsigned char m_accelCompassSlaveAddr;                  // I2C address of LSM303D
 
@@ -82,7 +86,6 @@ private:
     RTFLOAT m_compassScale;
 
 #ifdef GD20HM303D_CACHE_MODE
-    bool m_firstTime;                                       // if first sample
 
     GD20HM303D_CACHE_BLOCK m_cache[GD20HM303D_CACHE_BLOCK_COUNT]; // the cache itself
     int m_cacheIn;                                          // the in index
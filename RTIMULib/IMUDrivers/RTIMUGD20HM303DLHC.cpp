@@ -29,6 +29,52 @@
 
 #define COMPASS_ALPHA 0.2f
 
+//  slaves and values in the init sequence
+
+#define GD20HM303DLHC_GYRO              0
+#define GD20HM303DLHC_ACCEL             1
+#define GD20HM303DLHC_COMPASS           2
+
+#define GD20HM303DLHC_GYRO_CTRL1        0
+#define GD20HM303DLHC_GYRO_CTRL2        1
+#define GD20HM303DLHC_GYRO_CTRL3        2
+#define GD20HM303DLHC_GYRO_CTRL4        3
+#define GD20HM303DLHC_GYRO_CTRL5        4
+#define GD20HM303DLHC_GYRO_LOW_ODR      5
+#define GD20HM303DLHC_ACCEL_CTRL1       6
+#define GD20HM303DLHC_ACCEL_CTRL4       7
+#define GD20HM303DLHC_COMPASS_CRA       8
+#define GD20HM303DLHC_COMPASS_CRB       9
+#define GD20HM303DLHC_COMPASS_CRM       10
+
+//  Registers are in address order so that they go out as burst writes
+
+const RTIMU_REG_INIT RTIMUGD20HM303DLHC::m_initSequence[] = {
+    {RTIMUREGINIT_WRITE, GD20HM303DLHC_GYRO, L3GD20H_LOW_ODR, 0x04, 0, "Failed to reset L3GD20H"},
+    {RTIMUREGINIT_WRITE, GD20HM303DLHC_GYRO, L3GD20H_CTRL5, 0x80, 0, "Failed to boot L3GD20H"},
+    {RTIMUREGINIT_VERIFY, GD20HM303DLHC_GYRO, L3GD20H_WHO_AM_I, L3GD20H_ID, 0xff, "Incorrect L3GD20H id"},
+
+#ifdef GD20HM303DLHC_CACHE_MODE
+    //  the gyro fifo mode, the fifo is turned on in CTRL5
+
+    {RTIMUREGINIT_WRITE, GD20HM303DLHC_GYRO, L3GD20H_FIFO_CTRL, 0x3f, 0, "Failed to set L3GD20H FIFO mode"},
+#endif
+
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303DLHC_GYRO, L3GD20H_CTRL1, GD20HM303DLHC_GYRO_CTRL1, 0, "Failed to set L3GD20H CTRL1-5"},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303DLHC_GYRO, L3GD20H_CTRL2, GD20HM303DLHC_GYRO_CTRL2, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303DLHC_GYRO, L3GD20H_CTRL3, GD20HM303DLHC_GYRO_CTRL3, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303DLHC_GYRO, L3GD20H_CTRL4, GD20HM303DLHC_GYRO_CTRL4, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303DLHC_GYRO, L3GD20H_CTRL5, GD20HM303DLHC_GYRO_CTRL5, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303DLHC_GYRO, L3GD20H_LOW_ODR, GD20HM303DLHC_GYRO_LOW_ODR, 0, "Failed to set L3GD20H LOW_ODR"},
+
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303DLHC_ACCEL, LSM303DLHC_CTRL1_A, GD20HM303DLHC_ACCEL_CTRL1, 0, "Failed to set LSM303DLHC CTRL1"},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303DLHC_ACCEL, LSM303DLHC_CTRL4_A, GD20HM303DLHC_ACCEL_CTRL4, 0, "Failed to set LSM303DLHC CTRL4"},
+
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303DLHC_COMPASS, LSM303DLHC_CRA_M, GD20HM303DLHC_COMPASS_CRA, 0, "Failed to set LSM303DLHC CRA-CRM"},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303DLHC_COMPASS, LSM303DLHC_CRB_M, GD20HM303DLHC_COMPASS_CRB, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, GD20HM303DLHC_COMPASS, LSM303DLHC_CRM_M, GD20HM303DLHC_COMPASS_CRM, 0, ""}
+};
+
 RTIMUGD20HM303DLHC::RTIMUGD20HM303DLHC(RTIMUSettings *settings) : RTIMU(settings)
 {
     m_sampleRate = 100;
@@ -36,26 +82,24 @@ RTIMUGD20HM303DLHC::RTIMUGD20HM303DLHC(RTIMUSettings *settings) : RTIMU(settings
 
 RTIMUGD20HM303DLHC::~RTIMUGD20HM303DLHC()
 {
+    stopAcquisition();
 }
 
 bool RTIMUGD20HM303DLHC::IMUInit()
 {
-    unsigned char result;
-
 #ifdef GD20HM303DLHC_CACHE_MODE
-    m_firstTime = true;
     m_cacheIn = m_cacheOut = m_cacheCount = 0;
 #endif
     // set validity flags
 
-    m_imuData.fusionPoseValid = false;
-    m_imuData.fusionQPoseValid = false;
-    m_imuData.gyroValid = true;
-    m_imuData.accelValid = true;
-    m_imuData.compassValid = true;
-    m_imuData.pressureValid = false;
-    m_imuData.temperatureValid = false;
-    m_imuData.humidityValid = false;
+    m_imuData->fusionPoseValid = false;
+    m_imuData->fusionQPoseValid = false;
+    m_imuData->gyroValid = true;
+    m_imuData->accelValid = true;
+    m_imuData->compassValid = true;
+    m_imuData->pressureValid = false;
+    m_imuData->temperatureValid = false;
+    m_imuData->humidityValid = false;
 
     //  configure IMU
 
@@ -70,32 +114,72 @@ bool RTIMUGD20HM303DLHC::IMUInit()
     if (!m_settings->HALOpen())
         return false;
 
-    //  Set up the gyro
+    m_regInit.setSlave(GD20HM303DLHC_GYRO, m_gyroSlaveAddr, true, 0x80);
+    m_regInit.setSlave(GD20HM303DLHC_ACCEL, m_accelSlaveAddr, true, 0x80);
+    m_regInit.setSlave(GD20HM303DLHC_COMPASS, m_compassSlaveAddr, true, 0x80);
 
-    if (!m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_LOW_ODR, 0x04, "Failed to reset L3GD20H"))
+    if (!setRegisterValues())
         return false;
 
-    if (!m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_CTRL5, 0x80, "Failed to boot L3GD20H"))
+    if (!m_regInit.run(m_settings, RTIMUREGINIT_TABLE(m_initSequence)))
         return false;
 
-    if (!m_settings->HALRead(m_gyroSlaveAddr, L3GD20H_WHO_AM_I, 1, &result, "Failed to read L3GD20H id"))
-        return false;
+    m_dataReadyConfigured = dataReadyEnabled();
+
+    gyroBiasInit();
+
+    m_timestamp.reset(m_sampleInterval);
+
+    HAL_INFO("GD20HM303DLHC init complete\n");
+    return true;
+}
 
-    if (result != L3GD20H_ID) {
-        HAL_ERROR1("Incorrect L3GD20H id %d\n", result);
+bool RTIMUGD20HM303DLHC::IMUReconfigure()
+{
+#ifdef GD20M303DLHC_CACHE_MODE
+    HAL_ERROR("GD20HM303DLHC can't be reconfigured in cache mode\n");
+    return false;
+#else
+    RTFLOAT gyroScale = m_gyroScale;
+    RTFLOAT accelScale = m_accelScale;
+    RTFLOAT compassScaleXY = m_compassScaleXY;
+    RTFLOAT compassScaleZ = m_compassScaleZ;
+    int written;
+
+    reconfigureBegin();
+
+    if (!setRegisterValues()) {
+        m_gyroScale = gyroScale;
+        m_accelScale = accelScale;
+        m_compassScaleXY = compassScaleXY;
+        m_compassScaleZ = compassScaleZ;
+        reconfigureAbandon();
         return false;
     }
 
+    if (!m_regInit.update(m_settings, RTIMUREGINIT_TABLE(m_initSequence), written))
+        return false;
+
+    reconfigureEnd(written > 0);
+
+    HAL_INFO1("GD20HM303DLHC reconfigured, %d registers written\n", written);
+    return true;
+#endif
+}
+
+bool RTIMUGD20HM303DLHC::setRegisterValues()
+{
     if (!setGyroSampleRate())
-            return false;
+        return false;
 
     if (!setGyroCTRL2())
-            return false;
+        return false;
 
     if (!setGyroCTRL4())
-            return false;
+        return false;
 
-    //  Set up the accel
+    if (!setGyroCTRL5())
+        return false;
 
     if (!setAccelCTRL1())
         return false;
@@ -103,8 +187,6 @@ bool RTIMUGD20HM303DLHC::IMUInit()
     if (!setAccelCTRL4())
         return false;
 
-    //  Set up the compass
-
     if (!setCompassCRA())
         return false;
 
@@ -114,20 +196,9 @@ bool RTIMUGD20HM303DLHC::IMUInit()
     if (!setCompassCRM())
         return false;
 
-#ifdef GD20HM303DLHC_CACHE_MODE
-
-    //  turn on gyro fifo
-
-    if (!m_settings->HALWrite(m_gyroSlaveAddr, L3GD20_FIFO_CTRL, 0x3f, "Failed to set L3GD20 FIFO mode"))
-        return false;
-#endif
-
-    if (!setGyroCTRL5())
-            return false;
-
-    gyroBiasInit();
+    //  gyro data ready on DRDY/INT2
 
-    HAL_INFO("GD20HM303DLHC init complete\n");
+    m_regInit.setValue(GD20HM303DLHC_GYRO_CTRL3, dataReadyEnabled() ? 0x08 : 0x00);
     return true;
 }
 
@@ -201,10 +272,9 @@ bool RTIMUGD20HM303DLHC::setGyroSampleRate()
 
     }
 
-    if (!m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_LOW_ODR, lowOdr, "Failed to set L3GD20H LOW_ODR"))
-        return false;
-
-    return (m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_CTRL1, ctrl1, "Failed to set L3GD20H CTRL1"));
+    m_regInit.setValue(GD20HM303DLHC_GYRO_LOW_ODR, lowOdr);
+    m_regInit.setValue(GD20HM303DLHC_GYRO_CTRL1, ctrl1);
+    return true;
 }
 
 bool RTIMUGD20HM303DLHC::setGyroCTRL2()
@@ -213,7 +283,8 @@ bool RTIMUGD20HM303DLHC::setGyroCTRL2()
         HAL_ERROR1("Illegal L3GD20H high pass filter code %d\n", m_settings->m_GD20HM303DLHCGyroHpf);
         return false;
     }
-    return m_settings->HALWrite(m_gyroSlaveAddr,  L3GD20H_CTRL2, m_settings->m_GD20HM303DLHCGyroHpf, "Failed to set L3GD20H CTRL2");
+    m_regInit.setValue(GD20HM303DLHC_GYRO_CTRL2, m_settings->m_GD20HM303DLHCGyroHpf);
+    return true;
 }
 
 bool RTIMUGD20HM303DLHC::setGyroCTRL4()
@@ -241,7 +312,8 @@ bool RTIMUGD20HM303DLHC::setGyroCTRL4()
         return false;
     }
 
-    return m_settings->HALWrite(m_gyroSlaveAddr,  L3GD20H_CTRL4, ctrl4, "Failed to set L3GD20H CTRL4");
+    m_regInit.setValue(GD20HM303DLHC_GYRO_CTRL4, ctrl4);
+    return true;
 }
 
 
@@ -259,7 +331,8 @@ bool RTIMUGD20HM303DLHC::setGyroCTRL5()
     ctrl5 |= 0x40;
 #endif
 
-    return m_settings->HALWrite(m_gyroSlaveAddr,  L3GD20H_CTRL5, ctrl5, "Failed to set L3GD20H CTRL5");
+    m_regInit.setValue(GD20HM303DLHC_GYRO_CTRL5, ctrl5);
+    return true;
 }
 
 
@@ -274,7 +347,8 @@ bool RTIMUGD20HM303DLHC::setAccelCTRL1()
 
     ctrl1 = (m_settings->m_GD20HM303DLHCAccelSampleRate << 4) | 0x07;
 
-    return m_settings->HALWrite(m_accelSlaveAddr,  LSM303DLHC_CTRL1_A, ctrl1, "Failed to set LSM303D CTRL1");
+    m_regInit.setValue(GD20HM303DLHC_ACCEL_CTRL1, ctrl1);
+    return true;
 }
 
 bool RTIMUGD20HM303DLHC::setAccelCTRL4()
@@ -305,7 +379,8 @@ bool RTIMUGD20HM303DLHC::setAccelCTRL4()
 
     ctrl4 = 0x80 + (m_settings->m_GD20HM303DLHCAccelFsr << 4);
 
-    return m_settings->HALWrite(m_accelSlaveAddr,  LSM303DLHC_CTRL4_A, ctrl4, "Failed to set LSM303DLHC CTRL4");
+    m_regInit.setValue(GD20HM303DLHC_ACCEL_CTRL4, ctrl4);
+    return true;
 }
 
 
@@ -320,7 +395,8 @@ bool RTIMUGD20HM303DLHC::setCompassCRA()
 
     cra = (m_settings->m_GD20HM303DLHCCompassSampleRate << 2);
 
-    return m_settings->HALWrite(m_compassSlaveAddr,  LSM303DLHC_CRA_M, cra, "Failed to set LSM303DLHC CRA_M");
+    m_regInit.setValue(GD20HM303DLHC_COMPASS_CRA, cra);
+    return true;
 }
 
 bool RTIMUGD20HM303DLHC::setCompassCRB()
@@ -377,12 +453,14 @@ bool RTIMUGD20HM303DLHC::setCompassCRB()
         return false;
     }
 
-    return m_settings->HALWrite(m_compassSlaveAddr,  LSM303DLHC_CRB_M, crb, "Failed to set LSM303DLHC CRB_M");
+    m_regInit.setValue(GD20HM303DLHC_COMPASS_CRB, crb);
+    return true;
 }
 
 bool RTIMUGD20HM303DLHC::setCompassCRM()
 {
-     return m_settings->HALWrite(m_compassSlaveAddr,  LSM303DLHC_CRM_M, 0x00, "Failed to set LSM303DLHC CRM_M");
+    m_regInit.setValue(GD20HM303DLHC_COMPASS_CRM, 0x00);
+    return true;
 }
 
 
@@ -416,16 +494,27 @@ bool RTIMUGD20HM303DLHC::IMURead()
         if (!m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_FIFO_CTRL, 0x3f, "Failed to set L3GD20 FIFO mode"))
             return false;
 
-        if (!setGyroCTRL5())
+        if (!m_settings->HALWrite(m_gyroSlaveAddr, L3GD20H_CTRL5, 0x50, "Failed to set L3GD20H CTRL5"))
             return false;
 
-        m_imuData.timestamp += m_sampleInterval * 32;
+        m_timestamp.reset(m_sampleInterval);
         return false;
     }
 
     // get count of samples in fifo
     count = status & 0x1f;
 
+    //  samples not yet delivered are those in the fifo and in the cache
+
+    int pending = count;
+
+    for (int i = 0, block = m_cacheOut; i < m_cacheCount; i++) {
+        pending += m_cache[block].count;
+        if (++block == GD20HM303DLHC_CACHE_BLOCK_COUNT)
+            block = 0;
+    }
+    m_timestamp.fifoLevel(pending, m_settings->HALTimestamp());
+
     if ((m_cacheCount == 0) && (count > 0) && (count < GD20HM303DLHC_FIFO_THRESH)) {
         // special case of a small fifo and nothing cached - just handle as simple read
 
@@ -438,19 +527,14 @@ bool RTIMUGD20HM303DLHC::IMURead()
         if (!m_settings->HALRead(m_compassSlaveAddr, 0x80 | LSM303DLHC_OUT_X_H_M, 6, compassData, "Failed to read LSM303DLHC compass data"))
             return false;
 
-        if (m_firstTime)
-            m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
-        else
-            m_imuData.timestamp += m_sampleInterval;
-
-        m_firstTime = false;
+        m_imuData->timestamp = m_timestamp.nextTimestamp();
     } else {
         if (count >=  GD20HM303DLHC_FIFO_THRESH) {
             // need to create a cache block
 
             if (m_cacheCount == GD20HM303DLHC_CACHE_BLOCK_COUNT) {
                 // all cache blocks are full - discard oldest and update timestamp to account for lost samples
-                m_imuData.timestamp += m_sampleInterval * m_cache[m_cacheOut].count;
+                m_timestamp.discard(m_cache[m_cacheOut].count);
                 if (++m_cacheOut == GD20HM303DLHC_CACHE_BLOCK_COUNT)
                     m_cacheOut = 0;
                 m_cacheCount--;
@@ -495,12 +579,7 @@ bool RTIMUGD20HM303DLHC::IMURead()
                 m_cacheOut = 0;
             m_cacheCount--;
         }
-        if (m_firstTime)
-            m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
-        else
-            m_imuData.timestamp += m_sampleInterval;
-
-        m_firstTime = false;
+        m_imuData->timestamp = m_timestamp.nextTimestamp();
     }
 
 #else
@@ -510,10 +589,12 @@ bool RTIMUGD20HM303DLHC::IMURead()
     if ((status & 0x8) == 0)
         return false;
 
+    m_timestamp.sampleReady(m_settings->HALTimestamp());
+
     if (!m_settings->HALRead(m_gyroSlaveAddr, 0x80 | L3GD20H_OUT_X_L, 6, gyroData, "Failed to read L3GD20H data"))
         return false;
 
-    m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
+    m_imuData->timestamp = m_timestamp.nextTimestamp();
 
     if (!m_settings->HALRead(m_accelSlaveAddr, 0x80 | LSM303DLHC_OUT_X_L_A, 6, accelData, "Failed to read LSM303DLHC accel data"))
         return false;
@@ -523,30 +604,30 @@ bool RTIMUGD20HM303DLHC::IMURead()
 
 #endif
 
-    RTMath::convertToVector(gyroData, m_imuData.gyro, m_gyroScale, false);
-    RTMath::convertToVector(accelData, m_imuData.accel, m_accelScale, false);
+    RTMath::convertToVector(gyroData, m_imuData->gyro, m_gyroScale, false);
+    RTMath::convertToVector(accelData, m_imuData->accel, m_accelScale, false);
 
-    m_imuData.compass.setX((RTFLOAT)((int16_t)(((uint16_t)compassData[0] << 8) | (uint16_t)compassData[1])) * m_compassScaleXY);
-    m_imuData.compass.setY((RTFLOAT)((int16_t)(((uint16_t)compassData[2] << 8) | (uint16_t)compassData[3])) * m_compassScaleXY);
-    m_imuData.compass.setZ((RTFLOAT)((int16_t)(((uint16_t)compassData[4] << 8) | (uint16_t)compassData[5])) * m_compassScaleZ);
+    m_imuData->compass.setX((RTFLOAT)((int16_t)(((uint16_t)compassData[0] << 8) | (uint16_t)compassData[1])) * m_compassScaleXY);
+    m_imuData->compass.setY((RTFLOAT)((int16_t)(((uint16_t)compassData[2] << 8) | (uint16_t)compassData[3])) * m_compassScaleXY);
+    m_imuData->compass.setZ((RTFLOAT)((int16_t)(((uint16_t)compassData[4] << 8) | (uint16_t)compassData[5])) * m_compassScaleZ);
 
     //  sort out gyro axes
 
-    m_imuData.gyro.setX(m_imuData.gyro.x());
-    m_imuData.gyro.setY(-m_imuData.gyro.y());
-    m_imuData.gyro.setZ(-m_imuData.gyro.z());
+    m_imuData->gyro.setX(m_imuData->gyro.x());
+    m_imuData->gyro.setY(-m_imuData->gyro.y());
+    m_imuData->gyro.setZ(-m_imuData->gyro.z());
 
     //  sort out accel data;
 
-    m_imuData.accel.setX(-m_imuData.accel.x());
+    m_imuData->accel.setX(-m_imuData->accel.x());
 
     //  sort out compass axes
 
     RTFLOAT temp;
 
-    temp = m_imuData.compass.z();
-    m_imuData.compass.setZ(-m_imuData.compass.y());
-    m_imuData.compass.setY(-temp);
+    temp = m_imuData->compass.z();
+    m_imuData->compass.setZ(-m_imuData->compass.y());
+    m_imuData->compass.setY(-temp);
 
     //  now do standard processing
 
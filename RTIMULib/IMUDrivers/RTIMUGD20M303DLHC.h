@@ -60,10 +60,12 @@ public:
     virtual const char *IMUName() { return "L3GD20 + LSM303DLHC"; }
     virtual int IMUType() { return RTIMU_TYPE_GD20M303DLHC; }
     virtual bool IMUInit();
+    virtual bool IMUReconfigure();
     virtual int IMUGetPollInterval();
     virtual bool IMURead();
 
 private:
+    bool setRegisterValues();                               // works out the register values from the settings
     bool setGyroSampleRate();
     bool setGyroCTRL2();
     bool setGyroCTRL4();
@@ -74,6 +76,8 @@ private:
     bool setCompassCRB();
     bool setCompassCRM();
 
+    static const RTIMU_REG_INIT m_initSequence[];           // the init sequence for all the chips
+
     unsigned char m_gyroSlaveAddr;                          // I2C address of L3GD20
     unsigned char m_accelSlaveAddr;                         // I2C address of LSM303DLHC accel
     unsigned char m_compassSlaveAddr;                       // I2C address of LSM303DLHC compass
@@ -84,7 +88,6 @@ private:
     RTFLOAT m_compassScaleZ;
 
 #ifdef GD20M303DLHC_CACHE_MODE
-    bool m_firstTime;                                       // if first sample
 
     GD20M303DLHC_CACHE_BLOCK m_cache[GD20M303DLHC_CACHE_BLOCK_COUNT]; // the cache itself
     int m_cacheIn;                                          // the in index
@@ -43,19 +43,20 @@ RTIMU5883L::RTIMU5883L(RTIMUSettings *settings) : RTIMU(settings)
 
 RTIMU5883L::~RTIMU5883L()
 {
+    stopAcquisition();
 }
 
 
 bool RTIMU5883L::IMUInit()
 {
-    m_imuData.fusionPoseValid = false;
-    m_imuData.fusionQPoseValid = false;
-    m_imuData.gyroValid = true;
-    m_imuData.accelValid = true;
-    m_imuData.compassValid = true;
-    m_imuData.pressureValid = false;
-    m_imuData.temperatureValid = false;
-    m_imuData.humidityValid = false;
+    m_imuData->fusionPoseValid = false;
+    m_imuData->fusionQPoseValid = false;
+    m_imuData->gyroValid = true;
+    m_imuData->accelValid = true;
+    m_imuData->compassValid = true;
+    m_imuData->pressureValid = false;
+    m_imuData->temperatureValid = false;
+    m_imuData->humidityValid = false;
     
 
     setCalibrationData();
@@ -103,6 +104,7 @@ bool RTIMU5883L::IMUInit()
     {
 	return false;
     }
+    m_dataReadyConfigured = true;
 
     // Configure gyro full-scale range: 0x00 = 250, 0x10 = 500, 0x30 = 2000
     if (!m_settings->HALWrite(m_gyroSlaveAddr, CTRL_REG4, 0x30, "Error Setting up L3G4200D"))
@@ -218,44 +220,44 @@ bool RTIMU5883L::IMURead()
     {
        return false;
     }
-    m_imuData.gyro.setX((RTFLOAT)x * m_gyroScale);
-    m_imuData.gyro.setY((RTFLOAT)y * m_gyroScale);
-    m_imuData.gyro.setZ((RTFLOAT)z * m_gyroScale);
+    m_imuData->gyro.setX((RTFLOAT)x * m_gyroScale);
+    m_imuData->gyro.setY((RTFLOAT)y * m_gyroScale);
+    m_imuData->gyro.setZ((RTFLOAT)z * m_gyroScale);
 
     if (!readHMC5883L(x, y, z))
     {
 	return false;
     }
-    m_imuData.compass.setX((RTFLOAT)x * m_compassScale);
-    m_imuData.compass.setY((RTFLOAT)y * m_compassScale);
-    m_imuData.compass.setZ((RTFLOAT)z * m_compassScale);
+    m_imuData->compass.setX((RTFLOAT)x * m_compassScale);
+    m_imuData->compass.setY((RTFLOAT)y * m_compassScale);
+    m_imuData->compass.setZ((RTFLOAT)z * m_compassScale);
 
     if (!readADXL345(x, y, z))
     {
 	return false;
     }
-    m_imuData.accel.setX((RTFLOAT)x * m_accelScale);
-    m_imuData.accel.setY((RTFLOAT)y * m_accelScale);
-    m_imuData.accel.setZ((RTFLOAT)z * m_accelScale);
+    m_imuData->accel.setX((RTFLOAT)x * m_accelScale);
+    m_imuData->accel.setY((RTFLOAT)y * m_accelScale);
+    m_imuData->accel.setZ((RTFLOAT)z * m_accelScale);
 
     // Timestamp the data
-    m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
+    m_imuData->timestamp = m_settings->HALTimestamp();
 
 
     //  Swap the axes to match the board
     //  Might have to change these depending on specific board layout
     RTFLOAT temp;
-    temp = m_imuData.gyro.x();
-    m_imuData.gyro.setX(-m_imuData.gyro.y());
-    m_imuData.gyro.setY(-temp);
+    temp = m_imuData->gyro.x();
+    m_imuData->gyro.setX(-m_imuData->gyro.y());
+    m_imuData->gyro.setY(-temp);
     
-    temp = m_imuData.accel.x();
-    m_imuData.accel.setX(m_imuData.accel.y());
-    m_imuData.accel.setY(temp);
+    temp = m_imuData->accel.x();
+    m_imuData->accel.setX(m_imuData->accel.y());
+    m_imuData->accel.setY(temp);
     
-    temp = m_imuData.compass.y();
-    m_imuData.compass.setY(m_imuData.compass.x());
-    m_imuData.compass.setX(temp);
+    temp = m_imuData->compass.y();
+    m_imuData->compass.setY(m_imuData->compass.x());
+    m_imuData->compass.setX(temp);
 
     
     //  now do standard processing and update the filter
@@ -35,6 +35,7 @@ RTIMUICM20948::RTIMUICM20948(RTIMUSettings *settings) : RTIMU(settings)
 
 RTIMUICM20948::~RTIMUICM20948()
 {
+    stopAcquisition();
 }
 
 bool RTIMUICM20948::setSampleRate(int rate)
@@ -192,21 +193,22 @@ bool RTIMUICM20948::SelectRegisterBank(uint8_t reg_bank)
 
 bool RTIMUICM20948::IMUInit()
 {
-    m_firstTime = true;
+    RTFLOAT temperature;
 
     // set validity flags
 
-    m_imuData.fusionPoseValid = false;
-    m_imuData.fusionQPoseValid = false;
-    m_imuData.gyroValid = true;
-    m_imuData.accelValid = true;
-    m_imuData.compassValid = true;
-    m_imuData.pressureValid = false;
-    m_imuData.temperatureValid = false;
-    m_imuData.humidityValid = false;
+    m_imuData->fusionPoseValid = false;
+    m_imuData->fusionQPoseValid = false;
+    m_imuData->gyroValid = true;
+    m_imuData->accelValid = true;
+    m_imuData->compassValid = true;
+    m_imuData->pressureValid = false;
+    m_imuData->temperatureValid = false;
+    m_imuData->humidityValid = false;
 
     //  configure IMU
     m_slaveAddr = m_settings->m_I2CSlaveAddress;
+    m_fifo.setup(m_settings, m_slaveAddr, ICM20948_FIFO_R_W, ICM20948_FIFO_CHUNK_SIZE, ICM20948_FIFO_SIZE);
 
     setSampleRate(m_settings->m_ICM20948GyroAccelSampleRate);
     setCompassRate(m_settings->m_ICM20948CompassSampleRate);
@@ -223,6 +225,28 @@ bool RTIMUICM20948::IMUInit()
     if (!m_settings->HALOpen())
         return false;
 
+    //  a chip that is still set up from last time doesn't need to be reset
+
+    if (warmStart()) {
+        HAL_INFO1("%s warm start\n", IMUName());
+    } else if (!fullInit()) {
+        return false;
+    }
+
+    setFifoLayout();
+    gyroBiasInit();
+
+    if (readTemperature(temperature))
+        gyroBiasSeed(temperature);
+
+    HAL_INFO1("%s init complete\n", IMUName());
+    return true;
+}
+
+
+
+bool RTIMUICM20948::fullInit()
+{
     //  reset the ICM20948
 
     if (!SelectRegisterBank(ICM20948_BANK0))
@@ -259,15 +283,113 @@ bool RTIMUICM20948::IMUInit()
     if (!setSampleRate())
         return false;
 
-    gyroBiasInit();
+    return resetFifo();
+}
+
+bool RTIMUICM20948::warmStart()
+{
+    static const unsigned char banks[3] = { ICM20948_BANK0, ICM20948_BANK2, ICM20948_BANK3 };
+    static const unsigned char fifoReset[2] = { 0x01, 0x00 };
+    unsigned char id;
+    unsigned char control[5];
+    unsigned char intEnable1;
+    unsigned char fifoEnable[2];
+    unsigned char gyroConfig[3];
+    unsigned char accelConfig[2];
+    unsigned char master[5];
 
-    if (!resetFifo())
+    //  read back what fullInit() sets up in all three banks in one batch, leaving bank 0 selected
+
+    m_settings->HALBatchBegin();
+    m_settings->HALBatchWrite(m_slaveAddr, ICM20948_REG_BANK_SEL, 1, banks + 0);
+    m_settings->HALBatchRead(m_slaveAddr, ICM20948_WHO_AM_I, 1, &id);
+    m_settings->HALBatchRead(m_slaveAddr, ICM20948_USER_CTRL, 5, control);
+    m_settings->HALBatchRead(m_slaveAddr, ICM20948_INT_ENABLE_1, 1, &intEnable1);
+    m_settings->HALBatchRead(m_slaveAddr, ICM20948_FIFO_EN_1, 2, fifoEnable);
+    m_settings->HALBatchWrite(m_slaveAddr, ICM20948_REG_BANK_SEL, 1, banks + 1);
+    m_settings->HALBatchRead(m_slaveAddr, ICM20948_GYRO_SMPLRT_DIV, 3, gyroConfig);
+    m_settings->HALBatchRead(m_slaveAddr, ICM20948_ACCEL_CONFIG, 2, accelConfig);
+    m_settings->HALBatchWrite(m_slaveAddr, ICM20948_REG_BANK_SEL, 1, banks + 2);
+    m_settings->HALBatchRead(m_slaveAddr, ICM20948_I2C_MST_CTRL, 5, master);
+    m_settings->HALBatchWrite(m_slaveAddr, ICM20948_REG_BANK_SEL, 1, banks + 0);
+    m_reg_bank = 255;
+    if (!m_settings->HALBatchSubmit(""))
         return false;
+    m_reg_bank = ICM20948_BANK0;
 
-    HAL_INFO1("%s init complete\n", IMUName());
+    if (id != ICM20948_ID)
+        return false;
+
+    //  user control and the power management registers
+
+    if ((control[0] != 0x60) || (control[3] != 0x01) || (control[4] != 0x00))
+        return false;
+
+    if ((intEnable1 != (dataReadyEnabled() ? 0x01 : 0x00)) || (fifoEnable[0] != 0x01) || (fifoEnable[1] != 0x1e))
+        return false;
+
+    uint8_t rate = (1100.0 / m_sampleRate) - 1;
+    unsigned char expectedGyro[3] = { rate, (unsigned char)((4 << 3) | (m_gyroFsr << 1) | 1), 0 };
+    unsigned char expectedAccel[2] = { (unsigned char)((4 << 3) | (m_accelFsr << 1) | 1), 0 };
+    unsigned char expectedMaster[5] = { 0x08, 0x81, AK09916_I2C_ADDR | 0x80, AK09916_ST1 + 1, 0x88 };
+
+    if ((memcmp(gyroConfig, expectedGyro, 3) != 0) || (memcmp(accelConfig, expectedAccel, 2) != 0) ||
+            (memcmp(master, expectedMaster, 5) != 0))
+        return false;
+
+    //  as setGyroConfig() works it out
+
+    m_sampleInterval = (uint64_t)(1 + rate) * 1000000 / 1125;
+
+    if (dataReadyEnabled()) {
+        m_dataReadyConfigured = true;
+        m_dataReadyActiveLow = true;
+    }
+
+    //  empty the fifo without the delay in resetFifo()
+
+    m_settings->HALBatchBegin();
+    m_settings->HALBatchWrite(m_slaveAddr, ICM20948_FIFO_RST, 1, fifoReset + 0);
+    m_settings->HALBatchWrite(m_slaveAddr, ICM20948_FIFO_RST, 1, fifoReset + 1);
+    if (!m_settings->HALBatchSubmit("Resetting fifo"))
+        return false;
+
+    m_fifo.reset();
+    m_timestamp.reset(m_sampleInterval);
     return true;
 }
 
+bool RTIMUICM20948::readTemperature(RTFLOAT& temperature)
+{
+    unsigned char data[2];
+
+    if (!SelectRegisterBank(ICM20948_BANK0))
+        return false;
+
+    if (!m_settings->HALRead(m_slaveAddr, ICM20948_TEMP_OUT_H, 2, data, "Failed to read temperature"))
+        return false;
+
+    temperature = (RTFLOAT)(int16_t)(((uint16_t)data[0] << 8) | data[1]) / 333.87f + 21.0f;
+    return true;
+}
+
+void RTIMUICM20948::setFifoLayout()
+{
+    RTMATH_RAW_TRIPLE triples[3];
+
+    //  accel x is inverted and gyro y and z are inverted
+
+    RTMath::setRawTriple(triples[0], 0, m_accelScale, true);
+    triples[0].scale[0] = -m_accelScale;
+
+    RTMath::setRawTriple(triples[1], 6, m_gyroScale, true);
+    triples[1].scale[1] = -m_gyroScale;
+    triples[1].scale[2] = -m_gyroScale;
+
+    RTMath::setRawTriple(triples[2], 12, 0.6 / 4, false);
+
+    m_fifo.setLayout(triples, 3);
+}
 
 bool RTIMUICM20948::resetFifo()
 {
@@ -296,6 +418,18 @@ bool RTIMUICM20948::resetFifo()
 
     if (!m_settings->HALWrite(m_slaveAddr, ICM20948_USER_CTRL, 0x60, "Enabling the fifo"))
         return false;
+
+    //  raw data ready on the INT pin, which INT_PIN_CFG has made active low
+
+    if (dataReadyEnabled()) {
+        if (!m_settings->HALWrite(m_slaveAddr, ICM20948_INT_ENABLE_1, 0x01, "Writing int enable 1"))
+            return false;
+        m_dataReadyConfigured = true;
+        m_dataReadyActiveLow = true;
+    }
+
+    m_fifo.reset();
+    m_timestamp.reset(m_sampleInterval);
     return true;
 }
 
@@ -312,6 +446,10 @@ bool RTIMUICM20948::setGyroConfig()
     uint8_t rate = (1100.0 / m_sampleRate) - 1;
     if (!m_settings->HALWrite(m_slaveAddr, ICM20948_GYRO_SMPLRT_DIV, rate, "Failed to write gyro sample rate"))
         return false;
+
+    //  the actual output rate is 1.125kHz / (1 + div)
+
+    m_sampleInterval = (uint64_t)(1 + rate) * 1000000 / 1125;
         
     value = (/*m_gyroLpf*/ 4 & 0x07) << 3;
     value |= m_gyroFsr << 1; // gyro fsr
@@ -540,101 +678,89 @@ int RTIMUICM20948::IMUGetPollInterval()
 bool RTIMUICM20948::IMURead()
 {
     unsigned char fifoCount[2];
-    unsigned char fifoData[400];
     unsigned int count;
+    uint64_t readTime;
 
-    if (!SelectRegisterBank(ICM20948_BANK0)) return false;
-    if (!m_settings->HALRead(m_slaveAddr, ICM20948_FIFO_COUNTH, 2, fifoCount, "Failed to read fifo count")) {
-        return false;
-    }
-    
-    count = ((unsigned int)fifoCount[0] << 8) + fifoCount[1];
-    if (count < ICM20948_FIFO_CHUNK_SIZE)
-        return false;
+    if (m_fifo.available() == 0) {
+        if (!SelectRegisterBank(ICM20948_BANK0)) return false;
+        if (!m_settings->HALRead(m_slaveAddr, ICM20948_FIFO_COUNTH, 2, fifoCount, "Failed to read fifo count")) {
+            return false;
+        }
 
-    if (count > 512) {
-        HAL_INFO("ICM20948 fifo has overflowed\n");
-        HAL_INFO("ICM20948 trying to reinitialize sensors\n");
-        IMUInit();
-        return false;
-    }
+        count = ((unsigned int)fifoCount[0] << 8) + fifoCount[1];
+        readTime = m_settings->HALTimestamp();
+        m_fifo.level(count, readTime);
+        if (count < ICM20948_FIFO_CHUNK_SIZE)
+            return false;
 
-    if (count > 400) {
-        HAL_INFO("ICM20948 fifo has more than 20 samples!!\n");
-        count = 400;
-    }
-    
-    count /= ICM20948_FIFO_CHUNK_SIZE;
-    // read fifo data in two reads if more than 10 samples
-    int roffset = 0;
-    int fcount = count;
-    if (count > 10) {
-        if (!m_settings->HALRead(m_slaveAddr, ICM20948_FIFO_R_W, ICM20948_FIFO_CHUNK_SIZE*10, fifoData, "Failed to read fifo data"))
+        m_timestamp.fifoLevel(count / ICM20948_FIFO_CHUNK_SIZE, readTime);
+
+        if (!m_fifo.drain(count, "Failed to read fifo data")) {
+            if (count >= ICM20948_FIFO_SIZE) {
+                HAL_INFO("ICM20948 fifo has overflowed\n");
+                HAL_INFO("ICM20948 trying to reinitialize sensors\n");
+                IMUInit();
+            } else {
+                resetFifo();
+            }
+            return false;
+        }
+
+        if (m_fifo.available() == 0)
             return false;
-        fcount = count - 10;
-        roffset = ICM20948_FIFO_CHUNK_SIZE*10;
     }
-    if (!m_settings->HALRead(m_slaveAddr, ICM20948_FIFO_R_W, fcount*ICM20948_FIFO_CHUNK_SIZE, fifoData+roffset, "Failed to read fifo data"))
-        return false;
 
-    RTVector3 accel_t, gyro_t, compass_t;
-    unsigned char *p = fifoData;
+    //  either the next sample from the cache or the average of everything in it
 
+    bool average = m_settings->m_fifoAverage;
+    int samples = average ? m_fifo.available() : 1;
+
+    for (int i = 0; i < 3; i++) {
+        m_imuData->accel.setData(i, m_fifo.average(0, i, samples));
+        m_imuData->gyro.setData(i, m_fifo.average(1, i, samples));
+    }
+
+    //  only the compass samples without an overflow are used
+
+    const RTFLOAT *compass[3];
+    RTVector3 compass_t;
     int compass_count = 0;
-    for(uint8_t i=0; i<count; i++) {
-        RTVector3 accel, gyro, compass;
-        RTMath::convertToVector(p,    accel, m_accelScale, true);
-        RTMath::convertToVector(p+6,  gyro, m_gyroScale, true);
-        RTMath::convertToVector(p+12, compass, .6/4, false);
 
-        if(fabs(gyro.x()) > 3 || fabs(gyro.y()) > 3 || fabs(gyro.z()) > 3)
-            printf("AAAHAHA %f %f %f %d %d\n", gyro.x(), gyro.y(), gyro.z(), i, count);
+    for (int i = 0; i < 3; i++)
+        compass[i] = m_fifo.converted(2, i);
 
-        accel_t += accel;
-        gyro_t += gyro;
+    for (int i = 0; i < samples; i++) {
+        unsigned char *p = m_fifo.next();
 
-        if(!(p[19] & 0x08))
-        { // compass data valid?
-            compass_t += compass;
+        if (!(p[19] & 0x08)) {
+            m_lastCompass = RTVector3(compass[0][i], compass[1][i], compass[2][i]);
+            compass_t += m_lastCompass;
             compass_count++;
         }
-        p += ICM20948_FIFO_CHUNK_SIZE;
-    }
 
-    if(compass_count == 0)
-        return false;
+        //  the average is stamped with the time of the last sample in it
 
-    // average samples
-    for(int i=0; i<3; i++) {
-        m_imuData.accel.setData(i, accel_t.data(i)/count);
-        m_imuData.gyro.setData(i, gyro_t.data(i)/count);
-        m_imuData.compass.setData(i, compass_t.data(i)/compass_count);
+        m_imuData->timestamp = m_timestamp.nextTimestamp();
     }
-    //  sort out gyro axes
 
-    // x fwd y right z down
-    m_imuData.gyro.setX(m_imuData.gyro.x());
-    m_imuData.gyro.setY(-m_imuData.gyro.y());
-    m_imuData.gyro.setZ(-m_imuData.gyro.z());
+    //  single samples use the last good compass reading
 
-    //  sort out accel data;
-
-    // x back y left z up
-    m_imuData.accel.setX(-m_imuData.accel.x());
+    if (!average) {
+        compass_t = m_lastCompass;
+        compass_count = 1;
+    }
 
-    //  sort out compass axes
+    if (compass_count == 0)
+        return false;
 
-    // x fwd y right z down
+    for (int i = 0; i < 3; i++)
+        m_imuData->compass.setData(i, compass_t.data(i) / compass_count);
 
     //  now do standard processing
     handleGyroBias();
     calibrateAverageCompass();
     calibrateAccel();
 
-    m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
-
-    m_firstTime = false;
-
     //  now update the filter
 
     updateFusion();
@@ -32,6 +32,7 @@
 //  FIFO transfer size
 
 #define ICM20948_FIFO_CHUNK_SIZE     20 // gyro and accel are 12, compass 8
+#define ICM20948_FIFO_SIZE           512 // fifo capacity in bytes
 
 class RTIMUICM20948 : public RTIMU
 {
@@ -60,19 +61,23 @@ public:
 
 protected:
 
+    virtual bool readTemperature(RTFLOAT& temperature);
+
     RTFLOAT m_compassAdjust[3];                             // the compass fuse ROM values converted for use
 
 private:
+    bool fullInit();                                        // reset and set up the chip
+    bool warmStart();                                       // true if the chip is still set up as fullInit() left it
     bool setGyroConfig();
     bool setAccelConfig();
     bool setSampleRate();
     bool compassSetup();
     bool setCompassRate();
     bool resetFifo();
+    void setFifoLayout();                                   // sets up the fifo's conversion for the current scales
     bool bypassOn();
     bool bypassOff();
 
-    bool m_firstTime;                                       // if first sample
 
     unsigned char m_slaveAddr;                              // I2C address of ICM20948
 
@@ -87,6 +92,7 @@ private:
     RTFLOAT m_gyroScale;
     RTFLOAT m_accelScale;
 
+    RTVector3 m_lastCompass;                                // last compass reading without overflow
 
 #ifdef ICM20948_CACHE_MODE
 
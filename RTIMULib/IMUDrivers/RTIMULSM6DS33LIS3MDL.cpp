@@ -31,6 +31,119 @@
 
 #define COMPASS_ALPHA 0.2f
 
+//  slaves and values in the init sequence
+
+#define LSM6DS33LIS3MDL_GYRO_ACCEL      0
+#define LSM6DS33LIS3MDL_COMPASS         1
+
+#define LSM6DS33LIS3MDL_CTRL1_XL        0
+#define LSM6DS33LIS3MDL_CTRL2_G         1
+#define LSM6DS33LIS3MDL_CTRL7_G         2
+#define LSM6DS33LIS3MDL_CTRL_REG1       3
+#define LSM6DS33LIS3MDL_CTRL_REG2       4
+#define LSM6DS33LIS3MDL_CTRL_REG3       5
+#define LSM6DS33LIS3MDL_CTRL_REG4       6
+
+//  The LSM6DS33 is reset first and the LIS3MDL set up while it comes out of reset.
+//  Registers are in address order so that they go out as burst writes.
+
+const RTIMU_REG_INIT RTIMULSM6DS33LIS3MDL::m_initSequence[] = {
+    {RTIMUREGINIT_WRITE, LSM6DS33LIS3MDL_GYRO_ACCEL, LSM6DS33_CTRL3_C, 0x01, 0, "Failed to reset LSM6DS33"},
+    {RTIMUREGINIT_SETTLE, LSM6DS33LIS3MDL_GYRO_ACCEL, 0, 1, 0, ""},
+
+    {RTIMUREGINIT_VERIFY, LSM6DS33LIS3MDL_COMPASS, LIS3MDL_WHO_AM_I, LIS3MDL_ID, 0xff, "Incorrect LIS3MDL mag id"},
+    {RTIMUREGINIT_WRITE_VALUE, LSM6DS33LIS3MDL_COMPASS, LIS3MDL_CTRL_REG1, LSM6DS33LIS3MDL_CTRL_REG1, 0, "Failed to set LIS3MDL CTRL1-4"},
+    {RTIMUREGINIT_WRITE_VALUE, LSM6DS33LIS3MDL_COMPASS, LIS3MDL_CTRL_REG2, LSM6DS33LIS3MDL_CTRL_REG2, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, LSM6DS33LIS3MDL_COMPASS, LIS3MDL_CTRL_REG3, LSM6DS33LIS3MDL_CTRL_REG3, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, LSM6DS33LIS3MDL_COMPASS, LIS3MDL_CTRL_REG4, LSM6DS33LIS3MDL_CTRL_REG4, 0, ""},
+
+    //  block data update and register increment
+
+    {RTIMUREGINIT_WRITE_VALUE, LSM6DS33LIS3MDL_GYRO_ACCEL, LSM6DS33_CTRL1_XL, LSM6DS33LIS3MDL_CTRL1_XL, 0, "Failed to set LSM6DS33 CTRL1-8"},
+    {RTIMUREGINIT_WRITE_VALUE, LSM6DS33LIS3MDL_GYRO_ACCEL, LSM6DS33_CTRL2_G, LSM6DS33LIS3MDL_CTRL2_G, 0, ""},
+    {RTIMUREGINIT_WRITE, LSM6DS33LIS3MDL_GYRO_ACCEL, LSM6DS33_CTRL3_C, 0x44, 0, ""},
+    {RTIMUREGINIT_WRITE, LSM6DS33LIS3MDL_GYRO_ACCEL, LSM6DS33_CTRL6_C, 0x40, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, LSM6DS33LIS3MDL_GYRO_ACCEL, LSM6DS33_CTRL7_G, LSM6DS33LIS3MDL_CTRL7_G, 0, ""},
+    {RTIMUREGINIT_WRITE, LSM6DS33LIS3MDL_GYRO_ACCEL, LSM6DS33_CTRL8_XL, 0x40, 0, ""}
+};
+
+const RTIMU_REG_CHOICE RTIMULSM6DS33LIS3MDL::m_accelRates[] = {
+    {LSM6DS33_ACCEL_SAMPLERATE_13, 0x10, 13},
+    {LSM6DS33_ACCEL_SAMPLERATE_26, 0x20, 26},
+    {LSM6DS33_ACCEL_SAMPLERATE_52, 0x30, 52},
+    {LSM6DS33_ACCEL_SAMPLERATE_104, 0x40, 104},
+    {LSM6DS33_ACCEL_SAMPLERATE_208, 0x50, 208},
+    {LSM6DS33_ACCEL_SAMPLERATE_416, 0x60, 416},
+    {LSM6DS33_ACCEL_SAMPLERATE_833, 0x70, 833},
+    {LSM6DS33_ACCEL_SAMPLERATE_1660, 0x80, 1660},
+    {LSM6DS33_ACCEL_SAMPLERATE_3330, 0x90, 3330},
+    {LSM6DS33_ACCEL_SAMPLERATE_6660, 0xa0, 6660}
+};
+
+const RTIMU_REG_CHOICE RTIMULSM6DS33LIS3MDL::m_accelFsrs[] = {
+    {LSM6DS33_ACCEL_FSR_2, 0x00, (RTFLOAT)0.000061},
+    {LSM6DS33_ACCEL_FSR_4, 0x08, (RTFLOAT)0.000122},
+    {LSM6DS33_ACCEL_FSR_8, 0x0c, (RTFLOAT)0.000244},
+    {LSM6DS33_ACCEL_FSR_16, 0x04, (RTFLOAT)0.000488}
+};
+
+const RTIMU_REG_CHOICE RTIMULSM6DS33LIS3MDL::m_accelLpfs[] = {
+    {LSM6DS33_ACCEL_LPF_400, 0x00, 400},
+    {LSM6DS33_ACCEL_LPF_200, 0x01, 200},
+    {LSM6DS33_ACCEL_LPF_100, 0x02, 100},
+    {LSM6DS33_ACCEL_LPF_50, 0x03, 50}
+};
+
+const RTIMU_REG_CHOICE RTIMULSM6DS33LIS3MDL::m_gyroRates[] = {
+    {LSM6DS33_GYRO_SAMPLERATE_13, 0x10, 13},
+    {LSM6DS33_GYRO_SAMPLERATE_26, 0x20, 26},
+    {LSM6DS33_GYRO_SAMPLERATE_52, 0x30, 52},
+    {LSM6DS33_GYRO_SAMPLERATE_104, 0x40, 104},
+    {LSM6DS33_GYRO_SAMPLERATE_208, 0x50, 208},
+    {LSM6DS33_GYRO_SAMPLERATE_416, 0x60, 416},
+    {LSM6DS33_GYRO_SAMPLERATE_833, 0x70, 833},
+    {LSM6DS33_GYRO_SAMPLERATE_1660, 0x80, 1660}
+};
+
+const RTIMU_REG_CHOICE RTIMULSM6DS33LIS3MDL::m_gyroFsrs[] = {
+    {LSM6DS33_GYRO_FSR_125, 0x02, (RTFLOAT)0.004375 * RTMATH_DEGREE_TO_RAD},
+    {LSM6DS33_GYRO_FSR_245, 0x00, (RTFLOAT)0.00875 * RTMATH_DEGREE_TO_RAD},
+    {LSM6DS33_GYRO_FSR_500, 0x04, (RTFLOAT)0.0175 * RTMATH_DEGREE_TO_RAD},
+    {LSM6DS33_GYRO_FSR_1000, 0x08, (RTFLOAT)0.035 * RTMATH_DEGREE_TO_RAD},
+    {LSM6DS33_GYRO_FSR_2000, 0x0c, (RTFLOAT)0.07 * RTMATH_DEGREE_TO_RAD}
+};
+
+const RTIMU_REG_CHOICE RTIMULSM6DS33LIS3MDL::m_gyroHpfs[] = {
+    {LSM6DS33_GYRO_HPF_0, 0x00, 0},
+    {LSM6DS33_GYRO_HPF_1, 0x10, 0},
+    {LSM6DS33_GYRO_HPF_2, 0x20, 0},
+    {LSM6DS33_GYRO_HPF_3, 0x30, 0}
+};
+
+//  the rates go up in doubles from 0.625Hz, the scale is the sample interval in uS.
+//  The fast rates are read every sample.
+
+const RTIMU_REG_CHOICE RTIMULSM6DS33LIS3MDL::m_compassRates[] = {
+    {LIS3MDL_SAMPLERATE_0_625, 0x00, 1600000},
+    {LIS3MDL_SAMPLERATE_1_25, 0x04, 800000},
+    {LIS3MDL_SAMPLERATE_2_5, 0x08, 400000},
+    {LIS3MDL_SAMPLERATE_5, 0x0c, 200000},
+    {LIS3MDL_SAMPLERATE_10, 0x10, 100000},
+    {LIS3MDL_SAMPLERATE_20, 0x14, 50000},
+    {LIS3MDL_SAMPLERATE_40, 0x18, 25000},
+    {LIS3MDL_SAMPLERATE_80, 0x1c, 12500},
+    {LIS3MDL_SAMPLERATE_FAST, 0x02, 0}
+};
+
+//  the scale converts to uT
+
+const RTIMU_REG_CHOICE RTIMULSM6DS33LIS3MDL::m_compassFsrs[] = {
+    {LIS3MDL_FSR_4, 0x00, (RTFLOAT)0.146},
+    {LIS3MDL_FSR_8, 0x20, (RTFLOAT)0.29},
+    {LIS3MDL_FSR_12, 0x40, (RTFLOAT)0.44},
+    {LIS3MDL_FSR_16, 0x60, (RTFLOAT)0.58}
+};
+
 RTIMULSM6DS33LIS3MDL::RTIMULSM6DS33LIS3MDL(RTIMUSettings *settings) : RTIMU(settings)
 {
     m_sampleRate = 100;
@@ -38,6 +151,7 @@ RTIMULSM6DS33LIS3MDL::RTIMULSM6DS33LIS3MDL(RTIMUSettings *settings) : RTIMU(sett
 
 RTIMULSM6DS33LIS3MDL::~RTIMULSM6DS33LIS3MDL()
 {
+    stopAcquisition();
 }
 
 bool RTIMULSM6DS33LIS3MDL::IMUInit()
@@ -46,14 +160,14 @@ bool RTIMULSM6DS33LIS3MDL::IMUInit()
 
     // set validity flags
 
-    m_imuData.fusionPoseValid = false;
-    m_imuData.fusionQPoseValid = false;
-    m_imuData.gyroValid = true;
-    m_imuData.accelValid = true;
-    m_imuData.compassValid = true;
-    m_imuData.pressureValid = false;
-    m_imuData.temperatureValid = false;
-    m_imuData.humidityValid = false;
+    m_imuData->fusionPoseValid = false;
+    m_imuData->fusionQPoseValid = false;
+    m_imuData->gyroValid = true;
+    m_imuData->accelValid = true;
+    m_imuData->compassValid = true;
+    m_imuData->pressureValid = false;
+    m_imuData->temperatureValid = false;
+    m_imuData->humidityValid = false;
 
     //  configure IMU
 
@@ -86,31 +200,68 @@ bool RTIMULSM6DS33LIS3MDL::IMUInit()
         return false;
     }
 
-    // reset device
-    m_settings->HALWrite(m_accelGyroSlaveAddr, LSM6DS33_CTRL3_C, 0x01, "Failed to set LSM6DS33 gyro CTRL3_C");
+    m_regInit.setSlave(LSM6DS33LIS3MDL_GYRO_ACCEL, m_accelGyroSlaveAddr, true);
+    m_regInit.setSlave(LSM6DS33LIS3MDL_COMPASS, m_compassSlaveAddr, true, 0x80);
 
-    // block data update msb and lsb and register increment
-    m_settings->HALWrite(m_accelGyroSlaveAddr, LSM6DS33_CTRL3_C, 0x44, "Failed to set LSM6DS33 gyro CTRL3_C");
+    if (!setRegisterValues())
+        return false;
 
-    if (!setAccelCTRL1())
+    if (!m_regInit.run(m_settings, RTIMUREGINIT_TABLE(m_initSequence)))
         return false;
 
-    if (!setGyroCTRL2())
-            return false;
+    //  gyro data ready on INT1
 
-    if (!setGyroCTRL7())
+    if (dataReadyEnabled()) {
+        if (!m_settings->HALWrite(m_accelGyroSlaveAddr, LSM6DS33_INT1_CTRL, 0x02, "Failed to set LSM6DS33 INT1_CTRL"))
             return false;
+        m_dataReadyConfigured = true;
+    }
 
-    //  Set up the mag
+    gyroBiasInit();
 
-    if (!m_settings->HALRead(m_compassSlaveAddr, LIS3MDL_WHO_AM_I, 1, &result, "Failed to read LIS3MDL mag id"))
-        return false;
+    m_timestamp.reset(m_sampleInterval);
+
+    HAL_INFO("LSM6DS33LIS3MDL init complete\n");
+    return true;
+}
 
-    if (result != LIS3MDL_ID) {
-        HAL_ERROR1("Incorrect LIS3MDL mag id %d\n", result);
+bool RTIMULSM6DS33LIS3MDL::IMUReconfigure()
+{
+    RTFLOAT gyroScale = m_gyroScale;
+    RTFLOAT accelScale = m_accelScale;
+    RTFLOAT compassScale = m_compassScale;
+    int written;
+
+    reconfigureBegin();
+
+    if (!setRegisterValues()) {
+        m_gyroScale = gyroScale;
+        m_accelScale = accelScale;
+        m_compassScale = compassScale;
+        reconfigureAbandon();
         return false;
     }
 
+    if (!m_regInit.update(m_settings, RTIMUREGINIT_TABLE(m_initSequence), written))
+        return false;
+
+    reconfigureEnd(written > 0);
+
+    HAL_INFO1("LSM6DS33LIS3MDL reconfigured, %d registers written\n", written);
+    return true;
+}
+
+bool RTIMULSM6DS33LIS3MDL::setRegisterValues()
+{
+    if (!setAccelCTRL1())
+        return false;
+
+    if (!setGyroCTRL2())
+        return false;
+
+    if (!setGyroCTRL7())
+        return false;
+
     if (!setCompassCTRL1())
         return false;
 
@@ -123,335 +274,104 @@ bool RTIMULSM6DS33LIS3MDL::IMUInit()
     if (!setCompassCTRL4())
         return false;
 
-    if (!setCompassCTRL5())
-        return false;
-
-    gyroBiasInit();
-
-    HAL_INFO("LSM6DS33LIS3MDL init complete\n");
     return true;
 }
 
 bool RTIMULSM6DS33LIS3MDL::setAccelCTRL1()
 {
-    unsigned char ctrl1;
+    unsigned char ctrl1, fsr, lpf;
+    RTFLOAT rate;
 
-    switch (m_settings->m_LSM6DS33LIS3MDLAccelSampleRate) {
-    case LSM6DS33_ACCEL_SAMPLERATE_13:
-        ctrl1 = 0x10;
-        break;
-
-    case LSM6DS33_ACCEL_SAMPLERATE_26:
-        ctrl1 = 0x20;
-        break;
-
-    case LSM6DS33_ACCEL_SAMPLERATE_52:
-        ctrl1 = 0x30;
-        break;
-
-    case LSM6DS33_ACCEL_SAMPLERATE_104:
-        ctrl1 = 0x40;
-        break;
-
-    case LSM6DS33_ACCEL_SAMPLERATE_208:
-        ctrl1 = 0x50;
-        break;
-
-    case LSM6DS33_ACCEL_SAMPLERATE_416:
-        ctrl1 = 0x60;
-        break;
-
-    case LSM6DS33_ACCEL_SAMPLERATE_833:
-        ctrl1 = 0x70;
-        break;
-
-    case LSM6DS33_ACCEL_SAMPLERATE_1660:
-        ctrl1 = 0x80;
-        break;
-
-    case LSM6DS33_ACCEL_SAMPLERATE_3330:
-        ctrl1 = 0x90;
-        break;
-
-    case LSM6DS33_ACCEL_SAMPLERATE_6660:
-        ctrl1 = 0xa0;
-        break;
-
-    default:
-        HAL_ERROR1("Illegal LSM6DS33 accel sample rate code %d\n", m_settings->m_LSM6DS33LIS3MDLAccelSampleRate);
+    if (!RTIMURegInit::choose(RTIMUREGINIT_TABLE(m_accelRates), m_settings->m_LSM6DS33LIS3MDLAccelSampleRate,
+            "LSM6DS33 accel sample rate code", ctrl1, &rate))
         return false;
-    }
-
-    switch (m_settings->m_LSM6DS33LIS3MDLAccelFsr) {
-    case LSM6DS33_ACCEL_FSR_2:
-        m_accelScale = (RTFLOAT)0.000061;
-        break;
 
-    case LSM6DS33_ACCEL_FSR_4:
-        ctrl1 |= 0x08;
-        m_accelScale = (RTFLOAT)0.000122;
-        break;
-
-    case LSM6DS33_ACCEL_FSR_8:
-        ctrl1 |= 0x0c;
-        m_accelScale = (RTFLOAT)0.000244;
-        break;
-
-    case LSM6DS33_ACCEL_FSR_16:
-        ctrl1 |= 0x04;
-        m_accelScale = (RTFLOAT)0.000488;
-        break;
-
-    default:
-        HAL_ERROR1("Illegal LSM6DS33 accel FSR code %d\n", m_settings->m_LSM6DS33LIS3MDLAccelFsr);
+    if (!RTIMURegInit::choose(RTIMUREGINIT_TABLE(m_accelFsrs), m_settings->m_LSM6DS33LIS3MDLAccelFsr,
+            "LSM6DS33 accel FSR code", fsr, &m_accelScale))
         return false;
-    }
-
-    switch (m_settings->m_LSM6DS33LIS3MDLAccelLpf) {
-    case LSM6DS33_ACCEL_LPF_400:
-        break;
-
-    case LSM6DS33_ACCEL_LPF_200:
-        ctrl1 |= 0x01;
-        break;
 
-    case LSM6DS33_ACCEL_LPF_100:
-        ctrl1 |= 0x02;
-        break;
-
-    case LSM6DS33_ACCEL_LPF_50:
-        ctrl1 |= 0x03;
-        break;
-
-    default:
-        HAL_ERROR1("Illegal LSM6DS33 accel low pass filter code %d\n", m_settings->m_LSM6DS33LIS3MDLAccelLpf);
+    if (!RTIMURegInit::choose(RTIMUREGINIT_TABLE(m_accelLpfs), m_settings->m_LSM6DS33LIS3MDLAccelLpf,
+            "LSM6DS33 accel low pass filter code", lpf))
         return false;
-    }
 
-
-    m_settings->HALWrite(m_accelGyroSlaveAddr, LSM6DS33_CTRL8_XL, 0x40, "Failed to set LSM6DS33 accel CTRL8_XL");
-    
+    ctrl1 |= fsr | lpf;
     ctrl1 &= ~0x1;
 
-    return m_settings->HALWrite(m_accelGyroSlaveAddr, LSM6DS33_CTRL1_XL, ctrl1, "Failed to set LSM6DS33 accel CTRL1_XL");
+    m_regInit.setValue(LSM6DS33LIS3MDL_CTRL1_XL, ctrl1);
+    return true;
 }
 
 bool RTIMULSM6DS33LIS3MDL::setGyroCTRL2()
 {
-    unsigned char ctrl2;
+    unsigned char ctrl2, fsr;
+    RTFLOAT rate;
 
-    switch (m_settings->m_LSM6DS33LIS3MDLGyroSampleRate) {
-    case LSM6DS33_GYRO_SAMPLERATE_13:
-        ctrl2 = 0x10;
-        m_sampleRate = 13;
-        break;
-
-    case LSM6DS33_GYRO_SAMPLERATE_26:
-        ctrl2 = 0x20;
-        m_sampleRate = 26;
-        break;
-
-    case LSM6DS33_GYRO_SAMPLERATE_52:
-        ctrl2 = 0x30;
-        m_sampleRate = 52;
-        break;
-
-    case LSM6DS33_GYRO_SAMPLERATE_104:
-        ctrl2 = 0x40;
-        m_sampleRate = 104;
-        break;
-
-    case LSM6DS33_GYRO_SAMPLERATE_208:
-        ctrl2 = 0x50;
-        m_sampleRate = 208;
-        break;
-
-    case LSM6DS33_GYRO_SAMPLERATE_416:
-        ctrl2 = 0x60;
-        m_sampleRate = 416;
-        break;
-
-    case LSM6DS33_GYRO_SAMPLERATE_833:
-        ctrl2 = 0x70;
-        m_sampleRate = 833;
-        break;
-
-    case LSM6DS33_GYRO_SAMPLERATE_1660:
-        ctrl2 = 0x80;
-        m_sampleRate = 1660;
-        break;
-
-    default:
-        HAL_ERROR1("Illegal LSM6DS33 gyro sample rate code %d\n", m_settings->m_LSM6DS33LIS3MDLGyroSampleRate);
+    if (!RTIMURegInit::choose(RTIMUREGINIT_TABLE(m_gyroRates), m_settings->m_LSM6DS33LIS3MDLGyroSampleRate,
+            "LSM6DS33 gyro sample rate code", ctrl2, &rate))
         return false;
-    }
 
+    m_sampleRate = (int)rate;
     m_sampleInterval = (uint64_t)1000000 / m_sampleRate;
 
-    switch (m_settings->m_LSM6DS33LIS3MDLGyroFsr) {
-    case LSM6DS33_GYRO_FSR_125:
-        ctrl2 |= 0x02;
-        m_gyroScale = (RTFLOAT)0.004375 * RTMATH_DEGREE_TO_RAD;
-        break;
-
-    case LSM6DS33_GYRO_FSR_245:
-        m_gyroScale = (RTFLOAT)0.00875 * RTMATH_DEGREE_TO_RAD;
-        break;
-
-    case LSM6DS33_GYRO_FSR_500:
-        ctrl2 |= 0x04;
-        m_gyroScale = (RTFLOAT)0.0175 * RTMATH_DEGREE_TO_RAD;
-        break;
-
-    case LSM6DS33_GYRO_FSR_1000:
-        ctrl2 |= 0x08;
-        m_gyroScale = (RTFLOAT)0.035 * RTMATH_DEGREE_TO_RAD;
-        break;
-
-    case LSM6DS33_GYRO_FSR_2000:
-        ctrl2 |= 0x0c;
-        m_gyroScale = (RTFLOAT)0.07 * RTMATH_DEGREE_TO_RAD;
-        break;
-
-    default:
-        HAL_ERROR1("Illegal LSM6DS33 gyro FSR code %d\n", m_settings->m_LSM6DS33LIS3MDLGyroFsr);
+    if (!RTIMURegInit::choose(RTIMUREGINIT_TABLE(m_gyroFsrs), m_settings->m_LSM6DS33LIS3MDLGyroFsr,
+            "LSM6DS33 gyro FSR code", fsr, &m_gyroScale))
         return false;
-    }
-    
-    return (m_settings->HALWrite(m_accelGyroSlaveAddr, LSM6DS33_CTRL2_G, ctrl2, "Failed to set LSM6DS33 gyro CTRL2_G"));
+
+    m_regInit.setValue(LSM6DS33LIS3MDL_CTRL2_G, ctrl2 | fsr);
+    return true;
 }
 
 bool RTIMULSM6DS33LIS3MDL::setGyroCTRL7()
 {
     unsigned char ctrl7;
 
-
-    switch (m_settings->m_LSM6DS33LIS3MDLGyroHpf) {
-    case LSM6DS33_GYRO_HPF_0:
-        break;
-
-    case LSM6DS33_GYRO_HPF_1:
-        ctrl7 |= 0x10;
-        break;
-
-    case LSM6DS33_GYRO_HPF_2:
-        ctrl7 |= 0x20;
-        break;
-
-    case LSM6DS33_GYRO_HPF_3:
-        ctrl7 |= 0x30;
-        break;
-
-    default:
-        HAL_ERROR1("Illegal LSM6DS33 gyro high pass filter code %d\n", m_settings->m_LSM6DS33LIS3MDLGyroHpf);
+    if (!RTIMURegInit::choose(RTIMUREGINIT_TABLE(m_gyroHpfs), m_settings->m_LSM6DS33LIS3MDLGyroHpf,
+            "LSM6DS33 gyro high pass filter code", ctrl7))
         return false;
-    }
 
-    m_settings->HALWrite(m_accelGyroSlaveAddr, LSM6DS33_CTRL6_C, 0x40, "Failed to set LSM6DS33 accel CTRL6_C");
     // Turn off HPF
     ctrl7 = 0x0;
-    return m_settings->HALWrite(m_accelGyroSlaveAddr, LSM6DS33_CTRL7_G, ctrl7, "Failed to set LSM6DS33 gyro CTRL7");
+    m_regInit.setValue(LSM6DS33LIS3MDL_CTRL7_G, ctrl7);
+    return true;
 }
 
 bool RTIMULSM6DS33LIS3MDL::setCompassCTRL1()
 {
     unsigned char ctrl1;
+    RTFLOAT interval;
 
-    switch (m_settings->m_LSM6DS33LIS3MDLCompassSampleRate) {
-    case LIS3MDL_SAMPLERATE_0_625:
-        ctrl1 = 0x00;
-        break;
-
-    case LIS3MDL_SAMPLERATE_1_25:
-        ctrl1 = 0x04;
-        break;
-
-    case LIS3MDL_SAMPLERATE_2_5:
-        ctrl1 = 0x08;
-        break;
-
-    case LIS3MDL_SAMPLERATE_5:
-        ctrl1 = 0x0c;
-        break;
-
-    case LIS3MDL_SAMPLERATE_10:
-        ctrl1 = 0x10;
-        break;
-
-    case LIS3MDL_SAMPLERATE_20:
-        ctrl1 = 0x14;
-        break;
-
-    case LIS3MDL_SAMPLERATE_40:
-        ctrl1 = 0x18;
-        break;
-
-    case LIS3MDL_SAMPLERATE_80:
-        ctrl1 = 0x1c;
-        break;
+    if (!RTIMURegInit::choose(RTIMUREGINIT_TABLE(m_compassRates), m_settings->m_LSM6DS33LIS3MDLCompassSampleRate,
+            "LIS3MDL compass sample rate code", ctrl1, &interval))
+        return false;
 
-    case LIS3MDL_SAMPLERATE_FAST:
-        // Enable FAST_ODR
-        ctrl1 = 0x02 | (m_settings->m_LSM6DS33LIS3MDLCompassPowerMode << 5);
-        break;
+    // Enable FAST_ODR
 
-    default:
-        HAL_ERROR1("Illegal LIS3MDL compass sample rate code %d\n", m_settings->m_LSM6DS33LIS3MDLCompassSampleRate);
-        return false;
-    }
+    if (m_settings->m_LSM6DS33LIS3MDLCompassSampleRate == LIS3MDL_SAMPLERATE_FAST)
+        ctrl1 |= m_settings->m_LSM6DS33LIS3MDLCompassPowerMode << 5;
 
-    return m_settings->HALWrite(m_compassSlaveAddr, LIS3MDL_CTRL_REG1, ctrl1, "Failed to set LIS3MDL CTRL1");
+    compassSetInterval((uint64_t)interval);
+    m_regInit.setValue(LSM6DS33LIS3MDL_CTRL_REG1, ctrl1);
+    return true;
 }
 
 bool RTIMULSM6DS33LIS3MDL::setCompassCTRL2()
 {
     unsigned char ctrl2;
 
-    // Convert FSR to uT
-    switch (m_settings->m_LSM6DS33LIS3MDLCompassFsr) {
-    case LIS3MDL_FSR_4:
-        ctrl2 = 0x00;
-        m_compassScale = (RTFLOAT)0.146;
-        break;
-
-    case LIS3MDL_FSR_8:
-        ctrl2 = 0x20;
-        m_compassScale = (RTFLOAT)0.29;
-        break;
-
-    case LIS3MDL_FSR_12:
-        ctrl2 = 0x40;
-        m_compassScale = (RTFLOAT)0.44;
-        break;
-
-    case LIS3MDL_FSR_16:
-        ctrl2 = 0x60;
-        m_compassScale = (RTFLOAT)0.58;
-        break;
-
-    default:
-        HAL_ERROR1("Illegal LIS3MDL compass FSR code %d\n", m_settings->m_LSM6DS33LIS3MDLCompassFsr);
+    if (!RTIMURegInit::choose(RTIMUREGINIT_TABLE(m_compassFsrs), m_settings->m_LSM6DS33LIS3MDLCompassFsr,
+            "LIS3MDL compass FSR code", ctrl2, &m_compassScale))
         return false;
-    }
 
-    return m_settings->HALWrite(m_compassSlaveAddr, LIS3MDL_CTRL_REG2, ctrl2, "Failed to set LIS3MDL CTRL2");
+    m_regInit.setValue(LSM6DS33LIS3MDL_CTRL_REG2, ctrl2);
+    return true;
 }
 
 bool RTIMULSM6DS33LIS3MDL::setCompassCTRL3()
 {
-    unsigned char ctrl3;
+    // Continuous-conversion mode
 
-    // Turn on magnetometer
-    if (m_settings->m_LSM6DS33LIS3MDLCompassSampleRate < LIS3MDL_SAMPLERATE_FAST) {
-        // Single conversion mode
-        ctrl3 = 0x01;
-    } else {
-        // Continuous-conversion mode
-        ctrl3 = 0x00;
-    }
-    ctrl3=0;
-
-    return m_settings->HALWrite(m_compassSlaveAddr, LIS3MDL_CTRL_REG3, ctrl3, "Failed to set LIS3MDL CTRL3");
+    m_regInit.setValue(LSM6DS33LIS3MDL_CTRL_REG3, 0x00);
+    return true;
 }
 
 bool RTIMULSM6DS33LIS3MDL::setCompassCTRL4()
@@ -461,13 +381,8 @@ bool RTIMULSM6DS33LIS3MDL::setCompassCTRL4()
         return false;
     }
 
-    return m_settings->HALWrite(m_compassSlaveAddr, LIS3MDL_CTRL_REG4, m_settings->m_LSM6DS33LIS3MDLCompassPowerMode<<2, "Failed to set LIS3MDL CTRL4");
-}
-
-bool RTIMULSM6DS33LIS3MDL::setCompassCTRL5()
-{
+    m_regInit.setValue(LSM6DS33LIS3MDL_CTRL_REG4, m_settings->m_LSM6DS33LIS3MDLCompassPowerMode << 2);
     return true;
-    return m_settings->HALWrite(m_compassSlaveAddr, LIS3MDL_CTRL_REG5, 0x40, "Failed to set LIS3MDL CTRL5");
 }
 
 int RTIMULSM6DS33LIS3MDL::IMUGetPollInterval()
@@ -480,7 +395,7 @@ bool RTIMULSM6DS33LIS3MDL::IMURead()
     unsigned char status;
     unsigned char gyroData[6];
     unsigned char accelData[6];
-    unsigned char compassData[6];
+    unsigned char compassData[7];                           // status then data
 
     if (!m_settings->HALRead(m_accelGyroSlaveAddr, LSM6DS33_STATUS_REG, 1, &status, "Failed to read LSM6DS33 status"))
         return false;
@@ -489,36 +404,44 @@ bool RTIMULSM6DS33LIS3MDL::IMURead()
     if ((status & 0x02) == 0)
         return false;
 
+    m_timestamp.sampleReady(m_settings->HALTimestamp());
+
     if (!m_settings->HALRead(m_accelGyroSlaveAddr, LSM6DS33_OUTX_L_G, 6, gyroData, "Failed to read LSM6DS33 gyro data"))
         return false;
 
-    m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
+    m_imuData->timestamp = m_timestamp.nextTimestamp();
 
     if (!m_settings->HALRead(m_accelGyroSlaveAddr, LSM6DS33_OUTX_L_XL, 6, accelData, "Failed to read LSM6DS33 accel data"))
         return false;
 
+    //  the compass status is read with its data
 
-    if (!m_settings->HALRead(m_compassSlaveAddr, LIS3MDL_OUT_X_L, 6, compassData, "Failed to read LIS3MDL compass data"))
-        return false;
+    if (compassDue()) {
+        if (!m_settings->HALRead(m_compassSlaveAddr, 0x80 | LIS3MDL_STATUS_REG, 7, compassData, "Failed to read LIS3MDL compass data"))
+            return false;
+        compassRead((compassData[0] & 0x08) != 0);
+    }
 
-    RTMath::convertToVector(gyroData, m_imuData.gyro, m_gyroScale, false);
-    RTMath::convertToVector(accelData, m_imuData.accel, m_accelScale, false);
-    RTMath::convertToVector(compassData, m_imuData.compass, m_compassScale/10, false);
+    RTMath::convertToVector(gyroData, m_imuData->gyro, m_gyroScale, false);
+    RTMath::convertToVector(accelData, m_imuData->accel, m_accelScale, false);
 
     //  sort out gyro axes and correct for bias
 
-    m_imuData.gyro.setX(m_imuData.gyro.x());
-    m_imuData.gyro.setY(-m_imuData.gyro.y());
-    m_imuData.gyro.setZ(-m_imuData.gyro.z());
+    m_imuData->gyro.setX(m_imuData->gyro.x());
+    m_imuData->gyro.setY(-m_imuData->gyro.y());
+    m_imuData->gyro.setZ(-m_imuData->gyro.z());
 
     //  sort out accel data;
 
-    m_imuData.accel.setX(-m_imuData.accel.x());
+    m_imuData->accel.setX(-m_imuData->accel.x());
 
-    //  sort out compass axes
+    //  sort out compass axes, the compass keeps its last value if there's no new sample
 
-    m_imuData.compass.setY(-m_imuData.compass.y());
-    m_imuData.compass.setZ(-m_imuData.compass.z());
+    if (m_imuData->compassValid) {
+        RTMath::convertToVector(compassData + 1, m_imuData->compass, m_compassScale/10, false);
+        m_imuData->compass.setY(-m_imuData->compass.y());
+        m_imuData->compass.setZ(-m_imuData->compass.z());
+    }
 
     //  now do standard processing
 
@@ -38,10 +38,12 @@ public:
     virtual const char *IMUName() { return "LSM6DS33 + LIS3MDL"; }
     virtual int IMUType() { return RTIMU_TYPE_LSM6DS33LIS3MDL; }
     virtual bool IMUInit();
+    virtual bool IMUReconfigure();
     virtual int IMUGetPollInterval();
     virtual bool IMURead();
 
 private:
+    bool setRegisterValues();                               // works out the register values from the settings
     bool setAccelCTRL1();
     bool setGyroCTRL2();
     bool setGyroCTRL7();
@@ -49,7 +51,18 @@ private:
     bool setCompassCTRL2();
     bool setCompassCTRL3();
     bool setCompassCTRL4();
-    bool setCompassCTRL5();
+
+    //  the init sequence and the register settings for each settings code
+
+    static const RTIMU_REG_INIT m_initSequence[];
+    static const RTIMU_REG_CHOICE m_accelRates[];
+    static const RTIMU_REG_CHOICE m_accelFsrs[];
+    static const RTIMU_REG_CHOICE m_accelLpfs[];
+    static const RTIMU_REG_CHOICE m_gyroRates[];
+    static const RTIMU_REG_CHOICE m_gyroFsrs[];
+    static const RTIMU_REG_CHOICE m_gyroHpfs[];
+    static const RTIMU_REG_CHOICE m_compassRates[];
+    static const RTIMU_REG_CHOICE m_compassFsrs[];
 
     unsigned char m_accelGyroSlaveAddr;                     // I2C address of LSM6DS33 accel and gyro
     unsigned char m_compassSlaveAddr;                       // I2C address of LIS3MDL mag
@@ -29,6 +29,49 @@
 
 #define COMPASS_ALPHA 0.2f
 
+//  slaves and values in the init sequence
+
+#define LSM9DS0_GYRO                    0
+#define LSM9DS0_ACCEL_COMPASS           1
+
+#define LSM9DS0_GYRO_CTRL1_VALUE        0
+#define LSM9DS0_GYRO_CTRL2_VALUE        1
+#define LSM9DS0_GYRO_CTRL3_VALUE        2
+#define LSM9DS0_GYRO_CTRL4_VALUE        3
+#define LSM9DS0_GYRO_CTRL5_VALUE        4
+#define LSM9DS0_CTRL1_VALUE             5
+#define LSM9DS0_CTRL2_VALUE             6
+#define LSM9DS0_CTRL5_VALUE             7
+#define LSM9DS0_CTRL6_VALUE             8
+#define LSM9DS0_CTRL7_VALUE             9
+
+//  Both parts of the chip are checked before anything is set up. Registers are in
+//  address order so that they go out as burst writes.
+
+const RTIMU_REG_INIT RTIMULSM9DS0::m_initSequence[] = {
+    {RTIMUREGINIT_WRITE, LSM9DS0_GYRO, LSM9DS0_GYRO_CTRL5, 0x80, 0, "Failed to boot LSM9DS0"},
+    {RTIMUREGINIT_VERIFY, LSM9DS0_GYRO, LSM9DS0_GYRO_WHO_AM_I, LSM9DS0_GYRO_ID, 0xff, "Incorrect LSM9DS0 gyro id"},
+    {RTIMUREGINIT_VERIFY, LSM9DS0_ACCEL_COMPASS, LSM9DS0_WHO_AM_I, LSM9DS0_ACCELMAG_ID, 0xff, "Incorrect LSM9DS0 accel/mag id"},
+
+#ifdef LSM9DS0_CACHE_MODE
+    //  the gyro fifo mode, the fifo is turned on in CTRL5
+
+    {RTIMUREGINIT_WRITE, LSM9DS0_GYRO, LSM9DS0_GYRO_FIFO_CTRL, 0x3f, 0, "Failed to set LSM9DS0 FIFO mode"},
+#endif
+
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS0_GYRO, LSM9DS0_GYRO_CTRL1, LSM9DS0_GYRO_CTRL1_VALUE, 0, "Failed to set LSM9DS0 gyro CTRL1-5"},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS0_GYRO, LSM9DS0_GYRO_CTRL2, LSM9DS0_GYRO_CTRL2_VALUE, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS0_GYRO, LSM9DS0_GYRO_CTRL3, LSM9DS0_GYRO_CTRL3_VALUE, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS0_GYRO, LSM9DS0_GYRO_CTRL4, LSM9DS0_GYRO_CTRL4_VALUE, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS0_GYRO, LSM9DS0_GYRO_CTRL5, LSM9DS0_GYRO_CTRL5_VALUE, 0, ""},
+
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS0_ACCEL_COMPASS, LSM9DS0_CTRL1, LSM9DS0_CTRL1_VALUE, 0, "Failed to set LSM9DS0 accel CTRL1-2"},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS0_ACCEL_COMPASS, LSM9DS0_CTRL2, LSM9DS0_CTRL2_VALUE, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS0_ACCEL_COMPASS, LSM9DS0_CTRL5, LSM9DS0_CTRL5_VALUE, 0, "Failed to set LSM9DS0 compass CTRL5-7"},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS0_ACCEL_COMPASS, LSM9DS0_CTRL6, LSM9DS0_CTRL6_VALUE, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS0_ACCEL_COMPASS, LSM9DS0_CTRL7, LSM9DS0_CTRL7_VALUE, 0, ""}
+};
+
 RTIMULSM9DS0::RTIMULSM9DS0(RTIMUSettings *settings) : RTIMU(settings)
 {
     m_sampleRate = 100;
@@ -36,6 +79,7 @@ RTIMULSM9DS0::RTIMULSM9DS0(RTIMUSettings *settings) : RTIMU(settings)
 
 RTIMULSM9DS0::~RTIMULSM9DS0()
 {
+    stopAcquisition();
 }
 
 bool RTIMULSM9DS0::IMUInit()
@@ -43,19 +87,18 @@ bool RTIMULSM9DS0::IMUInit()
     unsigned char result;
 
 #ifdef LSM9DS0_CACHE_MODE
-    m_firstTime = true;
     m_cacheIn = m_cacheOut = m_cacheCount = 0;
 #endif
     // set validity flags
 
-    m_imuData.fusionPoseValid = false;
-    m_imuData.fusionQPoseValid = false;
-    m_imuData.gyroValid = true;
-    m_imuData.accelValid = true;
-    m_imuData.compassValid = true;
-    m_imuData.pressureValid = false;
-    m_imuData.temperatureValid = false;
-    m_imuData.humidityValid = false;
+    m_imuData->fusionPoseValid = false;
+    m_imuData->fusionQPoseValid = false;
+    m_imuData->gyroValid = true;
+    m_imuData->accelValid = true;
+    m_imuData->compassValid = true;
+    m_imuData->pressureValid = false;
+    m_imuData->temperatureValid = false;
+    m_imuData->humidityValid = false;
 
     //  configure IMU
 
@@ -78,37 +121,69 @@ bool RTIMULSM9DS0::IMUInit()
     if (!m_settings->HALOpen())
         return false;
 
-    //  Set up the gyro
+    m_regInit.setSlave(LSM9DS0_GYRO, m_gyroSlaveAddr, true, 0x80);
+    m_regInit.setSlave(LSM9DS0_ACCEL_COMPASS, m_accelCompassSlaveAddr, true, 0x80);
 
-    if (!m_settings->HALWrite(m_gyroSlaveAddr, LSM9DS0_GYRO_CTRL5, 0x80, "Failed to boot LSM9DS0"))
+    if (!setRegisterValues())
         return false;
 
-    if (!m_settings->HALRead(m_gyroSlaveAddr, LSM9DS0_GYRO_WHO_AM_I, 1, &result, "Failed to read LSM9DS0 gyro id"))
+    if (!m_regInit.run(m_settings, RTIMUREGINIT_TABLE(m_initSequence)))
         return false;
 
-    if (result != LSM9DS0_GYRO_ID) {
-        HAL_ERROR1("Incorrect LSM9DS0 gyro id %d\n", result);
+    m_dataReadyConfigured = dataReadyEnabled();
+
+    gyroBiasInit();
+
+    m_timestamp.reset(m_sampleInterval);
+
+    HAL_INFO("LSM9DS0 init complete\n");
+    return true;
+}
+
+bool RTIMULSM9DS0::IMUReconfigure()
+{
+#ifdef LSM9DS0_CACHE_MODE
+    HAL_ERROR("LSM9DS0 can't be reconfigured in cache mode\n");
+    return false;
+#else
+    RTFLOAT gyroScale = m_gyroScale;
+    RTFLOAT accelScale = m_accelScale;
+    RTFLOAT compassScale = m_compassScale;
+    int written;
+
+    reconfigureBegin();
+
+    if (!setRegisterValues()) {
+        m_gyroScale = gyroScale;
+        m_accelScale = accelScale;
+        m_compassScale = compassScale;
+        reconfigureAbandon();
         return false;
     }
 
+    if (!m_regInit.update(m_settings, RTIMUREGINIT_TABLE(m_initSequence), written))
+        return false;
+
+    reconfigureEnd(written > 0);
+
+    HAL_INFO1("LSM9DS0 reconfigured, %d registers written\n", written);
+    return true;
+#endif
+}
+
+bool RTIMULSM9DS0::setRegisterValues()
+{
     if (!setGyroSampleRate())
-            return false;
+        return false;
 
     if (!setGyroCTRL2())
-            return false;
+        return false;
 
     if (!setGyroCTRL4())
-            return false;
-
-    //  Set up the accel
-
-    if (!m_settings->HALRead(m_accelCompassSlaveAddr, LSM9DS0_WHO_AM_I, 1, &result, "Failed to read LSM9DS0 accel/mag id"))
         return false;
 
-    if (result != LSM9DS0_ACCELMAG_ID) {
-        HAL_ERROR1("Incorrect LSM9DS0 accel/mag id %d\n", result);
+    if (!setGyroCTRL5())
         return false;
-    }
 
     if (!setAccelCTRL1())
         return false;
@@ -125,20 +200,9 @@ bool RTIMULSM9DS0::IMUInit()
     if (!setCompassCTRL7())
         return false;
 
-#ifdef LSM9DS0_CACHE_MODE
-
-    //  turn on gyro fifo
+    //  gyro data ready on DRDY_G
 
-    if (!m_settings->HALWrite(m_gyroSlaveAddr, LSM9DS0_GYRO_FIFO_CTRL, 0x3f, "Failed to set LSM9DS0 FIFO mode"))
-        return false;
-#endif
-
-    if (!setGyroCTRL5())
-            return false;
-
-    gyroBiasInit();
-
-    HAL_INFO("LSM9DS0 init complete\n");
+    m_regInit.setValue(LSM9DS0_GYRO_CTRL3_VALUE, dataReadyEnabled() ? 0x08 : 0x00);
     return true;
 }
 
@@ -193,7 +257,8 @@ bool RTIMULSM9DS0::setGyroSampleRate()
 
     }
 
-    return (m_settings->HALWrite(m_gyroSlaveAddr, LSM9DS0_GYRO_CTRL1, ctrl1, "Failed to set LSM9DS0 gyro CTRL1"));
+    m_regInit.setValue(LSM9DS0_GYRO_CTRL1_VALUE, ctrl1);
+    return true;
 }
 
 bool RTIMULSM9DS0::setGyroCTRL2()
@@ -202,7 +267,8 @@ bool RTIMULSM9DS0::setGyroCTRL2()
         HAL_ERROR1("Illegal LSM9DS0 gyro high pass filter code %d\n", m_settings->m_LSM9DS0GyroHpf);
         return false;
     }
-    return m_settings->HALWrite(m_gyroSlaveAddr,  LSM9DS0_GYRO_CTRL2, m_settings->m_LSM9DS0GyroHpf, "Failed to set LSM9DS0 gyro CTRL2");
+    m_regInit.setValue(LSM9DS0_GYRO_CTRL2_VALUE, m_settings->m_LSM9DS0GyroHpf);
+    return true;
 }
 
 bool RTIMULSM9DS0::setGyroCTRL4()
@@ -230,7 +296,8 @@ bool RTIMULSM9DS0::setGyroCTRL4()
         return false;
     }
 
-    return m_settings->HALWrite(m_gyroSlaveAddr,  LSM9DS0_GYRO_CTRL4, ctrl4, "Failed to set LSM9DS0 gyro CTRL4");
+    m_regInit.setValue(LSM9DS0_GYRO_CTRL4_VALUE, ctrl4);
+    return true;
 }
 
 
@@ -248,7 +315,8 @@ bool RTIMULSM9DS0::setGyroCTRL5()
     ctrl5 |= 0x40;
 #endif
 
-    return m_settings->HALWrite(m_gyroSlaveAddr,  LSM9DS0_GYRO_CTRL5, ctrl5, "Failed to set LSM9DS0 gyro CTRL5");
+    m_regInit.setValue(LSM9DS0_GYRO_CTRL5_VALUE, ctrl5);
+    return true;
 }
 
 
@@ -263,7 +331,8 @@ bool RTIMULSM9DS0::setAccelCTRL1()
 
     ctrl1 = (m_settings->m_LSM9DS0AccelSampleRate << 4) | 0x07;
 
-    return m_settings->HALWrite(m_accelCompassSlaveAddr,  LSM9DS0_CTRL1, ctrl1, "Failed to set LSM9DS0 accell CTRL1");
+    m_regInit.setValue(LSM9DS0_CTRL1_VALUE, ctrl1);
+    return true;
 }
 
 bool RTIMULSM9DS0::setAccelCTRL2()
@@ -303,7 +372,8 @@ bool RTIMULSM9DS0::setAccelCTRL2()
 
     ctrl2 = (m_settings->m_LSM9DS0AccelLpf << 6) | (m_settings->m_LSM9DS0AccelFsr << 3);
 
-    return m_settings->HALWrite(m_accelCompassSlaveAddr,  LSM9DS0_CTRL2, ctrl2, "Failed to set LSM9DS0 accel CTRL2");
+    m_regInit.setValue(LSM9DS0_CTRL2_VALUE, ctrl2);
+    return true;
 }
 
 
@@ -318,13 +388,18 @@ bool RTIMULSM9DS0::setCompassCTRL5()
 
     ctrl5 = (m_settings->m_LSM9DS0CompassSampleRate << 2);
 
+    //  the rates go up in doubles from 3.125Hz
+
+    compassSetInterval(320000 >> m_settings->m_LSM9DS0CompassSampleRate);
+
 #ifdef LSM9DS0_CACHE_MODE
     //  enable fifo
 
     ctrl5 |= 0x40;
 #endif
 
-    return m_settings->HALWrite(m_accelCompassSlaveAddr,  LSM9DS0_CTRL5, ctrl5, "Failed to set LSM9DS0 compass CTRL5");
+    m_regInit.setValue(LSM9DS0_CTRL5_VALUE, ctrl5);
+    return true;
 }
 
 bool RTIMULSM9DS0::setCompassCTRL6()
@@ -359,12 +434,14 @@ bool RTIMULSM9DS0::setCompassCTRL6()
         return false;
     }
 
-    return m_settings->HALWrite(m_accelCompassSlaveAddr,  LSM9DS0_CTRL6, ctrl6, "Failed to set LSM9DS0 compass CTRL6");
+    m_regInit.setValue(LSM9DS0_CTRL6_VALUE, ctrl6);
+    return true;
 }
 
 bool RTIMULSM9DS0::setCompassCTRL7()
 {
-     return m_settings->HALWrite(m_accelCompassSlaveAddr,  LSM9DS0_CTRL7, 0x60, "Failed to set LSM9DS0CTRL7");
+    m_regInit.setValue(LSM9DS0_CTRL7_VALUE, 0x60);
+    return true;
 }
 
 
@@ -379,7 +456,7 @@ bool RTIMULSM9DS0::IMURead()
     unsigned char status;
     unsigned char gyroData[6];
     unsigned char accelData[6];
-    unsigned char compassData[6];
+    unsigned char compassData[7];                           // status then data
 
 
 #ifdef LSM9DS0_CACHE_MODE
@@ -399,56 +476,58 @@ bool RTIMULSM9DS0::IMURead()
         if (!m_settings->HALWrite(m_gyroSlaveAddr, LSM9DS0_GYRO_FIFO_CTRL, 0x3f, "Failed to set LSM9DS0 gyro FIFO mode"))
             return false;
 
-        if (!setGyroCTRL5())
+        if (!m_settings->HALWrite(m_gyroSlaveAddr, LSM9DS0_GYRO_CTRL5, 0x50, "Failed to set LSM9DS0 gyro CTRL5"))
             return false;
 
-        m_imuData.timestamp += m_sampleInterval * 32;
+        m_timestamp.reset(m_sampleInterval);
         return false;
     }
 
     // get count of samples in fifo
     count = status & 0x1f;
 
+    //  samples not yet delivered are those in the fifo and in the cache
+
+    int pending = count;
+
+    for (int i = 0, block = m_cacheOut; i < m_cacheCount; i++) {
+        pending += m_cache[block].count;
+        if (++block == LSM9DS0_CACHE_BLOCK_COUNT)
+            block = 0;
+    }
+    m_timestamp.fifoLevel(pending, m_settings->HALTimestamp());
+
     if ((m_cacheCount == 0) && (count > 0) && (count < LSM9DS0_FIFO_THRESH)) {
         // special case of a small fifo and nothing cached - just handle as simple read
 
-        if (!m_settings->HALRead(m_gyroSlaveAddr, 0x80 | LSM9DS0_GYRO_OUT_X_L, 6, gyroData, "Failed to read LSM9DS0 gyro data"))
-            return false;
+        m_settings->HALBatchBegin();
+        m_settings->HALBatchRead(m_gyroSlaveAddr, 0x80 | LSM9DS0_GYRO_OUT_X_L, 6, gyroData);
+        m_settings->HALBatchRead(m_accelCompassSlaveAddr, 0x80 | LSM9DS0_OUT_X_L_A, 6, accelData);
+        m_settings->HALBatchRead(m_accelCompassSlaveAddr, 0x80 | LSM9DS0_OUT_X_L_M, 6, compassData + 1);
 
-        if (!m_settings->HALRead(m_accelCompassSlaveAddr, 0x80 | LSM9DS0_OUT_X_L_A, 6, accelData, "Failed to read LSM9DS0 accel data"))
+        if (!m_settings->HALBatchSubmit("Failed to read LSM9DS0 data"))
             return false;
 
-        if (!m_settings->HALRead(m_accelCompassSlaveAddr, 0x80 | LSM9DS0_OUT_X_L_M, 6, compassData, "Failed to read LSM9DS0 compass data"))
-            return false;
-
-        if (m_firstTime)
-            m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
-        else
-            m_imuData.timestamp += m_sampleInterval;
-
-        m_firstTime = false;
+        m_imuData->timestamp = m_timestamp.nextTimestamp();
    } else {
         if (count >=  LSM9DS0_FIFO_THRESH) {
             // need to create a cache block
 
             if (m_cacheCount == LSM9DS0_CACHE_BLOCK_COUNT) {
                 // all cache blocks are full - discard oldest and update timestamp to account for lost samples
-                m_imuData.timestamp += m_sampleInterval * m_cache[m_cacheOut].count;
+                m_timestamp.discard(m_cache[m_cacheOut].count);
                 if (++m_cacheOut == LSM9DS0_CACHE_BLOCK_COUNT)
                     m_cacheOut = 0;
                 m_cacheCount--;
             }
 
-            if (!m_settings->HALRead(m_gyroSlaveAddr, 0x80 | LSM9DS0_GYRO_OUT_X_L, LSM9DS0_FIFO_CHUNK_SIZE * LSM9DS0_FIFO_THRESH,
-                         m_cache[m_cacheIn].data, "Failed to read LSM9DS0 fifo data"))
-                return false;
-
-            if (!m_settings->HALRead(m_accelCompassSlaveAddr, 0x80 | LSM9DS0_OUT_X_L_A, 6,
-                         m_cache[m_cacheIn].accel, "Failed to read LSM9DS0 accel data"))
-                return false;
+            m_settings->HALBatchBegin();
+            m_settings->HALBatchRead(m_gyroSlaveAddr, 0x80 | LSM9DS0_GYRO_OUT_X_L, LSM9DS0_FIFO_CHUNK_SIZE * LSM9DS0_FIFO_THRESH,
+                         m_cache[m_cacheIn].data);
+            m_settings->HALBatchRead(m_accelCompassSlaveAddr, 0x80 | LSM9DS0_OUT_X_L_A, 6, m_cache[m_cacheIn].accel);
+            m_settings->HALBatchRead(m_accelCompassSlaveAddr, 0x80 | LSM9DS0_OUT_X_L_M, 6, m_cache[m_cacheIn].compass);
 
-            if (!m_settings->HALRead(m_accelCompassSlaveAddr, 0x80 | LSM9DS0_OUT_X_L_M, 6,
-                         m_cache[m_cacheIn].compass, "Failed to read LSM9DS0 compass data"))
+            if (!m_settings->HALBatchSubmit("Failed to read LSM9DS0 fifo data"))
                 return false;
 
             m_cache[m_cacheIn].count = LSM9DS0_FIFO_THRESH;
@@ -467,7 +546,7 @@ bool RTIMULSM9DS0::IMURead()
 
         memcpy(gyroData, m_cache[m_cacheOut].data + m_cache[m_cacheOut].index, LSM9DS0_FIFO_CHUNK_SIZE);
         memcpy(accelData, m_cache[m_cacheOut].accel, 6);
-        memcpy(compassData, m_cache[m_cacheOut].compass, 6);
+        memcpy(compassData + 1, m_cache[m_cacheOut].compass, 6);
 
         m_cache[m_cacheOut].index += LSM9DS0_FIFO_CHUNK_SIZE;
 
@@ -478,12 +557,7 @@ bool RTIMULSM9DS0::IMURead()
                 m_cacheOut = 0;
             m_cacheCount--;
         }
-        if (m_firstTime)
-            m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
-        else
-            m_imuData.timestamp += m_sampleInterval;
-
-        m_firstTime = false;
+        m_imuData->timestamp = m_timestamp.nextTimestamp();
     }
 
 #else
@@ -493,37 +567,48 @@ bool RTIMULSM9DS0::IMURead()
     if ((status & 0x8) == 0)
         return false;
 
-    if (!m_settings->HALRead(m_gyroSlaveAddr, 0x80 | LSM9DS0_GYRO_OUT_X_L, 6, gyroData, "Failed to read LSM9DS0 gyro data"))
-        return false;
+    m_timestamp.sampleReady(m_settings->HALTimestamp());
 
-    m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
+    //  the compass status is read with its data
 
-    if (!m_settings->HALRead(m_accelCompassSlaveAddr, 0x80 | LSM9DS0_OUT_X_L_A, 6, accelData, "Failed to read LSM9DS0 accel data"))
-        return false;
+    bool readCompass = compassDue();
 
-    if (!m_settings->HALRead(m_accelCompassSlaveAddr, 0x80 | LSM9DS0_OUT_X_L_M, 6, compassData, "Failed to read LSM9DS0 compass data"))
+    m_settings->HALBatchBegin();
+    m_settings->HALBatchRead(m_gyroSlaveAddr, 0x80 | LSM9DS0_GYRO_OUT_X_L, 6, gyroData);
+    m_settings->HALBatchRead(m_accelCompassSlaveAddr, 0x80 | LSM9DS0_OUT_X_L_A, 6, accelData);
+    if (readCompass)
+        m_settings->HALBatchRead(m_accelCompassSlaveAddr, 0x80 | LSM9DS0_STATUS_M, 7, compassData);
+
+    if (!m_settings->HALBatchSubmit("Failed to read LSM9DS0 data"))
         return false;
 
+    if (readCompass)
+        compassRead((compassData[0] & 0x08) != 0);
+
+    m_imuData->timestamp = m_timestamp.nextTimestamp();
+
 #endif
 
-    RTMath::convertToVector(gyroData, m_imuData.gyro, m_gyroScale, false);
-    RTMath::convertToVector(accelData, m_imuData.accel, m_accelScale, false);
-    RTMath::convertToVector(compassData, m_imuData.compass, m_compassScale, false);
+    RTMath::convertToVector(gyroData, m_imuData->gyro, m_gyroScale, false);
+    RTMath::convertToVector(accelData, m_imuData->accel, m_accelScale, false);
 
     //  sort out gyro axes and correct for bias
 
-    m_imuData.gyro.setX(m_imuData.gyro.x());
-    m_imuData.gyro.setY(-m_imuData.gyro.y());
-    m_imuData.gyro.setZ(-m_imuData.gyro.z());
+    m_imuData->gyro.setX(m_imuData->gyro.x());
+    m_imuData->gyro.setY(-m_imuData->gyro.y());
+    m_imuData->gyro.setZ(-m_imuData->gyro.z());
 
     //  sort out accel data;
 
-    m_imuData.accel.setX(-m_imuData.accel.x());
+    m_imuData->accel.setX(-m_imuData->accel.x());
 
-    //  sort out compass axes
+    //  sort out compass axes, the compass keeps its last value if there's no new sample
 
-    m_imuData.compass.setY(-m_imuData.compass.y());
-    m_imuData.compass.setZ(-m_imuData.compass.z());
+    if (m_imuData->compassValid) {
+        RTMath::convertToVector(compassData + 1, m_imuData->compass, m_compassScale, false);
+        m_imuData->compass.setY(-m_imuData->compass.y());
+        m_imuData->compass.setZ(-m_imuData->compass.z());
+    }
 
     //  now do standard processing
 
@@ -29,13 +29,58 @@
 
 #define COMPASS_ALPHA 0.2f
 
+//  slaves and values in the init sequence
+
+#define LSM9DS1_GYRO_ACCEL              0
+#define LSM9DS1_COMPASS                 1
+
+#define LSM9DS1_INT1_CTRL_VALUE         0
+#define LSM9DS1_CTRL1_VALUE             1
+#define LSM9DS1_CTRL3_VALUE             2
+#define LSM9DS1_CTRL6_VALUE             3
+#define LSM9DS1_CTRL7_VALUE             4
+#define LSM9DS1_CTRL9_VALUE             5
+#define LSM9DS1_MAG_CTRL1_VALUE         6
+#define LSM9DS1_MAG_CTRL2_VALUE         7
+#define LSM9DS1_MAG_CTRL3_VALUE         8
+
+//  The accel/gyro takes 100mS to boot and the mag is set up in the meantime.
+//  Registers are in address order so that they go out as burst writes.
+
+const RTIMU_REG_INIT RTIMULSM9DS1::m_initSequence[] = {
+    {RTIMUREGINIT_WRITE, LSM9DS1_GYRO_ACCEL, LSM9DS1_CTRL8, 0x80, 0, "Failed to boot LSM9DS1"},
+    {RTIMUREGINIT_SETTLE, LSM9DS1_GYRO_ACCEL, 0, 100, 0, ""},
+
+    {RTIMUREGINIT_VERIFY, LSM9DS1_COMPASS, LSM9DS1_MAG_WHO_AM_I, LSM9DS1_MAG_ID, 0xff, "Incorrect LSM9DS1 accel/mag id"},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS1_COMPASS, LSM9DS1_MAG_CTRL1, LSM9DS1_MAG_CTRL1_VALUE, 0, "Failed to set LSM9DS1 compass CTRL1-3"},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS1_COMPASS, LSM9DS1_MAG_CTRL2, LSM9DS1_MAG_CTRL2_VALUE, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS1_COMPASS, LSM9DS1_MAG_CTRL3, LSM9DS1_MAG_CTRL3_VALUE, 0, ""},
+
+    {RTIMUREGINIT_VERIFY, LSM9DS1_GYRO_ACCEL, LSM9DS1_WHO_AM_I, LSM9DS1_ID, 0xff, "Incorrect LSM9DS1 gyro id"},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS1_GYRO_ACCEL, LSM9DS1_INT1_CTRL, LSM9DS1_INT1_CTRL_VALUE, 0, "Failed to set LSM9DS1 INT1_CTRL"},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS1_GYRO_ACCEL, LSM9DS1_CTRL1, LSM9DS1_CTRL1_VALUE, 0, "Failed to set LSM9DS1 gyro CTRL1"},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS1_GYRO_ACCEL, LSM9DS1_CTRL3, LSM9DS1_CTRL3_VALUE, 0, "Failed to set LSM9DS1 gyro CTRL3"},
+
+    //  block data update and register auto increment so that each output is a single burst read
+
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS1_GYRO_ACCEL, LSM9DS1_CTRL6, LSM9DS1_CTRL6_VALUE, 0, "Failed to set LSM9DS1 CTRL6-9"},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS1_GYRO_ACCEL, LSM9DS1_CTRL7, LSM9DS1_CTRL7_VALUE, 0, ""},
+    {RTIMUREGINIT_WRITE, LSM9DS1_GYRO_ACCEL, LSM9DS1_CTRL8, 0x44, 0, ""},
+    {RTIMUREGINIT_WRITE_VALUE, LSM9DS1_GYRO_ACCEL, LSM9DS1_CTRL9, LSM9DS1_CTRL9_VALUE, 0, ""}
+};
+
 RTIMULSM9DS1::RTIMULSM9DS1(RTIMUSettings *settings) : RTIMU(settings)
 {
     m_sampleRate = 100;
+    m_fifoMode = false;
+    m_fifoThreshold = 1;
+    m_cacheIndex = 0;
+    m_cacheCount = 0;
 }
 
 RTIMULSM9DS1::~RTIMULSM9DS1()
 {
+    stopAcquisition();
 }
 
 bool RTIMULSM9DS1::IMUInit()
@@ -44,14 +89,14 @@ bool RTIMULSM9DS1::IMUInit()
 
     // set validity flags
 
-    m_imuData.fusionPoseValid = false;
-    m_imuData.fusionQPoseValid = false;
-    m_imuData.gyroValid = true;
-    m_imuData.accelValid = true;
-    m_imuData.compassValid = true;
-    m_imuData.pressureValid = false;
-    m_imuData.temperatureValid = false;
-    m_imuData.humidityValid = false;
+    m_imuData->fusionPoseValid = false;
+    m_imuData->fusionQPoseValid = false;
+    m_imuData->gyroValid = true;
+    m_imuData->accelValid = true;
+    m_imuData->compassValid = true;
+    m_imuData->pressureValid = false;
+    m_imuData->temperatureValid = false;
+    m_imuData->humidityValid = false;
 
     //  configure IMU
 
@@ -84,36 +129,79 @@ bool RTIMULSM9DS1::IMUInit()
     if (!m_settings->HALOpen())
         return false;
 
-    //  Set up the gyro/accel
+    //  the accel/gyro increments the register address by itself, the mag needs the flag
+
+    m_regInit.setSlave(LSM9DS1_GYRO_ACCEL, m_accelGyroSlaveAddr, true);
+    m_regInit.setSlave(LSM9DS1_COMPASS, m_magSlaveAddr, true, 0x80);
 
-    if (!m_settings->HALWrite(m_accelGyroSlaveAddr, LSM9DS1_CTRL8, 0x80, "Failed to boot LSM9DS1"))
+    if (!setRegisterValues())
         return false;
 
-    m_settings->delayMs(100);
+    if (!m_regInit.run(m_settings, RTIMUREGINIT_TABLE(m_initSequence)))
+        return false;
 
-    if (!m_settings->HALRead(m_accelGyroSlaveAddr, LSM9DS1_WHO_AM_I, 1, &result, "Failed to read LSM9DS1 accel/gyro id"))
+    m_dataReadyConfigured = dataReadyEnabled();
+
+    if (m_fifoMode && !resetFifo())
         return false;
 
-    if (result != LSM9DS1_ID) {
-        HAL_ERROR1("Incorrect LSM9DS1 gyro id %d\n", result);
+    gyroBiasInit();
+
+    m_timestamp.reset(m_sampleInterval);
+
+    HAL_INFO("LSM9DS1 init complete\n");
+    return true;
+}
+
+bool RTIMULSM9DS1::IMUReconfigure()
+{
+    RTFLOAT gyroScale = m_gyroScale;
+    RTFLOAT accelScale = m_accelScale;
+    RTFLOAT compassScale = m_compassScale;
+    bool fifoMode = m_fifoMode;
+    int fifoThreshold = m_fifoThreshold;
+    int written;
+
+    reconfigureBegin();
+
+    if (!setRegisterValues()) {
+        m_gyroScale = gyroScale;
+        m_accelScale = accelScale;
+        m_compassScale = compassScale;
+        m_fifoMode = fifoMode;
+        m_fifoThreshold = fifoThreshold;
+        reconfigureAbandon();
         return false;
     }
 
-    if (!setGyroSampleRate())
-            return false;
+    if (!m_regInit.update(m_settings, RTIMUREGINIT_TABLE(m_initSequence), written))
+        return false;
 
-    if (!setGyroCTRL3())
+    //  samples in the FIFO were taken with the old settings
+
+    if (m_fifoMode && ((written > 0) || !fifoMode || (m_fifoThreshold != fifoThreshold))) {
+        if (!resetFifo())
+            return false;
+    } else if (!m_fifoMode && fifoMode) {
+        if (!m_settings->HALWrite(m_accelGyroSlaveAddr, LSM9DS1_FIFO_CTRL, 0x00, "Failed to set LSM9DS1 FIFO bypass mode"))
             return false;
+        m_cacheIndex = 0;
+        m_cacheCount = 0;
+    }
+
+    reconfigureEnd(written > 0);
 
-    //  Set up the mag
+    HAL_INFO1("LSM9DS1 reconfigured, %d registers written\n", written);
+    return true;
+}
 
-    if (!m_settings->HALRead(m_magSlaveAddr, LSM9DS1_MAG_WHO_AM_I, 1, &result, "Failed to read LSM9DS1 accel/mag id"))
+bool RTIMULSM9DS1::setRegisterValues()
+{
+    if (!setGyroSampleRate())
         return false;
 
-    if (result != LSM9DS1_MAG_ID) {
-        HAL_ERROR1("Incorrect LSM9DS1 accel/mag id %d\n", result);
+    if (!setGyroCTRL3())
         return false;
-    }
 
     if (!setAccelCTRL6())
         return false;
@@ -130,9 +218,23 @@ bool RTIMULSM9DS1::IMUInit()
     if (!setCompassCTRL3())
         return false;
 
-    gyroBiasInit();
+    //  set up the FIFO if it is to be used
 
-    HAL_INFO("LSM9DS1 init complete\n");
+    m_fifoMode = m_settings->m_LSM9DS1FifoEnable;
+    m_fifoThreshold = m_settings->m_LSM9DS1FifoThreshold;
+    if (m_fifoThreshold < 1)
+        m_fifoThreshold = 1;
+    if (m_fifoThreshold > LSM9DS1_FIFO_DEPTH - 1)
+        m_fifoThreshold = LSM9DS1_FIFO_DEPTH - 1;
+
+    m_regInit.setValue(LSM9DS1_CTRL9_VALUE, m_fifoMode ? 0x02 : 0x00);
+
+    //  gyro data ready or FIFO threshold on INT1_A/G
+
+    if (dataReadyEnabled())
+        m_regInit.setValue(LSM9DS1_INT1_CTRL_VALUE, m_fifoMode ? 0x08 : 0x02);
+    else
+        m_regInit.setValue(LSM9DS1_INT1_CTRL_VALUE, 0x00);
     return true;
 }
 
@@ -216,7 +318,8 @@ bool RTIMULSM9DS1::setGyroSampleRate()
         HAL_ERROR1("Illegal LSM9DS1 gyro FSR code %d\n", m_settings->m_LSM9DS1GyroFsr);
         return false;
     }
-    return (m_settings->HALWrite(m_accelGyroSlaveAddr, LSM9DS1_CTRL1, ctrl1, "Failed to set LSM9DS1 gyro CTRL1"));
+    m_regInit.setValue(LSM9DS1_CTRL1_VALUE, ctrl1);
+    return true;
 }
 
 bool RTIMULSM9DS1::setGyroCTRL3()
@@ -232,7 +335,8 @@ bool RTIMULSM9DS1::setGyroCTRL3()
     //  Turn on hpf
     ctrl3 |= 0x40;
 
-    return m_settings->HALWrite(m_accelGyroSlaveAddr,  LSM9DS1_CTRL3, ctrl3, "Failed to set LSM9DS1 gyro CTRL3");
+    m_regInit.setValue(LSM9DS1_CTRL3_VALUE, ctrl3);
+    return true;
 }
 
 bool RTIMULSM9DS1::setAccelCTRL6()
@@ -275,7 +379,8 @@ bool RTIMULSM9DS1::setAccelCTRL6()
 
     ctrl6 |= (m_settings->m_LSM9DS1AccelLpf) | (m_settings->m_LSM9DS1AccelFsr << 3);
 
-    return m_settings->HALWrite(m_accelGyroSlaveAddr,  LSM9DS1_CTRL6, ctrl6, "Failed to set LSM9DS1 accel CTRL6");
+    m_regInit.setValue(LSM9DS1_CTRL6_VALUE, ctrl6);
+    return true;
 }
 
 bool RTIMULSM9DS1::setAccelCTRL7()
@@ -286,7 +391,8 @@ bool RTIMULSM9DS1::setAccelCTRL7()
     //Bug: Bad things happen.
     //ctrl7 = 0x05;
 
-    return m_settings->HALWrite(m_accelGyroSlaveAddr,  LSM9DS1_CTRL7, ctrl7, "Failed to set LSM9DS1 accel CTRL7");
+    m_regInit.setValue(LSM9DS1_CTRL7_VALUE, ctrl7);
+    return true;
 }
 
 
@@ -301,7 +407,8 @@ bool RTIMULSM9DS1::setCompassCTRL1()
 
     ctrl1 = (m_settings->m_LSM9DS1CompassSampleRate << 2);
 
-    return m_settings->HALWrite(m_magSlaveAddr, LSM9DS1_MAG_CTRL1, ctrl1, "Failed to set LSM9DS1 compass CTRL5");
+    m_regInit.setValue(LSM9DS1_MAG_CTRL1_VALUE, ctrl1);
+    return true;
 }
 
 bool RTIMULSM9DS1::setCompassCTRL2()
@@ -336,16 +443,91 @@ bool RTIMULSM9DS1::setCompassCTRL2()
         return false;
     }
 
-    return m_settings->HALWrite(m_magSlaveAddr, LSM9DS1_MAG_CTRL2, ctrl2, "Failed to set LSM9DS1 compass CTRL6");
+    m_regInit.setValue(LSM9DS1_MAG_CTRL2_VALUE, ctrl2);
+    return true;
 }
 
 bool RTIMULSM9DS1::setCompassCTRL3()
 {
-     return m_settings->HALWrite(m_magSlaveAddr,  LSM9DS1_MAG_CTRL3, 0x00, "Failed to set LSM9DS1 compass CTRL3");
+    m_regInit.setValue(LSM9DS1_MAG_CTRL3_VALUE, 0x00);
+    return true;
+}
+
+bool RTIMULSM9DS1::resetFifo()
+{
+    //  going through bypass mode empties the FIFO, then continuous mode with the threshold
+
+    if (!m_settings->HALWrite(m_accelGyroSlaveAddr, LSM9DS1_FIFO_CTRL, 0x00, "Failed to set LSM9DS1 FIFO bypass mode"))
+        return false;
+
+    if (!m_settings->HALWrite(m_accelGyroSlaveAddr, LSM9DS1_FIFO_CTRL, 0xc0 | m_fifoThreshold, "Failed to set LSM9DS1 FIFO mode"))
+        return false;
+
+    m_cacheIndex = 0;
+    m_cacheCount = 0;
+    m_timestamp.reset(m_sampleInterval);
+    return true;
+}
+
+//  readFifo() waits for the FIFO to reach the threshold and then reads everything in it
+//  into the cache, LSM9DS1_FIFO_READ_BLOCK samples to a batch. The compass has no FIFO so
+//  one reading is taken with the first batch and used for all of the samples.
+
+bool RTIMULSM9DS1::readFifo()
+{
+    unsigned char fifoSrc;
+    int count;
+    int block;
+
+    if (!m_settings->HALRead(m_accelGyroSlaveAddr, LSM9DS1_FIFO_SRC, 1, &fifoSrc, "Failed to read LSM9DS1 fifo status"))
+        return false;
+
+    if ((fifoSrc & 0x40) != 0) {
+        //  overrun - samples have been lost so start again
+
+        HAL_INFO("LSM9DS1 fifo overrun\n");
+        resetFifo();
+        return false;
+    }
+
+    count = fifoSrc & 0x3f;
+    m_timestamp.fifoLevel(count, m_settings->HALTimestamp());
+
+    if (count < m_fifoThreshold)
+        return false;
+
+    m_cacheIndex = 0;
+    m_cacheCount = 0;
+
+    while (m_cacheCount < count) {
+        block = count - m_cacheCount;
+        if (block > LSM9DS1_FIFO_READ_BLOCK)
+            block = LSM9DS1_FIFO_READ_BLOCK;
+
+        m_settings->HALBatchBegin();
+        if (m_cacheCount == 0)
+            m_settings->HALBatchRead(m_magSlaveAddr, 0x80 | LSM9DS1_MAG_OUT_X_L, 6, m_cacheCompass);
+
+        //  each sample is popped from the FIFO when its last accel byte is read
+
+        for (int i = 0; i < block; i++) {
+            m_settings->HALBatchRead(m_accelGyroSlaveAddr, LSM9DS1_OUT_X_L_G, 6, m_cache[m_cacheCount + i]);
+            m_settings->HALBatchRead(m_accelGyroSlaveAddr, LSM9DS1_OUT_X_L_XL, 6, m_cache[m_cacheCount + i] + 6);
+        }
+
+        if (!m_settings->HALBatchSubmit("Failed to read LSM9DS1 fifo data")) {
+            resetFifo();
+            return false;
+        }
+        m_cacheCount += block;
+    }
+    return true;
 }
 
 int RTIMULSM9DS1::IMUGetPollInterval()
 {
+    if (m_fifoMode)
+        return (400 * m_fifoThreshold) / m_sampleRate;
     return (400 / m_sampleRate);
 }
 
@@ -356,43 +538,53 @@ bool RTIMULSM9DS1::IMURead()
     unsigned char accelData[6];
     unsigned char compassData[6];
 
-    if (!m_settings->HALRead(m_accelGyroSlaveAddr, LSM9DS1_STATUS, 1, &status, "Failed to read LSM9DS1 status"))
-        return false;
-
-    if ((status & 0x3) == 0)
-        return false;
+    if (m_fifoMode) {
+        if ((m_cacheIndex == m_cacheCount) && !readFifo())
+            return false;
 
-    for (int i = 0; i<6; i++){
-        if (!m_settings->HALRead(m_accelGyroSlaveAddr, LSM9DS1_OUT_X_L_G + i, 1, &gyroData[i], "Failed to read LSM9DS1 gyro data"))
+        memcpy(gyroData, m_cache[m_cacheIndex], 6);
+        memcpy(accelData, m_cache[m_cacheIndex] + 6, 6);
+        memcpy(compassData, m_cacheCompass, 6);
+        m_cacheIndex++;
+    } else {
+        if (!m_settings->HALRead(m_accelGyroSlaveAddr, LSM9DS1_STATUS, 1, &status, "Failed to read LSM9DS1 status"))
             return false;
 
-        if (!m_settings->HALRead(m_accelGyroSlaveAddr, LSM9DS1_OUT_X_L_XL + i, 1, &accelData[i], "Failed to read LSM9DS1 accel data"))
+        if ((status & 0x3) == 0)
             return false;
 
-        if (!m_settings->HALRead(m_magSlaveAddr, LSM9DS1_MAG_OUT_X_L + i, 1, &compassData[i], "Failed to read LSM9DS1 compass data"))
+        m_timestamp.sampleReady(m_settings->HALTimestamp());
+
+        //  the compass needs bit 7 of the register address set to auto increment
+
+        m_settings->HALBatchBegin();
+        m_settings->HALBatchRead(m_accelGyroSlaveAddr, LSM9DS1_OUT_X_L_G, 6, gyroData);
+        m_settings->HALBatchRead(m_accelGyroSlaveAddr, LSM9DS1_OUT_X_L_XL, 6, accelData);
+        m_settings->HALBatchRead(m_magSlaveAddr, 0x80 | LSM9DS1_MAG_OUT_X_L, 6, compassData);
+
+        if (!m_settings->HALBatchSubmit("Failed to read LSM9DS1 data"))
             return false;
     }
 
+    m_imuData->timestamp = m_timestamp.nextTimestamp();
 
-    m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
-
-    RTMath::convertToVector(gyroData, m_imuData.gyro, m_gyroScale, false);
-    RTMath::convertToVector(accelData, m_imuData.accel, m_accelScale, false);
-    RTMath::convertToVector(compassData, m_imuData.compass, m_compassScale, false);
+    RTMath::convertToVector(gyroData, m_imuData->gyro, m_gyroScale, false);
+    RTMath::convertToVector(accelData, m_imuData->accel, m_accelScale, false);
+    RTMath::convertToVector(compassData, m_imuData->compass, m_compassScale, false);
 
     //  sort out gyro axes and correct for bias
 
-    m_imuData.gyro.setZ(-m_imuData.gyro.z());
+    m_imuData->gyro.setZ(-m_imuData->gyro.z());
 
     //  sort out accel data;
 
-    m_imuData.accel.setX(-m_imuData.accel.x());
-    m_imuData.accel.setY(-m_imuData.accel.y());
+    m_imuData->accel.setX(-m_imuData->accel.x());
+    m_imuData->accel.setY(-m_imuData->accel.y());
 
     //  sort out compass axes
 
-    m_imuData.compass.setX(-m_imuData.compass.x());
-    m_imuData.compass.setZ(-m_imuData.compass.z());
+    m_imuData->compass.setX(-m_imuData->compass.x());
+    m_imuData->compass.setZ(-m_imuData->compass.z());
 
     //  now do standard processing
 
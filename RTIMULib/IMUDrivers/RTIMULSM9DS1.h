@@ -27,29 +27,11 @@
 
 #include "RTIMU.h"
 
-//  Define this symbol to use cache mode
+//  FIFO defs
 
-//#define LSM9DS1_CACHE_MODE   // not reliable at the moment
-
-#ifdef LSM9DS1_CACHE_MODE
-
-//  Cache defs
-
-#define LSM9DS1_FIFO_CHUNK_SIZE    6                       // 6 bytes of gyro data
-#define LSM9DS1_FIFO_THRESH        16                      // threshold point in fifo
-#define LSM9DS1_CACHE_BLOCK_COUNT  16                      // number of cache blocks
-
-typedef struct
-{
-    unsigned char data[LSM9DS1_FIFO_THRESH * LSM9DS1_FIFO_CHUNK_SIZE];
-    int count;                                              // number of chunks in the cache block
-    int index;                                              // current index into the cache
-    unsigned char accel[6];                                 // the raw accel readings for the block
-    unsigned char compass[6];                               // the raw compass readings for the block
-
-} LSM9DS1_CACHE_BLOCK;
-
-#endif
+#define LSM9DS1_FIFO_DEPTH          32                      // samples the FIFO holds
+#define LSM9DS1_FIFO_FRAME_SIZE     12                      // 6 bytes gyro then 6 bytes accel
+#define LSM9DS1_FIFO_READ_BLOCK     8                       // max samples read in one batch
 
 class RTIMULSM9DS1 : public RTIMU
 {
@@ -60,10 +42,12 @@ public:
     virtual const char *IMUName() { return "LSM9DS1"; }
     virtual int IMUType() { return RTIMU_TYPE_LSM9DS1; }
     virtual bool IMUInit();
+    virtual bool IMUReconfigure();
     virtual int IMUGetPollInterval();
     virtual bool IMURead();
 
 private:
+    bool setRegisterValues();                               // works out the register values from the settings
     bool setGyroSampleRate();
     bool setGyroCTRL3();
     bool setAccelCTRL6();
@@ -72,6 +56,10 @@ private:
     bool setCompassCTRL2();
     bool setCompassCTRL3();
 
+    static const RTIMU_REG_INIT m_initSequence[];           // the init sequence for the accel/gyro and mag
+    bool resetFifo();
+    bool readFifo();
+
     unsigned char m_accelGyroSlaveAddr;                     // I2C address of accel andgyro
     unsigned char m_magSlaveAddr;                           // I2C address of mag
 
@@ -79,15 +67,13 @@ private:
     RTFLOAT m_accelScale;
     RTFLOAT m_compassScale;
 
-#ifdef LSM9DS1_CACHE_MODE
-    bool m_firstTime;                                       // if first sample
-
-    LSM9DS1_CACHE_BLOCK m_cache[LSM9DS1_CACHE_BLOCK_COUNT]; // the cache itself
-    int m_cacheIn;                                          // the in index
-    int m_cacheOut;                                         // the out index
-    int m_cacheCount;                                       // number of used cache blocks
+    bool m_fifoMode;                                        // true if reading through the FIFO
+    int m_fifoThreshold;                                    // samples in the FIFO before it is read
 
-#endif
+    unsigned char m_cache[LSM9DS1_FIFO_DEPTH][LSM9DS1_FIFO_FRAME_SIZE]; // samples read from the FIFO
+    unsigned char m_cacheCompass[6];                        // compass reading taken with them
+    int m_cacheIndex;                                       // next sample to process
+    int m_cacheCount;                                       // samples in the cache
 };
 
 #endif // _RTIMULSM9DS1_H
@@ -32,6 +32,7 @@ RTIMUMPU9150::RTIMUMPU9150(RTIMUSettings *settings) : RTIMU(settings)
 
 RTIMUMPU9150::~RTIMUMPU9150()
 {
+    stopAcquisition();
 }
 
 bool RTIMUMPU9150::setLpf(unsigned char lpf)
@@ -138,22 +139,20 @@ bool RTIMUMPU9150::IMUInit()
 {
     unsigned char result;
 
-    m_firstTime = true;
-
 #ifdef MPU9150_CACHE_MODE
     m_cacheIn = m_cacheOut = m_cacheCount = 0;
 #endif
 
     // set validity flags
 
-    m_imuData.fusionPoseValid = false;
-    m_imuData.fusionQPoseValid = false;
-    m_imuData.gyroValid = true;
-    m_imuData.accelValid = true;
-    m_imuData.compassValid = true;
-    m_imuData.pressureValid = false;
-    m_imuData.temperatureValid = false;
-    m_imuData.humidityValid = false;
+    m_imuData->fusionPoseValid = false;
+    m_imuData->fusionQPoseValid = false;
+    m_imuData->gyroValid = true;
+    m_imuData->accelValid = true;
+    m_imuData->compassValid = true;
+    m_imuData->pressureValid = false;
+    m_imuData->temperatureValid = false;
+    m_imuData->humidityValid = false;
 
     //  configure IMU
 
@@ -222,6 +221,11 @@ bool RTIMUMPU9150::IMUInit()
     if (!resetFifo())
         return false;
 
+    //  resetFifo() has enabled raw data ready on the INT pin, which is active low
+
+    m_dataReadyConfigured = true;
+    m_dataReadyActiveLow = true;
+
     gyroBiasInit();
 
     HAL_INFO("MPU9150 init complete\n");
@@ -261,7 +265,7 @@ bool RTIMUMPU9150::configureCompass()
 
             HAL_INFO("Detected MPU-6050 without compass\n");
 
-            m_imuData.compassValid = false;
+            m_imuData->compassValid = false;
             return true;
         }
         if (id != 0x48) {                                   // incorrect id for HMC5883L
@@ -272,7 +276,7 @@ bool RTIMUMPU9150::configureCompass()
 
             HAL_INFO("Detected MPU-6050 without compass\n");
 
-            m_imuData.compassValid = false;
+            m_imuData->compassValid = false;
             return true;
         }
 
@@ -386,6 +390,7 @@ bool RTIMUMPU9150::resetFifo()
     if (!m_settings->HALWrite(m_slaveAddr, MPU9150_FIFO_EN, 0x78, "Failed to set FIFO enables"))
         return false;
 
+    m_timestamp.reset(m_sampleInterval);
     return true;
 }
 
@@ -479,10 +484,22 @@ bool RTIMUMPU9150::IMURead()
     if (count == 1024) {
         HAL_INFO("MPU9150 fifo has overflowed");
         resetFifo();
-        m_imuData.timestamp += m_sampleInterval * (1024 / MPU9150_FIFO_CHUNK_SIZE + 1); // try to fix timestamp
         return false;
     }
 
+#ifdef MPU9150_CACHE_MODE
+    int cached = 0;
+
+    for (int i = 0, block = m_cacheOut; i < m_cacheCount; i++) {
+        cached += m_cache[block].count;
+        if (++block == MPU9150_CACHE_BLOCK_COUNT)
+            block = 0;
+    }
+    m_timestamp.fifoLevel(count / MPU9150_FIFO_CHUNK_SIZE + cached, m_settings->HALTimestamp());
+#else
+    m_timestamp.fifoLevel(count / MPU9150_FIFO_CHUNK_SIZE, m_settings->HALTimestamp());
+#endif
+
 
 #ifdef MPU9150_CACHE_MODE
     if ((m_cacheCount == 0) && (count  >= MPU9150_FIFO_CHUNK_SIZE) && (count < (MPU9150_CACHE_SIZE * MPU9150_FIFO_CHUNK_SIZE))) {
@@ -497,7 +514,7 @@ bool RTIMUMPU9150::IMURead()
         if (count >= (MPU9150_CACHE_SIZE * MPU9150_FIFO_CHUNK_SIZE)) {
             if (m_cacheCount == MPU9150_CACHE_BLOCK_COUNT) {
                 // all cache blocks are full - discard oldest and update timestamp to account for lost samples
-                m_imuData.timestamp += m_sampleInterval * m_cache[m_cacheOut].count;
+                m_timestamp.discard(m_cache[m_cacheOut].count);
                 if (++m_cacheOut == MPU9150_CACHE_BLOCK_COUNT)
                     m_cacheOut = 0;
                 m_cacheCount--;
@@ -551,7 +568,7 @@ bool RTIMUMPU9150::IMURead()
             if (!m_settings->HALRead(m_slaveAddr, MPU9150_FIFO_R_W, MPU9150_FIFO_CHUNK_SIZE, fifoData, "Failed to read fifo data"))
                 return false;
             count -= MPU9150_FIFO_CHUNK_SIZE;
-            m_imuData.timestamp += m_sampleInterval;
+            m_timestamp.discard(1);
         }
     }
 
@@ -566,23 +583,23 @@ bool RTIMUMPU9150::IMURead()
 
 #endif
 
-    RTMath::convertToVector(fifoData, m_imuData.accel, m_accelScale, true);
-    RTMath::convertToVector(fifoData + 6, m_imuData.gyro, m_gyroScale, true);
+    RTMath::convertToVector(fifoData, m_imuData->accel, m_accelScale, true);
+    RTMath::convertToVector(fifoData + 6, m_imuData->gyro, m_gyroScale, true);
 
     if (m_compassIs5883)
-        RTMath::convertToVector(compassData, m_imuData.compass, 0.092f, true);
+        RTMath::convertToVector(compassData, m_imuData->compass, 0.092f, true);
     else
-        RTMath::convertToVector(compassData + 1, m_imuData.compass, 0.3f, false);
+        RTMath::convertToVector(compassData + 1, m_imuData->compass, 0.3f, false);
 
     //  sort out gyro axes
 
-    m_imuData.gyro.setX(m_imuData.gyro.x());
-    m_imuData.gyro.setY(-m_imuData.gyro.y());
-    m_imuData.gyro.setZ(-m_imuData.gyro.z());
+    m_imuData->gyro.setX(m_imuData->gyro.x());
+    m_imuData->gyro.setY(-m_imuData->gyro.y());
+    m_imuData->gyro.setZ(-m_imuData->gyro.z());
 
     //  sort out accel data;
 
-    m_imuData.accel.setX(-m_imuData.accel.x());
+    m_imuData->accel.setX(-m_imuData->accel.x());
 
 
     if (m_compassIs5883) {
@@ -590,25 +607,25 @@ bool RTIMUMPU9150::IMURead()
 
         float temp;
 
-        temp = m_imuData.compass.y();
-        m_imuData.compass.setY(-m_imuData.compass.z());
-        m_imuData.compass.setZ(-temp);
+        temp = m_imuData->compass.y();
+        m_imuData->compass.setY(-m_imuData->compass.z());
+        m_imuData->compass.setZ(-temp);
 
     } else {
 
         //  use the compass fuse data adjustments
 
-        m_imuData.compass.setX(m_imuData.compass.x() * m_compassAdjust[0]);
-        m_imuData.compass.setY(m_imuData.compass.y() * m_compassAdjust[1]);
-        m_imuData.compass.setZ(m_imuData.compass.z() * m_compassAdjust[2]);
+        m_imuData->compass.setX(m_imuData->compass.x() * m_compassAdjust[0]);
+        m_imuData->compass.setY(m_imuData->compass.y() * m_compassAdjust[1]);
+        m_imuData->compass.setZ(m_imuData->compass.z() * m_compassAdjust[2]);
 
         //  sort out compass axes
 
         float temp;
 
-        temp = m_imuData.compass.x();
-        m_imuData.compass.setX(m_imuData.compass.y());
-        m_imuData.compass.setY(-temp);
+        temp = m_imuData->compass.x();
+        m_imuData->compass.setX(m_imuData->compass.y());
+        m_imuData->compass.setY(-temp);
     }
 
 
@@ -618,12 +635,7 @@ bool RTIMUMPU9150::IMURead()
     calibrateAverageCompass();
     calibrateAccel();
 
-    if (m_firstTime)
-        m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
-    else
-        m_imuData.timestamp += m_sampleInterval;
-
-    m_firstTime = false;
+    m_imuData->timestamp = m_timestamp.nextTimestamp();
 
     //  now update the filter
 
@@ -80,7 +80,6 @@ private:
     bool setCompassRate();
     bool resetFifo();
 
-    bool m_firstTime;                                       // if first sample
 
     unsigned char m_slaveAddr;                              // I2C address of MPU9150
 
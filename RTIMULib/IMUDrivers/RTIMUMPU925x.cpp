@@ -34,6 +34,7 @@ RTIMUMPU925x::RTIMUMPU925x(RTIMUSettings *settings) : RTIMU(settings)
 
 RTIMUMPU925x::~RTIMUMPU925x()
 {
+    stopAcquisition();
 }
 
 bool RTIMUMPU925x::setSampleRate(int rate)
@@ -174,20 +175,18 @@ bool RTIMUMPU925x::setAccelFsr(unsigned char fsr)
 
 bool RTIMUMPU925x::IMUInit()
 {
-    unsigned char result;
-
-    m_firstTime = true;
+    RTFLOAT temperature;
 
     // set validity flags
 
-    m_imuData.fusionPoseValid = false;
-    m_imuData.fusionQPoseValid = false;
-    m_imuData.gyroValid = true;
-    m_imuData.accelValid = true;
-    m_imuData.compassValid = true;
-    m_imuData.pressureValid = false;
-    m_imuData.temperatureValid = false;
-    m_imuData.humidityValid = false;
+    m_imuData->fusionPoseValid = false;
+    m_imuData->fusionQPoseValid = false;
+    m_imuData->gyroValid = true;
+    m_imuData->accelValid = true;
+    m_imuData->compassValid = true;
+    m_imuData->pressureValid = false;
+    m_imuData->temperatureValid = false;
+    m_imuData->humidityValid = false;
 
     //  configure IMU
 
@@ -195,6 +194,14 @@ bool RTIMUMPU925x::IMUInit()
 
     setSampleRate(m_settings->m_MPU925xGyroAccelSampleRate);
     setCompassRate(m_settings->m_MPU925xCompassSampleRate);
+
+    //  the compass only goes in the fifo if it's as fast as the gyro and accels,
+    //  otherwise it's read on its own when it has a new sample
+
+    m_compassInFifo = m_compassRate >= m_sampleRate;
+    m_fifoChunkSize = MPU925x_FIFO_CHUNK_SIZE + (m_compassInFifo ? MPU925x_FIFO_COMPASS_SIZE : 0);
+    m_fifo.setup(m_settings, m_slaveAddr, MPU925x_FIFO_R_W, m_fifoChunkSize, MPU925x_FIFO_SIZE);
+
     setGyroLpf(m_settings->m_MPU925xGyroLpf);
     setAccelLpf(m_settings->m_MPU925xAccelLpf);
     setGyroFsr(m_settings->m_MPU925xGyroFsr);
@@ -208,6 +215,34 @@ bool RTIMUMPU925x::IMUInit()
     if (!m_settings->HALOpen())
         return false;
 
+    //  a chip that is still set up from last time doesn't need to be reset
+
+    if (warmStart()) {
+        HAL_INFO1("%s warm start\n", IMUName());
+    } else if (!fullInit()) {
+        return false;
+    }
+
+    //  raw data ready is enabled on the INT pin, which is active low
+
+    m_dataReadyConfigured = true;
+    m_dataReadyActiveLow = true;
+
+    setFifoLayout();
+    gyroBiasInit();
+
+    if (readTemperature(temperature))
+        gyroBiasSeed(temperature);
+
+    HAL_INFO1("%s init complete\n", IMUName());
+    return true;
+}
+
+
+bool RTIMUMPU925x::fullInit()
+{
+    unsigned char result;
+
     //  reset the MPU925x
 
     if (!m_settings->HALWrite(m_slaveAddr, MPU925x_PWR_MGMT_1, 0x80, "Failed to initiate MPU925x reset"))
@@ -254,15 +289,169 @@ bool RTIMUMPU925x::IMUInit()
 
     //  select the data to go into the FIFO and enable
 
-    if (!resetFifo())
+    return resetFifo();
+}
+
+bool RTIMUMPU925x::warmStart()
+{
+    unsigned char id;
+    unsigned char config[5];
+    unsigned char master[8];
+    unsigned char slave4Ctrl;
+    unsigned char interrupt[2];
+    unsigned char control[10];
+
+    //  read back what fullInit() sets up in one batch
+
+    m_settings->HALBatchBegin();
+    m_settings->HALBatchRead(m_slaveAddr, MPU925x_WHO_AM_I, 1, &id);
+    m_settings->HALBatchRead(m_slaveAddr, MPU925x_SMPRT_DIV, 5, config);
+    m_settings->HALBatchRead(m_slaveAddr, MPU925x_FIFO_EN, 8, master);
+    m_settings->HALBatchRead(m_slaveAddr, MPU925x_I2C_SLV4_CTRL, 1, &slave4Ctrl);
+    m_settings->HALBatchRead(m_slaveAddr, MPU925x_INT_PIN_CFG, 2, interrupt);
+    m_settings->HALBatchRead(m_slaveAddr, MPU925x_I2C_SLV0_DO, 10, control);
+    if (!m_settings->HALBatchSubmit(""))
         return false;
 
-    gyroBiasInit();
+    if (id != MPU9250_ID && id != MPU9255_ID && id != MPU9250_6500_ID)
+        return false;
 
-    HAL_INFO1("%s init complete\n", IMUName());
+    unsigned char expectedConfig[5] = {
+        (unsigned char)((m_sampleRate > 1000) ? config[0] : 1000 / m_sampleRate - 1),
+        (unsigned char)(m_gyroLpf & 7),
+        (unsigned char)(m_gyroFsr + ((m_gyroLpf >> 3) & 3)),
+        m_accelFsr,
+        m_accelLpf };
+
+    unsigned char expectedMaster[8] = {
+        (unsigned char)(m_compassInFifo ? 0x79 : 0x78),
+        (unsigned char)(m_settings->m_busIsI2C ? 0x00 : 0x40),
+        0x80 | AK8963_ADDRESS, AK8963_ST1 + 1, 0x86,
+        AK8963_ADDRESS, AK8963_CNTL, 0x81 };
+
+    if ((memcmp(config, expectedConfig, 5) != 0) || (memcmp(master, expectedMaster, 8) != 0) ||
+            (slave4Ctrl != 0) || (interrupt[0] != 0x80) || (interrupt[1] != 0x01))
+        return false;
+
+    //  slave 1 data out, the I2C master delay, user control and the power management registers
+
+    if ((control[1] != 0x06) || (control[4] != 0x81) || (control[7] != 0x60) ||
+            (control[8] != 0x01) || (control[9] != 0x00))
+        return false;
+
+    //  compassSetup() left the fuse ROM values in slave 0, 2 and 3 data out
+
+    unsigned char asa[3] = { control[0], control[2], control[3] };
+
+    setCompassAdjust(asa);
+    compassSetInterval(m_compassInFifo ? 0 : 1000000 / m_compassRate);
+    return flushFifo();
+}
+
+bool RTIMUMPU925x::flushFifo()
+{
+    //  unlike resetFifo() this empties the fifo with one write that leaves the fifo and
+    //  I2C master enabled
+
+    if (!m_settings->HALWrite(m_slaveAddr, MPU925x_USER_CTRL, 0x64, "Resetting fifo"))
+        return false;
+
+    m_fifo.reset();
+    m_timestamp.reset(m_sampleInterval);
+    return true;
+}
+
+bool RTIMUMPU925x::readTemperature(RTFLOAT& temperature)
+{
+    unsigned char data[2];
+
+    if (!m_settings->HALRead(m_slaveAddr, MPU925x_TEMP_OUT_H, 2, data, "Failed to read temperature"))
+        return false;
+
+    temperature = (RTFLOAT)(int16_t)(((uint16_t)data[0] << 8) | data[1]) / 333.87f + 21.0f;
     return true;
 }
 
+bool RTIMUMPU925x::IMUReconfigure()
+{
+    int sampleRate = m_sampleRate;
+    int compassRate = m_compassRate;
+    bool compassInFifo = m_compassInFifo;
+    unsigned char gyroLpf = m_gyroLpf;
+    unsigned char accelLpf = m_accelLpf;
+    unsigned char gyroFsr = m_gyroFsr;
+    unsigned char accelFsr = m_accelFsr;
+    RTFLOAT gyroScale = m_gyroScale;
+    RTFLOAT accelScale = m_accelScale;
+    bool changed = false;
+
+    reconfigureBegin();
+
+    if (!setSampleRate(m_settings->m_MPU925xGyroAccelSampleRate) ||
+            !setCompassRate(m_settings->m_MPU925xCompassSampleRate) ||
+            !setGyroLpf(m_settings->m_MPU925xGyroLpf) ||
+            !setAccelLpf(m_settings->m_MPU925xAccelLpf) ||
+            !setGyroFsr(m_settings->m_MPU925xGyroFsr) ||
+            !setAccelFsr(m_settings->m_MPU925xAccelFsr)) {
+        m_compassRate = compassRate;
+        m_gyroLpf = gyroLpf;
+        m_accelLpf = accelLpf;
+        m_gyroFsr = gyroFsr;
+        m_accelFsr = accelFsr;
+        m_gyroScale = gyroScale;
+        m_accelScale = accelScale;
+        reconfigureAbandon();
+        return false;
+    }
+
+    //  only write the registers that have changed
+
+    if ((m_gyroFsr != gyroFsr) || (m_gyroLpf != gyroLpf)) {
+        if (!setGyroConfig())
+            return false;
+        changed = true;
+    }
+
+    if ((m_accelFsr != accelFsr) || (m_accelLpf != accelLpf)) {
+        if (!setAccelConfig())
+            return false;
+        changed = true;
+    }
+
+    if (m_sampleRate != sampleRate) {
+        if (!setSampleRate())
+            return false;
+        changed = true;
+    }
+
+    m_compassInFifo = m_compassRate >= m_sampleRate;
+
+    if ((m_compassRate != compassRate) || (m_compassInFifo != compassInFifo)) {
+        if (!setCompassRate())
+            return false;
+        changed = true;
+    }
+
+    if (m_compassInFifo != compassInFifo) {
+        m_fifoChunkSize = MPU925x_FIFO_CHUNK_SIZE + (m_compassInFifo ? MPU925x_FIFO_COMPASS_SIZE : 0);
+        m_fifo.setup(m_settings, m_slaveAddr, MPU925x_FIFO_R_W, m_fifoChunkSize, MPU925x_FIFO_SIZE);
+
+        if (!m_settings->HALWrite(m_slaveAddr, MPU925x_FIFO_EN, m_compassInFifo ? 0x79 : 0x78, "Failed to set FIFO enables"))
+            return false;
+    }
+
+    //  the fifo holds samples taken with the old settings
+
+    if (changed && !flushFifo())
+        return false;
+
+    setFifoLayout();
+
+    reconfigureEnd(changed);
+
+    HAL_INFO1("%s reconfigured\n", IMUName());
+    return true;
+}
 
 bool RTIMUMPU925x::resetFifo()
 {
@@ -284,12 +473,41 @@ bool RTIMUMPU925x::resetFifo()
     if (!m_settings->HALWrite(m_slaveAddr, MPU925x_INT_ENABLE, 1, "Writing int enable"))
         return false;
 
-    if (!m_settings->HALWrite(m_slaveAddr, MPU925x_FIFO_EN, 0x79, "Failed to set FIFO enables"))
+    if (!m_settings->HALWrite(m_slaveAddr, MPU925x_FIFO_EN, m_compassInFifo ? 0x79 : 0x78, "Failed to set FIFO enables"))
         return false;
 
+    m_fifo.reset();
+    m_timestamp.reset(m_sampleInterval);
     return true;
 }
 
+void RTIMUMPU925x::setFifoLayout()
+{
+    RTMATH_RAW_TRIPLE triples[3];
+
+    //  accel x is inverted, gyro y and z are inverted and the compass has x and y
+    //  swapped with the new y inverted, as well as the fuse ROM adjustments
+
+    RTMath::setRawTriple(triples[0], 0, m_accelScale, true);
+    triples[0].scale[0] = -m_accelScale;
+
+    RTMath::setRawTriple(triples[1], 6, m_gyroScale, true);
+    triples[1].scale[1] = -m_gyroScale;
+    triples[1].scale[2] = -m_gyroScale;
+
+    RTMath::setRawTriple(m_compassTriple, 0, 0.6, false);
+    m_compassTriple.axis[0] = 1;
+    m_compassTriple.axis[1] = 0;
+    m_compassTriple.scale[0] = (RTFLOAT)0.6 * m_compassAdjust[1];
+    m_compassTriple.scale[1] = (RTFLOAT)-0.6 * m_compassAdjust[0];
+    m_compassTriple.scale[2] = (RTFLOAT)0.6 * m_compassAdjust[2];
+
+    triples[2] = m_compassTriple;
+    triples[2].offset = MPU925x_FIFO_CHUNK_SIZE;
+
+    m_fifo.setLayout(triples, m_compassInFifo ? 3 : 2);
+}
+
 bool RTIMUMPU925x::setGyroConfig()
 {
     unsigned char gyroConfig = m_gyroFsr + ((m_gyroLpf >> 3) & 3);
@@ -402,9 +620,7 @@ bool RTIMUMPU925x::compassSetup() {
     //  convert asa to usable scale factor
     //printf("asa %x%x%x\n", asa[0], asa[1], asa[2]);
 
-    m_compassAdjust[0] = ((float)asa[0] - 128.0) / 256.0 + 1.0f;
-    m_compassAdjust[1] = ((float)asa[1] - 128.0) / 256.0 + 1.0f;
-    m_compassAdjust[2] = ((float)asa[2] - 128.0) / 256.0 + 1.0f;
+    setCompassAdjust(asa);
 
 //    if (!m_settings->HALWrite(m_slaveAddr, MPU925x_I2C_MST_CTRL, 0x40, "Failed to set I2C master mode"))
 //        return false;
@@ -427,7 +643,12 @@ bool RTIMUMPU925x::compassSetup() {
     if (!m_settings->HALWrite(m_slaveAddr, MPU925x_I2C_SLV1_CTRL, 0x81, "Failed to set slave 1 ctrl"))
         return false;
 
-    if (!m_settings->HALWrite(m_slaveAddr, MPU925x_I2C_SLV1_DO, 0x6, "Failed to set slave 1 DO"))
+    //  slave 1 data out puts the compass in continuous mode. Slave 0 is a read and slaves 2
+    //  and 3 aren't used so their data out registers keep the fuse ROM values for a warm start.
+
+    unsigned char dataOut[4] = { asa[0], 0x06, asa[1], asa[2] };
+
+    if (!m_settings->HALWrite(m_slaveAddr, MPU925x_I2C_SLV0_DO, 4, dataOut, "Failed to set slave data out"))
         return false;
 
     // needed to ensure correct data if reading without fifo
@@ -437,6 +658,13 @@ bool RTIMUMPU925x::compassSetup() {
     return true;
 }
 
+void RTIMUMPU925x::setCompassAdjust(const unsigned char *asa)
+{
+    m_compassAdjust[0] = ((float)asa[0] - 128.0) / 256.0 + 1.0f;
+    m_compassAdjust[1] = ((float)asa[1] - 128.0) / 256.0 + 1.0f;
+    m_compassAdjust[2] = ((float)asa[2] - 128.0) / 256.0 + 1.0f;
+}
+
 bool RTIMUMPU925x::setCompassRate()
 {
     int rate;
@@ -449,6 +677,14 @@ bool RTIMUMPU925x::setCompassRate()
     rate = 0; // compass rate is always sample rate
     if (!m_settings->HALWrite(m_slaveAddr, MPU925x_I2C_SLV4_CTRL, rate, "Failed to set slave ctrl 4"))
          return false;
+
+    //  the AK8963 runs at 100Hz and has no status in the external sensor data so if
+    //  it's not in the fifo the copy is read at the compass rate
+
+    if (m_compassInFifo)
+        compassSetInterval(0);
+    else
+        compassSetInterval(1000000 / m_compassRate);
     return true;
 }
 
@@ -509,122 +745,78 @@ bool RTIMUMPU925x::IMURead()
 {
     unsigned char fifoCount[2];
     unsigned int count;
-    unsigned char fifoData[360];
+    uint64_t readTime;
 
-    if (!m_settings->HALRead(m_slaveAddr, MPU925x_FIFO_COUNT_H, 2, fifoCount, "Failed to read fifo count")) {
-        resetFifo();
-        return false;
-    }
-
-    count = ((unsigned int)fifoCount[0] << 8) + fifoCount[1];
-
-    if (count < MPU925x_FIFO_CHUNK_SIZE)
-        return false;
-    
-    if (count == 512) {
-        HAL_INFO("MPU-925x fifo has overflowed\n");
-        HAL_INFO("MPU-925x trying to reinitialize sensors\n");
-        IMUInit();
-        return false;
-    }
-
-    if (count >= 512) {
-        // I have seen this in cases where the device gets in a bad state...
-        // I know to fixed it by rebooting the pi :-/  for now simply report it
-        HAL_INFO("MPU-925x fifo has invalid count\n");
-        resetFifo();
-        return false;
-    }
-
-    if (count > 360) {
-        HAL_INFO("MPU-925x fifo has more than 20 samples!!\n");
-        count = 360;
-    }
-
-#if 0    
-    if (count < MPU925x_FIFO_CHUNK_SIZE)
-        return false;
+    if (m_fifo.available() == 0) {
+        if (!m_settings->HALRead(m_slaveAddr, MPU925x_FIFO_COUNT_H, 2, fifoCount, "Failed to read fifo count")) {
+            resetFifo();
+            return false;
+        }
 
-    if (!m_settings->HALRead(m_slaveAddr, MPU925x_FIFO_R_W, MPU925x_FIFO_CHUNK_SIZE, fifoData, "Failed to read fifo data"))
-        return false;
+        count = ((unsigned int)fifoCount[0] << 8) + fifoCount[1];
+        readTime = m_settings->HALTimestamp();
+        m_fifo.level(count, readTime);
 
-    if (!m_settings->HALRead(m_slaveAddr, MPU925x_EXT_SENS_DATA_00, 6, compassData, "Failed to read compass data"))
-        return false;
+        if (count < (unsigned int)m_fifoChunkSize)
+            return false;
 
-    RTMath::convertToVector(fifoData, m_imuData.accel, m_accelScale, true);
-    RTMath::convertToVector(fifoData + 6, m_imuData.gyro, m_gyroScale, true);
-    RTMath::convertToVector(compassData + 1, m_imuData.compass, 0.6f, false);
-#else
+        if (count > MPU925x_FIFO_SIZE) {
+            // I have seen this in cases where the device gets in a bad state...
+            // I know to fixed it by rebooting the pi :-/  for now simply report it
+            HAL_INFO("MPU-925x fifo has invalid count\n");
+            resetFifo();
+            return false;
+        }
 
-    count /= MPU925x_FIFO_CHUNK_SIZE;
+        m_timestamp.fifoLevel(count / m_fifoChunkSize, readTime);
 
-    if (count > 10) {
-        if (!m_settings->HALRead(m_slaveAddr, MPU925x_FIFO_R_W, MPU925x_FIFO_CHUNK_SIZE*10, fifoData, "Failed to read fifo data") ||
-            !m_settings->HALRead(m_slaveAddr, MPU925x_FIFO_R_W, (count-10)*MPU925x_FIFO_CHUNK_SIZE, fifoData+MPU925x_FIFO_CHUNK_SIZE*10, "Failed to read fifo data"))
-            return false;
-    } else       
-        if (!m_settings->HALRead(m_slaveAddr, MPU925x_FIFO_R_W, count*MPU925x_FIFO_CHUNK_SIZE, fifoData, "Failed to read fifo data"))
+        if (!m_fifo.drain(count, "Failed to read fifo data")) {
+            if (count == MPU925x_FIFO_SIZE) {
+                HAL_INFO("MPU-925x fifo has overflowed\n");
+                HAL_INFO("MPU-925x trying to reinitialize sensors\n");
+                IMUInit();
+            } else {
+                resetFifo();
+            }
             return false;
-
-    RTVector3 accel_t, gyro_t, compass_t;
-    unsigned char *p = fifoData;
-    //printf("count %d\n", count);
-    for(uint8_t i=0; i<count; i++) {
-        RTVector3 accel, gyro, compass;
-        RTMath::convertToVector(p,    accel, m_accelScale, true);
-        RTMath::convertToVector(p+6,  gyro, m_gyroScale, true);
-        RTMath::convertToVector(p+12, compass, .6, false);
-
-        /* check for out of sync, if high/low bytes are not shadowed */
-        static RTVector3 lastcompass;
-#if 0 // enable to debug data spikes (assumed fixed)
-        if(fabs(lastcompass.z() - compass.z()) > 64) {
-            printf("possible byte issue %f %f", lastcompass.z(), compass.z());
-            for(int i=0; i<8; i++)
-                printf(" %x", p[i+12]);
-            printf("\n");
         }
-#endif        
-        lastcompass = compass;
-
-        p += MPU925x_FIFO_CHUNK_SIZE;
-    
-        accel_t += accel;
-        gyro_t += gyro;
-        compass_t += compass;
-    }
 
-    // average samples
-    for(int i=0; i<3; i++) {
-        m_imuData.accel.setData(i, accel_t.data(i)/count);
-        m_imuData.gyro.setData(i, gyro_t.data(i)/count);
-        m_imuData.compass.setData(i, compass_t.data(i)/count);
-   }
-#endif
-
-    //  sort out gyro axes
+        if (m_fifo.available() == 0)
+            return false;
+    }
 
-    m_imuData.gyro.setX(m_imuData.gyro.x());
-    m_imuData.gyro.setY(-m_imuData.gyro.y());
-    m_imuData.gyro.setZ(-m_imuData.gyro.z());
+    //  either the next sample from the cache or the average of everything in it
 
-    //  sort out accel data;
+    int samples = m_settings->m_fifoAverage ? m_fifo.available() : 1;
 
-    m_imuData.accel.setX(-m_imuData.accel.x());
+    for (int i = 0; i < 3; i++) {
+        m_imuData->accel.setData(i, m_fifo.average(0, i, samples));
+        m_imuData->gyro.setData(i, m_fifo.average(1, i, samples));
+        if (m_compassInFifo)
+            m_imuData->compass.setData(i, m_fifo.average(2, i, samples));
+    }
 
-    //  use the compass fuse data adjustments
+    //  the average is stamped with the time of the last sample in it
 
-    m_imuData.compass.setX(m_imuData.compass.x() * m_compassAdjust[0]);
-    m_imuData.compass.setY(m_imuData.compass.y() * m_compassAdjust[1]);
-    m_imuData.compass.setZ(m_imuData.compass.z() * m_compassAdjust[2]);
+    for (int i = 0; i < samples; i++) {
+        m_fifo.next();
+        m_imuData->timestamp = m_timestamp.nextTimestamp();
+    }
 
-    //  sort out compass axes
+    //  the compass keeps its last value if it isn't due
 
-    float temp;
+    if (m_compassInFifo) {
+        compassRead(true);
+    } else if (compassDue()) {
+        unsigned char compassData[6];
+        RTFLOAT compass[3];
 
-    temp = m_imuData.compass.x();
-    m_imuData.compass.setX(m_imuData.compass.y());
-    m_imuData.compass.setY(-temp);
+        if (!m_settings->HALRead(m_slaveAddr, MPU925x_EXT_SENS_DATA_00, 6, compassData, "Failed to read compass data"))
+            return false;
+        RTMath::convertBatch(compassData, 6, 1, &m_compassTriple, 1, compass, 1);
+        m_imuData->compass = RTVector3(compass[0], compass[1], compass[2]);
+        compassRead(true);
+    }
 
     //  now do standard processing
 
@@ -632,13 +824,6 @@ bool RTIMUMPU925x::IMURead()
     calibrateAverageCompass();
     calibrateAccel();
 
-    if (m_firstTime)
-        m_imuData.timestamp = RTMath::currentUSecsSinceEpoch();
-    else
-        m_imuData.timestamp += m_sampleInterval * count;
-
-    m_firstTime = false;
-
     //  now update the filter
 
     updateFusion();
@@ -32,7 +32,9 @@
 
 //  FIFO transfer size
 
-#define MPU925x_FIFO_CHUNK_SIZE     18                      // gyro and accels take 12 bytes
+#define MPU925x_FIFO_CHUNK_SIZE     12                      // gyro and accels take 12 bytes
+#define MPU925x_FIFO_COMPASS_SIZE   6                       // and the compass 6 if it's in the fifo
+#define MPU925x_FIFO_SIZE           512                     // fifo capacity in bytes
 
 
 class RTIMUMPU925x : public RTIMU
@@ -51,35 +53,46 @@ public:
     virtual const char *IMUName() { return "MPU-925x"; }
     virtual int IMUType() { return RTIMU_TYPE_MPU925x; }
     virtual bool IMUInit();
+    virtual bool IMUReconfigure();
     virtual bool IMURead();
     virtual int IMUGetPollInterval();
 
 protected:
 
+    virtual bool readTemperature(RTFLOAT& temperature);
+
     RTFLOAT m_compassAdjust[3];                             // the compass fuse ROM values converted for use
 
 private:
+    bool fullInit();                                        // reset and set up the chip
+    bool warmStart();                                       // true if the chip is still set up as fullInit() left it
+    bool flushFifo();                                       // empty the fifo without stopping it
+    void setCompassAdjust(const unsigned char *asa);        // works out m_compassAdjust from the fuse ROM
     bool setGyroConfig();
     bool setAccelConfig();
     bool setSampleRate();
     bool compassSetup();
     bool setCompassRate();
     bool resetFifo();
+    void setFifoLayout();                                   // sets up the fifo's conversion for the current scales
     bool bypassOn();
     bool bypassOff();
 
-    bool m_firstTime;                                       // if first sample
 
     unsigned char m_slaveAddr;                              // I2C address of MPU9150
 
     unsigned char m_gyroLpf;                                // gyro low pass filter setting
     unsigned char m_accelLpf;                               // accel low pass filter setting
     int m_compassRate;                                      // compass sample rate in Hz
+    bool m_compassInFifo;                                   // true if the compass is read with every sample
+    int m_fifoChunkSize;                                    // bytes in each fifo sample
     unsigned char m_gyroFsr;
     unsigned char m_accelFsr;
 
     RTFLOAT m_gyroScale;
     RTFLOAT m_accelScale;
+
+    RTMATH_RAW_TRIPLE m_compassTriple;                      // the compass scaling and axes
 };
 
 #endif // _RTIMUMPU925x_H
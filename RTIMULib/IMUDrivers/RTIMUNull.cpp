@@ -30,6 +30,7 @@ RTIMUNull::RTIMUNull(RTIMUSettings *settings) : RTIMU(settings)
 
 RTIMUNull::~RTIMUNull()
 {
+    stopAcquisition();
 }
 
 bool RTIMUNull::IMUInit()
@@ -50,5 +51,5 @@ bool RTIMUNull::IMURead()
 
 void RTIMUNull::setIMUData(const RTIMU_DATA& data)
 {
-    m_imuData = data;
+    *m_imuData = data;
 }
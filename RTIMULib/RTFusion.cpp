@@ -24,6 +24,7 @@
 
 #include "RTFusion.h"
 #include "RTIMUHal.h"
+#include "RTIMUSettings.h"
 
 //  The slerp power valule controls the influence of the measured state to correct the predicted state
 //  0 = measured state ignored (just gyros), 1 = measured state overrides predicted state.
@@ -42,9 +43,12 @@ RTFusion::RTFusion()
 {
     m_debug = false;
     m_firstTime = true;
+    m_lastFusionTime = 0;
+    m_restored = false;
     m_enableGyro = true;
     m_enableAccel = true;
     m_enableCompass = true;
+    m_compassValid = true;
 
     m_slerpPower = RTQF_SLERP_POWER;
 }
@@ -53,6 +57,99 @@ RTFusion::~RTFusion()
 {
 }
 
+RTFLOAT RTFusion::fusionTimeDelta(uint64_t timestamp)
+{
+    //  signed so that a timestamp going backwards is skipped
+
+    RTFLOAT timeDelta = (RTFLOAT)(int64_t)(timestamp - m_lastFusionTime) / (RTFLOAT)1000000;
+
+    m_lastFusionTime = timestamp;
+
+    if (m_restored) {
+        m_restored = false;
+        if (timeDelta > RTFUSION_STATE_MAX_GAP)
+            return 0;
+    }
+    return timeDelta;
+}
+
+int RTFusion::saveState(unsigned char *buffer, int length, const RTIMUSettings *settings)
+{
+    RTFusionState state(buffer, length);
+
+    for (int i = 0; i < 4; i++)
+        state.putInt(RTFUSION_STATE_MAGIC[i], 1);
+    state.putInt(RTFUSION_STATE_VERSION, 1);
+    state.putInt(fusionType(), 1);
+    state.putInt(0, 2);                                     // filled in below
+
+    state.putInt(m_firstTime ? 1 : 0, 1);
+    state.putInt(m_lastFusionTime, 8);
+    state.putQuaternion(m_measuredQPose);
+    state.putVector(m_measuredPose);
+    state.putQuaternion(m_fusionQPose);
+    state.putVector(m_fusionPose);
+    state.putVector(settings->m_gyroBias);
+    state.putInt(settings->m_gyroBiasValid ? 1 : 0, 1);
+
+    saveFusionState(state);
+
+    if (state.overrun()) {
+        HAL_ERROR("Buffer too small for fusion checkpoint\n");
+        return 0;
+    }
+
+    buffer[6] = state.length() & 0xff;
+    buffer[7] = state.length() >> 8;
+    return state.length();
+}
+
+bool RTFusion::restoreState(const unsigned char *buffer, int length, RTIMUSettings *settings)
+{
+    unsigned char expected[RTFUSION_STATE_MAX_LEN];
+
+    if ((length < RTFUSION_STATE_HEADER_LEN) || (memcmp(buffer, RTFUSION_STATE_MAGIC, 4) != 0)) {
+        HAL_ERROR("Not a fusion checkpoint\n");
+        return false;
+    }
+
+    if (buffer[4] != RTFUSION_STATE_VERSION) {
+        HAL_ERROR1("Unsupported fusion checkpoint version %d\n", buffer[4]);
+        return false;
+    }
+
+    if (buffer[5] != fusionType()) {
+        HAL_ERROR2("Fusion checkpoint is for %s, not %s\n",
+                   buffer[5] < RTFUSION_TYPE_COUNT ? fusionName(buffer[5]) : "unknown", fusionName(fusionType()));
+        return false;
+    }
+
+    //  a fusion type always saves the same length so checking it first means a
+    //  checkpoint can't be part restored
+
+    if ((length != (buffer[6] | (buffer[7] << 8))) || (length != saveState(expected, sizeof(expected), settings))) {
+        HAL_ERROR1("Fusion checkpoint has the wrong length %d\n", length);
+        return false;
+    }
+
+    RTFusionState state(buffer, length);
+
+    state.getInt(RTFUSION_STATE_HEADER_LEN);
+    m_firstTime = state.getInt(1) != 0;
+    m_lastFusionTime = state.getInt(8);
+    m_measuredQPose = state.getQuaternion();
+    m_measuredPose = state.getVector();
+    m_fusionQPose = state.getQuaternion();
+    m_fusionPose = state.getVector();
+    settings->m_gyroBias = state.getVector();
+    settings->m_gyroBiasValid = state.getInt(1) != 0;
+
+    restoreFusionState(state);
+
+    m_restored = true;
+    return true;
+}
+
 void RTFusion::calculatePose(const RTVector3& accel, const RTVector3& mag, float magDeclination)
 {
     RTQuaternion m;
@@ -158,3 +255,115 @@ RTVector3 RTFusion::getAccelGlobalFrame(RTVector3 accel)
     accelGCS.setZ(rotatedAccel.z());
     return accelGCS;
 }
+
+//----------------------------------------------------------
+//
+//  RTFusionState
+
+RTFusionState::RTFusionState(unsigned char *buffer, int length)
+{
+    m_out = buffer;
+    m_in = buffer;
+    m_length = length;
+    m_pos = 0;
+    m_overrun = false;
+}
+
+RTFusionState::RTFusionState(const unsigned char *buffer, int length)
+{
+    m_out = NULL;
+    m_in = buffer;
+    m_length = length;
+    m_pos = 0;
+    m_overrun = false;
+}
+
+void RTFusionState::putInt(uint64_t value, int bytes)
+{
+    if ((m_out == NULL) || (m_pos + bytes > m_length)) {
+        m_overrun = true;
+        return;
+    }
+    for (int i = 0; i < bytes; i++) {
+        m_out[m_pos++] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+void RTFusionState::putReal(RTFLOAT value)
+{
+    double real = value;
+    uint64_t bits;
+
+    memcpy(&bits, &real, 8);
+    putInt(bits, 8);
+}
+
+void RTFusionState::putVector(const RTVector3& vec)
+{
+    for (int i = 0; i < 3; i++)
+        putReal(vec.data(i));
+}
+
+void RTFusionState::putQuaternion(const RTQuaternion& quat)
+{
+    for (int i = 0; i < 4; i++)
+        putReal(quat.data(i));
+}
+
+void RTFusionState::putMatrix(const RTMatrix4x4& mat)
+{
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            putReal(mat.val(row, col));
+}
+
+uint64_t RTFusionState::getInt(int bytes)
+{
+    uint64_t value = 0;
+
+    if (m_pos + bytes > m_length) {
+        m_overrun = true;
+        return 0;
+    }
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)m_in[m_pos++] << (8 * i);
+    return value;
+}
+
+RTFLOAT RTFusionState::getReal()
+{
+    uint64_t bits = getInt(8);
+    double real;
+
+    memcpy(&real, &bits, 8);
+    return (RTFLOAT)real;
+}
+
+RTVector3 RTFusionState::getVector()
+{
+    RTVector3 vec;
+
+    for (int i = 0; i < 3; i++)
+        vec.setData(i, getReal());
+    return vec;
+}
+
+RTQuaternion RTFusionState::getQuaternion()
+{
+    RTQuaternion quat;
+
+    for (int i = 0; i < 4; i++)
+        quat.setData(i, getReal());
+    return quat;
+}
+
+RTMatrix4x4 RTFusionState::getMatrix()
+{
+    RTMatrix4x4 mat;
+
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            mat.setVal(row, col, getReal());
+    return mat;
+}
@@ -28,6 +28,57 @@
 
 class RTIMUSettings;
 
+//  Fusion checkpoints hold everything a fusion algorithm has learnt so that it can carry
+//  on where it left off after a restart instead of converging again from a single
+//  measurement. A checkpoint is a header followed by the state:
+//
+//      header:     "RTFS", version (1 byte), fusion type (1 byte), total length (2 bytes)
+//
+//  Integers are little endian and reals are stored as 64 bit IEEE doubles, so checkpoints
+//  don't depend on whether RTFLOAT is float or double.
+
+#define RTFUSION_STATE_MAGIC            "RTFS"
+#define RTFUSION_STATE_VERSION          1
+#define RTFUSION_STATE_HEADER_LEN       8
+#define RTFUSION_STATE_MAX_LEN          512                 // big enough for any fusion type
+
+//  If the first sample after a restore is more than this many seconds after the
+//  checkpoint, the gap is skipped rather than integrated
+
+#define RTFUSION_STATE_MAX_GAP          1.0
+
+//  RTFusionState packs and unpacks checkpoint data. Running off the end of the buffer
+//  sets the overrun flag rather than writing or reading outside it.
+
+class RTFusionState
+{
+public:
+    RTFusionState(unsigned char *buffer, int length);       // for saving
+    RTFusionState(const unsigned char *buffer, int length); // for restoring
+
+    void putInt(uint64_t value, int bytes);
+    void putReal(RTFLOAT value);
+    void putVector(const RTVector3& vec);
+    void putQuaternion(const RTQuaternion& quat);
+    void putMatrix(const RTMatrix4x4& mat);
+
+    uint64_t getInt(int bytes);
+    RTFLOAT getReal();
+    RTVector3 getVector();
+    RTQuaternion getQuaternion();
+    RTMatrix4x4 getMatrix();
+
+    int length() { return m_pos; }
+    bool overrun() { return m_overrun; }
+
+private:
+    unsigned char *m_out;
+    const unsigned char *m_in;
+    int m_length;
+    int m_pos;
+    bool m_overrun;
+};
+
 class RTFusion
 {
 public:
@@ -52,8 +103,20 @@ public:
 
     virtual void newIMUData(RTIMU_DATA& /* data */, const RTIMUSettings * /* settings */) {}
     virtual void gyroBiasInit(float) {}
+    virtual void gyroBiasSetRate(float) {}                 // sample rate changed, keep what has been learnt
+    virtual void gyroBiasSkipStartup() {}                   // the bias is already known so don't learn it quickly
+    virtual bool gyroBiasStartup() { return false; }        // true while the bias is being learnt quickly
     virtual void handleGyroBias(RTIMU_DATA&, RTIMUSettings *) {}
 
+    //  saveState() writes a checkpoint of the fusion state and the gyro bias in settings
+    //  to buffer and returns its length, or 0 if the buffer is too small.
+    //  restoreState() loads one saved by the same fusion type. It should be called after
+    //  IMUInit() and returns false, leaving everything unchanged, if the checkpoint
+    //  isn't valid.
+
+    int saveState(unsigned char *buffer, int length, const RTIMUSettings *settings);
+    bool restoreState(const unsigned char *buffer, int length, RTIMUSettings *settings);
+
     //  This static function returns performs the type to name mapping
 
     static const char *fusionName(int fusionType) { return m_fusionNameMap[fusionType]; }
@@ -83,6 +146,16 @@ public:
     void calculatePose(const RTVector3& accel, const RTVector3& mag, float magDeclination); // generates pose from accels and mag
     
 protected:
+    //  the state particular to each fusion algorithm
+
+    virtual void saveFusionState(RTFusionState& /* state */) {}
+    virtual void restoreFusionState(RTFusionState& /* state */) {}
+
+    //  fusionTimeDelta() returns the time since the last sample in seconds and moves
+    //  m_lastFusionTime on. The sample should be skipped if it returns 0 or less.
+
+    RTFLOAT fusionTimeDelta(uint64_t timestamp);
+
 
     RTFLOAT m_slerpPower;                                   // a value 0 to 1 that controls measured
 
@@ -99,6 +172,7 @@ protected:
 
     bool m_firstTime;                                       // if first time after reset
     uint64_t m_lastFusionTime;                              // for delta time calculation
+    bool m_restored;                                        // true until the first sample after restoreState()
 
     static const char *m_fusionNameMap[];                   // the fusion name array
 };
@@ -61,7 +61,45 @@ void RTFusionKalman4::reset()
     m_measuredQPose.fromEuler(m_measuredPose);
  }
 
-void RTFusionKalman4::predict()
+void RTFusionKalman4::saveFusionState(RTFusionState& state)
+{
+    state.putQuaternion(m_stateQ);
+    state.putMatrix(m_Pkk);
+    state.putReal(m_Q.val(0, 0));
+    state.putReal(m_Rk.val(0, 0));
+    state.putInt(m_gyroSampleCount, 4);
+    state.putReal(m_gyroSampleRate);
+    state.putVector(m_previousAccel);
+}
+
+void RTFusionKalman4::restoreFusionState(RTFusionState& state)
+{
+    m_stateQ = state.getQuaternion();
+    m_Pkk = state.getMatrix();
+
+    //  Q and Rk are diagonal and predict() only sets the off diagonal part of Fk
+
+    m_Q.fill(0);
+    m_Rk.fill(0);
+    RTFLOAT q = state.getReal();
+    RTFLOAT rk = state.getReal();
+    for (int i = 0; i < KALMAN_STATE_LENGTH; i++) {
+        m_Q.setVal(i, i, q);
+        m_Rk.setVal(i, i, rk);
+    }
+    m_Fk.fill(0);
+
+    //  the startup learning period is in samples so allow for a different sample rate
+
+    int sampleCount = (int)state.getInt(4);
+    RTFLOAT sampleRate = state.getReal();
+
+    if (sampleRate > 0)
+        m_gyroSampleCount = (int)((RTFLOAT)sampleCount * m_gyroSampleRate / sampleRate);
+    m_previousAccel = state.getVector();
+}
+
+RTMATH_DISPATCH void RTFusionKalman4::predict()
 {
     RTMatrix4x4 mat;
     RTQuaternion tQuat;
@@ -120,7 +158,7 @@ void RTFusionKalman4::predict()
 }
 
 
-void RTFusionKalman4::update()
+RTMATH_DISPATCH void RTFusionKalman4::update()
 {
     RTQuaternion delta;
     RTMatrix4x4 Sk, SkInverse;
@@ -198,8 +236,7 @@ void RTFusionKalman4::newIMUData(RTIMU_DATA& data, const RTIMUSettings *settings
         m_fusionPose = m_measuredPose;
         m_firstTime = false;
     } else {
-        m_timeDelta = (RTFLOAT)(data.timestamp - m_lastFusionTime) / (RTFLOAT)1000000;
-        m_lastFusionTime = data.timestamp;
+        m_timeDelta = fusionTimeDelta(data.timestamp);
         if (m_timeDelta <= 0)
             return;
 
@@ -256,6 +293,10 @@ void RTFusionKalman4::newIMUData(RTIMU_DATA& data, const RTIMUSettings *settings
 
 #define RTIMU_FUZZY_ACCEL_ZERO      0.05
 
+//  this is how long the gyro bias is learnt quickly for after startup in seconds
+
+#define RTIMU_GYRO_STARTUP_TIME     60
+
 void RTFusionKalman4::gyroBiasInit(float samplerate)
 {
     // sets up gyro bias calculation
@@ -265,13 +306,33 @@ void RTFusionKalman4::gyroBiasInit(float samplerate)
     m_gyroSampleRate = samplerate;
 }
 
+void RTFusionKalman4::gyroBiasSetRate(float samplerate)
+{
+    // keeps the bias and how far through the startup time we are
+
+    m_gyroSampleCount = (int)((float)m_gyroSampleCount * samplerate / m_gyroSampleRate);
+    m_gyroLearningAlpha = 0.01f / samplerate;
+    m_gyroContinuousAlpha = 0.004f / samplerate;
+    m_gyroSampleRate = samplerate;
+}
+
+void RTFusionKalman4::gyroBiasSkipStartup()
+{
+    m_gyroSampleCount = (int)(RTIMU_GYRO_STARTUP_TIME * m_gyroSampleRate) + 1;
+}
+
+bool RTFusionKalman4::gyroBiasStartup()
+{
+    return m_gyroSampleCount < (RTIMU_GYRO_STARTUP_TIME * m_gyroSampleRate);
+}
+
 void RTFusionKalman4::handleGyroBias(RTIMU_DATA& imuData, RTIMUSettings *settings)
 {
     RTVector3 deltaAccel = m_previousAccel;
     deltaAccel -= imuData.accel;   // compute difference
     m_previousAccel = imuData.accel;
 
-    int startuptime = 60;
+    int startuptime = RTIMU_GYRO_STARTUP_TIME;
     // at startup, find gyro bias much faster
     if (m_gyroSampleCount < (startuptime * m_gyroSampleRate) &&
 //        deltaAccel.length() < RTIMU_FUZZY_ACCEL_ZERO &&
@@ -59,8 +59,14 @@ protected:
     RTQuaternion m_rotationPower;                           // delta raised to the appopriate power
     RTVector3 m_rotationUnitVector;                         // the vector part of the rotation delta
 
+    virtual void saveFusionState(RTFusionState& state);
+    virtual void restoreFusionState(RTFusionState& state);
+
 private:
     virtual void gyroBiasInit(float samplerate);
+    virtual void gyroBiasSetRate(float samplerate);
+    virtual void gyroBiasSkipStartup();
+    virtual bool gyroBiasStartup();
     virtual void handleGyroBias(RTIMU_DATA& imuData, RTIMUSettings *settings);
     RTFLOAT m_gyroLearningAlpha;                            // gyro bias rapid learning rate
     RTFLOAT m_gyroContinuousAlpha;                          // gyro bias continuous (slow) learning rate
@@ -48,6 +48,18 @@ void RTFusionRTQF::reset()
     m_sampleNumber = 0;
  }
 
+void RTFusionRTQF::saveFusionState(RTFusionState& state)
+{
+    state.putQuaternion(m_stateQ);
+    state.putInt(m_sampleNumber, 4);
+}
+
+void RTFusionRTQF::restoreFusionState(RTFusionState& state)
+{
+    m_stateQ = state.getQuaternion();
+    m_sampleNumber = (int)state.getInt(4);
+}
+
 void RTFusionRTQF::predict()
 {
     RTFLOAT x2, y2, z2;
@@ -137,8 +149,7 @@ void RTFusionRTQF::newIMUData(RTIMU_DATA& data, const RTIMUSettings *settings)
         m_fusionPose = m_measuredPose;
         m_firstTime = false;
     } else {
-        m_timeDelta = (RTFLOAT)(data.timestamp - m_lastFusionTime) / (RTFLOAT)1000000;
-        m_lastFusionTime = data.timestamp;
+        m_timeDelta = fusionTimeDelta(data.timestamp);
         if (m_timeDelta <= 0)
             return;
 
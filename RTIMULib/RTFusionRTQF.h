@@ -54,6 +54,9 @@ protected:
     RTQuaternion m_rotationPower;                           // delta raised to the appopriate power
     RTVector3 m_rotationUnitVector;                         // the vector part of the rotation delta
 
+    virtual void saveFusionState(RTFusionState& state);
+    virtual void restoreFusionState(RTFusionState& state);
+
 private:
     void predict();
     void update();
@@ -0,0 +1,526 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "RTIMUBusLog.h"
+#include "RTMath.h"
+
+#if !defined(WIN32)
+#include <time.h>
+#include <errno.h>
+#endif
+
+//  The writer wakes when the buffer is a quarter full or after RTIMULOG_WRITE_INTERVAL mS
+
+#define RTIMULOG_WRITE_INTERVAL         100
+
+static uint64_t busLogTime()
+{
+#if !defined(WIN32)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#else
+    return RTMath::currentUSecsSinceEpoch();
+#endif
+}
+
+static void putLE(unsigned char *buf, uint64_t value, int length)
+{
+    for (int i = 0; i < length; i++) {
+        buf[i] = (unsigned char)value;
+        value >>= 8;
+    }
+}
+
+static uint64_t getLE(unsigned char const *buf, int length)
+{
+    uint64_t value = 0;
+
+    for (int i = length - 1; i >= 0; i--)
+        value = (value << 8) | buf[i];
+    return value;
+}
+
+//----------------------------------------------------------
+//
+//  RTIMUBusRecorder
+
+RTIMUBusRecorder::RTIMUBusRecorder()
+{
+    m_file = NULL;
+    m_buffer = NULL;
+    m_bufferSize = 0;
+    m_head = m_tail = m_used = 0;
+    m_dropped = m_totalDropped = 0;
+}
+
+RTIMUBusRecorder::~RTIMUBusRecorder()
+{
+    stop();
+}
+
+bool RTIMUBusRecorder::start(const char *fileName, int bufferSize)
+{
+    unsigned char header[RTIMULOG_HEADER_LEN];
+
+    stop();
+
+    if (bufferSize < 2 * (RTIMULOG_RECORD_LEN + MAX_READ_LEN)) {
+        HAL_ERROR1("Bus log buffer of %d bytes is too small\n", bufferSize);
+        return false;
+    }
+
+    if ((m_file = fopen(fileName, "wb")) == NULL) {
+        HAL_ERROR1("Failed to open bus log %s\n", fileName);
+        return false;
+    }
+
+    memcpy(header, RTIMULOG_MAGIC, 8);
+    putLE(header + 8, RTIMULOG_VERSION, 4);
+    if (fwrite(header, 1, RTIMULOG_HEADER_LEN, m_file) != RTIMULOG_HEADER_LEN) {
+        HAL_ERROR1("Failed to write bus log %s\n", fileName);
+        fclose(m_file);
+        m_file = NULL;
+        return false;
+    }
+
+    m_buffer = (unsigned char *)malloc(bufferSize);
+    m_bufferSize = bufferSize;
+    m_head = m_tail = m_used = 0;
+    m_dropped = m_totalDropped = 0;
+
+#if !defined(WIN32)
+    m_stop = false;
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_wakeup, NULL);
+    if (pthread_create(&m_thread, NULL, writerThread, this) != 0) {
+        HAL_ERROR("Failed to start bus log writer\n");
+        pthread_cond_destroy(&m_wakeup);
+        pthread_mutex_destroy(&m_lock);
+        free(m_buffer);
+        m_buffer = NULL;
+        fclose(m_file);
+        m_file = NULL;
+        return false;
+    }
+#endif
+    return true;
+}
+
+void RTIMUBusRecorder::stop()
+{
+    if (m_file == NULL)
+        return;
+
+#if !defined(WIN32)
+    pthread_mutex_lock(&m_lock);
+    m_stop = true;
+    pthread_cond_signal(&m_wakeup);
+    pthread_mutex_unlock(&m_lock);
+    pthread_join(m_thread, NULL);
+    pthread_cond_destroy(&m_wakeup);
+    pthread_mutex_destroy(&m_lock);
+#endif
+
+    //  the buffer is empty now unless there was no writer thread
+
+    if (m_dropped > 0) {
+        unsigned char count[4];
+
+        putLE(count, m_dropped, 4);
+        if (!put(RTIMULOG_DROPPED, 0, 0, 4, count)) {
+            writeOut(m_tail, m_used);
+            m_head = m_tail = m_used = 0;
+            put(RTIMULOG_DROPPED, 0, 0, 4, count);
+        }
+    }
+    writeOut(m_tail, m_used);
+
+    fclose(m_file);
+    m_file = NULL;
+    free(m_buffer);
+    m_buffer = NULL;
+}
+
+void RTIMUBusRecorder::record(unsigned char type, unsigned char slaveAddr, unsigned char regAddr,
+                unsigned char length, unsigned char const *data)
+{
+    unsigned char count[4];
+
+    if (m_file == NULL)
+        return;
+
+#if !defined(WIN32)
+    pthread_mutex_lock(&m_lock);
+#endif
+
+    if (m_dropped > 0) {
+        putLE(count, m_dropped, 4);
+        if (put(RTIMULOG_DROPPED, 0, 0, 4, count))
+            m_dropped = 0;
+    }
+
+    if ((m_dropped > 0) || !put(type, slaveAddr, regAddr, length, data)) {
+        m_dropped++;
+        m_totalDropped++;
+    }
+
+#if !defined(WIN32)
+    if (m_used >= m_bufferSize / 4)
+        pthread_cond_signal(&m_wakeup);
+    pthread_mutex_unlock(&m_lock);
+#else
+    //  no writer thread so write out from here once the buffer is half full
+
+    if (m_used >= m_bufferSize / 2) {
+        writeOut(m_tail, m_used);
+        m_tail = m_head;
+        m_used = 0;
+    }
+#endif
+}
+
+void RTIMUBusRecorder::recordTime(uint64_t timestamp)
+{
+    unsigned char value[8];
+
+    putLE(value, timestamp, 8);
+    record(RTIMULOG_TIME, 0, 0, 8, value);
+}
+
+bool RTIMUBusRecorder::put(unsigned char type, unsigned char slaveAddr, unsigned char regAddr,
+                unsigned char length, unsigned char const *data)
+{
+    unsigned char header[RTIMULOG_RECORD_LEN];
+    int part;
+
+    if (m_bufferSize - m_used < RTIMULOG_RECORD_LEN + length)
+        return false;
+
+    header[0] = type;
+    header[1] = slaveAddr;
+    header[2] = regAddr;
+    header[3] = length;
+    putLE(header + 4, busLogTime(), 8);
+
+    for (int i = 0; i < RTIMULOG_RECORD_LEN; i++) {
+        m_buffer[m_head++] = header[i];
+        if (m_head == m_bufferSize)
+            m_head = 0;
+    }
+
+    if (length > 0) {
+        part = m_bufferSize - m_head;
+        if (part >= length) {
+            memcpy(m_buffer + m_head, data, length);
+        } else {
+            memcpy(m_buffer + m_head, data, part);
+            memcpy(m_buffer, data + part, length - part);
+        }
+        m_head = (m_head + length) % m_bufferSize;
+    }
+    m_used += RTIMULOG_RECORD_LEN + length;
+    return true;
+}
+
+void RTIMUBusRecorder::writeOut(int tail, int length)
+{
+    int part;
+
+    if (length == 0)
+        return;
+
+    part = m_bufferSize - tail;
+    if (part >= length) {
+        fwrite(m_buffer + tail, 1, length, m_file);
+    } else {
+        fwrite(m_buffer + tail, 1, part, m_file);
+        fwrite(m_buffer, 1, length - part, m_file);
+    }
+    fflush(m_file);
+}
+
+#if !defined(WIN32)
+
+void *RTIMUBusRecorder::writerThread(void *arg)
+{
+    RTIMUBusRecorder *recorder = (RTIMUBusRecorder *)arg;
+    struct timespec wakeTime;
+    int tail, length;
+    bool stopping;
+
+    pthread_mutex_lock(&recorder->m_lock);
+
+    while (true) {
+        if (!recorder->m_stop && (recorder->m_used < recorder->m_bufferSize / 4)) {
+            clock_gettime(CLOCK_REALTIME, &wakeTime);
+            wakeTime.tv_nsec += RTIMULOG_WRITE_INTERVAL * 1000000L;
+            if (wakeTime.tv_nsec >= 1000000000L) {
+                wakeTime.tv_sec++;
+                wakeTime.tv_nsec -= 1000000000L;
+            }
+            if (pthread_cond_timedwait(&recorder->m_wakeup, &recorder->m_lock, &wakeTime) != ETIMEDOUT)
+                continue;
+        }
+
+        //  the records between tail and tail + length belong to this thread until
+        //  m_tail is updated so the file can be written without holding the lock
+
+        tail = recorder->m_tail;
+        length = recorder->m_used;
+        stopping = recorder->m_stop;
+
+        pthread_mutex_unlock(&recorder->m_lock);
+        recorder->writeOut(tail, length);
+        pthread_mutex_lock(&recorder->m_lock);
+
+        recorder->m_tail = (tail + length) % recorder->m_bufferSize;
+        recorder->m_used -= length;
+
+        if (stopping)
+            break;
+    }
+
+    pthread_mutex_unlock(&recorder->m_lock);
+    return NULL;
+}
+
+#endif
+
+//----------------------------------------------------------
+//
+//  RTIMUReplayTransport
+
+RTIMUReplayTransport::RTIMUReplayTransport()
+{
+    m_file = NULL;
+    m_finished = true;
+    m_diverged = false;
+    m_records = 0;
+    m_lastTime = 0;
+}
+
+RTIMUReplayTransport::~RTIMUReplayTransport()
+{
+    closeLog();
+}
+
+bool RTIMUReplayTransport::openLog(const char *fileName)
+{
+    unsigned char header[RTIMULOG_HEADER_LEN];
+
+    closeLog();
+
+    if ((m_file = fopen(fileName, "rb")) == NULL) {
+        HAL_ERROR1("Failed to open bus log %s\n", fileName);
+        return false;
+    }
+
+    if ((fread(header, 1, RTIMULOG_HEADER_LEN, m_file) != RTIMULOG_HEADER_LEN) ||
+            (memcmp(header, RTIMULOG_MAGIC, 8) != 0)) {
+        HAL_ERROR1("%s is not a bus log\n", fileName);
+        closeLog();
+        return false;
+    }
+
+    if (getLE(header + 8, 4) != RTIMULOG_VERSION) {
+        HAL_ERROR2("Bus log %s has unsupported version %d\n", fileName, (int)getLE(header + 8, 4));
+        closeLog();
+        return false;
+    }
+
+    m_finished = false;
+    m_diverged = false;
+    m_records = 0;
+    m_lastTime = 0;
+    loadNext();
+    return true;
+}
+
+void RTIMUReplayTransport::closeLog()
+{
+    if (m_file != NULL) {
+        fclose(m_file);
+        m_file = NULL;
+    }
+    m_finished = true;
+}
+
+bool RTIMUReplayTransport::loadNext()
+{
+    unsigned char header[RTIMULOG_RECORD_LEN];
+
+    while (true) {
+        if (fread(header, 1, RTIMULOG_RECORD_LEN, m_file) != RTIMULOG_RECORD_LEN) {
+            m_finished = true;
+            return false;
+        }
+        m_type = header[0];
+        m_slaveAddr = header[1];
+        m_regAddr = header[2];
+        m_length = header[3];
+        if (fread(m_payload, 1, m_length, m_file) != m_length) {
+            HAL_ERROR("Bus log is truncated\n");
+            m_finished = true;
+            return false;
+        }
+        if (m_type != RTIMULOG_DROPPED)
+            return true;
+
+        //  replay may not be faithful after a gap but carry on as far as it goes
+
+        HAL_ERROR1("Bus log is missing %d records\n", (int)getLE(m_payload, 4));
+        m_diverged = true;
+    }
+}
+
+bool RTIMUReplayTransport::match(unsigned char type, unsigned char slaveAddr, unsigned char regAddr,
+                unsigned char length)
+{
+    if (m_finished) {
+        HAL_ERROR("Bus log has no more records\n");
+        return false;
+    }
+
+    if (((m_type & ~RTIMULOG_FAILED) != type) || (m_slaveAddr != slaveAddr) ||
+            (m_regAddr != regAddr) || (m_length != length)) {
+        HAL_ERROR4("Replay diverged at record %lu - slave %d, reg %d, length %d not in log\n",
+                m_records, slaveAddr, regAddr, length);
+        m_diverged = true;
+        return false;
+    }
+    return true;
+}
+
+bool RTIMUReplayTransport::open()
+{
+    if (m_file == NULL) {
+        HAL_ERROR("No bus log open for replay\n");
+        return false;
+    }
+    return true;
+}
+
+void RTIMUReplayTransport::close()
+{
+}
+
+bool RTIMUReplayTransport::read(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                unsigned char *data, const char *errorMsg)
+{
+    bool result;
+
+    if (!match(RTIMULOG_READ, slaveAddr, regAddr, length))
+        return false;
+
+    memcpy(data, m_payload, length);
+    result = (m_type & RTIMULOG_FAILED) == 0;
+    if (!result && (strlen(errorMsg) > 0))
+        HAL_ERROR3("Replayed read error from %d, %d - %s\n", slaveAddr, regAddr, errorMsg);
+    m_records++;
+    loadNext();
+    return result;
+}
+
+bool RTIMUReplayTransport::read(unsigned char slaveAddr, unsigned char length,
+                unsigned char *data, const char *errorMsg)
+{
+    bool result;
+
+    if (!match(RTIMULOG_READ_NOREG, slaveAddr, 0, length))
+        return false;
+
+    memcpy(data, m_payload, length);
+    result = (m_type & RTIMULOG_FAILED) == 0;
+    if (!result && (strlen(errorMsg) > 0))
+        HAL_ERROR2("Replayed read error from %d - %s\n", slaveAddr, errorMsg);
+    m_records++;
+    loadNext();
+    return result;
+}
+
+bool RTIMUReplayTransport::write(unsigned char slaveAddr, unsigned char regAddr,
+                unsigned char length, unsigned char const *data, const char *errorMsg)
+{
+    bool result;
+
+    if (!match(RTIMULOG_WRITE, slaveAddr, regAddr, length))
+        return false;
+
+    if ((length > 0) && (memcmp(data, m_payload, length) != 0)) {
+        HAL_ERROR3("Replay diverged at record %lu - data written to %d, %d differs from log\n",
+                m_records, slaveAddr, regAddr);
+        m_diverged = true;
+        return false;
+    }
+
+    result = (m_type & RTIMULOG_FAILED) == 0;
+    if (!result && (strlen(errorMsg) > 0))
+        HAL_ERROR3("Replayed write error to %d, %d - %s\n", slaveAddr, regAddr, errorMsg);
+    m_records++;
+    loadNext();
+    return result;
+}
+
+bool RTIMUReplayTransport::batch(HAL_BATCH_ENTRY *entries, int count, const char *errorMsg)
+{
+    HAL_BATCH_ENTRY *entry;
+    bool result = true;
+
+    //  a failed batch is logged with every entry failed so all of them are consumed here
+
+    for (int i = 0; i < count; i++) {
+        entry = entries + i;
+        if (entry->read) {
+            if (!read(entry->slaveAddr, entry->regAddr, entry->length, entry->rxData, errorMsg))
+                result = false;
+        } else {
+            if (!write(entry->slaveAddr, entry->regAddr, entry->length, entry->txData, errorMsg))
+                result = false;
+        }
+    }
+    return result;
+}
+
+void RTIMUReplayTransport::delayMs(int /* milliSeconds */)
+{
+    //  replay runs as fast as it can
+}
+
+uint64_t RTIMUReplayTransport::currentUSecs()
+{
+    if (m_finished)
+        return m_lastTime;
+
+    if (m_type != RTIMULOG_TIME) {
+        HAL_ERROR1("Replay diverged at record %lu - timestamp not in log\n", m_records);
+        m_diverged = true;
+        return m_lastTime;
+    }
+
+    m_lastTime = getLE(m_payload, 8);
+    m_records++;
+    loadNext();
+    return m_lastTime;
+}
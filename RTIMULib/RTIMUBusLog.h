@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _RTIMUBUSLOG_H
+#define	_RTIMUBUSLOG_H
+
+#include "RTIMUTransport.h"
+
+#if !defined(WIN32)
+#include <pthread.h>
+#endif
+
+//  Bus logs record every transfer RTIMUHal makes so that a run can be replayed later
+//  through RTIMUReplayTransport. The file is a header followed by records:
+//
+//      header:     "RTIMULOG", version (4 bytes)
+//      record:     type (1 byte), slave address (1 byte), register (1 byte), length (1 byte),
+//                  monotonic timestamp in uS (8 bytes), then length bytes of payload
+//
+//  All multi-byte values are little endian. The payload is the data read or written,
+//  the value returned for RTIMULOG_TIME and the number of records lost for RTIMULOG_DROPPED.
+
+#define RTIMULOG_MAGIC                  "RTIMULOG"
+#define RTIMULOG_VERSION                1
+#define RTIMULOG_HEADER_LEN             12                  // file header length
+#define RTIMULOG_RECORD_LEN             12                  // record length without payload
+
+#define RTIMULOG_READ                   1                   // HALRead() with register select
+#define RTIMULOG_READ_NOREG             2                   // HALRead() without register select
+#define RTIMULOG_WRITE                  3                   // HALWrite()
+#define RTIMULOG_TIME                   4                   // HALTimestamp()
+#define RTIMULOG_DROPPED                5                   // records lost because the buffer was full
+#define RTIMULOG_FAILED                 0x80                // ORed into type if the transfer failed
+
+#define RTIMULOG_DEFAULT_BUFFER         (256 * 1024)        // default recorder buffer size in bytes
+
+//  RTIMUBusRecorder is used by RTIMUHal to write the log. Records are copied into a
+//  buffer allocated when recording starts and a background thread writes them out, so
+//  the cost on the bus thread is a short copy. If the writer falls behind and the buffer
+//  fills, records are dropped and a RTIMULOG_DROPPED record marks the gap.
+
+class RTIMUBusRecorder
+{
+public:
+    RTIMUBusRecorder();
+    virtual ~RTIMUBusRecorder();
+
+    bool start(const char *fileName, int bufferSize);
+    void stop();
+
+    void record(unsigned char type, unsigned char slaveAddr, unsigned char regAddr,
+                unsigned char length, unsigned char const *data);
+    void recordTime(uint64_t timestamp);
+
+    unsigned long getDropped() { return m_totalDropped; }  // records lost since start()
+
+private:
+    bool put(unsigned char type, unsigned char slaveAddr, unsigned char regAddr,
+             unsigned char length, unsigned char const *data);
+    void writeOut(int tail, int length);                    // write out buffered bytes
+#if !defined(WIN32)
+    static void *writerThread(void *arg);
+#endif
+
+    FILE *m_file;
+    unsigned char *m_buffer;                                // the ring buffer
+    int m_bufferSize;
+    int m_head;                                             // next byte to fill
+    int m_tail;                                             // next byte to write out
+    int m_used;                                             // bytes waiting to be written
+    unsigned long m_dropped;                                // records dropped since the last RTIMULOG_DROPPED
+    unsigned long m_totalDropped;
+
+#if !defined(WIN32)
+    pthread_t m_thread;
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_wakeup;
+    bool m_stop;
+#endif
+};
+
+//  RTIMUReplayTransport plays a bus log back to the drivers. Reads return the recorded
+//  data and result, writes are checked against the log and currentUSecs() returns the
+//  recorded timestamps, so IMUInit(), IMURead() and fusion see exactly what they saw
+//  when the log was made. A transfer that does not match the next record means the code
+//  has taken a different path; it fails with an error and isDiverged() becomes true.
+
+class RTIMUReplayTransport : public RTIMUTransport
+{
+public:
+    RTIMUReplayTransport();
+    virtual ~RTIMUReplayTransport();
+
+    bool openLog(const char *fileName);
+    void closeLog();
+    bool isFinished() { return m_finished; }                // true when all records have been used
+    bool isDiverged() { return m_diverged; }
+    unsigned long getRecordCount() { return m_records; }    // records replayed so far
+
+    virtual bool open();
+    virtual void close();
+    virtual bool read(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg);
+    virtual bool read(unsigned char slaveAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg);
+    virtual bool write(unsigned char slaveAddr, unsigned char regAddr,
+                  unsigned char length, unsigned char const *data, const char *errorMsg);
+    virtual bool batch(HAL_BATCH_ENTRY *entries, int count, const char *errorMsg);
+    virtual void delayMs(int milliSeconds);
+    virtual void delayUntil(uint64_t /* uSecs */) {}        // replay runs as fast as it can
+    virtual uint64_t currentUSecs();
+
+private:
+    bool loadNext();
+    bool match(unsigned char type, unsigned char slaveAddr, unsigned char regAddr,
+               unsigned char length);
+
+    FILE *m_file;
+    bool m_finished;
+    bool m_diverged;
+    unsigned long m_records;
+    uint64_t m_lastTime;                                    // last RTIMULOG_TIME value
+
+    unsigned char m_type;                                   // the next record
+    unsigned char m_slaveAddr;
+    unsigned char m_regAddr;
+    unsigned char m_length;
+    unsigned char m_payload[MAX_READ_LEN];
+};
+
+#endif // _RTIMUBUSLOG_H
@@ -0,0 +1,290 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "RTIMUBusRegistry.h"
+
+#if !defined(WIN32) && !defined(__APPLE__)
+
+#include <time.h>
+
+static uint64_t busTime()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+//----------------------------------------------------------
+//
+//  RTIMUSharedBus
+
+RTIMUSharedBus::RTIMUSharedBus(bool isI2C, unsigned char bus, unsigned char select, unsigned int speed)
+{
+    m_isI2C = isI2C;
+    m_bus = bus;
+    m_select = select;
+    m_users = 0;
+
+    m_I2C = NULL;
+    m_SPI = NULL;
+    if (isI2C) {
+        m_I2C = new RTIMUI2CTransport();
+        m_I2C->setBus(bus);
+        m_transport = m_I2C;
+    } else {
+        m_SPI = new RTIMUSPITransport();
+        m_SPI->setBus(bus, select, speed);
+        m_transport = m_SPI;
+    }
+
+    pthread_mutex_init(&m_lock, NULL);
+    resetStats();
+}
+
+RTIMUSharedBus::~RTIMUSharedBus()
+{
+    delete m_transport;
+    pthread_mutex_destroy(&m_lock);
+}
+
+bool RTIMUSharedBus::matches(bool isI2C, unsigned char bus, unsigned char select)
+{
+    if (isI2C != m_isI2C)
+        return false;
+    if (isI2C)
+        return bus == m_bus;
+    return (bus == m_bus) && (select == m_select);
+}
+
+void RTIMUSharedBus::setSPISpeed(unsigned int speed)
+{
+    if (m_SPI != NULL)
+        m_SPI->setBus(m_bus, m_select, speed);
+}
+
+void RTIMUSharedBus::getStats(RTIMU_BUS_STATS& stats)
+{
+    pthread_mutex_lock(&m_lock);
+    stats = m_stats;
+    if (m_I2C != NULL)
+        stats.slaveSelects = m_I2C->getSlaveSelects() - m_stats.slaveSelects;
+    stats.elapsedTime = busTime() - m_statsStart;
+    pthread_mutex_unlock(&m_lock);
+
+    stats.users = m_users;
+    if (stats.elapsedTime > 0)
+        stats.utilization = (float)stats.busyTime / (float)stats.elapsedTime;
+    else
+        stats.utilization = 0;
+}
+
+void RTIMUSharedBus::resetStats()
+{
+    pthread_mutex_lock(&m_lock);
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    //  slaveSelects holds the count at reset until getStats() works out the difference
+
+    if (m_I2C != NULL)
+        m_stats.slaveSelects = m_I2C->getSlaveSelects();
+    m_statsStart = busTime();
+    pthread_mutex_unlock(&m_lock);
+}
+
+uint64_t RTIMUSharedBus::lock()
+{
+    uint64_t start = busTime();
+    uint64_t now;
+
+    pthread_mutex_lock(&m_lock);
+    now = busTime();
+    m_stats.waitTime += now - start;
+    return now;
+}
+
+void RTIMUSharedBus::unlock(uint64_t lockTime, int transfers, int bytes, bool result)
+{
+    m_stats.busyTime += busTime() - lockTime;
+    m_stats.transfers += transfers;
+    m_stats.bytes += bytes;
+    if (!result)
+        m_stats.errors++;
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool RTIMUSharedBus::open()
+{
+    bool result;
+
+    pthread_mutex_lock(&m_lock);
+    result = m_transport->open();
+    pthread_mutex_unlock(&m_lock);
+    return result;
+}
+
+void RTIMUSharedBus::close()
+{
+    pthread_mutex_lock(&m_lock);
+    m_transport->close();
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool RTIMUSharedBus::read(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                unsigned char *data, const char *errorMsg)
+{
+    uint64_t lockTime = lock();
+    bool result = m_transport->read(slaveAddr, regAddr, length, data, errorMsg);
+
+    unlock(lockTime, 1, length, result);
+    return result;
+}
+
+bool RTIMUSharedBus::read(unsigned char slaveAddr, unsigned char length,
+                unsigned char *data, const char *errorMsg)
+{
+    uint64_t lockTime = lock();
+    bool result = m_transport->read(slaveAddr, length, data, errorMsg);
+
+    unlock(lockTime, 1, length, result);
+    return result;
+}
+
+bool RTIMUSharedBus::write(unsigned char slaveAddr, unsigned char regAddr,
+                unsigned char length, unsigned char const *data, const char *errorMsg)
+{
+    uint64_t lockTime = lock();
+    bool result = m_transport->write(slaveAddr, regAddr, length, data, errorMsg);
+
+    unlock(lockTime, 1, length, result);
+    return result;
+}
+
+bool RTIMUSharedBus::batch(HAL_BATCH_ENTRY *entries, int count, const char *errorMsg)
+{
+    uint64_t lockTime = lock();
+    bool result = m_transport->batch(entries, count, errorMsg);
+    int bytes = 0;
+
+    for (int i = 0; i < count; i++)
+        bytes += entries[i].length;
+    unlock(lockTime, count, bytes, result);
+    return result;
+}
+
+void RTIMUSharedBus::delayMs(int milliSeconds)
+{
+    //  no need to hold the bus while waiting
+
+    m_transport->delayMs(milliSeconds);
+}
+
+//----------------------------------------------------------
+//
+//  RTIMUBusRegistry
+
+RTIMUSharedBus *RTIMUBusRegistry::m_buses[RTIMUBUS_MAX_BUSES];
+int RTIMUBusRegistry::m_busCount = 0;
+pthread_mutex_t RTIMUBusRegistry::m_lock = PTHREAD_MUTEX_INITIALIZER;
+
+RTIMUSharedBus *RTIMUBusRegistry::acquireI2C(unsigned char bus)
+{
+    return acquire(true, bus, 0, 0);
+}
+
+RTIMUSharedBus *RTIMUBusRegistry::acquireSPI(unsigned char bus, unsigned char select, unsigned int speed)
+{
+    return acquire(false, bus, select, speed);
+}
+
+RTIMUSharedBus *RTIMUBusRegistry::acquire(bool isI2C, unsigned char bus, unsigned char select, unsigned int speed)
+{
+    RTIMUSharedBus *sharedBus = NULL;
+
+    pthread_mutex_lock(&m_lock);
+
+    for (int i = 0; i < m_busCount; i++) {
+        if (m_buses[i]->matches(isI2C, bus, select)) {
+            sharedBus = m_buses[i];
+            break;
+        }
+    }
+
+    if (sharedBus == NULL) {
+        if (m_busCount == RTIMUBUS_MAX_BUSES) {
+            HAL_ERROR("Too many buses in use\n");
+            pthread_mutex_unlock(&m_lock);
+            return NULL;
+        }
+        sharedBus = new RTIMUSharedBus(isI2C, bus, select, speed);
+        m_buses[m_busCount++] = sharedBus;
+    }
+
+    //  the SPI speed is set by the first user to open the bus
+
+    if (sharedBus->m_users == 0) {
+        sharedBus->setSPISpeed(speed);
+        if (!sharedBus->open()) {
+            pthread_mutex_unlock(&m_lock);
+            return NULL;
+        }
+    }
+    sharedBus->m_users++;
+
+    pthread_mutex_unlock(&m_lock);
+    return sharedBus;
+}
+
+void RTIMUBusRegistry::release(RTIMUSharedBus *bus)
+{
+    pthread_mutex_lock(&m_lock);
+    if ((bus->m_users > 0) && (--bus->m_users == 0))
+        bus->close();
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool RTIMUBusRegistry::getStats(bool isI2C, unsigned char bus, unsigned char select, RTIMU_BUS_STATS& stats)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < m_busCount; i++) {
+        if (m_buses[i]->matches(isI2C, bus, select)) {
+            m_buses[i]->getStats(stats);
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+    return found;
+}
+
+void RTIMUBusRegistry::resetStats()
+{
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < m_busCount; i++)
+        m_buses[i]->resetStats();
+    pthread_mutex_unlock(&m_lock);
+}
+
+#endif
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _RTIMUBUSREGISTRY_H
+#define	_RTIMUBUSREGISTRY_H
+
+#include "RTIMUTransport.h"
+
+#if !defined(WIN32) && !defined(__APPLE__)
+
+#include <pthread.h>
+
+#define RTIMUBUS_MAX_BUSES              8                   // max I2C and SPI buses in the registry
+
+//  RTIMUSharedBus is one physical I2C bus or SPI bus and chip select, shared by every
+//  RTIMUHal in the process that uses it. There is one file descriptor and one cache of
+//  the selected I2C slave, and each transfer holds the bus lock so that users on
+//  different threads don't interleave.
+
+class RTIMUSharedBus : public RTIMUTransport
+{
+public:
+    RTIMUSharedBus(bool isI2C, unsigned char bus, unsigned char select, unsigned int speed);
+    virtual ~RTIMUSharedBus();
+
+    bool matches(bool isI2C, unsigned char bus, unsigned char select);
+    void setSPISpeed(unsigned int speed);                   // takes effect on the next open()
+    void getStats(RTIMU_BUS_STATS& stats);
+    void resetStats();
+
+    virtual bool open();
+    virtual void close();
+    virtual bool read(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg);
+    virtual bool read(unsigned char slaveAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg);
+    virtual bool write(unsigned char slaveAddr, unsigned char regAddr,
+                  unsigned char length, unsigned char const *data, const char *errorMsg);
+    virtual bool batch(HAL_BATCH_ENTRY *entries, int count, const char *errorMsg);
+    virtual void delayMs(int milliSeconds);
+    virtual int maxReadLength() { return m_transport->maxReadLength(); }
+
+    int m_users;                                            // RTIMUHal objects that have acquired the bus
+
+private:
+    uint64_t lock();                                        // returns the time the lock was taken
+    void unlock(uint64_t lockTime, int transfers, int bytes, bool result);
+
+    bool m_isI2C;
+    unsigned char m_bus;
+    unsigned char m_select;
+
+    RTIMUI2CTransport *m_I2C;                               // one of these is the actual bus
+    RTIMUSPITransport *m_SPI;
+    RTIMUTransport *m_transport;
+
+    pthread_mutex_t m_lock;
+    RTIMU_BUS_STATS m_stats;                                // protected by m_lock
+    uint64_t m_statsStart;                                  // when the stats were reset
+};
+
+//  RTIMUBusRegistry hands out the shared buses. acquire opens the bus if this is its
+//  first user and returns NULL if it can't be opened. release closes it again when the
+//  last user has gone. Statistics are kept for as long as the process runs.
+
+class RTIMUBusRegistry
+{
+public:
+    static RTIMUSharedBus *acquireI2C(unsigned char bus);
+    static RTIMUSharedBus *acquireSPI(unsigned char bus, unsigned char select, unsigned int speed);
+    static void release(RTIMUSharedBus *bus);
+
+    static bool getStats(bool isI2C, unsigned char bus, unsigned char select, RTIMU_BUS_STATS& stats);
+    static void resetStats();                               // resets the statistics of all buses
+
+private:
+    static RTIMUSharedBus *acquire(bool isI2C, unsigned char bus, unsigned char select, unsigned int speed);
+
+    static RTIMUSharedBus *m_buses[RTIMUBUS_MAX_BUSES];
+    static int m_busCount;
+    static pthread_mutex_t m_lock;
+};
+
+#endif
+
+#endif // _RTIMUBUSREGISTRY_H
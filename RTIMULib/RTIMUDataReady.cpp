@@ -0,0 +1,186 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "RTIMUDataReady.h"
+#include "RTIMUSimTransport.h"
+
+RTIMUDataReady::RTIMUDataReady()
+{
+}
+
+RTIMUDataReady::~RTIMUDataReady()
+{
+}
+
+#if !defined(WIN32) && !defined(__APPLE__)
+
+#include <poll.h>
+#include <errno.h>
+#include <linux/gpio.h>
+
+//----------------------------------------------------------
+//
+//  RTIMUGPIODataReady
+
+RTIMUGPIODataReady::RTIMUGPIODataReady(int chip, int line)
+{
+    m_chip = chip;
+    m_line = line;
+    m_fd = -1;
+}
+
+RTIMUGPIODataReady::~RTIMUGPIODataReady()
+{
+    close();
+}
+
+bool RTIMUGPIODataReady::open(bool activeLow)
+{
+    char buf[32];
+    int chipFd;
+    struct gpioevent_request request;
+
+    close();
+
+    sprintf(buf, "/dev/gpiochip%d", m_chip);
+    if ((chipFd = ::open(buf, O_RDONLY)) < 0) {
+        HAL_ERROR1("Failed to open %s\n", buf);
+        return false;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.lineoffset = m_line;
+    request.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    request.eventflags = activeLow ? GPIOEVENT_REQUEST_FALLING_EDGE : GPIOEVENT_REQUEST_RISING_EDGE;
+    strcpy(request.consumer_label, "RTIMULib");
+
+    if (ioctl(chipFd, GPIO_GET_LINEEVENT_IOCTL, &request) < 0) {
+        HAL_ERROR2("Failed to request data ready events on %s line %d\n", buf, m_line);
+        ::close(chipFd);
+        return false;
+    }
+    ::close(chipFd);
+
+    //  non-blocking so that all queued events can be read without waiting for another
+
+    m_fd = request.fd;
+    fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+void RTIMUGPIODataReady::close()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool RTIMUGPIODataReady::readEvents()
+{
+    struct gpioevent_data event;
+    bool gotEvent = false;
+
+    while (read(m_fd, &event, sizeof(event)) == sizeof(event))
+        gotEvent = true;
+    return gotEvent;
+}
+
+bool RTIMUGPIODataReady::wait(int timeoutMs)
+{
+    struct pollfd pfd;
+    int result;
+
+    if (m_fd < 0)
+        return false;
+
+    if (readEvents())
+        return true;
+
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+
+    do {
+        result = poll(&pfd, 1, timeoutMs);
+    } while ((result < 0) && (errno == EINTR));
+
+    if (result <= 0)
+        return false;
+    return readEvents();
+}
+
+#endif
+
+//----------------------------------------------------------
+//
+//  RTIMUSimDataReady
+
+RTIMUSimDataReady::RTIMUSimDataReady(RTIMUSimTransport *transport, unsigned char slaveAddr)
+{
+    m_transport = transport;
+    m_slaveAddr = slaveAddr;
+    m_sampleCount = 0;
+}
+
+bool RTIMUSimDataReady::open(bool /* activeLow */)
+{
+    RTIMUSimDevice *device = m_transport->findDevice(m_slaveAddr);
+
+    if (device == NULL) {
+        HAL_ERROR1("No simulated device at %d for data ready\n", m_slaveAddr);
+        return false;
+    }
+    m_sampleCount = device->getSampleCount();
+    return true;
+}
+
+void RTIMUSimDataReady::close()
+{
+}
+
+bool RTIMUSimDataReady::wait(int timeoutMs)
+{
+    RTIMUSimDevice *device = m_transport->findDevice(m_slaveAddr);
+    uint64_t now = m_transport->getTime();
+    uint64_t deadline = now + (uint64_t)timeoutMs * 1000;
+    uint64_t next;
+
+    if (device == NULL)
+        return false;
+
+    device->update(now);
+
+    if (device->getSampleCount() == m_sampleCount) {
+        next = device->nextSampleTime();
+        if ((next == 0) || (next > deadline)) {
+            m_transport->advanceTime(deadline - now);
+            return false;
+        }
+        if (next > now)
+            m_transport->advanceTime(next - now);
+        device->update(m_transport->getTime());
+    }
+
+    m_sampleCount = device->getSampleCount();
+    return true;
+}
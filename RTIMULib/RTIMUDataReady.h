@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _RTIMUDATAREADY_H
+#define	_RTIMUDATAREADY_H
+
+#include "RTIMUHal.h"
+
+class RTIMUSimTransport;
+
+//  RTIMUDataReady is a source of data ready events from an IMU's interrupt pin. It is
+//  used through RTIMU::IMUWaitForData() so that consumers wake when a sample arrives
+//  rather than sleeping for the poll interval.
+
+class RTIMUDataReady
+{
+public:
+    RTIMUDataReady();
+    virtual ~RTIMUDataReady();
+
+    //  open() is called with the polarity of the interrupt pin once the IMU has been set up
+
+    virtual bool open(bool activeLow) = 0;
+    virtual void close() = 0;
+
+    //  wait() returns true when there has been a data ready event since the last call and
+    //  false if there is none within timeoutMs. Events that arrive while the caller is
+    //  reading the IMU are remembered for the next call.
+
+    virtual bool wait(int timeoutMs) = 0;
+
+    //  getFd() returns a file descriptor that polls readable when wait() would return
+    //  immediately, or -1 if the source doesn't have one
+
+    virtual int getFd() { return -1; }
+};
+
+#if !defined(WIN32) && !defined(__APPLE__)
+
+//  RTIMUGPIODataReady uses a GPIO line through the Linux gpiochip character device.
+//  Events are edges on the line and are timestamped by the kernel.
+
+class RTIMUGPIODataReady : public RTIMUDataReady
+{
+public:
+    RTIMUGPIODataReady(int chip, int line);
+    virtual ~RTIMUGPIODataReady();
+
+    virtual bool open(bool activeLow);
+    virtual void close();
+    virtual bool wait(int timeoutMs);
+    virtual int getFd() { return m_fd; }
+
+private:
+    bool readEvents();                                      // consume pending events, true if there were any
+
+    int m_chip;                                             // gpiochip number
+    int m_line;                                             // line offset on the chip
+    int m_fd;                                               // line event fd
+};
+
+#endif
+
+//  RTIMUSimDataReady is the data ready line of a device on an RTIMUSimTransport. As
+//  simulated time only moves when the bus is used, wait() advances it to the device's
+//  next sample (or by timeoutMs if that comes first). There is no file descriptor.
+
+class RTIMUSimDataReady : public RTIMUDataReady
+{
+public:
+    RTIMUSimDataReady(RTIMUSimTransport *transport, unsigned char slaveAddr);
+
+    virtual bool open(bool activeLow);
+    virtual void close();
+    virtual bool wait(int timeoutMs);
+
+private:
+    RTIMUSimTransport *m_transport;
+    unsigned char m_slaveAddr;
+    unsigned long m_sampleCount;                            // device sample count at the last event
+};
+
+#endif // _RTIMUDATAREADY_H
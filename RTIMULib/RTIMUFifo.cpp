@@ -0,0 +1,273 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "RTIMUFifo.h"
+
+RTIMUFifo::RTIMUFifo()
+{
+    m_hal = NULL;
+    m_slaveAddr = 0;
+    m_dataReg = 0;
+    m_chunkSize = 0;
+    m_fifoSize = 0;
+    m_cache = NULL;
+    m_capacity = 0;
+    m_index = 0;
+    m_count = 0;
+    m_partialReads = 0;
+    m_dropped = 0;
+    m_tripleCount = 0;
+    m_converted = NULL;
+    m_levelSeen = false;
+    m_levelFirst = 0;
+    m_levelStart = 0;
+    m_levelTime = 0;
+    m_levelLeft = 0;
+    m_levelExpected = 0;
+    m_pollScale = 1;
+}
+
+RTIMUFifo::~RTIMUFifo()
+{
+    delete [] m_cache;
+    delete [] m_converted;
+}
+
+bool RTIMUFifo::setup(RTIMUHal *hal, unsigned char slaveAddr, unsigned char dataReg, int chunkSize, int fifoSize)
+{
+    if ((chunkSize <= 0) || (fifoSize < chunkSize)) {
+        HAL_ERROR2("Invalid FIFO sample size %d for FIFO size %d\n", chunkSize, fifoSize);
+        return false;
+    }
+
+    m_hal = hal;
+    m_slaveAddr = slaveAddr;
+    m_dataReg = dataReg;
+
+    if ((chunkSize != m_chunkSize) || (fifoSize != m_fifoSize)) {
+        delete [] m_cache;
+        m_chunkSize = chunkSize;
+        m_fifoSize = fifoSize;
+        m_capacity = fifoSize / chunkSize;
+        m_cache = new unsigned char[m_capacity * chunkSize];
+        delete [] m_converted;
+        m_converted = new RTFLOAT[3 * RTIMUFIFO_MAX_TRIPLES * m_capacity];
+        m_tripleCount = 0;
+        m_index = 0;
+        m_count = 0;
+    }
+    reset();
+    return true;
+}
+
+void RTIMUFifo::reset()
+{
+    m_dropped += available();
+    m_index = 0;
+    m_count = 0;
+    m_partialReads = 0;
+    m_levelLeft = 0;
+}
+
+bool RTIMUFifo::drain(int byteCount, const char *errorMsg)
+{
+    unsigned char discard[MAX_READ_LEN];
+    unsigned char *data;
+    int partial;
+    int samples;
+    int bytes;
+    int length;
+    int maxLength;
+
+    if (m_cache == NULL)
+        return false;
+
+    if (byteCount >= m_fifoSize) {
+        m_dropped += byteCount / m_chunkSize;
+        return false;
+    }
+
+    partial = byteCount % m_chunkSize;
+    if (partial != 0) {
+        if (++m_partialReads < RTIMUFIFO_RESYNC_READS)
+            return true;
+
+        //  the partial sample is at the head of the FIFO
+
+        if (!m_hal->HALRead(m_slaveAddr, m_dataReg, partial, discard, errorMsg))
+            return false;
+        m_dropped++;
+        byteCount -= partial;
+        HAL_INFO("FIFO out of step, discarded a partial sample\n");
+    }
+    m_partialReads = 0;
+
+    //  move what's left in the cache to the front to make room
+
+    if (m_index > 0) {
+        memmove(m_cache, m_cache + m_index * m_chunkSize, (m_count - m_index) * m_chunkSize);
+        m_count -= m_index;
+        m_index = 0;
+    }
+
+    //  anything that doesn't fit stays in the FIFO for next time
+
+    samples = byteCount / m_chunkSize;
+    if (samples > m_capacity - m_count)
+        samples = m_capacity - m_count;
+
+    maxLength = m_hal->HALMaxReadLength();
+    if (maxLength >= m_chunkSize)
+        maxLength -= maxLength % m_chunkSize;
+
+    data = m_cache + m_count * m_chunkSize;
+    bytes = samples * m_chunkSize;
+
+    while (bytes > 0) {
+        length = bytes < maxLength ? bytes : maxLength;
+        if (!m_hal->HALRead(m_slaveAddr, m_dataReg, length, data, errorMsg))
+            return false;
+        data += length;
+        bytes -= length;
+    }
+    m_count += samples;
+    m_levelLeft = byteCount / m_chunkSize - samples;
+
+    //  the cache was moved up so convert all of it
+
+    if (m_tripleCount > 0)
+        RTMath::convertBatch(m_cache, m_chunkSize, m_count, m_triples, m_tripleCount, m_converted, m_capacity);
+    return true;
+}
+
+unsigned char *RTIMUFifo::next()
+{
+    if (m_index == m_count)
+        return NULL;
+    return m_cache + m_chunkSize * m_index++;
+}
+
+void RTIMUFifo::level(int byteCount, uint64_t readTime)
+{
+    //  the first read after a wait is the one that shows whether it was the right length
+    //  and the last is where the next one starts from, with whatever drain() leaves behind
+
+    if (!m_levelSeen) {
+        m_levelSeen = true;
+        m_levelFirst = m_chunkSize > 0 ? byteCount / m_chunkSize : 0;
+        m_levelStart = readTime;
+    }
+    m_levelTime = readTime;
+    m_levelLeft = m_chunkSize > 0 ? byteCount / m_chunkSize : 0;
+}
+
+uint64_t RTIMUFifo::nextRead(uint64_t sampleInterval, int targetPercent, uint64_t latest)
+{
+    int target;
+    RTFLOAT expected;
+    RTFLOAT wait;
+    RTFLOAT limit;
+
+    if (!m_levelSeen || (targetPercent <= 0) || (sampleInterval == 0) || (m_capacity == 0)) {
+        m_levelExpected = 0;
+        return 0;
+    }
+    m_levelSeen = false;
+
+    //  only a read after a wait from here says anything about how long it should be
+
+    if (m_levelExpected > 0) {
+        if (m_levelFirst >= m_capacity)
+            m_pollScale *= 0.5f;                            // overflowed
+        else if (m_levelFirst == 0)
+            m_pollScale *= 1.25f;                           // nothing there yet
+        else
+            m_pollScale *= sqrtf(m_levelExpected / (RTFLOAT)m_levelFirst);
+
+        if (m_pollScale < 0.5f)
+            m_pollScale = 0.5f;
+        else if (m_pollScale > 2.0f)
+            m_pollScale = 2.0f;
+    }
+
+    if (targetPercent > RTIMUFIFO_POLL_TARGET_MAX)
+        targetPercent = RTIMUFIFO_POLL_TARGET_MAX;
+    target = (m_capacity * targetPercent) / 100;
+    if (target < 1)
+        target = 1;
+
+    target -= m_levelLeft;
+    if (target < 0)
+        target = 0;
+    wait = m_pollScale * (RTFLOAT)target * (RTFLOAT)sampleInterval;
+
+    //  never so long that it would overflow at the nominal rate or the corrected one,
+    //  leaving room for the samples that arrive while it's being read
+
+    limit = (RTFLOAT)(m_capacity - 1 - m_levelLeft) * (RTFLOAT)sampleInterval - (RTFLOAT)(m_levelTime - m_levelStart);
+    if (limit < 0)
+        limit = 0;
+    if (m_pollScale < 1)
+        limit *= m_pollScale;
+    if (wait > limit)
+        wait = limit;
+    if (m_levelTime + (uint64_t)wait > latest)
+        wait = (RTFLOAT)(latest > m_levelTime ? latest - m_levelTime : 0);
+
+    //  what the next read should find if the wait is right
+
+    expected = (RTFLOAT)m_levelLeft + wait / (m_pollScale * (RTFLOAT)sampleInterval);
+    m_levelExpected = expected >= 1 ? expected : 0;
+    return m_levelTime + (uint64_t)wait;
+}
+
+bool RTIMUFifo::setLayout(const RTMATH_RAW_TRIPLE *triples, int tripleCount)
+{
+    if ((tripleCount < 0) || (tripleCount > RTIMUFIFO_MAX_TRIPLES)) {
+        HAL_ERROR1("Invalid FIFO triple count %d\n", tripleCount);
+        return false;
+    }
+
+    for (int t = 0; t < tripleCount; t++) {
+        if ((triples[t].offset < 0) || (triples[t].offset + 6 > m_chunkSize)) {
+            HAL_ERROR2("FIFO triple at offset %d doesn't fit in %d byte samples\n", triples[t].offset, m_chunkSize);
+            return false;
+        }
+        m_triples[t] = triples[t];
+    }
+    m_tripleCount = tripleCount;
+    return true;
+}
+
+RTFLOAT RTIMUFifo::average(int triple, int axis, int count)
+{
+    const RTFLOAT *data = converted(triple, axis);
+    RTFLOAT sum = 0;
+
+    if (count <= 0)
+        return 0;
+
+    for (int i = 0; i < count; i++)
+        sum += data[i];
+    return sum / count;
+}
@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _RTIMUFIFO_H
+#define	_RTIMUFIFO_H
+
+#include "RTIMUHal.h"
+#include "RTMath.h"
+
+#define RTIMUFIFO_RESYNC_READS          3                   // reads with a partial sample before it's taken as out of step
+#define RTIMUFIFO_MAX_TRIPLES           3                   // triples setLayout() can describe
+#define RTIMUFIFO_POLL_TARGET_MAX       75                  // highest percent full nextRead() aims for
+
+//  RTIMUFifo drains a sensor FIFO that is read a byte at a time through a single data
+//  register and holds the samples until the driver has processed them. The driver
+//  reads the FIFO's byte count itself, as every part does that differently, and passes
+//  it to drain(). Whole samples are read in as few transfers as the bus allows, sized
+//  to HALMaxReadLength() and rounded down to whole samples.
+//
+//  A count that isn't a whole number of samples is normally a sample still being
+//  written and the read is left until next time. If it stays that way the oldest
+//  sample in the FIFO is incomplete (after an overrun, for example) and its remains
+//  are discarded to get back in step.
+//
+//  getDropped() counts the samples known to have been lost: those thrown away to
+//  resynchronize, those in a FIFO that overflowed and any still in the cache when
+//  reset() is called.
+//
+//  A driver that calls setLayout() has each batch converted to scaled values as it is
+//  read, in one pass over the cache rather than sample by sample.
+//
+//  A driver that calls level() with every count it reads lets nextRead() work out when
+//  the FIFO will be at a given fill level, so that it can be read when there's enough to
+//  be worth it and long before it overflows. Each wait is scaled by how far the level the
+//  next read found was from the target: down quickly after an overflow, up after a read
+//  that found nothing.
+
+class RTIMUFifo
+{
+public:
+    RTIMUFifo();
+    ~RTIMUFifo();
+
+    //  setup() describes the FIFO. chunkSize is the bytes in one sample and fifoSize the
+    //  FIFO's capacity in bytes, which is also the size of the cache.
+
+    bool setup(RTIMUHal *hal, unsigned char slaveAddr, unsigned char dataReg, int chunkSize, int fifoSize);
+
+    //  reset() empties the cache and should be called whenever the FIFO itself is reset
+
+    void reset();
+
+    //  drain() reads the whole samples in the FIFO into the cache, byteCount being the
+    //  FIFO's count. It returns false if the FIFO needs to be reset, because it has
+    //  overflowed or a read failed.
+
+    bool drain(int byteCount, const char *errorMsg);
+
+    int available() { return m_count - m_index; }           // samples in the cache
+    unsigned char *next();                                  // the oldest sample in the cache, NULL if none
+    unsigned long getDropped() { return m_dropped; }
+
+    //  setLayout() describes the 16 bit triples in each sample (see RTMath::convertBatch())
+    //  and is called after setup() and whenever the scales change. converted() then gives
+    //  one axis of a triple for the available() samples, starting with the one next() will
+    //  return, and average() is the mean of the first count of them.
+
+    bool setLayout(const RTMATH_RAW_TRIPLE *triples, int tripleCount);
+    const RTFLOAT *converted(int triple, int axis) { return m_converted + (3 * triple + axis) * m_capacity + m_index; }
+    RTFLOAT average(int triple, int axis, int count);
+
+    //  level() is called with the FIFO's byte count and the time it was read every time the
+    //  driver reads it, before drain(). nextRead() is then the time to read it again so it
+    //  is about targetPercent full given the sampleInterval in uS, but no later than latest.
+    //  It is 0 if the driver hasn't called level() since the last nextRead() or targetPercent
+    //  is 0.
+
+    void level(int byteCount, uint64_t readTime);
+    uint64_t nextRead(uint64_t sampleInterval, int targetPercent, uint64_t latest);
+
+private:
+    RTIMUHal *m_hal;
+    unsigned char m_slaveAddr;
+    unsigned char m_dataReg;
+    int m_chunkSize;
+    int m_fifoSize;
+
+    unsigned char *m_cache;
+    int m_capacity;                                         // samples the cache holds
+    int m_index;                                            // next sample to hand out
+    int m_count;                                            // samples in the cache
+    int m_partialReads;                                     // consecutive reads that found a partial sample
+    unsigned long m_dropped;
+
+    RTMATH_RAW_TRIPLE m_triples[RTIMUFIFO_MAX_TRIPLES];     // the layout from setLayout()
+    int m_tripleCount;
+    RTFLOAT *m_converted;                                   // the converted cache, axis by axis
+
+    bool m_levelSeen;                                       // level() called since the last nextRead()
+    int m_levelFirst;                                       // the samples the first of those found
+    uint64_t m_levelStart;                                  // when the first of those read it
+    uint64_t m_levelTime;                                   // when the FIFO was last read
+    int m_levelLeft;                                        // the samples left in it then
+    RTFLOAT m_levelExpected;                                // what the first read should find, 0 if not known
+    RTFLOAT m_pollScale;                                    // the correction to the wait
+};
+
+#endif // _RTIMUFIFO_H
@@ -25,126 +25,99 @@
 //  staslock@gmail.com (www.clickdrive.io)
 
 #include "IMUDrivers/RTIMU.h"
-
-#if !defined(WIN32) && !defined(__APPLE__)
-
-#include <linux/spi/spidev.h>
+#include "RTIMUTransport.h"
+#include "RTIMUBusLog.h"
+#include "RTIMUBusRegistry.h"
 
 RTIMUHal::RTIMUHal()
 {
     m_I2CBus = 255;
-    m_currentSlave = 255;
-    m_I2C = -2;
-    m_SPI = -2;
     m_SPISpeed = 500000;
-    m_SPIPrev = 1;
+    m_transport = NULL;
+    m_sharedBus = NULL;
+    m_batchCount = 0;
+    m_recorder = NULL;
 }
 
 RTIMUHal::~RTIMUHal()
 {
+    HALStopRecording();
     HALClose();
 }
 
-bool RTIMUHal::HALOpen()
+void RTIMUHal::setTransport(RTIMUTransport *transport)
 {
-    char buf[32];
-    unsigned char SPIMode = SPI_MODE_0;
-    unsigned char SPIBits = 8;
-    uint32_t SPISpeed = m_SPISpeed;
-
-    if (m_busIsI2C) {
-        if (m_I2C >= 0)
-            return true;
-
-        if (m_I2CBus == 255) {
-            HAL_ERROR("No I2C bus has been set\n");
-            return false;
-        }
-        sprintf(buf, "/dev/i2c-%d", m_I2CBus);
-        m_I2C = open(buf, O_RDWR);
-        if (m_I2C < 0) {
-            if(m_I2C != -1)
-                HAL_ERROR1("Failed to open I2C bus %d\n", m_I2CBus);
-            m_I2C = -1;
-            return false;
-        }
-    } else {
-        if (m_SPIBus == 255) {
-            HAL_ERROR("No SPI bus has been set\n");
-            return false;
-        }
-
-        sprintf(buf, "/dev/spidev%d.%d", m_SPIBus, m_SPISelect);
-        m_SPI = open(buf, O_RDWR);
-        if (m_SPI < 0) {
-            if(m_SPIPrev != -1)
-                HAL_ERROR2("Failed to open SPI bus %d, select %d\n", m_SPIBus, m_SPISelect);
-            m_SPI = -1;
-            m_SPIPrev = -1;
-            return false;
-        }
-
-        if (ioctl(m_SPI, SPI_IOC_WR_MODE, &SPIMode) < 0) {
-            HAL_ERROR1("Failed to set WR SPI_MODE0 on bus %d", m_SPIBus);
-            close(m_SPIBus);
-            return false;
-        }
+    HALClose();
+    m_transport = transport;
+}
 
-        if (ioctl(m_SPI, SPI_IOC_RD_MODE, &SPIMode) < 0) {
-            HAL_ERROR1("Failed to set RD SPI_MODE0 on bus %d", m_SPIBus);
-            close(m_SPIBus);
-            return false;
-        }
+RTIMUTransport *RTIMUHal::busTransport()
+{
+    if (m_transport != NULL)
+        return m_transport;
 
-        if (ioctl(m_SPI, SPI_IOC_WR_BITS_PER_WORD, &SPIBits) < 0) {
-            HAL_ERROR1("Failed to set WR 8 bit mode on bus %d", m_SPIBus);
-            close(m_SPIBus);
-            return false;
-        }
+#if !defined(WIN32) && !defined(__APPLE__)
+    if ((m_sharedBus != NULL) && m_sharedBus->matches(m_busIsI2C, m_busIsI2C ? m_I2CBus : m_SPIBus, m_SPISelect))
+        return m_sharedBus;
 
-        if (ioctl(m_SPI, SPI_IOC_RD_BITS_PER_WORD, &SPIBits) < 0) {
-            HAL_ERROR1("Failed to set RD 8 bit mode on bus %d", m_SPIBus);
-            close(m_SPIBus);
-            return false;
-        }
+    //  the bus settings have changed or the bus has not been acquired yet
 
-        if (ioctl(m_SPI, SPI_IOC_WR_MAX_SPEED_HZ, &SPISpeed) < 0) {
-             HAL_ERROR2("Failed to set WR %dHz on bus %d", SPISpeed, m_SPIBus);
-             close(m_SPIBus);
-             return false;
-        }
+    HALClose();
+    if (m_busIsI2C)
+        m_sharedBus = RTIMUBusRegistry::acquireI2C(m_I2CBus);
+    else
+        m_sharedBus = RTIMUBusRegistry::acquireSPI(m_SPIBus, m_SPISelect, m_SPISpeed);
+    return m_sharedBus;
+#else
+    //  no bus support so everything is a dummy unless a transport is installed
+    return NULL;
+#endif
+}
 
-        if (ioctl(m_SPI, SPI_IOC_RD_MAX_SPEED_HZ, &SPISpeed) < 0) {
-             HAL_ERROR2("Failed to set RD %dHz on bus %d", SPISpeed, m_SPIBus);
-             close(m_SPIBus);
-             return false;
-        }
-        m_SPIPrev = 1;
-    }
+bool RTIMUHal::noTransport(const char *errorMsg)
+{
+#if !defined(WIN32) && !defined(__APPLE__)
+    HAL_ERROR1("Failed to open bus - %s\n", errorMsg);
+    return false;
+#else
     return true;
+#endif
 }
 
-void RTIMUHal::HALClose()
+bool RTIMUHal::HALOpen()
 {
-    I2CClose();
-    SPIClose();
+    if (m_transport != NULL)
+        return m_transport->open();
+
+#if !defined(WIN32) && !defined(__APPLE__)
+    return busTransport() != NULL;
+#else
+    return true;
+#endif
 }
 
-void RTIMUHal::I2CClose()
+void RTIMUHal::HALClose()
 {
-    if (m_I2C >= 0) {
-        close(m_I2C);
-        m_I2C = -1;
-        m_currentSlave = 255;
+    if (m_transport != NULL)
+        m_transport->close();
+#if !defined(WIN32) && !defined(__APPLE__)
+    if (m_sharedBus != NULL) {
+        RTIMUBusRegistry::release(m_sharedBus);
+        m_sharedBus = NULL;
     }
+#endif
 }
 
-void RTIMUHal::SPIClose()
+bool RTIMUHal::HALGetBusStats(RTIMU_BUS_STATS& stats)
 {
-    if (m_SPI >= 0) {
-        close(m_SPI);
-        m_SPI = -1;
+#if !defined(WIN32) && !defined(__APPLE__)
+    if ((m_transport == NULL) && (m_sharedBus != NULL)) {
+        m_sharedBus->getStats(stats);
+        return true;
     }
+#endif
+    memset(&stats, 0, sizeof(stats));
+    return false;
 }
 
 bool RTIMUHal::HALWrite(unsigned char slaveAddr, unsigned char regAddr,
@@ -156,257 +129,188 @@ bool RTIMUHal::HALWrite(unsigned char slaveAddr, unsigned char regAddr,
 bool RTIMUHal::HALWrite(unsigned char slaveAddr, unsigned char regAddr,
                    unsigned char length, unsigned char const *data, const char *errorMsg)
 {
-    int result;
-    unsigned char txBuff[MAX_WRITE_LEN + 1];
-    char *ifType;
-
-    if (m_busIsI2C) {
-        if (!I2CSelectSlave(slaveAddr, errorMsg))
-            return false;
-        ifType = (char *)"I2C";
-    } else {
-        ifType = (char *)"SPI";
-    }
-
-    if (length == 0) {
-        result = ifWrite(&regAddr, 1);
-
-        if (result < 0) {
-            if (strlen(errorMsg) > 0)
-                HAL_ERROR2("%s write of regAddr failed - %s\n", ifType, errorMsg);
-            return false;
-        } else if (result != 1) {
-            if (strlen(errorMsg) > 0)
-                HAL_ERROR2("%s write of regAddr failed (nothing written) - %s\n", ifType, errorMsg);
-            return false;
-        }
-    } else {
-        txBuff[0] = regAddr;
-        memcpy(txBuff + 1, data, length);
-
-        result = ifWrite(txBuff, length + 1);
-
-        if (result < 0) {
-            if (strlen(errorMsg) > 0)
-                HAL_ERROR3("%s data write of %d bytes failed - %s\n", ifType, length, errorMsg);
-            return false;
-        } else if (result < (int)length) {
-            if (strlen(errorMsg) > 0)
-                HAL_ERROR4("%s data write of %d bytes failed, only %d written - %s\n", ifType, length, result, errorMsg);
-            return false;
-        }
-    }
-    return true;
-}
-
-bool RTIMUHal::ifWrite(unsigned char *data, unsigned char length)
-{
-    struct spi_ioc_transfer wrIOC;
-
-    if (m_busIsI2C) {
-        return write(m_I2C, data, length);
-    } else {
-        memset(&wrIOC, 0, sizeof(wrIOC));
-        wrIOC.tx_buf = (unsigned long) data;
-        wrIOC.rx_buf = 0;
-        wrIOC.len = length;
-        return ioctl(m_SPI, SPI_IOC_MESSAGE(1), &wrIOC);
-    }
+    RTIMUTransport *transport = busTransport();
+    bool result;
+
+    if (transport != NULL)
+        result = transport->write(slaveAddr, regAddr, length, data, errorMsg);
+    else
+        result = noTransport(errorMsg);
+    if (m_recorder != NULL)
+        m_recorder->record(RTIMULOG_WRITE | (result ? 0 : RTIMULOG_FAILED), slaveAddr, regAddr, length, data);
+    return result;
 }
 
-
 bool RTIMUHal::HALRead(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
                     unsigned char *data, const char *errorMsg)
 {
-    int tries, result, total;
-    unsigned char rxBuff[MAX_READ_LEN + 1];
-    struct spi_ioc_transfer rdIOC;
-
-    if (m_busIsI2C) {
-        if (!HALWrite(slaveAddr, regAddr, 0, NULL, errorMsg))
-            return false;
-
-        total = 0;
-        tries = 0;
-
-        while ((total < length) && (tries < 5)) {
-            result = read(m_I2C, data + total, length - total);
-
-            if (result < 0) {
-                if (strlen(errorMsg) > 0)
-                    HAL_ERROR3("I2C read error from %d, %d - %s\n", slaveAddr, regAddr, errorMsg);
-                return false;
-            }
-
-            total += result;
-
-            if (total == length)
-                break;
-
-            delayMs(1);
-            tries++;
-        }
-
-        if (total < length) {
-            if (strlen(errorMsg) > 0)
-                HAL_ERROR3("I2C read from %d, %d failed - %s\n", slaveAddr, regAddr, errorMsg);
-            return false;
-        }
-    } else {
-        rxBuff[0] = regAddr | 0x80;
-        memcpy(rxBuff + 1, data, length);
-        memset(&rdIOC, 0, sizeof(rdIOC));
-        rdIOC.tx_buf = (unsigned long) rxBuff;
-        rdIOC.rx_buf = (unsigned long) rxBuff;
-        rdIOC.len = length + 1;
-
-        if (ioctl(m_SPI, SPI_IOC_MESSAGE(1), &rdIOC) < 0) {
-            if (strlen(errorMsg) > 0)
-                HAL_ERROR2("SPI read error from %d - %s\n", regAddr, errorMsg);
-            return false;
-        }
-        memcpy(data, rxBuff + 1, length);
-    }
-    return true;
+    RTIMUTransport *transport = busTransport();
+    bool result;
+
+    if (transport != NULL)
+        result = transport->read(slaveAddr, regAddr, length, data, errorMsg);
+    else
+        result = noTransport(errorMsg);
+    if (m_recorder != NULL)
+        m_recorder->record(RTIMULOG_READ | (result ? 0 : RTIMULOG_FAILED), slaveAddr, regAddr, length, data);
+    return result;
 }
 
 bool RTIMUHal::HALRead(unsigned char slaveAddr, unsigned char length,
                     unsigned char *data, const char *errorMsg)
 {
-    int tries, result, total;
-    unsigned char rxBuff[MAX_READ_LEN + 1];
-    struct spi_ioc_transfer rdIOC;
-
-    if (m_busIsI2C) {
-        if (!I2CSelectSlave(slaveAddr, errorMsg))
-            return false;
-
-        total = 0;
-        tries = 0;
-
-        while ((total < length) && (tries < 5)) {
-            result = read(m_I2C, data + total, length - total);
-
-            if (result < 0) {
-                if (strlen(errorMsg) > 0)
-                    HAL_ERROR2("I2C read error from %d - %s\n", slaveAddr, errorMsg);
-                return false;
-            }
-
-            total += result;
-
-            if (total == length)
-                break;
-
-            delayMs(1);
-            tries++;
-        }
-
-        if (total < length) {
-            if (strlen(errorMsg) > 0)
-                HAL_ERROR2("I2C read from %d failed - %s\n", slaveAddr, errorMsg);
-            return false;
-        }
-    } else {
-        memset(&rdIOC, 0, sizeof(rdIOC));
-        rdIOC.tx_buf = 0;
-        rdIOC.rx_buf = (unsigned long) rxBuff;
-        rdIOC.len = length;
-
-        if (ioctl(m_SPI, SPI_IOC_MESSAGE(1), &rdIOC) < 0) {
-            if (strlen(errorMsg) > 0)
-                HAL_ERROR1("SPI read error from - %s\n", errorMsg);
-            return false;
-        }
-        memcpy(data, rxBuff, length);
-    }
-    return true;
+    RTIMUTransport *transport = busTransport();
+    bool result;
+
+    if (transport != NULL)
+        result = transport->read(slaveAddr, length, data, errorMsg);
+    else
+        result = noTransport(errorMsg);
+    if (m_recorder != NULL)
+        m_recorder->record(RTIMULOG_READ_NOREG | (result ? 0 : RTIMULOG_FAILED), slaveAddr, 0, length, data);
+    return result;
 }
 
 
-bool RTIMUHal::I2CSelectSlave(unsigned char slaveAddr, const char *errorMsg)
+void RTIMUHal::HALBatchBegin()
 {
-    if (m_currentSlave == slaveAddr)
-        return true;
+    m_batchCount = 0;
+}
 
-    if (!HALOpen()) {
-        HAL_ERROR1("Failed to open I2C port - %s\n", errorMsg);
-        return false;
-    }
+bool RTIMUHal::HALBatchRead(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                    unsigned char *data)
+{
+    HAL_BATCH_ENTRY *entry;
 
-    if (ioctl(m_I2C, I2C_SLAVE, slaveAddr) < 0) {
-        HAL_ERROR2("I2C slave select %d failed - %s\n", slaveAddr, errorMsg);
+    if (m_batchCount == MAX_BATCH_LEN) {
+        HAL_ERROR("Batch transfer queue is full\n");
         return false;
     }
 
-    m_currentSlave = slaveAddr;
-
+    entry = m_batch + m_batchCount++;
+    entry->read = true;
+    entry->slaveAddr = slaveAddr;
+    entry->regAddr = regAddr;
+    entry->regByte = regAddr | 0x80;
+    entry->length = length;
+    entry->rxData = data;
+    entry->txData = NULL;
     return true;
 }
 
-void RTIMUHal::delayMs(int milliSeconds)
+bool RTIMUHal::HALBatchWrite(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                    unsigned char const *data)
 {
-    usleep(1000 * milliSeconds);
-}
+    HAL_BATCH_ENTRY *entry;
 
-#else
-//  just dummy routines for Windows
+    if (m_batchCount == MAX_BATCH_LEN) {
+        HAL_ERROR("Batch transfer queue is full\n");
+        return false;
+    }
 
-RTIMUHal::RTIMUHal()
-{
+    entry = m_batch + m_batchCount++;
+    entry->read = false;
+    entry->slaveAddr = slaveAddr;
+    entry->regAddr = regAddr;
+    entry->regByte = regAddr;
+    entry->length = length;
+    entry->rxData = NULL;
+    entry->txData = data;
+    return true;
 }
 
-RTIMUHal::~RTIMUHal()
+bool RTIMUHal::HALBatchSubmit(const char *errorMsg)
 {
-}
+    RTIMUTransport *transport = busTransport();
+    int count = m_batchCount;
+    HAL_BATCH_ENTRY *entry;
+    unsigned char failed;
+    bool result;
 
+    m_batchCount = 0;
 
-bool RTIMUHal::HALOpen()
-{
-    return true;
+    if (count == 0)
+        return true;
+    if (transport != NULL)
+        result = transport->batch(m_batch, count, errorMsg);
+    else
+        result = noTransport(errorMsg);
+
+    //  entries are logged as single transfers so that replay does not depend on batching
+
+    if (m_recorder != NULL) {
+        failed = result ? 0 : RTIMULOG_FAILED;
+        for (int i = 0; i < count; i++) {
+            entry = m_batch + i;
+            if (entry->read)
+                m_recorder->record(RTIMULOG_READ | failed, entry->slaveAddr, entry->regAddr, entry->length, entry->rxData);
+            else
+                m_recorder->record(RTIMULOG_WRITE | failed, entry->slaveAddr, entry->regAddr, entry->length, entry->txData);
+        }
+    }
+    return result;
 }
 
-void RTIMUHal::HALClose()
+void RTIMUHal::delayMs(int milliSeconds)
 {
+    if (m_transport != NULL)
+        m_transport->delayMs(milliSeconds);
+#if !defined(WIN32)
+    else
+        usleep(1000 * milliSeconds);
+#endif
 }
 
-void RTIMUHal::I2CClose()
+void RTIMUHal::delayUntil(uint64_t uSecs)
 {
+    if (m_transport != NULL)
+        m_transport->delayUntil(uSecs);
+    else
+        RTMath::sleepUntilUSecsMonotonic(uSecs);
 }
 
-bool RTIMUHal::HALWrite(unsigned char , unsigned char ,
-                   unsigned char const , const char *)
+uint64_t RTIMUHal::HALTimestamp()
 {
-    return true;
+    uint64_t timestamp;
+
+    if (m_transport != NULL)
+        timestamp = m_transport->currentUSecs();
+    else
+        timestamp = RTMath::currentUSecsMonotonic();
+    if (m_recorder != NULL)
+        m_recorder->recordTime(timestamp);
+    return timestamp;
 }
 
-bool RTIMUHal::HALWrite(unsigned char , unsigned char ,
-                   unsigned char , unsigned char const *, const char *)
+int RTIMUHal::HALMaxReadLength()
 {
-    return true;
-}
+    RTIMUTransport *transport = busTransport();
+    int length;
 
-
-bool RTIMUHal::HALRead(unsigned char , unsigned char , unsigned char ,
-                    unsigned char *, const char *)
-{
-    return true;
+    if (transport == NULL)
+        return MAX_READ_LEN;
+    length = transport->maxReadLength();
+    return length < MAX_READ_LEN ? length : MAX_READ_LEN;
 }
 
-bool RTIMUHal::HALRead(unsigned char slaveAddr, unsigned char length,
-                    unsigned char *data, const char *errorMsg)
+bool RTIMUHal::HALStartRecording(const char *fileName, int bufferSize)
 {
-    return true;
-}
-
+    if (m_recorder == NULL)
+        m_recorder = new RTIMUBusRecorder();
 
-bool RTIMUHal::I2CSelectSlave(unsigned char , const char *)
-{
+    if (!m_recorder->start(fileName, bufferSize > 0 ? bufferSize : RTIMULOG_DEFAULT_BUFFER)) {
+        delete m_recorder;
+        m_recorder = NULL;
+        return false;
+    }
     return true;
 }
 
-void RTIMUHal::delayMs(int milliSeconds)
+void RTIMUHal::HALStopRecording()
 {
+    if (m_recorder != NULL) {
+        m_recorder->stop();
+        delete m_recorder;
+        m_recorder = NULL;
+    }
 }
-#endif
-
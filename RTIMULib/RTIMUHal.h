@@ -65,6 +65,7 @@
 
 #if !defined(WIN32) && !defined(__APPLE__)
 #include <sys/ioctl.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #endif
 
@@ -75,6 +76,39 @@
 
 #define MAX_WRITE_LEN                   255
 #define MAX_READ_LEN                    255
+#define MAX_BATCH_LEN                   20                  // max register transfers in one batch (I2C_RDWR allows 42 messages)
+
+//  One queued register transfer in a batch
+
+typedef struct
+{
+    bool read;                                              // true for a read, false for a write
+    unsigned char slaveAddr;                                // I2C slave address (ignored on SPI)
+    unsigned char regAddr;                                  // the register address
+    unsigned char regByte;                                  // register byte as sent on the bus
+    unsigned char length;                                   // number of data bytes
+    unsigned char *rxData;                                  // caller's buffer for reads
+    unsigned char const *txData;                            // caller's buffer for writes
+} HAL_BATCH_ENTRY;
+
+//  Statistics for a shared bus, see RTIMUHal::HALGetBusStats()
+
+typedef struct
+{
+    uint64_t transfers;                                     // register reads and writes
+    uint64_t bytes;                                         // data bytes transferred
+    uint64_t errors;                                        // failed transfers
+    uint64_t busyTime;                                      // uS the bus was held for transfers
+    uint64_t waitTime;                                      // uS spent waiting for another user of the bus
+    uint64_t elapsedTime;                                   // uS since the statistics were reset
+    unsigned long slaveSelects;                             // I2C_SLAVE ioctls issued
+    int users;                                              // RTIMUHal objects using the bus
+    float utilization;                                      // busyTime / elapsedTime
+} RTIMU_BUS_STATS;
+
+class RTIMUTransport;
+class RTIMUSharedBus;
+class RTIMUBusRecorder;
 
 class RTIMUHal
 {
@@ -88,8 +122,21 @@ public:
     unsigned char m_SPISelect;                              // SPI select line - defaults to CE0
     unsigned int m_SPISpeed;                                // speed of interface
 
+    //  setTransport() replaces the Linux I2C/SPI transports with another one, for example
+    //  an RTIMUSimTransport. The caller keeps ownership and the transport must stay valid
+    //  until it is removed again with setTransport(NULL) or this object is destroyed.
+
+    void setTransport(RTIMUTransport *transport);
+    RTIMUTransport *getTransport() { return m_transport; }
+
+    //  Unless a transport is installed, each I2C bus and SPI chip select is shared by all
+    //  RTIMUHal objects in the process (see RTIMUBusRegistry). HALOpen() acquires the bus
+    //  for the current settings and HALClose() releases it. HALGetBusStats() returns the
+    //  statistics of the bus this object is using and returns false if there isn't one.
+
     bool HALOpen();
     void HALClose();
+    bool HALGetBusStats(RTIMU_BUS_STATS& stats);
     bool HALRead(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
                  unsigned char *data, const char *errorMsg);    // normal read with register select
     bool HALRead(unsigned char slaveAddr, unsigned char length,
@@ -99,19 +146,53 @@ public:
     bool HALWrite(unsigned char slaveAddr, unsigned char regAddr,
                   unsigned char const data, const char *errorMsg);
 
+    //  Batched transfers. Up to MAX_BATCH_LEN register reads and writes can be queued
+    //  with HALBatchRead() and HALBatchWrite() and are then issued by HALBatchSubmit().
+    //  On SPI the whole batch is a single SPI_IOC_MESSAGE with chip select released
+    //  between entries. On I2C the batch is a single I2C_RDWR transaction if the
+    //  adapter supports it, otherwise entries are performed one at a time.
+    //  Data goes directly to and from the caller's buffers which must remain valid
+    //  until HALBatchSubmit() returns.
+
+    void HALBatchBegin();
+    bool HALBatchRead(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                 unsigned char *data);
+    bool HALBatchWrite(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                 unsigned char const *data);
+    bool HALBatchSubmit(const char *errorMsg);
+
     void delayMs(int milliSeconds);
+    void delayUntil(uint64_t uSecs);                        // until HALTimestamp() reaches uSecs
+
+    //  HALTimestamp() is the current time in uS from the transport. Drivers use it for
+    //  sample timestamps so that simulated and replayed runs keep the bus's time.
+
+    uint64_t HALTimestamp();
+
+    //  HALMaxReadLength() is the longest read the bus can do in one transfer, at most MAX_READ_LEN
+
+    int HALMaxReadLength();
+
+    //  HALStartRecording() logs every transfer and timestamp to fileName until
+    //  HALStopRecording() is called. The log can be played back with RTIMUReplayTransport.
+    //  bufferSize is the size of the recorder's buffer in bytes, 0 for the default.
+
+    bool HALStartRecording(const char *fileName, int bufferSize = 0);
+    void HALStopRecording();
 
 protected:
-    void I2CClose();
-    bool I2CSelectSlave(unsigned char slaveAddr, const char *errorMsg);
-    void SPIClose();
-    bool ifWrite(unsigned char *data, unsigned char length);
+    RTIMUTransport *busTransport();                         // the transport for the current bus settings
 
 private:
-    int m_I2C;
-    unsigned char m_currentSlave;
-    int m_SPI;
-    int m_SPIPrev;
+    bool noTransport(const char *errorMsg);                 // result of a transfer when the bus can't be opened
+
+    RTIMUTransport *m_transport;                            // installed transport or NULL to use the shared buses
+    RTIMUSharedBus *m_sharedBus;                            // the shared bus acquired or NULL
+
+    HAL_BATCH_ENTRY m_batch[MAX_BATCH_LEN];                 // the queued batch transfers
+    int m_batchCount;                                       // number of entries in m_batch
+
+    RTIMUBusRecorder *m_recorder;                           // NULL if not recording
 };
 
 #endif // _RTIMUHAL_H
@@ -32,6 +32,14 @@
 #include "RTFusion.h"
 
 #include "RTIMUHal.h"
+#include "RTIMUSimTransport.h"
+#include "RTIMUBusLog.h"
+#include "RTIMUBusRegistry.h"
+#include "RTIMUDataReady.h"
+#include "RTIMUFifo.h"
+#include "RTIMURing.h"
+#include "RTIMURegInit.h"
+#include "RTIMUTimestamp.h"
 #include "IMUDrivers/RTIMU.h"
 #include "IMUDrivers/RTIMUNull.h"
 #include "IMUDrivers/RTIMUMPU9150.h"
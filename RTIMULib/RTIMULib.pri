@@ -28,6 +28,15 @@ HEADERS += $$PWD/RTIMULib.h \
     $$PWD/RTIMULibDefs.h \
     $$PWD/RTMath.h \
     $$PWD/RTIMUHal.h \
+    $$PWD/RTIMUTransport.h \
+    $$PWD/RTIMUSimTransport.h \
+    $$PWD/RTIMUBusLog.h \
+    $$PWD/RTIMUBusRegistry.h \
+    $$PWD/RTIMUDataReady.h \
+    $$PWD/RTIMUFifo.h \
+    $$PWD/RTIMURing.h \
+    $$PWD/RTIMURegInit.h \
+    $$PWD/RTIMUTimestamp.h \
     $$PWD/RTFusion.h \
     $$PWD/RTFusionKalman4.h \
     $$PWD/RTFusionRTQF.h \
@@ -60,6 +69,15 @@ HEADERS += $$PWD/RTIMULib.h \
 
 SOURCES += $$PWD/RTMath.cpp \
     $$PWD/RTIMUHal.cpp \
+    $$PWD/RTIMUTransport.cpp \
+    $$PWD/RTIMUSimTransport.cpp \
+    $$PWD/RTIMUBusLog.cpp \
+    $$PWD/RTIMUBusRegistry.cpp \
+    $$PWD/RTIMUDataReady.cpp \
+    $$PWD/RTIMUFifo.cpp \
+    $$PWD/RTIMURing.cpp \
+    $$PWD/RTIMURegInit.cpp \
+    $$PWD/RTIMUTimestamp.cpp \
     $$PWD/RTFusion.cpp \
     $$PWD/RTFusionKalman4.cpp \
     $$PWD/RTFusionRTQF.cpp \
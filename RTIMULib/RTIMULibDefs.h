@@ -40,27 +40,71 @@
 
 #define RTFUSION_TYPE_COUNT                 5                   // number of fusion algorithm types
 
-//  This is a convenience structure that can be used to pass IMU data around
+//  these are the scheduling options for the acquisition thread
+
+#define RTIMU_ACQUISITION_NORMAL            0                   // the default scheduling
+#define RTIMU_ACQUISITION_FIFO              1                   // SCHED_FIFO
+#define RTIMU_ACQUISITION_DEADLINE          2                   // SCHED_DEADLINE
+
+//  This is a convenience structure that can be used to pass IMU data around.
+//
+//  The members are ordered largest first so that there is no padding between them. The
+//  validity flags are plain bools kept together at the end. validMask() packs them into
+//  the RTIMU_DATA_*_VALID bits of one byte so that they can be tested together and
+//  setValidMask() sets them all from one.
+
+#define RTIMU_DATA_FUSIONPOSE_VALID         0x01
+#define RTIMU_DATA_FUSIONQPOSE_VALID        0x02
+#define RTIMU_DATA_GYRO_VALID               0x04
+#define RTIMU_DATA_ACCEL_VALID              0x08
+#define RTIMU_DATA_COMPASS_VALID            0x10
+#define RTIMU_DATA_PRESSURE_VALID           0x20
+#define RTIMU_DATA_TEMPERATURE_VALID        0x40
+#define RTIMU_DATA_HUMIDITY_VALID           0x80
 
 typedef struct
 {
+    RTQuaternion fusionQPose;
     uint64_t timestamp;
-    bool fusionPoseValid;
     RTVector3 fusionPose;
+    RTVector3 gyro;
+    RTVector3 accel;
+    RTVector3 compass;
+    RTFLOAT pressure;
+    RTFLOAT temperature;
+    RTFLOAT humidity;
+    bool fusionPoseValid;
     bool fusionQPoseValid;
-    RTQuaternion fusionQPose;
     bool gyroValid;
-    RTVector3 gyro;
     bool accelValid;
-    RTVector3 accel;
     bool compassValid;
-    RTVector3 compass;
     bool pressureValid;
-    RTFLOAT pressure;
     bool temperatureValid;
-    RTFLOAT temperature;
     bool humidityValid;
-    RTFLOAT humidity;
+
+    uint8_t validMask() const
+    {
+        return (fusionPoseValid ? RTIMU_DATA_FUSIONPOSE_VALID : 0) |
+               (fusionQPoseValid ? RTIMU_DATA_FUSIONQPOSE_VALID : 0) |
+               (gyroValid ? RTIMU_DATA_GYRO_VALID : 0) |
+               (accelValid ? RTIMU_DATA_ACCEL_VALID : 0) |
+               (compassValid ? RTIMU_DATA_COMPASS_VALID : 0) |
+               (pressureValid ? RTIMU_DATA_PRESSURE_VALID : 0) |
+               (temperatureValid ? RTIMU_DATA_TEMPERATURE_VALID : 0) |
+               (humidityValid ? RTIMU_DATA_HUMIDITY_VALID : 0);
+    }
+
+    void setValidMask(uint8_t mask)
+    {
+        fusionPoseValid = (mask & RTIMU_DATA_FUSIONPOSE_VALID) != 0;
+        fusionQPoseValid = (mask & RTIMU_DATA_FUSIONQPOSE_VALID) != 0;
+        gyroValid = (mask & RTIMU_DATA_GYRO_VALID) != 0;
+        accelValid = (mask & RTIMU_DATA_ACCEL_VALID) != 0;
+        compassValid = (mask & RTIMU_DATA_COMPASS_VALID) != 0;
+        pressureValid = (mask & RTIMU_DATA_PRESSURE_VALID) != 0;
+        temperatureValid = (mask & RTIMU_DATA_TEMPERATURE_VALID) != 0;
+        humidityValid = (mask & RTIMU_DATA_HUMIDITY_VALID) != 0;
+    }
 } RTIMU_DATA;
 
 #endif // _RTIMULIBDEFS_H
@@ -0,0 +1,282 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "RTIMURegInit.h"
+
+RTIMURegInit::RTIMURegInit()
+{
+    for (int i = 0; i < RTIMUREGINIT_MAX_SLAVES; i++) {
+        m_slaveAddr[i] = 0;
+        m_burst[i] = false;
+        m_burstFlag[i] = 0;
+        m_readyTime[i] = 0;
+    }
+    for (int i = 0; i < RTIMUREGINIT_MAX_VALUES; i++) {
+        m_values[i] = 0;
+        m_active[i] = 0;
+        m_activeValid[i] = false;
+    }
+    m_batchCount = 0;
+    m_dataCount = 0;
+    m_batchError = "";
+}
+
+void RTIMURegInit::setSlave(int index, unsigned char slaveAddr, bool burst, unsigned char burstFlag)
+{
+    if ((index < 0) || (index >= RTIMUREGINIT_MAX_SLAVES)) {
+        HAL_ERROR1("Invalid init sequence slave index %d\n", index);
+        return;
+    }
+    m_slaveAddr[index] = slaveAddr;
+    m_burst[index] = burst;
+    m_burstFlag[index] = burstFlag;
+    m_readyTime[index] = 0;
+}
+
+void RTIMURegInit::setValue(int index, unsigned char value)
+{
+    if ((index < 0) || (index >= RTIMUREGINIT_MAX_VALUES)) {
+        HAL_ERROR1("Invalid init sequence value index %d\n", index);
+        return;
+    }
+    m_values[index] = value;
+}
+
+bool RTIMURegInit::run(RTIMUHal *hal, const RTIMU_REG_INIT *steps, int count)
+{
+    const RTIMU_REG_INIT *step;
+    unsigned char value;
+    unsigned char data;
+
+    m_batchCount = 0;
+    m_dataCount = 0;
+
+    for (int i = 0; i < RTIMUREGINIT_MAX_VALUES; i++)
+        m_activeValid[i] = false;
+
+    for (int i = 0; i < count; i++) {
+        step = steps + i;
+
+        if (step->slave >= RTIMUREGINIT_MAX_SLAVES) {
+            HAL_ERROR1("Invalid init sequence slave index %d\n", step->slave);
+            return false;
+        }
+
+        switch (step->op) {
+        case RTIMUREGINIT_WRITE:
+        case RTIMUREGINIT_WRITE_VALUE:
+            if (step->op == RTIMUREGINIT_WRITE) {
+                value = step->value;
+            } else {
+                if (step->value >= RTIMUREGINIT_MAX_VALUES) {
+                    HAL_ERROR1("Invalid init sequence value index %d\n", step->value);
+                    return false;
+                }
+                value = m_values[step->value];
+            }
+
+            if (!queueWrite(hal, step, value))
+                return false;
+            break;
+
+        case RTIMUREGINIT_VERIFY:
+            if (!flush(hal))
+                return false;
+            waitReady(hal, step->slave);
+
+            if (!hal->HALRead(m_slaveAddr[step->slave], step->regAddr, 1, &data, step->errorMsg))
+                return false;
+
+            if ((data & step->mask) != step->value) {
+                HAL_ERROR2("%s - read 0x%02x\n", step->errorMsg, data);
+                return false;
+            }
+            break;
+
+        case RTIMUREGINIT_SETTLE:
+            //  the time starts when the writes before it have been done
+
+            if (!flush(hal))
+                return false;
+            m_readyTime[step->slave] = hal->HALTimestamp() + (uint64_t)step->value * 1000;
+            break;
+
+        default:
+            HAL_ERROR1("Invalid init sequence op %d\n", step->op);
+            return false;
+        }
+    }
+
+    if (!flush(hal))
+        return false;
+
+    for (int i = 0; i < RTIMUREGINIT_MAX_SLAVES; i++)
+        waitReady(hal, i);
+
+    for (int i = 0; i < count; i++) {
+        if (steps[i].op == RTIMUREGINIT_WRITE_VALUE) {
+            m_active[steps[i].value] = m_values[steps[i].value];
+            m_activeValid[steps[i].value] = true;
+        }
+    }
+    return true;
+}
+
+bool RTIMURegInit::update(RTIMUHal *hal, const RTIMU_REG_INIT *steps, int count, int& written)
+{
+    const RTIMU_REG_INIT *step;
+    bool changed[RTIMUREGINIT_MAX_VALUES];
+
+    written = 0;
+    m_batchCount = 0;
+    m_dataCount = 0;
+
+    for (int i = 0; i < RTIMUREGINIT_MAX_VALUES; i++)
+        changed[i] = !m_activeValid[i] || (m_active[i] != m_values[i]);
+
+    for (int i = 0; i < count; i++) {
+        step = steps + i;
+        if (step->op != RTIMUREGINIT_WRITE_VALUE)
+            continue;
+
+        if ((step->slave >= RTIMUREGINIT_MAX_SLAVES) || (step->value >= RTIMUREGINIT_MAX_VALUES)) {
+            HAL_ERROR2("Invalid init sequence slave %d or value index %d\n", step->slave, step->value);
+            return false;
+        }
+        if (!changed[step->value])
+            continue;
+
+        if (!queueWrite(hal, step, m_values[step->value]))
+            return false;
+        written++;
+    }
+
+    if (!flush(hal)) {
+        //  don't know what the chip has now so write everything next time
+
+        for (int i = 0; i < RTIMUREGINIT_MAX_VALUES; i++)
+            m_activeValid[i] = false;
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (steps[i].op == RTIMUREGINIT_WRITE_VALUE) {
+            m_active[steps[i].value] = m_values[steps[i].value];
+            m_activeValid[steps[i].value] = true;
+        }
+    }
+    return true;
+}
+
+void RTIMURegInit::discard()
+{
+    for (int i = 0; i < RTIMUREGINIT_MAX_VALUES; i++) {
+        if (m_activeValid[i])
+            m_values[i] = m_active[i];
+    }
+}
+
+bool RTIMURegInit::choose(const RTIMU_REG_CHOICE *choices, int count, int code, const char *name,
+                          unsigned char& bits, RTFLOAT *scale)
+{
+    for (int i = 0; i < count; i++) {
+        if (choices[i].code == code) {
+            bits = choices[i].bits;
+            if (scale != NULL)
+                *scale = choices[i].scale;
+            return true;
+        }
+    }
+    HAL_ERROR2("Illegal %s %d\n", name, code);
+    return false;
+}
+
+bool RTIMURegInit::queueWrite(RTIMUHal *hal, const RTIMU_REG_INIT *step, unsigned char value)
+{
+    int last;
+
+    //  a slave that's settling has to be left until its time is up
+
+    if (m_readyTime[step->slave] > hal->HALTimestamp()) {
+        if (!flush(hal))
+            return false;
+        waitReady(hal, step->slave);
+    }
+
+    //  add to the last write if this is the next register along
+
+    last = m_batchCount - 1;
+    if ((last >= 0) && m_burst[step->slave] && (m_batchSlave[last] == step->slave) &&
+            (m_batchReg[last] + m_batchLength[last] == step->regAddr) &&
+            (m_dataCount < RTIMUREGINIT_MAX_DATA)) {
+        m_data[m_dataCount++] = value;
+        m_batchLength[last]++;
+        return true;
+    }
+
+    if ((m_batchCount == MAX_BATCH_LEN) || (m_dataCount == RTIMUREGINIT_MAX_DATA)) {
+        if (!flush(hal))
+            return false;
+    }
+
+    if (m_batchCount == 0)
+        m_batchError = step->errorMsg;
+    m_batchSlave[m_batchCount] = step->slave;
+    m_batchReg[m_batchCount] = step->regAddr;
+    m_batchStart[m_batchCount] = m_dataCount;
+    m_batchLength[m_batchCount] = 1;
+    m_batchCount++;
+    m_data[m_dataCount++] = value;
+    return true;
+}
+
+bool RTIMURegInit::flush(RTIMUHal *hal)
+{
+    int slave;
+    unsigned char regAddr;
+
+    if (m_batchCount == 0)
+        return true;
+
+    hal->HALBatchBegin();
+    for (int i = 0; i < m_batchCount; i++) {
+        slave = m_batchSlave[i];
+        regAddr = m_batchReg[i];
+        if (m_batchLength[i] > 1)
+            regAddr |= m_burstFlag[slave];
+        hal->HALBatchWrite(m_slaveAddr[slave], regAddr, m_batchLength[i], m_data + m_batchStart[i]);
+    }
+
+    m_batchCount = 0;
+    m_dataCount = 0;
+    return hal->HALBatchSubmit(m_batchError);
+}
+
+void RTIMURegInit::waitReady(RTIMUHal *hal, int slave)
+{
+    uint64_t now = hal->HALTimestamp();
+
+    if (m_readyTime[slave] > now)
+        hal->delayMs((int)((m_readyTime[slave] - now + 999) / 1000));
+    m_readyTime[slave] = 0;
+}
@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _RTIMUREGINIT_H
+#define	_RTIMUREGINIT_H
+
+#include "RTMath.h"
+#include "RTIMUHal.h"
+
+#define RTIMUREGINIT_MAX_SLAVES         4                   // slave addresses in one sequence
+#define RTIMUREGINIT_MAX_VALUES         16                  // values set from the settings in one sequence
+#define RTIMUREGINIT_MAX_DATA           (MAX_BATCH_LEN * 8) // bytes of write data in one batch
+
+//  Init sequence operations
+
+#define RTIMUREGINIT_WRITE              0                   // write value to the register
+#define RTIMUREGINIT_WRITE_VALUE        1                   // write the value set with setValue(value)
+#define RTIMUREGINIT_VERIFY             2                   // read the register and check that (data & mask) == value
+#define RTIMUREGINIT_SETTLE             3                   // leave the slave alone for value mS
+
+//  One step of an init sequence. slave is the index of the address given to
+//  setSlave() so that the same table works at either of a chip's addresses.
+
+typedef struct
+{
+    unsigned char op;                                       // one of RTIMUREGINIT_*
+    unsigned char slave;                                    // slave index
+    unsigned char regAddr;                                  // the register
+    unsigned char value;                                    // data, expected value, value index or time in mS
+    unsigned char mask;                                     // the bits checked by RTIMUREGINIT_VERIFY
+    const char *errorMsg;
+} RTIMU_REG_INIT;
+
+//  One row of a table that maps a settings code to register bits and the scale
+//  factor or rate that goes with them
+
+typedef struct
+{
+    int code;                                               // the settings code
+    unsigned char bits;                                     // register bits for it
+    RTFLOAT scale;                                          // scale factor or rate for it
+} RTIMU_REG_CHOICE;
+
+//  RTIMUREGINIT_TABLE() passes a table and its length to run() or choose()
+
+#define RTIMUREGINIT_TABLE(table)       table, (int)(sizeof(table) / sizeof(table[0]))
+
+//  RTIMURegInit runs a chip's init sequence from a table. Consecutive writes to
+//  consecutive registers of a slave that allows it are coalesced into one burst
+//  write, and the writes between verify reads go to the bus as a single batch.
+//  A settle step doesn't delay the whole sequence. The slave isn't accessed again
+//  until its time is up but other slaves carry on, and run() only waits for what is
+//  still outstanding before it returns.
+
+class RTIMURegInit
+{
+public:
+    RTIMURegInit();
+
+    //  setSlave() gives the address for a slave index. burstFlag is or'd into the
+    //  register address for burst writes (0x80 for most ST parts) and burst is false
+    //  if the slave can't auto-increment at all.
+
+    void setSlave(int index, unsigned char slaveAddr, bool burst, unsigned char burstFlag = 0);
+
+    //  setValue() sets a value for RTIMUREGINIT_WRITE_VALUE steps, usually worked out
+    //  from the settings
+
+    void setValue(int index, unsigned char value);
+
+    //  run() performs count steps and returns false if a transfer or verify failed
+
+    bool run(RTIMUHal *hal, const RTIMU_REG_INIT *steps, int count);
+
+    //  update() is for reconfiguring a running chip. It writes only the
+    //  RTIMUREGINIT_WRITE_VALUE steps whose value has changed since run() or the last
+    //  update() and skips everything else. written is set to the number of registers
+    //  written and it returns false if a transfer failed.
+
+    bool update(RTIMUHal *hal, const RTIMU_REG_INIT *steps, int count, int& written);
+
+    //  discard() puts back the values that were last written, for when new values
+    //  turn out to be invalid part way through
+
+    void discard();
+
+    //  choose() finds code in a choice table and returns false with an error if it isn't
+    //  there. name describes the setting for the error message.
+
+    static bool choose(const RTIMU_REG_CHOICE *choices, int count, int code, const char *name,
+                       unsigned char& bits, RTFLOAT *scale = NULL);
+
+private:
+    bool queueWrite(RTIMUHal *hal, const RTIMU_REG_INIT *step, unsigned char value);
+    bool flush(RTIMUHal *hal);                              // submit the batch
+    void waitReady(RTIMUHal *hal, int slave);               // wait for a slave to settle
+
+    unsigned char m_slaveAddr[RTIMUREGINIT_MAX_SLAVES];
+    bool m_burst[RTIMUREGINIT_MAX_SLAVES];
+    unsigned char m_burstFlag[RTIMUREGINIT_MAX_SLAVES];
+    uint64_t m_readyTime[RTIMUREGINIT_MAX_SLAVES];          // when each slave can be accessed again
+    unsigned char m_values[RTIMUREGINIT_MAX_VALUES];
+    unsigned char m_active[RTIMUREGINIT_MAX_VALUES];       // the values the chip has now
+    bool m_activeValid[RTIMUREGINIT_MAX_VALUES];            // true if m_active is known
+
+    //  the batch being built
+
+    int m_batchCount;
+    int m_batchSlave[MAX_BATCH_LEN];                        // slave index of each entry
+    unsigned char m_batchReg[MAX_BATCH_LEN];                // first register of each entry
+    int m_batchStart[MAX_BATCH_LEN];                        // offset of each entry's data in m_data
+    int m_batchLength[MAX_BATCH_LEN];
+    unsigned char m_data[RTIMUREGINIT_MAX_DATA];
+    int m_dataCount;
+    const char *m_batchError;                               // error message of the batch's first write
+};
+
+#endif // _RTIMUREGINIT_H
@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "RTIMURing.h"
+
+#include <new>
+
+RTIMURing::RTIMURing(int size)
+{
+    int count = 1;
+
+    while (count < size)
+        count <<= 1;
+
+    m_mask = count - 1;
+    m_stride = ((sizeof(RTIMURING_SLOT) + RTIMURING_CACHE_LINE - 1) / RTIMURING_CACHE_LINE) * RTIMURING_CACHE_LINE;
+    m_buffer = new unsigned char[count * m_stride + RTIMURING_CACHE_LINE];
+    m_slots = m_buffer + (RTIMURING_CACHE_LINE - ((uintptr_t)m_buffer % RTIMURING_CACHE_LINE)) % RTIMURING_CACHE_LINE;
+
+    for (int i = 0; i < count; i++) {
+        RTIMURING_SLOT *s = new (m_slots + i * m_stride) RTIMURING_SLOT;
+        s->sequence.store(0, std::memory_order_relaxed);
+        s->data.setValidMask(0);
+    }
+    m_head.store(0, std::memory_order_release);
+}
+
+RTIMURing::~RTIMURing()
+{
+    for (uint64_t i = 0; i <= m_mask; i++)
+        slot(i)->~RTIMURING_SLOT();
+    delete [] m_buffer;
+}
+
+void RTIMURing::push(const RTIMU_DATA& data)
+{
+    uint64_t position = m_head.load(std::memory_order_relaxed);
+    RTIMURING_SLOT *s = slot(position);
+
+    s->sequence.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s->data = data;
+    s->sequence.store(2 * position + 2, std::memory_order_release);
+    m_head.store(position + 1, std::memory_order_release);
+}
+
+bool RTIMURing::read(uint64_t position, RTIMU_DATA& data)
+{
+    RTIMURING_SLOT *s = slot(position);
+    uint64_t expected = 2 * position + 2;
+
+    if (s->sequence.load(std::memory_order_acquire) != expected)
+        return false;
+    data = s->data;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return s->sequence.load(std::memory_order_relaxed) == expected;
+}
+
+RTIMURingReader::RTIMURingReader(RTIMURing *ring)
+{
+    m_ring = ring;
+    m_position = ring->getPushed();
+    resetStats();
+}
+
+bool RTIMURingReader::read(RTIMU_DATA& data)
+{
+    uint64_t head = m_ring->getPushed();
+    uint64_t size = m_ring->getSize();
+    uint64_t lag;
+
+    if (m_position >= head)
+        return false;
+
+    lag = head - m_position;
+    if (lag > m_maxLag)
+        m_maxLag = lag;
+
+    //  the slot after the newest sample may be being written, so the oldest sample that
+    //  can be relied on is the one after that
+
+    while (true) {
+        if (head - m_position >= size) {
+            m_overruns += head - size + 1 - m_position;
+            m_position = head - size + 1;
+        }
+        if (m_ring->read(m_position, data))
+            break;
+        head = m_ring->getPushed();
+    }
+    m_position++;
+    m_read++;
+    return true;
+}
+
+void RTIMURingReader::skip()
+{
+    m_position = m_ring->getPushed();
+}
+
+uint64_t RTIMURingReader::getLag()
+{
+    return m_ring->getPushed() - m_position;
+}
+
+void RTIMURingReader::resetStats()
+{
+    m_maxLag = 0;
+    m_read = 0;
+    m_overruns = 0;
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef _RTIMURING_H
+#define	_RTIMURING_H
+
+#include "RTIMULibDefs.h"
+
+#include <atomic>
+
+#define RTIMURING_DEFAULT_SIZE          256                 // samples, about a quarter of a second at 1kHz
+#define RTIMURING_CACHE_LINE            64
+
+//  RTIMURing passes samples from the thread that reads the IMU to any number of readers
+//  without locks, so that several parts of a system can use the same stream without
+//  each polling the bus.
+//
+//  There is one writer, which calls push() and never waits for the readers. Once the
+//  ring is full each sample overwrites the oldest. Every reader has its own
+//  RTIMURingReader with its own position, so readers don't affect each other. A reader
+//  that falls more than the ring's size behind loses the oldest samples, and counts
+//  them, rather than holding up the writer.
+//
+//  Each slot has a sequence number that is odd while the writer is changing it. A
+//  reader checks it before and after copying a sample and throws the copy away if the
+//  writer got there in the meantime.
+
+class RTIMURing
+{
+public:
+    //  size is rounded up to a power of two
+
+    RTIMURing(int size = RTIMURING_DEFAULT_SIZE);
+    ~RTIMURing();
+
+    void push(const RTIMU_DATA& data);                      // only ever called by the writer
+
+    int getSize() { return m_mask + 1; }
+    uint64_t getPushed() { return m_head.load(std::memory_order_acquire); }
+
+private:
+    typedef struct
+    {
+        std::atomic<uint64_t> sequence;                     // 2 * position + 2 when the sample is there, odd while it's written
+        RTIMU_DATA data;
+    } RTIMURING_SLOT;
+
+    RTIMURING_SLOT *slot(uint64_t position) { return (RTIMURING_SLOT *)(m_slots + (position & m_mask) * m_stride); }
+    bool read(uint64_t position, RTIMU_DATA& data);         // false if the sample has been overwritten
+
+    unsigned char *m_buffer;
+    unsigned char *m_slots;                                 // m_buffer aligned to a cache line
+    int m_stride;                                           // slots are a whole number of cache lines apart
+    uint64_t m_mask;
+
+    char m_pad[RTIMURING_CACHE_LINE];                       // keeps the writer's m_head away from the rest
+    std::atomic<uint64_t> m_head;                           // samples pushed
+
+    friend class RTIMURingReader;
+};
+
+//  RTIMURingReader is one reader's position in a ring. It starts with the next sample
+//  pushed, and it and its counts should only be used by one thread.
+
+class RTIMURingReader
+{
+public:
+    RTIMURingReader(RTIMURing *ring);
+
+    //  read() gets the next sample and returns false if there isn't one yet. If samples
+    //  were lost it carries on with the oldest that's still there.
+
+    bool read(RTIMU_DATA& data);
+
+    //  skip() drops anything not read yet so the next read() is the next sample pushed
+
+    void skip();
+
+    uint64_t getLag();                                      // samples pushed but not read yet
+    uint64_t getMaxLag() { return m_maxLag; }               // the largest lag seen by read()
+    uint64_t getRead() { return m_read; }                   // samples read
+    uint64_t getOverruns() { return m_overruns; }           // samples lost because they were overwritten
+    void resetStats();
+
+private:
+    RTIMURing *m_ring;
+    uint64_t m_position;                                    // the next sample to read
+    uint64_t m_maxLag;
+    uint64_t m_read;
+    uint64_t m_overruns;
+};
+
+#endif // _RTIMURING_H
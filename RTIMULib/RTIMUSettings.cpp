@@ -46,14 +46,27 @@
 
 #define RATE_TIMER_INTERVAL 2
 
+//  Discovery cache entry kinds
+
+#define DISCOVERY_IMU                   0
+#define DISCOVERY_PRESSURE              1
+#define DISCOVERY_HUMIDITY              2
+
+#define DISCOVERY_MAX_ENTRIES           16                  // lines kept in the discovery cache file
+
+static const char *discoveryKinds[] = {"IMU", "Pressure", "Humidity"};
+
 RTIMUSettings::RTIMUSettings(const char *productType)
 {
     if ((strlen(productType) > 200) || (strlen(productType) == 0)) {
         HAL_ERROR("Product name too long or null - using default\n");
         strcpy(m_filename, "RTIMULib.ini");
+        strcpy(m_discoveryFilename, "RTIMULib.discovery");
     } else {
         sprintf(m_filename, "%s.ini", productType);
+        sprintf(m_discoveryFilename, "%s.discovery", productType);
     }
+    m_discoveryBus = -1;
     loadSettings();
 }
 
@@ -62,24 +75,96 @@ RTIMUSettings::RTIMUSettings(const char *settingsDirectory, const char *productT
     if (((strlen(productType) + strlen(settingsDirectory)) > 200) || (strlen(productType) == 0)) {
         HAL_ERROR("Product name too long or null - using default\n");
         strcpy(m_filename, "RTIMULib.ini");
+        strcpy(m_discoveryFilename, "RTIMULib.discovery");
     } else {
         sprintf(m_filename, "%s/%s.ini", settingsDirectory, productType);
+        sprintf(m_discoveryFilename, "%s/%s.discovery", settingsDirectory, productType);
     }
+    m_discoveryBus = -1;
     loadSettings();
 }
 
 bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& slaveAddress)
+{
+    int type;
+    unsigned char address;
+
+    if (discoveryCacheLookup(DISCOVERY_IMU, type, address)) {
+        if (HALOpen() && discoveryCheck(DISCOVERY_IMU, type, address)) {
+            imuType = type;
+            busIsI2C = m_busIsI2C;
+            slaveAddress = address;
+            HAL_INFO2("Using cached IMU type %d at address 0x%02x\n", type, address);
+            return true;
+        }
+        HALClose();
+        HAL_INFO("Cached IMU not found\n");
+    }
+
+    if (!searchIMU(imuType, busIsI2C, slaveAddress))
+        return false;
+
+    discoveryCacheStore(DISCOVERY_IMU, imuType, slaveAddress);
+    return true;
+}
+
+bool RTIMUSettings::discoverPressure(int& pressureType, unsigned char& pressureAddress)
+{
+    int type;
+    unsigned char address;
+
+    if (discoveryCacheLookup(DISCOVERY_PRESSURE, type, address)) {
+        if (HALOpen() && discoveryCheck(DISCOVERY_PRESSURE, type, address)) {
+            pressureType = type;
+            pressureAddress = address;
+            HAL_INFO2("Using cached pressure sensor type %d at address 0x%02x\n", type, address);
+            return true;
+        }
+        HAL_INFO("Cached pressure sensor not found\n");
+    }
+
+    if (!searchPressure(pressureType, pressureAddress))
+        return false;
+
+    discoveryCacheStore(DISCOVERY_PRESSURE, pressureType, pressureAddress);
+    return true;
+}
+
+bool RTIMUSettings::discoverHumidity(int& humidityType, unsigned char& humidityAddress)
+{
+    int type;
+    unsigned char address;
+
+    if (discoveryCacheLookup(DISCOVERY_HUMIDITY, type, address)) {
+        if (HALOpen() && discoveryCheck(DISCOVERY_HUMIDITY, type, address)) {
+            humidityType = type;
+            humidityAddress = address;
+            HAL_INFO2("Using cached humidity sensor type %d at address 0x%02x\n", type, address);
+            return true;
+        }
+        HAL_INFO("Cached humidity sensor not found\n");
+    }
+
+    if (!searchHumidity(humidityType, humidityAddress))
+        return false;
+
+    discoveryCacheStore(DISCOVERY_HUMIDITY, humidityType, humidityAddress);
+    return true;
+}
+
+bool RTIMUSettings::searchIMU(int& imuType, bool& busIsI2C, unsigned char& slaveAddress)
 {
     unsigned char result;
     unsigned char altResult;
 
-    //  auto detect on I2C bus
+    //  auto detect on I2C bus, trying addresses that didn't answer before again
 
     m_busIsI2C = true;
+    m_discoveryBus = -1;
 
     if (HALOpen()) {
 
-        if (HALRead(MPU9150_ADDRESS0, MPU9150_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(MPU9150_ADDRESS0, MPU9150_WHO_AM_I, &result)) {
             if (result == MPU9250_ID || result == MPU9255_ID || result == MPU9250_6500_ID) {
                 imuType = RTIMU_TYPE_MPU925x;
                 slaveAddress = MPU925x_ADDRESS0;
@@ -95,7 +180,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
             }
         }
 
-        if (HALRead(MPU9150_ADDRESS1, MPU9150_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(MPU9150_ADDRESS1, MPU9150_WHO_AM_I, &result)) {
             if (result == MPU9250_ID || result == MPU9255_ID || result == MPU9250_6500_ID) {
                 imuType = RTIMU_TYPE_MPU925x;
                 slaveAddress = MPU925x_ADDRESS1;
@@ -127,9 +212,9 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
             return true;
         }
 
-        if (HALRead(L3GD20H_ADDRESS0, L3GD20H_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(L3GD20H_ADDRESS0, L3GD20H_WHO_AM_I, &result)) {
             if (result == L3GD20H_ID) {
-                if (HALRead(LSM303D_ADDRESS0, LSM303D_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM303D_ADDRESS0, LSM303D_WHO_AM_I, &altResult)) {
                     if (altResult == LSM303D_ID) {
                         imuType = RTIMU_TYPE_GD20HM303D;
                         slaveAddress = L3GD20H_ADDRESS0;
@@ -138,7 +223,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LSM303D_ADDRESS1, LSM303D_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM303D_ADDRESS1, LSM303D_WHO_AM_I, &altResult)) {
                     if (altResult == LSM303D_ID) {
                         imuType = RTIMU_TYPE_GD20HM303D;
                         slaveAddress = L3GD20H_ADDRESS0;
@@ -147,7 +232,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LSM303DLHC_ACCEL_ADDRESS, LSM303DLHC_STATUS_A, 1, &altResult, "")) {
+                if (discoveryRead(LSM303DLHC_ACCEL_ADDRESS, LSM303DLHC_STATUS_A, &altResult)) {
                     imuType = RTIMU_TYPE_GD20HM303DLHC;
                     slaveAddress = L3GD20H_ADDRESS0;
                     busIsI2C = true;
@@ -155,7 +240,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                     return true;
                 }
             } else if (result == LSM9DS0_GYRO_ID) {
-                if (HALRead(LSM9DS0_ACCELMAG_ADDRESS0, LSM9DS0_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM9DS0_ACCELMAG_ADDRESS0, LSM9DS0_WHO_AM_I, &altResult)) {
                     if (altResult == LSM9DS0_ACCELMAG_ID) {
                         imuType = RTIMU_TYPE_LSM9DS0;
                         slaveAddress = LSM9DS0_GYRO_ADDRESS0;
@@ -164,7 +249,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LSM9DS0_ACCELMAG_ADDRESS1, LSM9DS0_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM9DS0_ACCELMAG_ADDRESS1, LSM9DS0_WHO_AM_I, &altResult)) {
                     if (altResult == LSM9DS0_ACCELMAG_ID) {
                         imuType = RTIMU_TYPE_LSM9DS0;
                         slaveAddress = LSM9DS0_GYRO_ADDRESS0;
@@ -174,7 +259,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                     }
                 }
             } else if (result == LSM9DS1_ID) {
-                if (HALRead(LSM9DS1_MAG_ADDRESS0, LSM9DS1_MAG_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM9DS1_MAG_ADDRESS0, LSM9DS1_MAG_WHO_AM_I, &altResult)) {
                     if (altResult == LSM9DS1_MAG_ID) {
                         imuType = RTIMU_TYPE_LSM9DS1;
                         slaveAddress = LSM9DS1_ADDRESS0;
@@ -183,7 +268,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LSM9DS1_MAG_ADDRESS1, LSM9DS1_MAG_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM9DS1_MAG_ADDRESS1, LSM9DS1_MAG_WHO_AM_I, &altResult)) {
                     if (altResult == LSM9DS1_MAG_ID) {
                         imuType = RTIMU_TYPE_LSM9DS1;
                         slaveAddress = LSM9DS1_ADDRESS0;
@@ -192,7 +277,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LSM9DS1_MAG_ADDRESS2, LSM9DS1_MAG_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM9DS1_MAG_ADDRESS2, LSM9DS1_MAG_WHO_AM_I, &altResult)) {
                     if (altResult == LSM9DS1_MAG_ID) {
                         imuType = RTIMU_TYPE_LSM9DS1;
                         slaveAddress = LSM9DS1_ADDRESS0;
@@ -201,7 +286,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LSM9DS1_MAG_ADDRESS3, LSM9DS1_MAG_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM9DS1_MAG_ADDRESS3, LSM9DS1_MAG_WHO_AM_I, &altResult)) {
                     if (altResult == LSM9DS1_MAG_ID) {
                         imuType = RTIMU_TYPE_LSM9DS1;
                         slaveAddress = LSM9DS1_ADDRESS0;
@@ -211,7 +296,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                     }
                 }
             } else if (result == LSM6DS33_ID || result == ISM330DHCX_ID) {
-                if (HALRead(LIS3MDL_ADDRESS0, LIS3MDL_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LIS3MDL_ADDRESS0, LIS3MDL_WHO_AM_I, &altResult)) {
                     if (altResult == LIS3MDL_ID) {
                         imuType = RTIMU_TYPE_LSM6DS33LIS3MDL;
                         slaveAddress = LSM6DS33_ADDRESS0;
@@ -220,7 +305,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LIS3MDL_ADDRESS1, LIS3MDL_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LIS3MDL_ADDRESS1, LIS3MDL_WHO_AM_I, &altResult)) {
                     if (altResult == LIS3MDL_ID) {
                         imuType = RTIMU_TYPE_LSM6DS33LIS3MDL;
                         slaveAddress = LSM6DS33_ADDRESS0;
@@ -232,9 +317,9 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
             }
         }
 
-        if (HALRead(L3GD20H_ADDRESS1, L3GD20H_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(L3GD20H_ADDRESS1, L3GD20H_WHO_AM_I, &result)) {
             if (result == L3GD20H_ID) {
-                if (HALRead(LSM303D_ADDRESS1, LSM303D_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM303D_ADDRESS1, LSM303D_WHO_AM_I, &altResult)) {
                     if (altResult == LSM303D_ID) {
                         imuType = RTIMU_TYPE_GD20HM303D;
                         slaveAddress = L3GD20H_ADDRESS1;
@@ -243,7 +328,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LSM303D_ADDRESS0, LSM303D_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM303D_ADDRESS0, LSM303D_WHO_AM_I, &altResult)) {
                     if (altResult == LSM303D_ID) {
                         imuType = RTIMU_TYPE_GD20HM303D;
                         slaveAddress = L3GD20H_ADDRESS1;
@@ -252,7 +337,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LSM303DLHC_ACCEL_ADDRESS, LSM303DLHC_STATUS_A, 1, &altResult, "")) {
+                if (discoveryRead(LSM303DLHC_ACCEL_ADDRESS, LSM303DLHC_STATUS_A, &altResult)) {
                     imuType = RTIMU_TYPE_GD20HM303DLHC;
                     slaveAddress = L3GD20H_ADDRESS1;
                     busIsI2C = true;
@@ -260,7 +345,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                     return true;
                 }
             } else if (result == LSM9DS0_GYRO_ID) {
-                if (HALRead(LSM9DS0_ACCELMAG_ADDRESS1, LSM9DS0_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM9DS0_ACCELMAG_ADDRESS1, LSM9DS0_WHO_AM_I, &altResult)) {
                     if (altResult == LSM9DS0_ACCELMAG_ID) {
                         imuType = RTIMU_TYPE_LSM9DS0;
                         slaveAddress = LSM9DS0_GYRO_ADDRESS1;
@@ -269,7 +354,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LSM9DS0_ACCELMAG_ADDRESS0, LSM9DS0_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM9DS0_ACCELMAG_ADDRESS0, LSM9DS0_WHO_AM_I, &altResult)) {
                     if (altResult == LSM9DS0_ACCELMAG_ID) {
                         imuType = RTIMU_TYPE_LSM9DS0;
                         slaveAddress = LSM9DS0_GYRO_ADDRESS1;
@@ -279,7 +364,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                     }
                 }
             } else if (result == LSM9DS1_ID) {
-                if (HALRead(LSM9DS1_MAG_ADDRESS0, LSM9DS1_MAG_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM9DS1_MAG_ADDRESS0, LSM9DS1_MAG_WHO_AM_I, &altResult)) {
                     if (altResult == LSM9DS1_MAG_ID) {
                         imuType = RTIMU_TYPE_LSM9DS1;
                         slaveAddress = LSM9DS1_ADDRESS1;
@@ -288,7 +373,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LSM9DS1_MAG_ADDRESS1, LSM9DS1_MAG_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM9DS1_MAG_ADDRESS1, LSM9DS1_MAG_WHO_AM_I, &altResult)) {
                     if (altResult == LSM9DS1_MAG_ID) {
                         imuType = RTIMU_TYPE_LSM9DS1;
                         slaveAddress = LSM9DS1_ADDRESS1;
@@ -297,7 +382,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LSM9DS1_MAG_ADDRESS2, LSM9DS1_MAG_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM9DS1_MAG_ADDRESS2, LSM9DS1_MAG_WHO_AM_I, &altResult)) {
                     if (altResult == LSM9DS1_MAG_ID) {
                         imuType = RTIMU_TYPE_LSM9DS1;
                         slaveAddress = LSM9DS1_ADDRESS1;
@@ -306,7 +391,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LSM9DS1_MAG_ADDRESS3, LSM9DS1_MAG_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LSM9DS1_MAG_ADDRESS3, LSM9DS1_MAG_WHO_AM_I, &altResult)) {
                     if (altResult == LSM9DS1_MAG_ID) {
                         imuType = RTIMU_TYPE_LSM9DS1;
                         slaveAddress = LSM9DS1_ADDRESS1;
@@ -316,7 +401,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                     }
                 }
             } else if (result == LSM6DS33_ID || result == ISM330DHCX_ID) {
-                if (HALRead(LIS3MDL_ADDRESS0, LIS3MDL_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LIS3MDL_ADDRESS0, LIS3MDL_WHO_AM_I, &altResult)) {
                     if (altResult == LIS3MDL_ID) {
                         imuType = RTIMU_TYPE_LSM6DS33LIS3MDL;
                         slaveAddress = LSM6DS33_ADDRESS1;
@@ -325,7 +410,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                         return true;
                     }
                 }
-                if (HALRead(LIS3MDL_ADDRESS1, LIS3MDL_WHO_AM_I, 1, &altResult, "")) {
+                if (discoveryRead(LIS3MDL_ADDRESS1, LIS3MDL_WHO_AM_I, &altResult)) {
                     if (altResult == LIS3MDL_ID) {
                         imuType = RTIMU_TYPE_LSM6DS33LIS3MDL;
                         slaveAddress = LSM6DS33_ADDRESS1;
@@ -337,7 +422,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
             }
         }
 
-        if (HALRead(L3GD20_ADDRESS0, L3GD20_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(L3GD20_ADDRESS0, L3GD20_WHO_AM_I, &result)) {
             if (result == L3GD20_ID) {
                 imuType = RTIMU_TYPE_GD20M303DLHC;
                 slaveAddress = L3GD20_ADDRESS0;
@@ -347,7 +432,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
             }
         }
 
-        if (HALRead(L3GD20_ADDRESS1, L3GD20_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(L3GD20_ADDRESS1, L3GD20_WHO_AM_I, &result)) {
             if (result == L3GD20_ID) {
                 imuType = RTIMU_TYPE_GD20M303DLHC;
                 slaveAddress = L3GD20_ADDRESS1;
@@ -357,7 +442,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
             }
         }
 
-        if (HALRead(BMX055_GYRO_ADDRESS0, BMX055_GYRO_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(BMX055_GYRO_ADDRESS0, BMX055_GYRO_WHO_AM_I, &result)) {
             if (result == BMX055_GYRO_ID) {
                 imuType = RTIMU_TYPE_BMX055;
                 slaveAddress = BMX055_GYRO_ADDRESS0;
@@ -366,7 +451,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                 return true;
             }
         }
-        if (HALRead(BMX055_GYRO_ADDRESS1, BMX055_GYRO_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(BMX055_GYRO_ADDRESS1, BMX055_GYRO_WHO_AM_I, &result)) {
             if (result == BMX055_GYRO_ID) {
                 imuType = RTIMU_TYPE_BMX055;
                 slaveAddress = BMX055_GYRO_ADDRESS1;
@@ -376,7 +461,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
             }
         }
 
-        if (HALRead(BNO055_ADDRESS0, BNO055_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(BNO055_ADDRESS0, BNO055_WHO_AM_I, &result)) {
             if (result == BNO055_ID) {
                 imuType = RTIMU_TYPE_BNO055;
                 slaveAddress = BNO055_ADDRESS0;
@@ -385,7 +470,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                 return true;
             }
         }
-        if (HALRead(BNO055_ADDRESS1, BNO055_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(BNO055_ADDRESS1, BNO055_WHO_AM_I, &result)) {
             if (result == BNO055_ID) {
                 imuType = RTIMU_TYPE_BNO055;
                 slaveAddress = BNO055_ADDRESS1;
@@ -394,7 +479,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
                 return true;
             }
         }
-	if (HALRead(HMC5883_ADDRESS, HMC5883L_WHO_AM_I, 1, &result, "")) {
+	if (discoveryRead(HMC5883_ADDRESS, HMC5883L_WHO_AM_I, &result)) {
 	    if (result == HMC5883L_ID) {
 		imuType = RTIMU_TYPE_HMC5883LADXL345;
 		slaveAddress = HMC5883_ADDRESS;
@@ -415,7 +500,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
     m_SPISelect = 0;
 
     if (HALOpen()) {
-        if (HALRead(MPU925x_ADDRESS0, MPU925x_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(MPU925x_ADDRESS0, MPU925x_WHO_AM_I, &result)) {
             if (result == MPU9250_ID || result == MPU9255_ID || result == MPU9250_6500_ID) {
                 imuType = RTIMU_TYPE_MPU925x;
                 slaveAddress = MPU925x_ADDRESS0;
@@ -427,7 +512,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
         HALClose();
     }
     if (HALOpen()) {
-        if (HALRead(ICM20948_ADDRESS0, ICM20948_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(ICM20948_ADDRESS0, ICM20948_WHO_AM_I, &result)) {
             if (result == ICM20948_ID) {
                 imuType = RTIMU_TYPE_ICM20948;
                 slaveAddress = ICM20948_ADDRESS0;
@@ -442,7 +527,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
     m_SPISelect = 1;
 
     if (HALOpen()) {
-        if (HALRead(MPU925x_ADDRESS0, MPU925x_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(MPU925x_ADDRESS0, MPU925x_WHO_AM_I, &result)) {
             if (result == MPU9250_ID || result == MPU9255_ID || result == MPU9250_6500_ID) {
                 imuType = RTIMU_TYPE_MPU925x;
                 slaveAddress = MPU925x_ADDRESS0;
@@ -454,7 +539,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
         HALClose();
     }
     if (HALOpen()) {
-        if (HALRead(ICM20948_ADDRESS0, ICM20948_WHO_AM_I, 1, &result, "")) {
+        if (discoveryRead(ICM20948_ADDRESS0, ICM20948_WHO_AM_I, &result)) {
             if (result == ICM20948_ID) {
                 imuType = RTIMU_TYPE_ICM20948;
                 slaveAddress = ICM20948_ADDRESS0;
@@ -471,7 +556,7 @@ bool RTIMUSettings::discoverIMU(int& imuType, bool& busIsI2C, unsigned char& sla
     return false;
 }
 
-bool RTIMUSettings::discoverPressure(int& pressureType, unsigned char& pressureAddress)
+bool RTIMUSettings::searchPressure(int& pressureType, unsigned char& pressureAddress)
 {
     unsigned char result;
 
@@ -479,7 +564,7 @@ bool RTIMUSettings::discoverPressure(int& pressureType, unsigned char& pressureA
 
     if (HALOpen()) {
 
-        if (HALRead(BMP180_ADDRESS, BMP180_REG_ID, 1, &result, "")) {
+        if (discoveryRead(BMP180_ADDRESS, BMP180_REG_ID, &result)) {
             if (result == BMP180_ID) {
                 pressureType = RTPRESSURE_TYPE_BMP180;
                 pressureAddress = BMP180_ADDRESS;
@@ -488,7 +573,7 @@ bool RTIMUSettings::discoverPressure(int& pressureType, unsigned char& pressureA
             }
         }
 
-        if (HALRead(LPS25H_ADDRESS0, LPS25H_REG_ID, 1, &result, "")) {
+        if (discoveryRead(LPS25H_ADDRESS0, LPS25H_REG_ID, &result)) {
             if (result == LPS25H_ID) {
                 pressureType = RTPRESSURE_TYPE_LPS25H;
                 pressureAddress = LPS25H_ADDRESS0;
@@ -497,7 +582,7 @@ bool RTIMUSettings::discoverPressure(int& pressureType, unsigned char& pressureA
             }
         }
 
-        if (HALRead(LPS25H_ADDRESS1, LPS25H_REG_ID, 1, &result, "")) {
+        if (discoveryRead(LPS25H_ADDRESS1, LPS25H_REG_ID, &result)) {
             if (result == LPS25H_ID) {
                 pressureType = RTPRESSURE_TYPE_LPS25H;
                 pressureAddress = LPS25H_ADDRESS1;
@@ -508,13 +593,13 @@ bool RTIMUSettings::discoverPressure(int& pressureType, unsigned char& pressureA
 
         // check for MS5611 (which unfortunately has no ID reg)
 
-        if (HALRead(MS5611_ADDRESS0, 0, 1, &result, "")) {
+        if (discoveryRead(MS5611_ADDRESS0, 0, &result)) {
             pressureType = RTPRESSURE_TYPE_MS5611;
             pressureAddress = MS5611_ADDRESS0;
             HAL_INFO("Detected MS5611 at standard address\n");
             return true;
         }
-        if (HALRead(MS5611_ADDRESS1, 0, 1, &result, "")) {
+        if (discoveryRead(MS5611_ADDRESS1, 0, &result)) {
             pressureType = RTPRESSURE_TYPE_MS5611;
             pressureAddress = MS5611_ADDRESS1;
             HAL_INFO("Detected MS5611 at option address\n");
@@ -525,7 +610,7 @@ bool RTIMUSettings::discoverPressure(int& pressureType, unsigned char& pressureA
     return false;
 }
 
-bool RTIMUSettings::discoverHumidity(int& humidityType, unsigned char& humidityAddress)
+bool RTIMUSettings::searchHumidity(int& humidityType, unsigned char& humidityAddress)
 {
     unsigned char result;
 
@@ -533,7 +618,7 @@ bool RTIMUSettings::discoverHumidity(int& humidityType, unsigned char& humidityA
 
     if (HALOpen()) {
 
-        if (HALRead(HTS221_ADDRESS, HTS221_REG_ID, 1, &result, "")) {
+        if (discoveryRead(HTS221_ADDRESS, HTS221_REG_ID, &result)) {
             if (result == HTS221_ID) {
                 humidityType = RTHUMIDITY_TYPE_HTS221;
                 humidityAddress = HTS221_ADDRESS;
@@ -542,7 +627,7 @@ bool RTIMUSettings::discoverHumidity(int& humidityType, unsigned char& humidityA
             }
         }
 
-        if (HALRead(HTU21D_ADDRESS, HTU21D_READ_USER_REG, 1, &result, "")) {
+        if (discoveryRead(HTU21D_ADDRESS, HTU21D_READ_USER_REG, &result)) {
             humidityType = RTHUMIDITY_TYPE_HTU21D;
             humidityAddress = HTU21D_ADDRESS;
             HAL_INFO("Detected HTU21D at standard address\n");
@@ -554,6 +639,277 @@ bool RTIMUSettings::discoverHumidity(int& humidityType, unsigned char& humidityA
     return false;
 }
 
+//  The first read of an address in a search doubles as its probe. An address that
+//  doesn't answer is remembered and isn't tried again on the same bus, so each missing
+//  sensor costs one failed transfer however many of the checks use its address.
+
+bool RTIMUSettings::discoveryRead(unsigned char slaveAddress, unsigned char regAddr, unsigned char *result)
+{
+    int index = (slaveAddress >> 3) & 0x0f;
+    unsigned char bit = 1 << (slaveAddress & 7);
+
+    if (!m_busIsI2C)
+        return HALRead(slaveAddress, regAddr, 1, result, "");
+
+    if (m_discoveryBus != m_I2CBus) {
+        memset(m_discoveryPresent, 0, sizeof(m_discoveryPresent));
+        memset(m_discoveryAbsent, 0, sizeof(m_discoveryAbsent));
+        m_discoveryBus = m_I2CBus;
+    }
+
+    if ((m_discoveryAbsent[index] & bit) != 0)
+        return false;
+
+    if (HALRead(slaveAddress, regAddr, 1, result, "")) {
+        m_discoveryPresent[index] |= bit;
+        return true;
+    }
+    if ((m_discoveryPresent[index] & bit) == 0)
+        m_discoveryAbsent[index] |= bit;
+    return false;
+}
+
+//  discoveryCheck() reads the id of a cached sensor to make sure that it is still there.
+//  That is one read except for the gyros that need the other chip to identify them.
+
+bool RTIMUSettings::discoveryCheck(int kind, int type, unsigned char slaveAddress)
+{
+    unsigned char regAddr;
+    unsigned char id;
+    unsigned char altId;
+    unsigned char result;
+
+    if (kind == DISCOVERY_IMU) {
+        switch (type) {
+        case RTIMU_TYPE_MPU9150:
+            regAddr = MPU9150_WHO_AM_I;
+            id = altId = MPU9150_ID;
+            break;
+
+        case RTIMU_TYPE_MPU925x:
+            if (!HALRead(slaveAddress, MPU925x_WHO_AM_I, 1, &result, ""))
+                return false;
+            return (result == MPU9250_ID) || (result == MPU9255_ID) || (result == MPU9250_6500_ID);
+
+        case RTIMU_TYPE_ICM20948:
+            return Detect_ICM20948(slaveAddress);
+
+        case RTIMU_TYPE_GD20HM303D:
+        case RTIMU_TYPE_GD20HM303DLHC:
+            regAddr = L3GD20H_WHO_AM_I;
+            id = altId = L3GD20H_ID;
+            break;
+
+        case RTIMU_TYPE_GD20M303DLHC:
+            regAddr = L3GD20_WHO_AM_I;
+            id = altId = L3GD20_ID;
+            break;
+
+        case RTIMU_TYPE_LSM9DS0:
+            regAddr = LSM9DS0_GYRO_WHO_AM_I;
+            id = altId = LSM9DS0_GYRO_ID;
+            break;
+
+        case RTIMU_TYPE_LSM9DS1:
+            regAddr = LSM9DS1_WHO_AM_I;
+            id = altId = LSM9DS1_ID;
+            break;
+
+        case RTIMU_TYPE_LSM6DS33LIS3MDL:
+            regAddr = LSM6DS33_WHO_AM_I;
+            id = LSM6DS33_ID;
+            altId = ISM330DHCX_ID;
+            break;
+
+        case RTIMU_TYPE_BMX055:
+            regAddr = BMX055_GYRO_WHO_AM_I;
+            id = altId = BMX055_GYRO_ID;
+            break;
+
+        case RTIMU_TYPE_BNO055:
+            regAddr = BNO055_WHO_AM_I;
+            id = altId = BNO055_ID;
+            break;
+
+        case RTIMU_TYPE_HMC5883LADXL345:
+            regAddr = HMC5883L_WHO_AM_I;
+            id = altId = HMC5883L_ID;
+            break;
+
+        default:
+            return false;
+        }
+    } else if (kind == DISCOVERY_PRESSURE) {
+        switch (type) {
+        case RTPRESSURE_TYPE_BMP180:
+            regAddr = BMP180_REG_ID;
+            id = altId = BMP180_ID;
+            break;
+
+        case RTPRESSURE_TYPE_LPS25H:
+            regAddr = LPS25H_REG_ID;
+            id = altId = LPS25H_ID;
+            break;
+
+        case RTPRESSURE_TYPE_MS5611:
+            return HALRead(slaveAddress, 0, 1, &result, "");
+
+        default:
+            return false;
+        }
+    } else {
+        switch (type) {
+        case RTHUMIDITY_TYPE_HTS221:
+            regAddr = HTS221_REG_ID;
+            id = altId = HTS221_ID;
+            break;
+
+        case RTHUMIDITY_TYPE_HTU21D:
+            return HALRead(slaveAddress, HTU21D_READ_USER_REG, 1, &result, "");
+
+        default:
+            return false;
+        }
+    }
+
+    if (!HALRead(slaveAddress, regAddr, 1, &result, ""))
+        return false;
+    if ((result != id) && (result != altId))
+        return false;
+
+    if (kind != DISCOVERY_IMU)
+        return true;
+
+    //  The L3GD20 and LSM9DS0 gyros have the same id, and the L3GD20H is used with both
+    //  the LSM303D and LSM303DLHC, so these are told apart by the other chip
+
+    switch (type) {
+    case RTIMU_TYPE_GD20HM303D:
+        if (HALRead(LSM303D_ADDRESS0, LSM303D_WHO_AM_I, 1, &result, "") && (result == LSM303D_ID))
+            return true;
+        return HALRead(LSM303D_ADDRESS1, LSM303D_WHO_AM_I, 1, &result, "") && (result == LSM303D_ID);
+
+    case RTIMU_TYPE_LSM9DS0:
+        if (HALRead(LSM9DS0_ACCELMAG_ADDRESS0, LSM9DS0_WHO_AM_I, 1, &result, "") && (result == LSM9DS0_ACCELMAG_ID))
+            return true;
+        return HALRead(LSM9DS0_ACCELMAG_ADDRESS1, LSM9DS0_WHO_AM_I, 1, &result, "") && (result == LSM9DS0_ACCELMAG_ID);
+
+    case RTIMU_TYPE_GD20M303DLHC:
+    case RTIMU_TYPE_GD20HM303DLHC:
+        return HALRead(LSM303DLHC_ACCEL_ADDRESS, LSM303DLHC_STATUS_A, 1, &result, "");
+
+    default:
+        return true;
+    }
+}
+
+//  The discovery cache has a line for each kind of sensor, I2C bus and adapter name
+//  (as in /sys/bus/i2c/devices), for example:
+//
+//    IMU,1,bcm2835 (i2c@7e804000)=1,0,0,7,104
+//
+//  The values are whether the sensor was on I2C, the SPI bus and select, the type code
+//  and the address.
+
+void RTIMUSettings::discoveryKey(char *key, int kind)
+{
+    char fileName[64];
+    char adapter[128];
+    FILE *fd;
+
+    strcpy(adapter, "unknown");
+    sprintf(fileName, "/sys/bus/i2c/devices/i2c-%d/name", m_I2CBus);
+    if ((fd = fopen(fileName, "r")) != NULL) {
+        if (fgets(adapter, sizeof(adapter), fd) == NULL)
+            strcpy(adapter, "unknown");
+        adapter[strcspn(adapter, "\r\n=")] = 0;
+        fclose(fd);
+    }
+    sprintf(key, "%s,%d,%s", discoveryKinds[kind], m_I2CBus, adapter);
+}
+
+//  discoveryCacheLookup() finds the cached sensor for the current I2C bus. For an IMU it
+//  also selects the bus it was found on. Pressure and humidity sensors are only cached
+//  when the current bus is I2C.
+
+bool RTIMUSettings::discoveryCacheLookup(int kind, int& type, unsigned char& slaveAddress)
+{
+    char key[256];
+    char line[512];
+    char *value;
+    int busIsI2C, SPIBus, SPISelect, cachedType, address;
+    bool found = false;
+    FILE *fd;
+
+    if ((kind != DISCOVERY_IMU) && !m_busIsI2C)
+        return false;
+
+    if ((fd = fopen(m_discoveryFilename, "r")) == NULL)
+        return false;
+
+    discoveryKey(key, kind);
+
+    while (!found && (fgets(line, sizeof(line), fd) != NULL)) {
+        if ((value = strrchr(line, '=')) == NULL)
+            continue;
+        *value++ = 0;
+        if (strcmp(line, key) != 0)
+            continue;
+        found = sscanf(value, "%d,%d,%d,%d,%d", &busIsI2C, &SPIBus, &SPISelect, &cachedType, &address) == 5;
+    }
+    fclose(fd);
+
+    if (!found)
+        return false;
+
+    if (kind == DISCOVERY_IMU) {
+        m_busIsI2C = busIsI2C != 0;
+        m_SPIBus = SPIBus;
+        m_SPISelect = SPISelect;
+    }
+    type = cachedType;
+    slaveAddress = address;
+    return true;
+}
+
+void RTIMUSettings::discoveryCacheStore(int kind, int type, unsigned char slaveAddress)
+{
+    char key[256];
+    char line[512];
+    char lines[DISCOVERY_MAX_ENTRIES][512];
+    int count = 0;
+    int keyLength;
+    FILE *fd;
+
+    if ((kind != DISCOVERY_IMU) && !m_busIsI2C)
+        return;
+
+    discoveryKey(key, kind);
+    keyLength = strlen(key);
+
+    //  keep the other entries
+
+    if ((fd = fopen(m_discoveryFilename, "r")) != NULL) {
+        while ((count < DISCOVERY_MAX_ENTRIES - 1) && (fgets(line, sizeof(line), fd) != NULL)) {
+            if (strchr(line, '=') == NULL)
+                continue;
+            if ((strncmp(line, key, keyLength) == 0) && (line[keyLength] == '='))
+                continue;
+            strcpy(lines[count++], line);
+        }
+        fclose(fd);
+    }
+
+    if ((fd = fopen(m_discoveryFilename, "w")) == NULL) {
+        HAL_ERROR1("Failed to write discovery cache %s\n", m_discoveryFilename);
+        return;
+    }
+    for (int i = 0; i < count; i++)
+        fputs(lines[i], fd);
+    fprintf(fd, "%s=%d,%d,%d,%d,%d\n", key, m_busIsI2C ? 1 : 0, m_SPIBus, m_SPISelect, type, slaveAddress);
+    fclose(fd);
+}
+
 /* the default bus is 1 for raspberry pi, but for orange pi,
    the bus is 0
 */
@@ -593,6 +949,16 @@ void RTIMUSettings::setDefaults()
     m_I2CPressureAddress = 0;
     m_humidityType = RTHUMIDITY_TYPE_AUTODISCOVER;
     m_I2CHumidityAddress = 0;
+    m_dataReadyGPIOChip = -1;
+    m_dataReadyGPIOLine = 0;
+    m_fifoAverage = false;
+    m_fifoPollTarget = 50;
+    m_acquisitionPolicy = RTIMU_ACQUISITION_NORMAL;
+    m_acquisitionPriority = 50;
+    m_acquisitionRuntime = 500;
+    m_acquisitionCPU = -1;
+    m_acquisitionLockMemory = false;
+    m_acquisitionStackPrefault = 0;
     m_compassCalValid = false;
     m_compassCalEllipsoidValid = false;
     for (int i = 0; i < 3; i++) {
@@ -608,6 +974,7 @@ void RTIMUSettings::setDefaults()
 
     m_accelCalValid = false;
     m_gyroBiasValid = false;
+    m_gyroBiasTempCount = 0;
 
     m_kalmanRk = 5e-4;
     m_kalmanQ = 1e-3;
@@ -705,6 +1072,9 @@ void RTIMUSettings::setDefaults()
 
     m_LSM9DS1CompassSampleRate = LSM9DS1_COMPASS_SAMPLERATE_20;
     m_LSM9DS1CompassFsr = LSM9DS1_COMPASS_FSR_4;
+
+    m_LSM9DS1FifoEnable = false;
+    m_LSM9DS1FifoThreshold = 8;
  
     // BMX055 defaults
 
@@ -729,6 +1099,10 @@ void RTIMUSettings::setDefaults()
     m_LSM6DS33LIS3MDLCompassSampleRate = LIS3MDL_SAMPLERATE_10;
     m_LSM6DS33LIS3MDLCompassFsr = LIS3MDL_FSR_4;
     m_LSM6DS33LIS3MDLCompassPowerMode = LIS3MDL_POWER_LP;
+
+    // BNO055 defaults
+
+    m_BNO055FusionPassthrough = false;
 }
 
 bool RTIMUSettings::loadSettings()
@@ -787,6 +1161,26 @@ bool RTIMUSettings::loadSettings()
             m_humidityType = atoi(val);
         } else if (strcmp(key, RTIMULIB_I2C_HUMIDITYADDRESS) == 0) {
             m_I2CHumidityAddress = atoi(val);
+        } else if (strcmp(key, RTIMULIB_DATAREADY_GPIOCHIP) == 0) {
+            m_dataReadyGPIOChip = atoi(val);
+        } else if (strcmp(key, RTIMULIB_DATAREADY_GPIOLINE) == 0) {
+            m_dataReadyGPIOLine = atoi(val);
+        } else if (strcmp(key, RTIMULIB_FIFO_AVERAGE) == 0) {
+            m_fifoAverage = strcmp(val, "true") == 0;
+        } else if (strcmp(key, RTIMULIB_FIFO_POLL_TARGET) == 0) {
+            m_fifoPollTarget = atoi(val);
+        } else if (strcmp(key, RTIMULIB_ACQUISITION_POLICY) == 0) {
+            m_acquisitionPolicy = atoi(val);
+        } else if (strcmp(key, RTIMULIB_ACQUISITION_PRIORITY) == 0) {
+            m_acquisitionPriority = atoi(val);
+        } else if (strcmp(key, RTIMULIB_ACQUISITION_RUNTIME) == 0) {
+            m_acquisitionRuntime = atoi(val);
+        } else if (strcmp(key, RTIMULIB_ACQUISITION_CPU) == 0) {
+            m_acquisitionCPU = atoi(val);
+        } else if (strcmp(key, RTIMULIB_ACQUISITION_LOCKMEMORY) == 0) {
+            m_acquisitionLockMemory = strcmp(val, "true") == 0;
+        } else if (strcmp(key, RTIMULIB_ACQUISITION_STACKPREFAULT) == 0) {
+            m_acquisitionStackPrefault = atoi(val);
 
         // compass calibration and adjustment
 
@@ -891,6 +1285,8 @@ bool RTIMUSettings::loadSettings()
         } else if (strcmp(key, RTIMULIB_GYRO_BIAS_Z) == 0) {
             sscanf(val, "%f", &ftemp);
             m_gyroBias.setZ(ftemp);
+        } else if (loadGyroBiasTemp(key, val)) {
+            //  loadGyroBiasTemp() has stored it in the gyro bias table
 
         //  MPU9150 settings
 
@@ -1035,6 +1431,10 @@ bool RTIMUSettings::loadSettings()
             m_LSM9DS1CompassSampleRate = atoi(val);
         } else if (strcmp(key, RTIMULIB_LSM9DS1_COMPASS_FSR) == 0) {
             m_LSM9DS1CompassFsr = atoi(val);
+        } else if (strcmp(key, RTIMULIB_LSM9DS1_FIFO_ENABLE) == 0) {
+            m_LSM9DS1FifoEnable = strcmp(val, "true") == 0;
+        } else if (strcmp(key, RTIMULIB_LSM9DS1_FIFO_THRESHOLD) == 0) {
+            m_LSM9DS1FifoThreshold = atoi(val);
 
         //  BMX055 settings
 
@@ -1070,6 +1470,11 @@ bool RTIMUSettings::loadSettings()
         } else if (strcmp(key, RTIMULIB_LSM6DS33LIS3MDL_COMPASS_POWERMODE) == 0) {
             m_LSM6DS33LIS3MDLCompassPowerMode = atoi(val);
 
+        //  BNO055 settings
+
+        } else if (strcmp(key, RTIMULIB_BNO055_FUSION_PASSTHROUGH) == 0) {
+            m_BNO055FusionPassthrough = strcmp(val, "true") == 0;
+
         //  Handle unrecognized key
 
         } else {
@@ -1191,6 +1596,42 @@ bool RTIMUSettings::saveSettings()
     setComment("I2C humidity sensor address (filled in automatically by auto discover) ");
     setValue(RTIMULIB_I2C_HUMIDITYADDRESS, m_I2CHumidityAddress);
 
+    setBlank();
+    setComment("");
+    setComment("Data ready interrupt - the gpiochip and line the IMU's interrupt pin is connected to.");
+    setComment("Set the chip to -1 if it is not connected and the IMU will be polled instead.");
+    setValue(RTIMULIB_DATAREADY_GPIOCHIP, m_dataReadyGPIOChip);
+    setValue(RTIMULIB_DATAREADY_GPIOLINE, m_dataReadyGPIOLine);
+
+    setBlank();
+    setComment("");
+    setComment("FIFO average - for IMUs that are read through a FIFO (MPU-925x, ICM-20948).");
+    setComment("If false every sample in the FIFO is delivered and fused in turn. If true all the");
+    setComment("samples found by a read are averaged into one.");
+    setValue(RTIMULIB_FIFO_AVERAGE, m_fifoAverage);
+
+    setBlank();
+    setComment("");
+    setComment("FIFO poll target - how full (1 - 75%) IMUWaitForData() lets the FIFO get before it");
+    setComment("returns, when there's no data ready interrupt. Lower is less latency, higher is fewer");
+    setComment("reads. The wakeups are adjusted from the level each read finds. 0 polls at the fixed");
+    setComment("interval from IMUGetPollInterval() instead.");
+    setValue(RTIMULIB_FIFO_POLL_TARGET, m_fifoPollTarget);
+
+    setBlank();
+    setComment("");
+    setComment("Acquisition thread - how the thread started by RTIMU::startAcquisition() is run.");
+    setComment("The policy is 0 for normal scheduling, 1 for SCHED_FIFO at the priority (1 - 99)");
+    setComment("and 2 for SCHED_DEADLINE with the runtime in uS for each poll interval. The real");
+    setComment("time policies need CAP_SYS_NICE. The CPU is -1 to run on any. Locking memory");
+    setComment("and touching the stack in advance (in KB) avoid page faults once it is running.");
+    setValue(RTIMULIB_ACQUISITION_POLICY, m_acquisitionPolicy);
+    setValue(RTIMULIB_ACQUISITION_PRIORITY, m_acquisitionPriority);
+    setValue(RTIMULIB_ACQUISITION_RUNTIME, m_acquisitionRuntime);
+    setValue(RTIMULIB_ACQUISITION_CPU, m_acquisitionCPU);
+    setValue(RTIMULIB_ACQUISITION_LOCKMEMORY, m_acquisitionLockMemory);
+    setValue(RTIMULIB_ACQUISITION_STACKPREFAULT, m_acquisitionStackPrefault);
+
     //  Compass settings
 
     setBlank();
@@ -1267,6 +1708,25 @@ bool RTIMUSettings::saveSettings()
     setValue(RTIMULIB_GYRO_BIAS_Y, m_gyroBias.y());
     setValue(RTIMULIB_GYRO_BIAS_Z, m_gyroBias.z());
 
+    setBlank();
+    setComment("Gyro bias recorded at different die temperatures, used to start with a");
+    setComment("known bias instead of learning it");
+    m_gyroBiasLock.lock();
+    setValue(RTIMULIB_GYRO_BIAS_TEMP_COUNT, m_gyroBiasTempCount);
+    for (int i = 0; i < m_gyroBiasTempCount; i++) {
+        char key[64];
+
+        sprintf(key, RTIMULIB_GYRO_BIAS_TEMP, i);
+        setValue(key, m_gyroBiasTemp[i]);
+        sprintf(key, RTIMULIB_GYRO_BIAS_TEMP_X, i);
+        setValue(key, m_gyroBiasTempValue[i].x());
+        sprintf(key, RTIMULIB_GYRO_BIAS_TEMP_Y, i);
+        setValue(key, m_gyroBiasTempValue[i].y());
+        sprintf(key, RTIMULIB_GYRO_BIAS_TEMP_Z, i);
+        setValue(key, m_gyroBiasTempValue[i].z());
+    }
+    m_gyroBiasLock.unlock();
+
     //  MPU-9150 settings
 
     setBlank();
@@ -1873,6 +2333,18 @@ bool RTIMUSettings::saveSettings()
     setComment("  3 = +/- 1600 uT ");
     setValue(RTIMULIB_LSM9DS1_COMPASS_FSR, m_LSM9DS1CompassFsr);
 
+    setBlank();
+    setComment("");
+    setComment("FIFO enable - if true the gyro and accel are read through the FIFO. Samples");
+    setComment("are left to collect until there are LSM9DS1FifoThreshold of them and are then");
+    setComment("read in one go, which cuts bus traffic at high sample rates.");
+    setValue(RTIMULIB_LSM9DS1_FIFO_ENABLE, m_LSM9DS1FifoEnable);
+
+    setBlank();
+    setComment("");
+    setComment("FIFO threshold - samples to collect before reading the FIFO (1 - 31)");
+    setValue(RTIMULIB_LSM9DS1_FIFO_THRESHOLD, m_LSM9DS1FifoThreshold);
+
     //  BMX055 settings
 
     setBlank();
@@ -2038,6 +2510,22 @@ bool RTIMUSettings::saveSettings()
     setComment("  3 = ultra high power ");
     setValue(RTIMULIB_LSM6DS33LIS3MDL_COMPASS_POWERMODE, m_LSM6DS33LIS3MDLCompassPowerMode);
 
+    //  BNO055 settings
+
+    setBlank();
+    setComment("#####################################################################");
+    setComment("");
+    setComment("BNO055 settings");
+    setComment("");
+
+    setBlank();
+    setComment("");
+    setComment("Fusion passthrough - if true the quaternion, linear acceleration and gravity");
+    setComment("from the BNO055's own fusion are read in one burst each time the chip has a new");
+    setComment("sample and published as they are. Otherwise the pose is made from the Euler");
+    setComment("angles and read every sample interval.");
+    setValue(RTIMULIB_BNO055_FUSION_PASSTHROUGH, m_BNO055FusionPassthrough);
+
     fclose(m_fd);
     return true;
 }
@@ -2046,7 +2534,7 @@ bool RTIMUSettings::Detect_ICM20948(uint8_t slaveAddress)
 {
     // to read WHO AM I, we need to ensure we are on the right register bank
     uint8_t bank;
-    if (!HALRead(slaveAddress, ICM20948_REG_BANK_SEL, 1, &bank, ""))
+    if (!discoveryRead(slaveAddress, ICM20948_REG_BANK_SEL, &bank))
         return false;
         
     if(bank != ICM20948_BANK0) {
@@ -2069,6 +2557,86 @@ bool RTIMUSettings::Detect_ICM20948(uint8_t slaveAddress)
     return false;
 }
 
+bool RTIMUSettings::getGyroBiasAt(RTFLOAT temperature, RTVector3& bias)
+{
+    std::lock_guard<std::mutex> lock(m_gyroBiasLock);
+    int entry = findGyroBiasTemp(temperature);
+
+    if ((entry < 0) || (fabs(m_gyroBiasTemp[entry] - temperature) > RTIMULIB_GYRO_BIAS_TEMP_RANGE))
+        return false;
+
+    bias = m_gyroBiasTempValue[entry];
+    return true;
+}
+
+void RTIMUSettings::setGyroBiasAt(RTFLOAT temperature, const RTVector3& bias)
+{
+    std::lock_guard<std::mutex> lock(m_gyroBiasLock);
+    int entry = findGyroBiasTemp(temperature);
+
+    if ((entry < 0) || (fabs(m_gyroBiasTemp[entry] - temperature) > RTIMULIB_GYRO_BIAS_TEMP_RANGE)) {
+        if (m_gyroBiasTempCount < RTIMULIB_GYRO_BIAS_TEMPS) {
+            entry = m_gyroBiasTempCount++;
+        } else {
+            //  replace the entry furthest from this temperature
+
+            entry = 0;
+            for (int i = 1; i < m_gyroBiasTempCount; i++) {
+                if (fabs(m_gyroBiasTemp[i] - temperature) > fabs(m_gyroBiasTemp[entry] - temperature))
+                    entry = i;
+            }
+        }
+        m_gyroBiasTemp[entry] = temperature;
+    }
+    m_gyroBiasTempValue[entry] = bias;
+}
+
+int RTIMUSettings::findGyroBiasTemp(RTFLOAT temperature)
+{
+    int entry = -1;
+
+    for (int i = 0; i < m_gyroBiasTempCount; i++) {
+        if ((entry < 0) || (fabs(m_gyroBiasTemp[i] - temperature) < fabs(m_gyroBiasTemp[entry] - temperature)))
+            entry = i;
+    }
+    return entry;
+}
+
+bool RTIMUSettings::loadGyroBiasTemp(const char *key, const char *val)
+{
+    std::lock_guard<std::mutex> lock(m_gyroBiasLock);
+    int entry;
+    float ftemp;
+
+    if (strcmp(key, RTIMULIB_GYRO_BIAS_TEMP_COUNT) == 0) {
+        m_gyroBiasTempCount = atoi(val);
+        if (m_gyroBiasTempCount < 0)
+            m_gyroBiasTempCount = 0;
+        if (m_gyroBiasTempCount > RTIMULIB_GYRO_BIAS_TEMPS)
+            m_gyroBiasTempCount = RTIMULIB_GYRO_BIAS_TEMPS;
+        return true;
+    }
+
+    sscanf(val, "%f", &ftemp);
+
+    if (sscanf(key, RTIMULIB_GYRO_BIAS_TEMP, &entry) == 1) {
+        if ((entry >= 0) && (entry < RTIMULIB_GYRO_BIAS_TEMPS))
+            m_gyroBiasTemp[entry] = ftemp;
+    } else if (sscanf(key, RTIMULIB_GYRO_BIAS_TEMP_X, &entry) == 1) {
+        if ((entry >= 0) && (entry < RTIMULIB_GYRO_BIAS_TEMPS))
+            m_gyroBiasTempValue[entry].setX(ftemp);
+    } else if (sscanf(key, RTIMULIB_GYRO_BIAS_TEMP_Y, &entry) == 1) {
+        if ((entry >= 0) && (entry < RTIMULIB_GYRO_BIAS_TEMPS))
+            m_gyroBiasTempValue[entry].setY(ftemp);
+    } else if (sscanf(key, RTIMULIB_GYRO_BIAS_TEMP_Z, &entry) == 1) {
+        if ((entry >= 0) && (entry < RTIMULIB_GYRO_BIAS_TEMPS))
+            m_gyroBiasTempValue[entry].setZ(ftemp);
+    } else {
+        return false;
+    }
+    return true;
+}
+
 void RTIMUSettings::setBlank()
 {
     fprintf(m_fd, "\n");
@@ -30,6 +30,8 @@
 #include "RTMath.h"
 #include "RTIMUHal.h"
 
+#include <mutex>
+
 //  Settings keys
 
 #define RTIMULIB_IMU_TYPE                   "IMUType"
@@ -45,6 +47,16 @@
 #define RTIMULIB_I2C_PRESSUREADDRESS        "I2CPressureAddress"
 #define RTIMULIB_HUMIDITY_TYPE              "HumidityType"
 #define RTIMULIB_I2C_HUMIDITYADDRESS        "I2CHumidityAddress"
+#define RTIMULIB_DATAREADY_GPIOCHIP         "DataReadyGPIOChip"
+#define RTIMULIB_DATAREADY_GPIOLINE         "DataReadyGPIOLine"
+#define RTIMULIB_FIFO_AVERAGE               "FifoAverage"
+#define RTIMULIB_FIFO_POLL_TARGET           "FifoPollTarget"
+#define RTIMULIB_ACQUISITION_POLICY         "AcquisitionPolicy"
+#define RTIMULIB_ACQUISITION_PRIORITY       "AcquisitionPriority"
+#define RTIMULIB_ACQUISITION_RUNTIME        "AcquisitionRuntime"
+#define RTIMULIB_ACQUISITION_CPU            "AcquisitionCPU"
+#define RTIMULIB_ACQUISITION_LOCKMEMORY     "AcquisitionLockMemory"
+#define RTIMULIB_ACQUISITION_STACKPREFAULT  "AcquisitionStackPrefault"
 
 //  MPU9150 settings keys
 
@@ -142,6 +154,9 @@
 #define RTIMULIB_LSM9DS1_COMPASS_SAMPLERATE "LSM9DS1CompassSampleRate"
 #define RTIMULIB_LSM9DS1_COMPASS_FSR       "LSM9DS1CompassFsr"
 
+#define RTIMULIB_LSM9DS1_FIFO_ENABLE       "LSM9DS1FifoEnable"
+#define RTIMULIB_LSM9DS1_FIFO_THRESHOLD    "LSM9DS1FifoThreshold"
+
 //  BMX055 settings keys
 
 #define RTIMULIB_BMX055_GYRO_SAMPLERATE     "BMX055GyroSampleRate"
@@ -166,6 +181,10 @@
 #define RTIMULIB_LSM6DS33LIS3MDL_COMPASS_FSR "LSM6DS33LIS3MDLCompassFsr"
 #define RTIMULIB_LSM6DS33LIS3MDL_COMPASS_POWERMODE "LSM6DS33LIS3MDLCompassPowerMode"
 
+//  BNO055 settings keys
+
+#define RTIMULIB_BNO055_FUSION_PASSTHROUGH  "BNO055FusionPassthrough"
+
 //  Gyro bias keys
 
 #define RTIMULIB_GYRO_BIAS_VALID            "GyroBiasValid"
@@ -173,6 +192,17 @@
 #define RTIMULIB_GYRO_BIAS_Y                "GyroBiasY"
 #define RTIMULIB_GYRO_BIAS_Z                "GyroBiasZ"
 
+//  Gyro bias by die temperature keys. %d is the entry number.
+
+#define RTIMULIB_GYRO_BIAS_TEMP_COUNT       "GyroBiasTempCount"
+#define RTIMULIB_GYRO_BIAS_TEMP             "GyroBiasTemp%d"
+#define RTIMULIB_GYRO_BIAS_TEMP_X           "GyroBiasTempX%d"
+#define RTIMULIB_GYRO_BIAS_TEMP_Y           "GyroBiasTempY%d"
+#define RTIMULIB_GYRO_BIAS_TEMP_Z           "GyroBiasTempZ%d"
+
+#define RTIMULIB_GYRO_BIAS_TEMPS            8               // die temperatures that can have a recorded bias
+#define RTIMULIB_GYRO_BIAS_TEMP_RANGE       2.5             // degrees C either side of an entry's temperature that it covers
+
 //  Compass calibration and adjustment settings keys
 
 #define RTIMULIB_COMPASSCAL_VALID           "CompassCalValid"
@@ -222,6 +252,11 @@ public:
 
     RTIMUSettings(const char *settingsDirectory, const char *productType);
 
+    //  The discover functions first try the sensor found last time on the same I2C bus
+    //  and adapter, which is kept in a discovery cache file next to the settings file, and
+    //  check it with one read. Otherwise the candidate addresses are searched, with an
+    //  address that doesn't answer only tried once. What is found goes into the cache.
+
     //  This function tries to find an IMU. It stops at the first valid one
     //  and returns true or else false
 
@@ -237,6 +272,16 @@ public:
 
     bool discoverHumidity(int& humidityType, unsigned char& humidityAddress);
 
+    //  getGyroBiasAt() finds the gyro bias recorded nearest to a die temperature and returns
+    //  false if there isn't one within RTIMULIB_GYRO_BIAS_TEMP_RANGE. setGyroBiasAt() records
+    //  a bias, replacing the entry that covers the temperature or, if the table is full, the
+    //  one furthest from it. The table is saved with the other settings, but only when
+    //  saveSettings() is called - RTIMU::saveGyroBiasTable() does this. Both are safe to call
+    //  while another thread is saving the settings.
+
+    bool getGyroBiasAt(RTFLOAT temperature, RTVector3& bias);
+    void setGyroBiasAt(RTFLOAT temperature, const RTVector3& bias);
+
     //  This function sets the settings to default values.
 
     void setDefaults();
@@ -254,11 +299,25 @@ public:
     int m_imuType;                                          // type code of imu in use
     int m_fusionType;                                       // fusion algorithm type code
     unsigned char m_I2CSlaveAddress;                        // I2C slave address of the imu
-    int m_axisRotation;                                     // axis rotation code
+    int m_axisRotation;                                     // axis rotation code (see below)
     int m_pressureType;                                     // type code of pressure sensor in use
     unsigned char m_I2CPressureAddress;                     // I2C slave address of the pressure sensor
     int m_humidityType;                                     // type code of humidity sensor in use
     unsigned char m_I2CHumidityAddress;                     // I2C slave address of the humidity sensor
+    int m_dataReadyGPIOChip;                                // gpiochip of the IMU's data ready line, -1 if not connected
+    int m_dataReadyGPIOLine;                                // line on m_dataReadyGPIOChip
+    bool m_fifoAverage;                                     // true to average each FIFO read into one sample
+    int m_fifoPollTarget;                                   // percent full IMUWaitForData() lets the FIFO get, 0 for fixed polling
+
+    int m_acquisitionPolicy;                                // scheduling of the RTIMU::startAcquisition() thread
+    int m_acquisitionPriority;                              // its SCHED_FIFO priority
+    int m_acquisitionRuntime;                               // its SCHED_DEADLINE runtime in uS per poll interval
+    int m_acquisitionCPU;                                   // the CPU it runs on, -1 for any
+    bool m_acquisitionLockMemory;                           // true to lock the process in memory when it starts
+    int m_acquisitionStackPrefault;                         // KB of its stack to touch when it starts
+
+    //  The IMU works from transforms built from the axis rotation and the calibration below,
+    //  so changes to them only take effect when RTIMU::setCalibrationData() is called
 
     bool m_compassCalValid;                                 // true if there is valid compass calibration data
     RTVector3 m_compassCalMin;                              // the minimum values
@@ -277,6 +336,10 @@ public:
     bool m_gyroBiasValid;                                   // true if the recorded gyro bias is valid
     RTVector3 m_gyroBias;                                   // the recorded gyro bias
 
+    int m_gyroBiasTempCount;                                // entries in the gyro bias by temperature table
+    RTFLOAT m_gyroBiasTemp[RTIMULIB_GYRO_BIAS_TEMPS];       // the die temperature of each entry
+    RTVector3 m_gyroBiasTempValue[RTIMULIB_GYRO_BIAS_TEMPS];    // the gyro bias at that temperature
+
     float m_kalmanRk, m_kalmanQ;
 
     //  IMU-specific vars
@@ -375,6 +438,9 @@ public:
     int m_LSM9DS1CompassSampleRate;                         // the compass sample rate
     int m_LSM9DS1CompassFsr;                                // the compass full scale range
 
+    bool m_LSM9DS1FifoEnable;                               // true to read the gyro and accel through the FIFO
+    int m_LSM9DS1FifoThreshold;                             // samples in the FIFO before it is read (1 - 31)
+
     //  BMX055
 
     int m_BMX055GyroSampleRate;                             // the gyro sample rate
@@ -399,15 +465,36 @@ public:
     int m_LSM6DS33LIS3MDLCompassFsr;                        // the compass full scale range
     int m_LSM6DS33LIS3MDLCompassPowerMode;                  // the compass power mode
 
+    //  BNO055
+
+    bool m_BNO055FusionPassthrough;                         // true to publish the chip's quaternion directly
+
 private:
+    bool searchIMU(int& imuType, bool& busIsI2C, unsigned char& slaveAddress);
+    bool searchPressure(int& pressureType, unsigned char& pressureAddress);
+    bool searchHumidity(int& humidityType, unsigned char& humidityAddress);
+    bool discoveryRead(unsigned char slaveAddress, unsigned char regAddr, unsigned char *result);
+    bool discoveryCheck(int kind, int type, unsigned char slaveAddress);    // checks a cached result with one read
+    bool discoveryCacheLookup(int kind, int& type, unsigned char& slaveAddress);
+    void discoveryCacheStore(int kind, int type, unsigned char slaveAddress);
+    void discoveryKey(char *key, int kind);                 // cache key for the current I2C bus and adapter
     bool Detect_ICM20948(uint8_t slaveAddress);
+    bool loadGyroBiasTemp(const char *key, const char *val);    // true if key is in the gyro bias table
+    int findGyroBiasTemp(RTFLOAT temperature);              // the nearest entry or -1 if there are none
     void setBlank();
     void setComment(const char *comment);
     void setValue(const char *key, const bool val);
     void setValue(const char *key, const int val);
     void setValue(const char *key, const RTFLOAT val);
 
+    std::mutex m_gyroBiasLock;                              // protects the gyro bias by temperature table
+
     char m_filename[256];                                    // the settings file name
+    char m_discoveryFilename[256];                           // the discovery cache file name
+
+    int m_discoveryBus;                                     // the I2C bus that has been probed, -1 if none
+    unsigned char m_discoveryPresent[16];                   // a bit for each address that has answered
+    unsigned char m_discoveryAbsent[16];                    // a bit for each address that hasn't
 
     FILE *m_fd;
 };
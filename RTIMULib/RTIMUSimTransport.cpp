@@ -0,0 +1,865 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "RTIMUSimTransport.h"
+#include "IMUDrivers/RTIMUDefs.h"
+#include "IMUDrivers/RTIMUHMC5883LADXL345.h"
+#include "IMUDrivers/RTPressureDefs.h"
+#include "IMUDrivers/RTHumidityDefs.h"
+
+//----------------------------------------------------------
+//
+//  RTIMUSimDevice
+
+RTIMUSimDevice::RTIMUSimDevice(RTIMUSimTransport *transport, unsigned char slaveAddr)
+{
+    m_transport = transport;
+    m_slaveAddr = slaveAddr;
+    m_regMask = 0xff;
+    m_bankReg = RTIMUSIM_NO_REG;
+    m_bankShift = 0;
+    m_bank = 0;
+    m_pointer = 0;
+
+    m_sampleInterval = 0;
+    m_rateDivReg = RTIMUSIM_NO_REG;
+    m_rateBase = 0;
+    m_lastSample = 0;
+    m_sampleCount = 0;
+
+    m_statusReg = RTIMUSIM_NO_REG;
+    m_statusBits = 0;
+    m_dataReg = RTIMUSIM_NO_REG;
+
+    m_fifoReg = RTIMUSIM_NO_REG;
+    m_fifoCountReg = RTIMUSIM_NO_REG;
+    m_fifoCountMode = RTIMUSIM_FIFO_COUNT_BYTES;
+    m_fifoCountMask = 0;
+    m_fifoOverflowBit = 0;
+    m_fifoEnableReg = RTIMUSIM_NO_REG;
+    m_fifoEnableBit = 0;
+    m_fifoResetReg = RTIMUSIM_NO_REG;
+    m_fifoResetBit = 0;
+    m_fifoResetOnClear = false;
+    m_fifoSize = 0;
+    m_frameBlocks = 0;
+    for (int i = 0; i < RTIMUSIM_MAX_FRAME_BLOCKS; i++)
+        m_frameEnableBit[i] = 0;
+    m_fifoHead = 0;
+    m_fifoCount = 0;
+    m_fifoOverflow = false;
+
+    m_auxSlaves = 0;
+    m_auxDataReg = RTIMUSIM_NO_REG;
+    m_auxTriggerReg = RTIMUSIM_NO_REG;
+
+    memset(m_regs, 0, sizeof(m_regs));
+    memset(m_selfClear, 0, sizeof(m_selfClear));
+}
+
+void RTIMUSimDevice::setReg(int reg, unsigned char value)
+{
+    m_regs[(reg >> 8) & (RTIMUSIM_BANKS - 1)][reg & 0xff] = value;
+}
+
+unsigned char RTIMUSimDevice::getReg(int reg)
+{
+    return m_regs[(reg >> 8) & (RTIMUSIM_BANKS - 1)][reg & 0xff];
+}
+
+void RTIMUSimDevice::setReg16(int reg, int16_t value, bool bigEndian)
+{
+    if (bigEndian) {
+        setReg(reg, (unsigned char)(value >> 8));
+        setReg(reg + 1, (unsigned char)value);
+    } else {
+        setReg(reg, (unsigned char)value);
+        setReg(reg + 1, (unsigned char)(value >> 8));
+    }
+}
+
+int RTIMUSimDevice::decode(unsigned char regAddr)
+{
+    return RTIMUSIM_REG(m_bank, regAddr & m_regMask);
+}
+
+bool RTIMUSimDevice::read(unsigned char regAddr, unsigned char length, unsigned char *data)
+{
+    int reg = decode(regAddr);
+    bool clearStatus = false;
+
+    m_pointer = regAddr & m_regMask;
+
+    for (int i = 0; i < length; i++) {
+        if (reg == m_dataReg)
+            clearStatus = true;
+        data[i] = readByte(reg);
+        if (reg != m_fifoReg)
+            reg = (reg & 0xf00) | ((reg + 1) & 0xff);
+    }
+
+    if (clearStatus && (m_statusReg != RTIMUSIM_NO_REG))
+        setReg(m_statusReg, getReg(m_statusReg) & ~m_statusBits);
+    return true;
+}
+
+bool RTIMUSimDevice::read(unsigned char length, unsigned char *data)
+{
+    return read(m_pointer, length, data);
+}
+
+bool RTIMUSimDevice::write(unsigned char regAddr, unsigned char length, unsigned char const *data)
+{
+    int reg = decode(regAddr);
+
+    m_pointer = regAddr & m_regMask;
+
+    for (int i = 0; i < length; i++) {
+        writeByte(reg, data[i]);
+        reg = (reg & 0xf00) | ((reg + 1) & 0xff);
+    }
+    return true;
+}
+
+unsigned char RTIMUSimDevice::readByte(int reg)
+{
+    unsigned char value;
+    int frames;
+    int offset;
+
+    if ((m_bankReg != RTIMUSIM_NO_REG) && ((reg & 0xff) == m_bankReg))
+        return m_bank << m_bankShift;
+
+    if (reg == m_fifoReg) {
+        if (m_fifoCount == 0)
+            return 0;
+        value = m_fifo[m_fifoHead];
+        m_fifoHead = (m_fifoHead + 1) % RTIMUSIM_FIFO_SIZE;
+        m_fifoCount--;
+        return value;
+    }
+
+    if ((m_fifoReg == RTIMUSIM_FIFO_OUTPUT) && (m_fifoCount > 0) && ((offset = frameOffset(reg)) >= 0)) {
+        value = m_fifo[(m_fifoHead + offset) % RTIMUSIM_FIFO_SIZE];
+        if (offset == frameSize() - 1) {
+            m_fifoHead = (m_fifoHead + frameSize()) % RTIMUSIM_FIFO_SIZE;
+            m_fifoCount -= frameSize();
+        }
+        return value;
+    }
+
+    if (m_fifoCountReg != RTIMUSIM_NO_REG) {
+        if (m_fifoCountMode == RTIMUSIM_FIFO_COUNT_BYTES) {
+            if (reg == m_fifoCountReg)
+                return m_fifoCount >> 8;
+            if (reg == m_fifoCountReg + 1)
+                return m_fifoCount & 0xff;
+        } else if (reg == m_fifoCountReg) {
+            frames = frameSize() > 0 ? m_fifoCount / frameSize() : 0;
+            return (frames & m_fifoCountMask) | (m_fifoOverflow ? m_fifoOverflowBit : 0);
+        }
+    }
+    return getReg(reg);
+}
+
+void RTIMUSimDevice::writeByte(int reg, unsigned char value)
+{
+    if ((m_bankReg != RTIMUSIM_NO_REG) && ((reg & 0xff) == m_bankReg)) {
+        m_bank = (value >> m_bankShift) & (RTIMUSIM_BANKS - 1);
+        return;
+    }
+
+    setReg(reg, value & ~m_selfClear[(reg >> 8) & (RTIMUSIM_BANKS - 1)][reg & 0xff]);
+
+    if ((reg == m_fifoResetReg) && (((value & m_fifoResetBit) != 0) != m_fifoResetOnClear)) {
+        m_fifoHead = 0;
+        m_fifoCount = 0;
+        m_fifoOverflow = false;
+    }
+
+    if (reg == m_auxTriggerReg)
+        auxTransfer();
+}
+
+bool RTIMUSimDevice::frameBlockEnabled(int block)
+{
+    if ((m_frameEnableBit[block] == 0) || (m_fifoEnableReg == RTIMUSIM_NO_REG))
+        return true;
+    return (getReg(m_fifoEnableReg) & m_frameEnableBit[block]) != 0;
+}
+
+int RTIMUSimDevice::frameSize()
+{
+    int size = 0;
+
+    for (int i = 0; i < m_frameBlocks; i++) {
+        if (frameBlockEnabled(i))
+            size += m_frameLen[i];
+    }
+    return size;
+}
+
+int RTIMUSimDevice::frameOffset(int reg)
+{
+    int offset = 0;
+
+    for (int i = 0; i < m_frameBlocks; i++) {
+        if ((reg >= m_frameReg[i]) && (reg < m_frameReg[i] + m_frameLen[i]))
+            return offset + reg - m_frameReg[i];
+        offset += m_frameLen[i];
+    }
+    return -1;
+}
+
+uint64_t RTIMUSimDevice::sampleInterval()
+{
+    if ((m_rateDivReg != RTIMUSIM_NO_REG) && (m_rateBase > 0))
+        return ((uint64_t)getReg(m_rateDivReg) + 1) * 1000000 / m_rateBase;
+    return m_sampleInterval;
+}
+
+uint64_t RTIMUSimDevice::nextSampleTime()
+{
+    uint64_t interval = sampleInterval();
+
+    if (interval == 0)
+        return 0;
+    return m_lastSample + interval;
+}
+
+void RTIMUSimDevice::update(uint64_t now)
+{
+    uint64_t interval = sampleInterval();
+    uint64_t maxSamples;
+
+    if (interval == 0)
+        return;
+
+    //  after a long gap only the samples that could still be in the FIFO matter
+
+    maxSamples = (frameSize() > 0 ? m_fifoSize / frameSize() : 0) + 1;
+    if ((now - m_lastSample) / interval > maxSamples)
+        m_lastSample = now - maxSamples * interval;
+
+    while ((m_lastSample + interval) <= now) {
+        m_lastSample += interval;
+        sample();
+    }
+}
+
+void RTIMUSimDevice::sample()
+{
+    int reg;
+
+    m_sampleCount++;
+    auxTransfer();
+
+    if (m_statusReg != RTIMUSIM_NO_REG)
+        setReg(m_statusReg, getReg(m_statusReg) | m_statusBits);
+
+    if (m_fifoReg == RTIMUSIM_NO_REG)
+        return;
+
+    if ((m_fifoEnableReg != RTIMUSIM_NO_REG) && ((getReg(m_fifoEnableReg) & m_fifoEnableBit) == 0))
+        return;
+
+    //  FIFOs with a byte count keep going when full, overwriting the oldest bytes, and
+    //  the others stop
+
+    if ((m_fifoCount + frameSize()) > m_fifoSize) {
+        m_fifoOverflow = true;
+        if (m_fifoCountMode != RTIMUSIM_FIFO_COUNT_BYTES)
+            return;
+    }
+
+    for (int block = 0; block < m_frameBlocks; block++) {
+        if (!frameBlockEnabled(block))
+            continue;
+        reg = m_frameReg[block];
+        for (int i = 0; i < m_frameLen[block]; i++) {
+            if (m_fifoCount == m_fifoSize) {
+                m_fifoHead = (m_fifoHead + 1) % RTIMUSIM_FIFO_SIZE;
+                m_fifoCount--;
+            }
+            m_fifo[(m_fifoHead + m_fifoCount) % RTIMUSIM_FIFO_SIZE] = getReg(reg + i);
+            m_fifoCount++;
+        }
+    }
+}
+
+void RTIMUSimDevice::auxTransfer()
+{
+    RTIMUSimDevice *slave;
+    unsigned char addr, ctrl, data;
+    unsigned char buf[16];
+    int offset = 0;
+
+    for (int i = 0; i < m_auxSlaves; i++) {
+        ctrl = getReg(m_auxCtrlReg[i]);
+        if ((ctrl & 0x80) == 0)
+            continue;
+        addr = getReg(m_auxAddrReg[i]);
+        slave = m_transport->findDevice(addr & 0x7f);
+
+        if (addr & 0x80) {
+            memset(buf, 0, sizeof(buf));
+            if (slave != NULL)
+                slave->read(getReg(m_auxRegReg[i]), ctrl & 0x0f, buf);
+            for (int j = 0; j < (ctrl & 0x0f); j++)
+                setReg(m_auxDataReg + offset++, buf[j]);
+        } else if (slave != NULL) {
+            data = getReg(m_auxDoReg[i]);
+            slave->write(getReg(m_auxRegReg[i]), 1, &data);
+        }
+    }
+}
+
+//----------------------------------------------------------
+//
+//  RTIMUSimTransport
+
+RTIMUSimTransport::RTIMUSimTransport()
+{
+    m_deviceCount = 0;
+    m_time = 0;
+    m_busSpeed = 400000;
+    m_transactions = 0;
+    m_maxRead = MAX_READ_LEN;
+}
+
+RTIMUSimTransport::~RTIMUSimTransport()
+{
+    for (int i = 0; i < m_deviceCount; i++)
+        delete m_devices[i];
+}
+
+RTIMUSimDevice *RTIMUSimTransport::addDevice(unsigned char slaveAddr)
+{
+    RTIMUSimDevice *device;
+
+    if (findDevice(slaveAddr) != NULL) {
+        HAL_ERROR1("Simulated device at %d already exists\n", slaveAddr);
+        return NULL;
+    }
+
+    if (m_deviceCount == RTIMUSIM_MAX_DEVICES) {
+        HAL_ERROR("Too many simulated devices\n");
+        return NULL;
+    }
+
+    device = new RTIMUSimDevice(this, slaveAddr);
+    m_devices[m_deviceCount++] = device;
+    return device;
+}
+
+RTIMUSimDevice *RTIMUSimTransport::findDevice(unsigned char slaveAddr)
+{
+    for (int i = 0; i < m_deviceCount; i++) {
+        if (m_devices[i]->m_slaveAddr == slaveAddr)
+            return m_devices[i];
+    }
+    return NULL;
+}
+
+bool RTIMUSimTransport::open()
+{
+    return true;
+}
+
+void RTIMUSimTransport::close()
+{
+}
+
+//  transaction() accounts for the bus time of a transfer of length data bytes plus
+//  address and register bytes and brings the addressed device up to date.
+
+RTIMUSimDevice *RTIMUSimTransport::transaction(unsigned char slaveAddr, int length)
+{
+    RTIMUSimDevice *device;
+
+    m_transactions++;
+    m_time += ((uint64_t)(length + 2) * 9 * 1000000 + m_busSpeed - 1) / m_busSpeed;
+
+    device = findDevice(slaveAddr);
+    if (device != NULL)
+        device->update(m_time);
+    return device;
+}
+
+bool RTIMUSimTransport::read(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                    unsigned char *data, const char *errorMsg)
+{
+    RTIMUSimDevice *device = transaction(slaveAddr, length);
+
+    if ((device == NULL) || (length > m_maxRead)) {
+        if (strlen(errorMsg) > 0)
+            HAL_ERROR3("Simulated read error from %d, %d - %s\n", slaveAddr, regAddr, errorMsg);
+        return false;
+    }
+    return device->read(regAddr, length, data);
+}
+
+bool RTIMUSimTransport::read(unsigned char slaveAddr, unsigned char length,
+                    unsigned char *data, const char *errorMsg)
+{
+    RTIMUSimDevice *device = transaction(slaveAddr, length);
+
+    if ((device == NULL) || (length > m_maxRead)) {
+        if (strlen(errorMsg) > 0)
+            HAL_ERROR2("Simulated read error from %d - %s\n", slaveAddr, errorMsg);
+        return false;
+    }
+    return device->read(length, data);
+}
+
+bool RTIMUSimTransport::write(unsigned char slaveAddr, unsigned char regAddr,
+                   unsigned char length, unsigned char const *data, const char *errorMsg)
+{
+    RTIMUSimDevice *device = transaction(slaveAddr, length);
+
+    if (device == NULL) {
+        if (strlen(errorMsg) > 0)
+            HAL_ERROR3("Simulated write error to %d, %d - %s\n", slaveAddr, regAddr, errorMsg);
+        return false;
+    }
+    return device->write(regAddr, length, data);
+}
+
+void RTIMUSimTransport::delayMs(int milliSeconds)
+{
+    m_time += (uint64_t)milliSeconds * 1000;
+}
+
+//----------------------------------------------------------
+//
+//  Chip models. Output registers hold a level, stationary device: 1g on z and
+//  a constant magnetic field.
+
+//  addInvenSense() sets up the part of the register map that the MPU-9150, MPU-9250
+//  and MPU-9255 have in common: the sample rate divider, data ready, the FIFO and the
+//  aux I2C master.
+
+RTIMUSimDevice *RTIMUSimTransport::addInvenSense(unsigned char slaveAddr, unsigned char id)
+{
+    RTIMUSimDevice *device = addDevice(slaveAddr);
+
+    if (device == NULL)
+        return NULL;
+
+    device->setReg(MPU925x_WHO_AM_I, id);
+    device->setReg(MPU925x_PWR_MGMT_1, 0x40);
+    device->m_selfClear[0][MPU925x_PWR_MGMT_1] = 0x80;
+    device->setReg16(MPU925x_ACCEL_XOUT_H + 4, 16384, true);
+
+    device->m_rateDivReg = MPU925x_SMPRT_DIV;
+    device->m_rateBase = 1000;
+    device->m_statusReg = MPU925x_INT_STATUS;
+    device->m_statusBits = 0x01;
+    device->m_dataReg = MPU925x_ACCEL_XOUT_H;
+
+    device->m_fifoReg = MPU925x_FIFO_R_W;
+    device->m_fifoCountReg = MPU925x_FIFO_COUNT_H;
+    device->m_fifoCountMode = RTIMUSIM_FIFO_COUNT_BYTES;
+    device->m_fifoEnableReg = MPU925x_FIFO_EN;             // the drivers set this last
+    device->m_fifoEnableBit = 0x08;                         // ACCEL_FIFO_EN
+    device->m_fifoResetReg = MPU925x_USER_CTRL;
+    device->m_fifoResetBit = 0x04;
+    device->m_selfClear[0][MPU925x_USER_CTRL] = 0x04;
+    device->m_frameReg[0] = MPU925x_ACCEL_XOUT_H;
+    device->m_frameLen[0] = 6;
+    device->m_frameReg[1] = MPU925x_GYRO_XOUT_H;
+    device->m_frameLen[1] = 6;
+    device->m_frameBlocks = 2;
+
+    for (int i = 0; i < RTIMUSIM_MAX_AUX_SLAVES; i++) {
+        device->m_auxAddrReg[i] = MPU925x_I2C_SLV0_ADDR + 3 * i;
+        device->m_auxRegReg[i] = MPU925x_I2C_SLV0_REG + 3 * i;
+        device->m_auxCtrlReg[i] = MPU925x_I2C_SLV0_CTRL + 3 * i;
+        device->m_auxDoReg[i] = MPU925x_I2C_SLV1_DO - 1 + i;
+    }
+    device->m_auxSlaves = RTIMUSIM_MAX_AUX_SLAVES;
+    device->m_auxDataReg = MPU925x_EXT_SENS_DATA_00;
+    return device;
+}
+
+//  addST() sets up an ST style device: 0x80 in the register address is the auto
+//  increment flag and outputs are little endian.
+
+RTIMUSimDevice *RTIMUSimTransport::addST(unsigned char slaveAddr, unsigned char whoAmIReg, unsigned char id)
+{
+    RTIMUSimDevice *device = addDevice(slaveAddr);
+
+    if (device == NULL)
+        return NULL;
+
+    device->m_regMask = 0x7f;
+    device->setReg(whoAmIReg, id);
+    return device;
+}
+
+bool RTIMUSimTransport::addIMU(int imuType)
+{
+    RTIMUSimDevice *device;
+    RTIMUSimDevice *compass;
+
+    switch (imuType) {
+    case RTIMU_TYPE_MPU9150:
+        if ((device = addInvenSense(MPU9150_ADDRESS0, MPU9150_ID)) == NULL)
+            return false;
+        device->m_fifoSize = 1024;
+        device->setReg16(MPU9150_ACCEL_XOUT_H + 4, 4096, true);
+        if ((compass = addDevice(AK8975_ADDRESS)) == NULL)
+            return false;
+        compass->setReg(0x00, 0x48);                        // WIA
+        compass->setReg(AK8975_ST1, 0x01);
+        compass->setReg16(AK8975_ST1 + 1, 100, false);
+        compass->setReg16(AK8975_ST1 + 5, -300, false);
+        compass->setReg(AK8975_ASAX, 128);
+        compass->setReg(AK8975_ASAX + 1, 128);
+        compass->setReg(AK8975_ASAX + 2, 128);
+        return true;
+
+    case RTIMU_TYPE_MPU925x:
+        if ((device = addInvenSense(MPU925x_ADDRESS0, MPU9250_ID)) == NULL)
+            return false;
+        device->m_fifoSize = 512;
+        device->m_frameReg[2] = MPU925x_EXT_SENS_DATA_00;
+        device->m_frameLen[2] = 6;
+        device->m_frameEnableBit[2] = 0x01;                 // SLV0 in FIFO_EN
+        device->m_frameBlocks = 3;
+        if ((compass = addDevice(AK8963_ADDRESS)) == NULL)
+            return false;
+        compass->setReg(0x00, 0x48);                        // WIA
+        compass->setReg(AK8963_ST1, 0x01);
+        compass->setReg16(AK8963_ST1 + 1, 100, false);
+        compass->setReg16(AK8963_ST1 + 5, -300, false);
+        compass->setReg(AK8963_ST1 + 7, 0x10);              // ST2 - 16 bit output
+        compass->setReg(AK8963_ASAX, 128);
+        compass->setReg(AK8963_ASAX + 1, 128);
+        compass->setReg(AK8963_ASAX + 2, 128);
+        return true;
+
+    case RTIMU_TYPE_ICM20948:
+        if ((device = addDevice(ICM20948_ADDRESS0)) == NULL)
+            return false;
+        device->m_bankReg = ICM20948_REG_BANK_SEL;
+        device->m_bankShift = 4;
+        device->setReg(ICM20948_WHO_AM_I, ICM20948_ID);
+        device->setReg(ICM20948_PWR_MGMT_1, 0x41);
+        device->m_selfClear[0][ICM20948_PWR_MGMT_1] = 0x80;
+        device->setReg16(ICM20948_ACCEL_XOUT_H + 4, 16384, true);
+
+        device->m_rateDivReg = RTIMUSIM_REG(ICM20948_BANK2 >> 4, ICM20948_GYRO_SMPLRT_DIV);
+        device->m_rateBase = 1125;
+        device->m_statusReg = ICM20948_INT_STATUS + 1;      // INT_STATUS_1
+        device->m_statusBits = 0x01;
+        device->m_dataReg = ICM20948_ACCEL_XOUT_H;
+
+        device->m_fifoReg = ICM20948_FIFO_R_W;
+        device->m_fifoCountReg = ICM20948_FIFO_COUNTH;
+        device->m_fifoCountMode = RTIMUSIM_FIFO_COUNT_BYTES;
+        device->m_fifoEnableReg = ICM20948_USER_CTRL;
+        device->m_fifoEnableBit = 0x40;
+        device->m_fifoResetReg = ICM20948_FIFO_RST;
+        device->m_fifoResetBit = 0x01;
+        device->m_fifoSize = 512;
+        device->m_frameReg[0] = ICM20948_ACCEL_XOUT_H;
+        device->m_frameLen[0] = 6;
+        device->m_frameReg[1] = ICM20948_GYRO_XOUT_H;
+        device->m_frameLen[1] = 6;
+        device->m_frameReg[2] = ICM20948_EXT_SLV_SENS_DATA_00;
+        device->m_frameLen[2] = 8;
+        device->m_frameBlocks = 3;
+
+        for (int i = 0; i < RTIMUSIM_MAX_AUX_SLAVES; i++) {
+            device->m_auxAddrReg[i] = RTIMUSIM_REG(ICM20948_BANK3 >> 4, ICM20948_I2C_SLV0_ADDR + 4 * i);
+            device->m_auxRegReg[i] = RTIMUSIM_REG(ICM20948_BANK3 >> 4, ICM20948_I2C_SLV0_REG + 4 * i);
+            device->m_auxCtrlReg[i] = RTIMUSIM_REG(ICM20948_BANK3 >> 4, ICM20948_I2C_SLV0_CTRL + 4 * i);
+            device->m_auxDoReg[i] = RTIMUSIM_REG(ICM20948_BANK3 >> 4, ICM20948_I2C_SLV0_DO + 4 * i);
+        }
+        device->m_auxSlaves = RTIMUSIM_MAX_AUX_SLAVES;
+        device->m_auxDataReg = ICM20948_EXT_SLV_SENS_DATA_00;
+        device->m_auxTriggerReg = ICM20948_USER_CTRL;
+
+        if ((compass = addDevice(AK09916_ADDRESS)) == NULL)
+            return false;
+        compass->setReg(AK09916_WHO_AM_I, 0x09);
+        compass->setReg(AK09916_ST1, 0x01);
+        compass->setReg16(AK09916_ST1 + 1, 100, false);
+        compass->setReg16(AK09916_ST1 + 5, -300, false);
+        compass->m_selfClear[0][AK09916_CNTL3] = 0x01;
+        return true;
+
+    case RTIMU_TYPE_GD20HM303D:
+    case RTIMU_TYPE_GD20M303DLHC:
+    case RTIMU_TYPE_GD20HM303DLHC:
+    case RTIMU_TYPE_LSM9DS0:
+        //  these share the L3GD20(H) gyro register layout
+
+        if (imuType == RTIMU_TYPE_GD20HM303D || imuType == RTIMU_TYPE_GD20HM303DLHC)
+            device = addST(L3GD20H_ADDRESS0, L3GD20H_WHO_AM_I, L3GD20H_ID);
+        else
+            device = addST(L3GD20_ADDRESS0, L3GD20_WHO_AM_I, L3GD20_ID);
+        if (device == NULL)
+            return false;
+        device->m_sampleInterval = 1000000 / 95;
+        device->m_statusReg = L3GD20H_STATUS;
+        device->m_statusBits = 0x0f;
+        device->m_dataReg = L3GD20H_OUT_X_L;
+
+        if (imuType == RTIMU_TYPE_GD20HM303D || imuType == RTIMU_TYPE_LSM9DS0) {
+            //  combined accel and mag
+
+            if ((device = addST(LSM303D_ADDRESS0, LSM303D_WHO_AM_I, LSM303D_ID)) == NULL)
+                return false;
+            device->m_sampleInterval = 1000000 / 50;        // the default compass rate
+            device->m_statusReg = LSM303D_STATUS_M;
+            device->m_statusBits = 0x08;
+            device->m_dataReg = LSM303D_OUT_X_L_M;
+            device->setReg16(LSM303D_OUT_X_L_A + 4, 4096, false);
+            device->setReg16(LSM303D_OUT_X_L_M, 1000, false);
+            device->setReg16(LSM303D_OUT_X_L_M + 4, -3000, false);
+        } else {
+            //  separate accel and mag, accel has no id register
+
+            if ((device = addST(LSM303DLHC_ACCEL_ADDRESS, LSM303DLHC_STATUS_A, 0x0f)) == NULL)
+                return false;
+            device->setReg16(LSM303DLHC_OUT_X_L_A + 4, 4000, false);
+            if ((device = addST(LSM303DLHC_COMPASS_ADDRESS, LSM303DLHC_STATUS_M, 0x01)) == NULL)
+                return false;
+            device->setReg16(LSM303DLHC_OUT_X_H_M, 300, true);
+            device->setReg16(LSM303DLHC_OUT_X_H_M + 2, -600, true);
+        }
+        return true;
+
+    case RTIMU_TYPE_LSM9DS1:
+        if ((device = addST(LSM9DS1_ADDRESS0, LSM9DS1_WHO_AM_I, LSM9DS1_ID)) == NULL)
+            return false;
+        device->m_sampleInterval = 1000000 / 119;
+        device->m_statusReg = LSM9DS1_STATUS;
+        device->m_statusBits = 0x03;
+        device->m_dataReg = LSM9DS1_OUT_X_L_G;
+        device->m_fifoReg = RTIMUSIM_FIFO_OUTPUT;
+        device->m_fifoCountReg = LSM9DS1_FIFO_SRC;
+        device->m_fifoCountMode = RTIMUSIM_FIFO_COUNT_FRAMES;
+        device->m_fifoCountMask = 0x3f;
+        device->m_fifoOverflowBit = 0x40;
+        device->m_fifoEnableReg = LSM9DS1_CTRL9;
+        device->m_fifoEnableBit = 0x02;
+        device->m_fifoResetReg = LSM9DS1_FIFO_CTRL;         // bypass mode empties the FIFO
+        device->m_fifoResetBit = 0xe0;
+        device->m_fifoResetOnClear = true;
+        device->m_fifoSize = 32 * 12;
+        device->m_frameReg[0] = LSM9DS1_OUT_X_L_G;
+        device->m_frameLen[0] = 6;
+        device->m_frameReg[1] = LSM9DS1_OUT_X_L_XL;
+        device->m_frameLen[1] = 6;
+        device->m_frameBlocks = 2;
+        device->setReg16(LSM9DS1_OUT_X_L_XL + 4, 4096, false);
+        if ((device = addST(LSM9DS1_MAG_ADDRESS0, LSM9DS1_MAG_WHO_AM_I, LSM9DS1_MAG_ID)) == NULL)
+            return false;
+        device->setReg16(LSM9DS1_MAG_OUT_X_L, 1000, false);
+        device->setReg16(LSM9DS1_MAG_OUT_X_L + 4, -3000, false);
+        return true;
+
+    case RTIMU_TYPE_LSM6DS33LIS3MDL:
+        if ((device = addST(LSM6DS33_ADDRESS0, LSM6DS33_WHO_AM_I, LSM6DS33_ID)) == NULL)
+            return false;
+        device->m_sampleInterval = 1000000 / 104;
+        device->m_statusReg = LSM6DS33_STATUS_REG;
+        device->m_statusBits = 0x03;
+        device->m_dataReg = LSM6DS33_OUTX_L_G;
+        device->setReg16(LSM6DS33_OUTX_L_XL + 4, 16384, false);
+        if ((device = addST(LIS3MDL_ADDRESS0, LIS3MDL_WHO_AM_I, LIS3MDL_ID)) == NULL)
+            return false;
+        device->m_sampleInterval = 1000000 / 10;            // the default compass rate
+        device->m_statusReg = LIS3MDL_STATUS_REG;
+        device->m_statusBits = 0x08;
+        device->m_dataReg = LIS3MDL_OUT_X_L;
+        device->setReg16(LIS3MDL_OUT_X_L, 1000, false);
+        device->setReg16(LIS3MDL_OUT_X_L + 4, -3000, false);
+        return true;
+
+    case RTIMU_TYPE_HMC5883LADXL345:
+        if ((device = addST(L3G4200D_ADDRESS, L3GD20H_WHO_AM_I, 0xd3)) == NULL)
+            return false;
+        device->m_sampleInterval = 1000000 / 100;
+        device->m_statusReg = L3GD20H_STATUS;
+        device->m_statusBits = 0x0f;
+        device->m_dataReg = L3GD20H_OUT_X_L;
+        if ((device = addDevice(ADXL345_ADDRESS)) == NULL)
+            return false;
+        device->setReg(0x00, 0xe5);                         // DEVID
+        device->setReg16(0x32 + 4, 26, false);
+        if ((device = addDevice(HMC5883_ADDRESS)) == NULL)
+            return false;
+        device->m_regMask = 0x7f;
+        device->setReg(HMC5883_ID, 0x48);
+        device->setReg(HMC5883_ID + 1, 0x34);
+        device->setReg(HMC5883_ID + 2, 0x33);
+        device->setReg16(HMC5883_DATA_X_HI, 300, true);
+        device->setReg16(HMC5883_DATA_X_HI + 2, -600, true);
+        return true;
+
+    case RTIMU_TYPE_BMX055:
+        if ((device = addDevice(BMX055_GYRO_ADDRESS0)) == NULL)
+            return false;
+        device->setReg(BMX055_GYRO_WHO_AM_I, BMX055_GYRO_ID);
+        device->m_sampleInterval = 1000000 / 100;
+        device->m_fifoReg = BMX055_GYRO_FIFO_DATA;
+        device->m_fifoCountReg = BMX055_GYRO_FIFO_STATUS;
+        device->m_fifoCountMode = RTIMUSIM_FIFO_COUNT_FRAMES;
+        device->m_fifoCountMask = 0x7f;
+        device->m_fifoOverflowBit = 0x80;
+        device->m_fifoResetReg = BMX055_GYRO_FIFO_CONFIG_1;
+        device->m_fifoResetBit = 0xc0;
+        device->m_fifoSize = 100 * 6;
+        device->m_frameReg[0] = 0x02;                       // RATE_X_LSB
+        device->m_frameLen[0] = 6;
+        device->m_frameBlocks = 1;
+        if ((device = addDevice(BMX055_ACCEL_ADDRESS0)) == NULL)
+            return false;
+        device->setReg(BMX055_ACCEL_WHO_AM_I, BMX055_ACCEL_ID);
+        device->setReg16(BMX055_ACCEL_X_LSB + 4, 256 << 4, false);
+        if ((device = addDevice(BMX055_MAG_ADDRESS0)) == NULL)
+            return false;
+        device->setReg(BMX055_MAG_WHO_AM_I, BMX055_MAG_ID);
+        device->setReg16(BMX055_MAG_DIG_Z1_LSB, 24747, false);
+        device->setReg16(BMX055_MAG_DIG_Z2_LSB, 763, false);
+        device->setReg16(BMX055_MAG_DIG_XYZ1_LSB, 7053, false);
+        device->setReg(BMX055_MAG_DIG_XY2, 0xf9);
+        device->setReg(BMX055_MAG_DIG_XY1, 29);
+        device->setReg16(BMX055_MAG_X_LSB, 100 << 3, false);
+        device->setReg16(BMX055_MAG_X_LSB + 4, -300 * 2, false);
+        device->setReg16(BMX055_MAG_X_LSB + 6, 6000 << 2, false);    // RHALL
+        return true;
+
+    case RTIMU_TYPE_BNO055:
+        if ((device = addDevice(BNO055_ADDRESS0)) == NULL)
+            return false;
+        device->setReg(BNO055_WHO_AM_I, BNO055_ID);
+        device->m_selfClear[0][BNO055_SYS_TRIGGER] = 0x20;
+        device->setReg16(BNO055_ACCEL_DATA + 4, 981, false);
+        device->setReg16(BNO055_MAG_DATA, 320, false);
+        device->setReg16(BNO055_MAG_DATA + 4, -640, false);
+        device->setReg16(BNO055_FUSED_QUAT, 16384, false);
+        device->setReg16(BNO055_GRAVITY + 4, 981, false);
+
+        //  the fusion runs at 100Hz and INT_STA clears when it's read
+
+        device->m_sampleInterval = 1000000 / 100;
+        device->m_statusReg = BNO055_INT_STA;
+        device->m_statusBits = BNO055_INT_ACC_BSX_DRDY;
+        device->m_dataReg = BNO055_INT_STA;
+        return true;
+
+    default:
+        HAL_ERROR1("No simulation of IMU type %d\n", imuType);
+        return false;
+    }
+}
+
+bool RTIMUSimTransport::addPressure(int pressureType)
+{
+    RTIMUSimDevice *device;
+    static const int16_t BMP180Cal[11] = {408, -72, -14383, (int16_t)32741, (int16_t)32757, 23153,
+                                          6190, 4, -32768, -8711, 2868};
+    static const uint16_t MS5611Prom[8] = {0, 40127, 36924, 23317, 23282, 33464, 28312, 0};
+
+    switch (pressureType) {
+    case RTPRESSURE_TYPE_BMP180:
+        if ((device = addDevice(BMP180_ADDRESS)) == NULL)
+            return false;
+        device->setReg(BMP180_REG_ID, BMP180_ID);
+        for (int i = 0; i < 11; i++)
+            device->setReg16(BMP180_REG_AC1 + 2 * i, BMP180Cal[i], true);
+        device->m_selfClear[0][BMP180_REG_SCO] = 0x20;      // conversions complete immediately
+        device->setReg16(BMP180_REG_RESULT, 27898, true);
+        return true;
+
+    case RTPRESSURE_TYPE_LPS25H:
+        if ((device = addST(LPS25H_ADDRESS0, LPS25H_REG_ID, LPS25H_ID)) == NULL)
+            return false;
+        device->m_sampleInterval = 1000000 / 25;
+        device->m_statusReg = LPS25H_STATUS_REG;
+        device->m_statusBits = 0x03;
+        device->m_dataReg = LPS25H_PRESS_OUT_XL;
+        device->setReg(LPS25H_PRESS_OUT_XL + 2, 0x3f);      // 1008hPa
+        device->setReg16(LPS25H_TEMP_OUT_L, -10080, false);
+        return true;
+
+    case RTPRESSURE_TYPE_MS5611:
+    case RTPRESSURE_TYPE_MS5637:
+        if ((device = addDevice(MS5611_ADDRESS0)) == NULL)
+            return false;
+        for (int i = 0; i < 8; i++)
+            device->setReg16(MS5611_CMD_PROM + 2 * i, MS5611Prom[i], true);
+        device->setReg(MS5611_CMD_ADC, 0x8a);               // D1/D2 = 9085466
+        device->setReg(MS5611_CMD_ADC + 1, 0xa2);
+        device->setReg(MS5611_CMD_ADC + 2, 0x1a);
+        return true;
+
+    default:
+        HAL_ERROR1("No simulation of pressure type %d\n", pressureType);
+        return false;
+    }
+}
+
+bool RTIMUSimTransport::addHumidity(int humidityType)
+{
+    RTIMUSimDevice *device;
+
+    switch (humidityType) {
+    case RTHUMIDITY_TYPE_HTS221:
+        if ((device = addST(HTS221_ADDRESS, HTS221_REG_ID, HTS221_ID)) == NULL)
+            return false;
+        device->m_sampleInterval = 1000000 * 2 / 25;
+        device->m_statusReg = HTS221_STATUS;
+        device->m_statusBits = 0x03;
+        device->m_dataReg = HTS221_HUMIDITY_OUT_L;
+        device->setReg(HTS221_H0_H_2, 60);                  // 30%rH
+        device->setReg(HTS221_H1_H_2, 140);                 // 70%rH
+        device->setReg(HTS221_T0_C_8, 160);                 // 20C
+        device->setReg(HTS221_T1_C_8, 240);                 // 30C
+        device->setReg16(HTS221_H1_T0_OUT, 8000, false);
+        device->setReg16(HTS221_T1_OUT, 1000, false);
+        device->setReg16(HTS221_HUMIDITY_OUT_L, 4000, false);
+        device->setReg16(HTS221_TEMP_OUT_L, 500, false);
+        return true;
+
+    case RTHUMIDITY_TYPE_HTU21D:
+        //  results are read back without a register select from the command address.
+        //  The temperature checksum byte overlaps the humidity result which is fine
+        //  as the driver does not check it.
+
+        if ((device = addDevice(HTU21D_ADDRESS)) == NULL)
+            return false;
+        device->setReg16(HTU21D_CMD_TRIG_TEMP, 0x6680, true);
+        device->setReg16(HTU21D_CMD_TRIG_HUM, 0x7c80, true);
+        return true;
+
+    default:
+        HAL_ERROR1("No simulation of humidity type %d\n", humidityType);
+        return false;
+    }
+}
@@ -0,0 +1,207 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _RTIMUSIMTRANSPORT_H
+#define	_RTIMUSIMTRANSPORT_H
+
+#include "RTIMUTransport.h"
+
+//  RTIMUSimTransport is an in-memory bus with register map models of the supported chips
+//  attached. It lets the drivers, fusion and calibration code run without hardware, for
+//  example in CI or when benchmarking. Time is simulated: it advances with delayMs() and
+//  with the bus time of every transaction, so runs are deterministic and go as fast as
+//  the host allows.
+//
+//  Typical use:
+//
+//      RTIMUSimTransport sim;
+//      sim.addIMU(RTIMU_TYPE_MPU925x);
+//      settings->setTransport(&sim);
+//      settings->m_imuType = RTIMU_TYPE_MPU925x;
+//      settings->m_I2CSlaveAddress = MPU925x_ADDRESS0;
+
+#define RTIMUSIM_MAX_DEVICES            8                   // max devices on the bus
+#define RTIMUSIM_BANKS                  4                   // max register banks per device
+#define RTIMUSIM_FIFO_SIZE              4096                // max FIFO size in bytes
+#define RTIMUSIM_MAX_FRAME_BLOCKS       4                   // max register blocks in a FIFO frame
+#define RTIMUSIM_MAX_AUX_SLAVES         4                   // max aux I2C master slave channels
+
+//  Registers are identified by bank and address
+
+#define RTIMUSIM_REG(bank, reg)         (((bank) << 8) | (reg))
+#define RTIMUSIM_NO_REG                 -1
+#define RTIMUSIM_FIFO_OUTPUT            -2                  // m_fifoReg for a FIFO read through the frame registers
+
+//  FIFO count register formats
+
+#define RTIMUSIM_FIFO_COUNT_BYTES       0                   // byte count, big endian in two registers
+#define RTIMUSIM_FIFO_COUNT_FRAMES      1                   // frame count and overflow bit in one register
+
+class RTIMUSimTransport;
+
+//  RTIMUSimDevice is one slave on the simulated bus. By default it is a plain 256 byte
+//  register map. The members below switch on extra behaviour: data ready status bits,
+//  a FIFO that is filled with a frame of output registers at the sample rate and an aux
+//  I2C master like the one in the InvenSense parts.
+
+class RTIMUSimDevice
+{
+public:
+    RTIMUSimDevice(RTIMUSimTransport *transport, unsigned char slaveAddr);
+
+    bool read(unsigned char regAddr, unsigned char length, unsigned char *data);
+    bool read(unsigned char length, unsigned char *data);   // read from last register addressed
+    bool write(unsigned char regAddr, unsigned char length, unsigned char const *data);
+
+    void update(uint64_t now);                              // generate samples due by now
+    uint64_t nextSampleTime();                              // when the next sample is due, 0 if never
+    unsigned long getSampleCount() { return m_sampleCount; }
+    void setReg(int reg, unsigned char value);              // set a register without side effects
+    unsigned char getReg(int reg);                          // get a register without side effects
+    void setReg16(int reg, int16_t value, bool bigEndian);  // set a 16 bit output register pair
+
+    unsigned char m_slaveAddr;                              // address on the bus
+    unsigned char m_regMask;                                // bits of register address used (0x7f if bit 7 is auto increment)
+
+    int m_bankReg;                                          // register bank select register
+    unsigned char m_bankShift;                              // position of bank number in m_bankReg
+
+    //  sample timing
+
+    uint64_t m_sampleInterval;                              // uS between samples, 0 for none
+    int m_rateDivReg;                                       // if set, interval is (1 + div) / m_rateBase
+    int m_rateBase;                                         // base rate in Hz for m_rateDivReg
+
+    //  data ready
+
+    int m_statusReg;                                        // status register
+    unsigned char m_statusBits;                             // bits set when a new sample is ready
+    int m_dataReg;                                          // reading this output register clears m_statusBits
+
+    //  FIFO
+
+    int m_fifoReg;                                          // FIFO data register - reads do not increment
+                                                            // or RTIMUSIM_FIFO_OUTPUT if the frame registers
+                                                            // return the oldest frame, popped by reading its last byte
+    int m_fifoCountReg;                                     // FIFO count register
+    int m_fifoCountMode;                                    // one of RTIMUSIM_FIFO_COUNT_*
+    unsigned char m_fifoCountMask;                          // count bits for RTIMUSIM_FIFO_COUNT_FRAMES
+    unsigned char m_fifoOverflowBit;                        // overflow bit for RTIMUSIM_FIFO_COUNT_FRAMES
+    int m_fifoEnableReg;                                    // FIFO only fills if this has m_fifoEnableBit set
+    unsigned char m_fifoEnableBit;
+    int m_fifoResetReg;                                     // writing m_fifoResetBit here empties the FIFO
+    unsigned char m_fifoResetBit;
+    bool m_fifoResetOnClear;                                // reset is writing m_fifoResetBit as zero instead
+    int m_fifoSize;                                         // FIFO capacity in bytes
+    int m_frameReg[RTIMUSIM_MAX_FRAME_BLOCKS];              // output register blocks that make up a frame
+    int m_frameLen[RTIMUSIM_MAX_FRAME_BLOCKS];
+    unsigned char m_frameEnableBit[RTIMUSIM_MAX_FRAME_BLOCKS];  // block only in the frame if set in m_fifoEnableReg, 0 for always
+    int m_frameBlocks;
+
+    //  aux I2C master. Enabled channels run at every sample and when m_auxTriggerReg is
+    //  written. Read channels copy from the slave into consecutive m_auxDataReg registers,
+    //  write channels send the data out byte to the slave.
+
+    int m_auxAddrReg[RTIMUSIM_MAX_AUX_SLAVES];              // slave address, bit 7 set for read
+    int m_auxRegReg[RTIMUSIM_MAX_AUX_SLAVES];               // slave register
+    int m_auxCtrlReg[RTIMUSIM_MAX_AUX_SLAVES];              // bit 7 enable, bits 3:0 length
+    int m_auxDoReg[RTIMUSIM_MAX_AUX_SLAVES];                // byte to write
+    int m_auxSlaves;
+    int m_auxDataReg;                                       // first external sensor data register
+    int m_auxTriggerReg;                                    // a write here runs the aux transfers
+
+    unsigned char m_selfClear[RTIMUSIM_BANKS][256];         // bits that clear as soon as they are written
+
+private:
+    int decode(unsigned char regAddr);
+    unsigned char readByte(int reg);
+    void writeByte(int reg, unsigned char value);
+    void sample();
+    uint64_t sampleInterval();
+    void auxTransfer();
+    bool frameBlockEnabled(int block);
+    int frameSize();
+    int frameOffset(int reg);                               // offset of reg in a frame, -1 if not in one
+
+    RTIMUSimTransport *m_transport;
+    unsigned char m_regs[RTIMUSIM_BANKS][256];
+    unsigned char m_bank;
+    unsigned char m_pointer;                                // last register addressed
+    uint64_t m_lastSample;
+    unsigned long m_sampleCount;
+
+    unsigned char m_fifo[RTIMUSIM_FIFO_SIZE];
+    int m_fifoHead;                                         // index of oldest byte
+    int m_fifoCount;                                        // bytes in the FIFO
+    bool m_fifoOverflow;
+};
+
+class RTIMUSimTransport : public RTIMUTransport
+{
+public:
+    RTIMUSimTransport();
+    virtual ~RTIMUSimTransport();
+
+    //  addDevice() adds an empty register map at slaveAddr for the caller to set up.
+    //  addIMU(), addPressure() and addHumidity() add all the devices that make up one of
+    //  the supported chips at their default addresses, set up as after power on.
+
+    RTIMUSimDevice *addDevice(unsigned char slaveAddr);
+    RTIMUSimDevice *findDevice(unsigned char slaveAddr);
+    bool addIMU(int imuType);
+    bool addPressure(int pressureType);
+    bool addHumidity(int humidityType);
+
+    uint64_t getTime() { return m_time; }                   // simulated time in uS
+    void advanceTime(uint64_t uSecs) { m_time += uSecs; }
+    void setBusSpeed(unsigned int speed) { m_busSpeed = speed; }  // bits per second
+    unsigned long getTransactionCount() { return m_transactions; }
+    void setMaxReadLength(int length) { m_maxRead = length; }  // longer reads fail, like a limited adapter
+
+    virtual bool open();
+    virtual void close();
+    virtual bool read(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg);
+    virtual bool read(unsigned char slaveAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg);
+    virtual bool write(unsigned char slaveAddr, unsigned char regAddr,
+                  unsigned char length, unsigned char const *data, const char *errorMsg);
+    virtual void delayMs(int milliSeconds);
+    virtual void delayUntil(uint64_t uSecs) { if (uSecs > m_time) m_time = uSecs; }
+    virtual int maxReadLength() { return m_maxRead; }
+    virtual uint64_t currentUSecs() { return m_time; }
+
+private:
+    RTIMUSimDevice *transaction(unsigned char slaveAddr, int length);
+    RTIMUSimDevice *addInvenSense(unsigned char slaveAddr, unsigned char id);
+    RTIMUSimDevice *addST(unsigned char slaveAddr, unsigned char whoAmIReg, unsigned char id);
+
+    RTIMUSimDevice *m_devices[RTIMUSIM_MAX_DEVICES];
+    int m_deviceCount;
+    uint64_t m_time;
+    unsigned int m_busSpeed;
+    unsigned long m_transactions;
+    int m_maxRead;
+};
+
+#endif // _RTIMUSIMTRANSPORT_H
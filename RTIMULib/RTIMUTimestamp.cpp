@@ -0,0 +1,216 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "RTIMUTimestamp.h"
+
+RTIMUTimestamp::RTIMUTimestamp()
+{
+    m_lastTimestamp = 0;
+    reset(10000);
+}
+
+void RTIMUTimestamp::reset(uint64_t sampleInterval)
+{
+    m_nominal = sampleInterval > 0 ? (double)sampleInterval : 1.0;
+    m_period = m_nominal;
+    m_offset = 0;
+    m_baseIndex = 0;
+    m_baseTime = 0;
+    m_synced = false;
+    m_next = 0;
+    m_produced = 0;
+    clearFit(0);
+}
+
+void RTIMUTimestamp::fifoLevel(int pending, uint64_t readTime)
+{
+    if (pending < 0)
+        pending = 0;
+    observe(m_next + pending, readTime);
+}
+
+void RTIMUTimestamp::sampleReady(uint64_t readTime)
+{
+    //  without a FIFO, samples that were overwritten between reads show up as a gap
+    //  in the sensor's clock. A read has to be a good way past the next sample's slot
+    //  before it's taken as missed, as a late read looks much the same.
+
+    if (m_synced) {
+        double late = (double)(int64_t)(readTime - m_baseTime) - m_offset -
+                m_period * (double)(int64_t)(m_next - m_baseIndex);
+        double missed = floor(late / m_period - RTIMUTIMESTAMP_MISSED_MARGIN);
+
+        if (missed > 0)
+            m_next += (uint64_t)missed;
+    }
+    observe(m_next + 1, readTime);
+}
+
+void RTIMUTimestamp::discard(int count)
+{
+    if (count > 0)
+        m_next += count;
+}
+
+uint64_t RTIMUTimestamp::nextTimestamp()
+{
+    uint64_t timestamp;
+
+    if (m_synced) {
+        double t = m_offset + m_period * (double)(int64_t)(m_next - m_baseIndex);
+        timestamp = (uint64_t)((int64_t)m_baseTime + (int64_t)floor(t + 0.5));
+    } else {
+        timestamp = m_lastTimestamp + (uint64_t)m_nominal;
+    }
+
+    if ((m_lastTimestamp != 0) && (timestamp <= m_lastTimestamp))
+        timestamp = m_lastTimestamp + 1;
+
+    m_lastTimestamp = timestamp;
+    m_next++;
+    return timestamp;
+}
+
+void RTIMUTimestamp::observe(uint64_t produced, uint64_t readTime)
+{
+    uint64_t index;
+    double x, y, err;
+    double det, slope, intercept, residual;
+
+    //  only a newly taken sample tells us anything
+
+    if (produced <= m_produced)
+        return;
+    m_produced = produced;
+    index = produced - 1;
+
+    if (!m_synced) {
+        resync(index, readTime);
+        return;
+    }
+
+    //  move the base along now and then so that the sums stay well conditioned
+
+    if ((int64_t)(index - m_baseIndex) >= RTIMUTIMESTAMP_REBASE) {
+        double dx = (double)(int64_t)(index - m_baseIndex);
+        double t = m_offset + m_period * dx;
+        double dy = floor(t);
+
+        m_sxy = m_sxy - dx * m_sy - dy * m_sx + dx * dy * m_sw;
+        m_sxx = m_sxx - 2 * dx * m_sx + dx * dx * m_sw;
+        m_sx -= dx * m_sw;
+        m_sy -= dy * m_sw;
+
+        m_baseTime += (int64_t)dy;
+        m_offset = t - dy;
+        m_baseIndex = index;
+    }
+
+    x = (double)(int64_t)(index - m_baseIndex);
+    y = (double)(int64_t)(readTime - m_baseTime);
+    err = y - (m_offset + m_period * x);
+
+    //  a large error means samples have gone missing without an overflow or the
+    //  host's clock has stepped, so start the line again from here
+
+    if (fabs(err) > RTIMUTIMESTAMP_RESYNC + 4 * m_nominal) {
+        HAL_INFO1("Timestamp resync, error %d uS\n", (int)err);
+        resync(index, readTime);
+        return;
+    }
+
+    //  until the fit can be used, the line has the current period and goes through the
+    //  earliest the samples could have been taken
+
+    if (!m_fitValid && (err < 0)) {
+        m_offset += err;
+        err = 0;
+    }
+
+    //  reads that were held up a long way after the sample don't say much about the
+    //  sensor's clock, and nor do ones well before the line as the sample has probably
+    //  been given the wrong index. If that keeps happening the line is wrong instead.
+
+    if ((err < -m_nominal / 2) || (err > RTIMUTIMESTAMP_OUTLIER * m_nominal)) {
+        if (++m_outliers > RTIMUTIMESTAMP_MAX_OUTLIERS) {
+            HAL_INFO("Timestamp resync after repeated outliers\n");
+            resync(index, readTime);
+        }
+        return;
+    }
+    m_outliers = 0;
+
+    m_sw = m_sw * RTIMUTIMESTAMP_FORGET + 1.0;
+    m_sx = m_sx * RTIMUTIMESTAMP_FORGET + x;
+    m_sy = m_sy * RTIMUTIMESTAMP_FORGET + y;
+    m_sxx = m_sxx * RTIMUTIMESTAMP_FORGET + x * x;
+    m_sxy = m_sxy * RTIMUTIMESTAMP_FORGET + x * y;
+
+    if ((int64_t)(index - m_fitStart) < RTIMUTIMESTAMP_MIN_SPAN)
+        return;
+
+    det = m_sw * m_sxx - m_sx * m_sx;
+    if (det <= 0)
+        return;
+
+    slope = (m_sw * m_sxy - m_sx * m_sy) / det;
+    if (fabs(slope - m_nominal) >= RTIMUTIMESTAMP_MAX_DRIFT * m_nominal)
+        return;
+
+    intercept = (m_sy - slope * m_sx) / m_sw;
+    residual = y - (intercept + slope * x);
+
+    //  the fitted line goes through the middle of the reads, so it is moved back
+    //  towards the earliest of them. The floor creeps up so that it can follow and the
+    //  correction is smoothed so that it doesn't add jitter.
+
+    if (!m_fitValid) {
+        m_floor = m_bias = (m_offset + m_period * x) - (intercept + slope * x);
+        m_fitValid = true;
+    }
+    m_floor += m_nominal / 256;
+    if (residual < m_floor)
+        m_floor = residual;
+    m_bias += (m_floor - m_bias) / 32;
+
+    m_period = slope;
+    m_offset = intercept + m_bias;
+}
+
+void RTIMUTimestamp::resync(uint64_t index, uint64_t readTime)
+{
+    m_baseIndex = index;
+    m_baseTime = readTime;
+    m_offset = 0;
+    m_synced = true;
+    clearFit(index);
+}
+
+void RTIMUTimestamp::clearFit(uint64_t index)
+{
+    m_sw = m_sx = m_sy = m_sxx = m_sxy = 0;
+    m_fitStart = index;
+    m_fitValid = false;
+    m_outliers = 0;
+}
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef _RTIMUTIMESTAMP_H
+#define	_RTIMUTIMESTAMP_H
+
+#include "RTIMUHal.h"
+
+#define RTIMUTIMESTAMP_FORGET           0.998               // weight of older observations in the period fit
+#define RTIMUTIMESTAMP_MIN_SPAN         64                  // samples the fit must cover before it's used
+#define RTIMUTIMESTAMP_MAX_DRIFT        0.1                 // max relative difference of the period from nominal
+#define RTIMUTIMESTAMP_OUTLIER          3                   // intervals late before an observation is left out of the fit
+#define RTIMUTIMESTAMP_MAX_OUTLIERS     16                  // consecutive outliers before the model is thrown away
+#define RTIMUTIMESTAMP_MISSED_MARGIN    0.25                // intervals past the next slot before a sample is missed
+#define RTIMUTIMESTAMP_RESYNC           100000              // uS out before the model is thrown away
+#define RTIMUTIMESTAMP_REBASE           (1 << 20)           // samples between rebasing the fit
+
+//  RTIMUTimestamp works out when each sample was taken from the sensor's own clock.
+//  The sensor produces samples at its nominal interval, give or take its oscillator's
+//  drift, but the host only sees them when it gets round to reading them. Each read
+//  is an observation: by readTime the sensor had produced every sample delivered so
+//  far plus those still pending. The line t(n) = offset + period * n is fitted to the
+//  observations by least squares with exponential forgetting and then moved back to
+//  the earliest reads, as read latency only ever makes samples look late.
+//
+//  Drivers call reset() when the sensor starts sampling (or restarts after an
+//  overflow loses an unknown number of samples), then for each read either
+//  fifoLevel() with the number of samples not yet delivered or, for parts without a
+//  FIFO, sampleReady(). nextTimestamp() is then called once per delivered sample.
+//  Times are in HALTimestamp() units and are strictly increasing, even across a reset.
+
+class RTIMUTimestamp
+{
+public:
+    RTIMUTimestamp();
+
+    void reset(uint64_t sampleInterval);                    // start again with the nominal interval
+    void fifoLevel(int pending, uint64_t readTime);         // samples read or in the FIFO but not yet delivered
+    void sampleReady(uint64_t readTime);                    // the latest sample, read at readTime
+    void discard(int count);                                // pending samples thrown away without a timestamp
+    uint64_t nextTimestamp();                               // the time of the next sample to be delivered
+
+    uint64_t getSampleInterval() { return (uint64_t)(m_period + 0.5); }
+    bool isSynced() { return m_synced; }
+
+private:
+    void observe(uint64_t produced, uint64_t readTime);     // produced samples had been taken by readTime
+    void resync(uint64_t index, uint64_t readTime);         // restart the model with sample index at readTime
+    void clearFit(uint64_t index);
+
+    double m_nominal;                                       // nominal sample interval in uS
+    double m_period;                                        // current estimate of the interval
+    double m_offset;                                        // time of sample m_baseIndex relative to m_baseTime
+    uint64_t m_baseIndex;
+    uint64_t m_baseTime;
+    bool m_synced;                                          // true if the model has had an observation
+
+    uint64_t m_next;                                        // index of the next sample to deliver
+    uint64_t m_produced;                                    // samples known to have been taken
+    uint64_t m_lastTimestamp;                               // last time handed out
+
+    double m_sw, m_sx, m_sy, m_sxx, m_sxy;                  // weighted sums for the period fit
+    uint64_t m_fitStart;                                    // index of the first observation in the fit
+    bool m_fitValid;                                        // true if the line is from the fit
+    double m_floor;                                         // earliest recent read relative to the fit
+    double m_bias;                                          // smoothed m_floor
+    int m_outliers;                                         // consecutive observations left out of the fit
+};
+
+#endif // _RTIMUTIMESTAMP_H
@@ -0,0 +1,604 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+//  The MPU-9250 and SPI driver code is based on code generously supplied by
+//  staslock@gmail.com (www.clickdrive.io)
+
+#include "RTIMUTransport.h"
+#include "RTMath.h"
+
+RTIMUTransport::RTIMUTransport()
+{
+}
+
+RTIMUTransport::~RTIMUTransport()
+{
+}
+
+bool RTIMUTransport::batch(HAL_BATCH_ENTRY *entries, int count, const char *errorMsg)
+{
+    HAL_BATCH_ENTRY *entry;
+
+    for (int i = 0; i < count; i++) {
+        entry = entries + i;
+        if (entry->read) {
+            if (!read(entry->slaveAddr, entry->regAddr, entry->length, entry->rxData, errorMsg))
+                return false;
+        } else {
+            if (!write(entry->slaveAddr, entry->regAddr, entry->length, entry->txData, errorMsg))
+                return false;
+        }
+    }
+    return true;
+}
+
+void RTIMUTransport::delayMs(int milliSeconds)
+{
+#if !defined(WIN32)
+    usleep(1000 * milliSeconds);
+#endif
+}
+
+void RTIMUTransport::delayUntil(uint64_t uSecs)
+{
+    RTMath::sleepUntilUSecsMonotonic(uSecs);
+}
+
+uint64_t RTIMUTransport::currentUSecs()
+{
+    return RTMath::currentUSecsMonotonic();
+}
+
+#if !defined(WIN32) && !defined(__APPLE__)
+
+#include <linux/spi/spidev.h>
+
+//----------------------------------------------------------
+//
+//  RTIMUI2CTransport
+
+RTIMUI2CTransport::RTIMUI2CTransport()
+{
+    m_I2CBus = 255;
+    m_I2C = -2;
+    m_I2CRdWr = false;
+    m_currentSlave = 255;
+    m_slaveSelects = 0;
+}
+
+RTIMUI2CTransport::~RTIMUI2CTransport()
+{
+    close();
+}
+
+bool RTIMUI2CTransport::open()
+{
+    char buf[32];
+
+    if (m_I2C >= 0)
+        return true;
+
+    if (m_I2CBus == 255) {
+        HAL_ERROR("No I2C bus has been set\n");
+        return false;
+    }
+    sprintf(buf, "/dev/i2c-%d", m_I2CBus);
+    m_I2C = ::open(buf, O_RDWR);
+    if (m_I2C < 0) {
+        if(m_I2C != -1)
+            HAL_ERROR1("Failed to open I2C bus %d\n", m_I2CBus);
+        m_I2C = -1;
+        return false;
+    }
+
+    //  see if the adapter can do a register select and read as one repeated start
+    //  transaction. If not, read falls back to separate write and read calls.
+
+    unsigned long funcs;
+
+    m_I2CRdWr = (ioctl(m_I2C, I2C_FUNCS, &funcs) >= 0) && (funcs & I2C_FUNC_I2C);
+    return true;
+}
+
+void RTIMUI2CTransport::close()
+{
+    if (m_I2C >= 0) {
+        ::close(m_I2C);
+        m_I2C = -1;
+        m_I2CRdWr = false;
+        m_currentSlave = 255;
+    }
+}
+
+bool RTIMUI2CTransport::write(unsigned char slaveAddr, unsigned char regAddr,
+                   unsigned char length, unsigned char const *data, const char *errorMsg)
+{
+    int result;
+    unsigned char txBuff[MAX_WRITE_LEN + 1];
+
+    if (!selectSlave(slaveAddr, errorMsg))
+        return false;
+
+    if (length == 0) {
+        result = ::write(m_I2C, &regAddr, 1);
+
+        if (result < 0) {
+            if (strlen(errorMsg) > 0)
+                HAL_ERROR1("I2C write of regAddr failed - %s\n", errorMsg);
+            return false;
+        } else if (result != 1) {
+            if (strlen(errorMsg) > 0)
+                HAL_ERROR1("I2C write of regAddr failed (nothing written) - %s\n", errorMsg);
+            return false;
+        }
+    } else {
+        txBuff[0] = regAddr;
+        memcpy(txBuff + 1, data, length);
+
+        result = ::write(m_I2C, txBuff, length + 1);
+
+        if (result < 0) {
+            if (strlen(errorMsg) > 0)
+                HAL_ERROR2("I2C data write of %d bytes failed - %s\n", length, errorMsg);
+            return false;
+        } else if (result < (int)length) {
+            if (strlen(errorMsg) > 0)
+                HAL_ERROR3("I2C data write of %d bytes failed, only %d written - %s\n", length, result, errorMsg);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RTIMUI2CTransport::read(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                    unsigned char *data, const char *errorMsg)
+{
+    int tries, result, total;
+
+    if ((m_I2C < 0) && !open()) {
+        HAL_ERROR1("Failed to open I2C port - %s\n", errorMsg);
+        return false;
+    }
+
+    if (m_I2CRdWr)
+        return readRdWr(slaveAddr, regAddr, length, data, errorMsg);
+
+    if (!write(slaveAddr, regAddr, 0, NULL, errorMsg))
+        return false;
+
+    total = 0;
+    tries = 0;
+
+    while ((total < length) && (tries < 5)) {
+        result = ::read(m_I2C, data + total, length - total);
+
+        if (result < 0) {
+            if (strlen(errorMsg) > 0)
+                HAL_ERROR3("I2C read error from %d, %d - %s\n", slaveAddr, regAddr, errorMsg);
+            return false;
+        }
+
+        total += result;
+
+        if (total == length)
+            break;
+
+        delayMs(1);
+        tries++;
+    }
+
+    if (total < length) {
+        if (strlen(errorMsg) > 0)
+            HAL_ERROR3("I2C read from %d, %d failed - %s\n", slaveAddr, regAddr, errorMsg);
+        return false;
+    }
+    return true;
+}
+
+bool RTIMUI2CTransport::read(unsigned char slaveAddr, unsigned char length,
+                    unsigned char *data, const char *errorMsg)
+{
+    int tries, result, total;
+
+    if (!selectSlave(slaveAddr, errorMsg))
+        return false;
+
+    total = 0;
+    tries = 0;
+
+    while ((total < length) && (tries < 5)) {
+        result = ::read(m_I2C, data + total, length - total);
+
+        if (result < 0) {
+            if (strlen(errorMsg) > 0)
+                HAL_ERROR2("I2C read error from %d - %s\n", slaveAddr, errorMsg);
+            return false;
+        }
+
+        total += result;
+
+        if (total == length)
+            break;
+
+        delayMs(1);
+        tries++;
+    }
+
+    if (total < length) {
+        if (strlen(errorMsg) > 0)
+            HAL_ERROR2("I2C read from %d failed - %s\n", slaveAddr, errorMsg);
+        return false;
+    }
+    return true;
+}
+
+bool RTIMUI2CTransport::batch(HAL_BATCH_ENTRY *entries, int count, const char *errorMsg)
+{
+    struct i2c_msg msgs[MAX_BATCH_LEN * 2];
+    struct i2c_rdwr_ioctl_data rdwr;
+    unsigned char txBuff[MAX_BATCH_LEN][MAX_WRITE_LEN + 1];
+    HAL_BATCH_ENTRY *entry;
+    int nmsgs = 0;
+
+    if ((m_I2C < 0) && !open()) {
+        HAL_ERROR1("Failed to open I2C port - %s\n", errorMsg);
+        return false;
+    }
+
+    if (!m_I2CRdWr)
+        return RTIMUTransport::batch(entries, count, errorMsg);
+
+    //  reads are a register select and a read, writes a single message with the
+    //  register in front of the data
+
+    for (int i = 0; i < count; i++) {
+        entry = entries + i;
+
+        if (entry->read) {
+            msgs[nmsgs].addr = entry->slaveAddr;
+            msgs[nmsgs].flags = 0;
+            msgs[nmsgs].len = 1;
+            msgs[nmsgs].buf = &entry->regAddr;
+            nmsgs++;
+
+            msgs[nmsgs].addr = entry->slaveAddr;
+            msgs[nmsgs].flags = I2C_M_RD;
+            msgs[nmsgs].len = entry->length;
+            msgs[nmsgs].buf = entry->rxData;
+            nmsgs++;
+        } else {
+            txBuff[i][0] = entry->regAddr;
+            memcpy(txBuff[i] + 1, entry->txData, entry->length);
+
+            msgs[nmsgs].addr = entry->slaveAddr;
+            msgs[nmsgs].flags = 0;
+            msgs[nmsgs].len = entry->length + 1;
+            msgs[nmsgs].buf = txBuff[i];
+            nmsgs++;
+        }
+    }
+
+    rdwr.msgs = msgs;
+    rdwr.nmsgs = nmsgs;
+
+    if (ioctl(m_I2C, I2C_RDWR, &rdwr) != nmsgs) {
+        if (strlen(errorMsg) > 0)
+            HAL_ERROR2("I2C batch transfer of %d blocks failed - %s\n", count, errorMsg);
+        return false;
+    }
+    return true;
+}
+
+//  readRdWr() performs the register select write and the data read as a single
+//  repeated start transaction. This halves the number of syscalls compared to write()
+//  followed by read() and means that no other bus user can get in between the two.
+
+bool RTIMUI2CTransport::readRdWr(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                    unsigned char *data, const char *errorMsg)
+{
+    struct i2c_msg msgs[2];
+    struct i2c_rdwr_ioctl_data rdwr;
+
+    msgs[0].addr = slaveAddr;
+    msgs[0].flags = 0;
+    msgs[0].len = 1;
+    msgs[0].buf = &regAddr;
+
+    msgs[1].addr = slaveAddr;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len = length;
+    msgs[1].buf = data;
+
+    rdwr.msgs = msgs;
+    rdwr.nmsgs = 2;
+
+    if (ioctl(m_I2C, I2C_RDWR, &rdwr) != 2) {
+        if (strlen(errorMsg) > 0)
+            HAL_ERROR3("I2C read error from %d, %d - %s\n", slaveAddr, regAddr, errorMsg);
+        return false;
+    }
+    return true;
+}
+
+bool RTIMUI2CTransport::selectSlave(unsigned char slaveAddr, const char *errorMsg)
+{
+    if (m_currentSlave == slaveAddr)
+        return true;
+
+    if (!open()) {
+        HAL_ERROR1("Failed to open I2C port - %s\n", errorMsg);
+        return false;
+    }
+
+    if (ioctl(m_I2C, I2C_SLAVE, slaveAddr) < 0) {
+        HAL_ERROR2("I2C slave select %d failed - %s\n", slaveAddr, errorMsg);
+        return false;
+    }
+
+    m_currentSlave = slaveAddr;
+    m_slaveSelects++;
+
+    return true;
+}
+
+//----------------------------------------------------------
+//
+//  RTIMUSPITransport
+
+RTIMUSPITransport::RTIMUSPITransport()
+{
+    m_SPIBus = 255;
+    m_SPISelect = 0;
+    m_SPISpeed = 500000;
+    m_SPI = -2;
+    m_SPIPrev = 1;
+    m_maxRead = MAX_READ_LEN;
+}
+
+RTIMUSPITransport::~RTIMUSPITransport()
+{
+    close();
+}
+
+bool RTIMUSPITransport::open()
+{
+    char buf[32];
+    unsigned char SPIMode = SPI_MODE_0;
+    unsigned char SPIBits = 8;
+    uint32_t SPISpeed = m_SPISpeed;
+    FILE *bufsiz;
+    int size;
+
+    if (m_SPI >= 0)
+        return true;
+
+    if (m_SPIBus == 255) {
+        HAL_ERROR("No SPI bus has been set\n");
+        return false;
+    }
+
+    sprintf(buf, "/dev/spidev%d.%d", m_SPIBus, m_SPISelect);
+    m_SPI = ::open(buf, O_RDWR);
+    if (m_SPI < 0) {
+        if(m_SPIPrev != -1)
+            HAL_ERROR2("Failed to open SPI bus %d, select %d\n", m_SPIBus, m_SPISelect);
+        m_SPI = -1;
+        m_SPIPrev = -1;
+        return false;
+    }
+
+    if (ioctl(m_SPI, SPI_IOC_WR_MODE, &SPIMode) < 0) {
+        HAL_ERROR1("Failed to set WR SPI_MODE0 on bus %d", m_SPIBus);
+        close();
+        return false;
+    }
+
+    if (ioctl(m_SPI, SPI_IOC_RD_MODE, &SPIMode) < 0) {
+        HAL_ERROR1("Failed to set RD SPI_MODE0 on bus %d", m_SPIBus);
+        close();
+        return false;
+    }
+
+    if (ioctl(m_SPI, SPI_IOC_WR_BITS_PER_WORD, &SPIBits) < 0) {
+        HAL_ERROR1("Failed to set WR 8 bit mode on bus %d", m_SPIBus);
+        close();
+        return false;
+    }
+
+    if (ioctl(m_SPI, SPI_IOC_RD_BITS_PER_WORD, &SPIBits) < 0) {
+        HAL_ERROR1("Failed to set RD 8 bit mode on bus %d", m_SPIBus);
+        close();
+        return false;
+    }
+
+    if (ioctl(m_SPI, SPI_IOC_WR_MAX_SPEED_HZ, &SPISpeed) < 0) {
+         HAL_ERROR2("Failed to set WR %dHz on bus %d", SPISpeed, m_SPIBus);
+         close();
+         return false;
+    }
+
+    if (ioctl(m_SPI, SPI_IOC_RD_MAX_SPEED_HZ, &SPISpeed) < 0) {
+         HAL_ERROR2("Failed to set RD %dHz on bus %d", SPISpeed, m_SPIBus);
+         close();
+         return false;
+    }
+
+    //  a transfer is the register byte and the data and has to fit in spidev's buffer
+
+    m_maxRead = MAX_READ_LEN;
+    bufsiz = fopen("/sys/module/spidev/parameters/bufsiz", "r");
+    if (bufsiz != NULL) {
+        if ((fscanf(bufsiz, "%d", &size) == 1) && (size - 1 < MAX_READ_LEN))
+            m_maxRead = size - 1;
+        fclose(bufsiz);
+    }
+    m_SPIPrev = 1;
+    return true;
+}
+
+void RTIMUSPITransport::close()
+{
+    if (m_SPI >= 0) {
+        ::close(m_SPI);
+        m_SPI = -1;
+    }
+}
+
+bool RTIMUSPITransport::write(unsigned char , unsigned char regAddr,
+                   unsigned char length, unsigned char const *data, const char *errorMsg)
+{
+    int result;
+    unsigned char txBuff[MAX_WRITE_LEN + 1];
+    struct spi_ioc_transfer wrIOC;
+
+    txBuff[0] = regAddr;
+    if (length > 0)
+        memcpy(txBuff + 1, data, length);
+
+    memset(&wrIOC, 0, sizeof(wrIOC));
+    wrIOC.tx_buf = (unsigned long) txBuff;
+    wrIOC.rx_buf = 0;
+    wrIOC.len = length + 1;
+
+    result = ioctl(m_SPI, SPI_IOC_MESSAGE(1), &wrIOC);
+
+    if (result < 0) {
+        if (strlen(errorMsg) > 0)
+            HAL_ERROR2("SPI data write of %d bytes failed - %s\n", length, errorMsg);
+        return false;
+    } else if (result < (int)length) {
+        if (strlen(errorMsg) > 0)
+            HAL_ERROR3("SPI data write of %d bytes failed, only %d written - %s\n", length, result, errorMsg);
+        return false;
+    }
+    return true;
+}
+
+bool RTIMUSPITransport::read(unsigned char , unsigned char regAddr, unsigned char length,
+                    unsigned char *data, const char *errorMsg)
+{
+    unsigned char rxBuff[MAX_READ_LEN + 1];
+    struct spi_ioc_transfer rdIOC;
+
+    rxBuff[0] = regAddr | 0x80;
+    memcpy(rxBuff + 1, data, length);
+    memset(&rdIOC, 0, sizeof(rdIOC));
+    rdIOC.tx_buf = (unsigned long) rxBuff;
+    rdIOC.rx_buf = (unsigned long) rxBuff;
+    rdIOC.len = length + 1;
+
+    if (ioctl(m_SPI, SPI_IOC_MESSAGE(1), &rdIOC) < 0) {
+        if (strlen(errorMsg) > 0)
+            HAL_ERROR2("SPI read error from %d - %s\n", regAddr, errorMsg);
+        return false;
+    }
+    memcpy(data, rxBuff + 1, length);
+    return true;
+}
+
+bool RTIMUSPITransport::read(unsigned char , unsigned char length,
+                    unsigned char *data, const char *errorMsg)
+{
+    unsigned char rxBuff[MAX_READ_LEN + 1];
+    struct spi_ioc_transfer rdIOC;
+
+    memset(&rdIOC, 0, sizeof(rdIOC));
+    rdIOC.tx_buf = 0;
+    rdIOC.rx_buf = (unsigned long) rxBuff;
+    rdIOC.len = length;
+
+    if (ioctl(m_SPI, SPI_IOC_MESSAGE(1), &rdIOC) < 0) {
+        if (strlen(errorMsg) > 0)
+            HAL_ERROR1("SPI read error from - %s\n", errorMsg);
+        return false;
+    }
+    memcpy(data, rxBuff, length);
+    return true;
+}
+
+bool RTIMUSPITransport::batch(HAL_BATCH_ENTRY *entries, int count, const char *errorMsg)
+{
+    struct spi_ioc_transfer xfers[MAX_BATCH_LEN * 2];
+    HAL_BATCH_ENTRY *entry;
+    int xferCount = 0;
+    int total = 0;
+
+    memset(xfers, 0, sizeof(xfers));
+
+    //  each entry is the register byte followed by the data. chip select stays
+    //  asserted within an entry and is released between entries. spidev limits the
+    //  total length of a message to its buffer size, so a batch that's longer is
+    //  sent as several messages, split between entries.
+
+    for (int i = 0; i < count; i++) {
+        entry = entries + i;
+
+        if (entry->length > m_maxRead) {
+            if (strlen(errorMsg) > 0)
+                HAL_ERROR3("SPI batch entry of %d bytes is longer than the %d byte limit - %s\n",
+                           entry->length, m_maxRead, errorMsg);
+            return false;
+        }
+
+        if (total + entry->length + 1 > m_maxRead + 1) {
+            xfers[xferCount - 1].cs_change = 0;
+            if (!batchMessage(xfers, xferCount, count, errorMsg))
+                return false;
+            memset(xfers, 0, sizeof(xfers));
+            xferCount = 0;
+            total = 0;
+        }
+
+        xfers[xferCount].tx_buf = (unsigned long) &entry->regByte;
+        xfers[xferCount].len = 1;
+        xferCount++;
+
+        if (entry->length > 0) {
+            if (entry->read)
+                xfers[xferCount].rx_buf = (unsigned long) entry->rxData;
+            else
+                xfers[xferCount].tx_buf = (unsigned long) entry->txData;
+            xfers[xferCount].len = entry->length;
+            xferCount++;
+        }
+        total += entry->length + 1;
+
+        if (i < (count - 1))
+            xfers[xferCount - 1].cs_change = 1;
+    }
+
+    return batchMessage(xfers, xferCount, count, errorMsg);
+}
+
+bool RTIMUSPITransport::batchMessage(struct spi_ioc_transfer *xfers, int xferCount, int count,
+                    const char *errorMsg)
+{
+    if (ioctl(m_SPI, SPI_IOC_MESSAGE(xferCount), xfers) < 0) {
+        if (strlen(errorMsg) > 0)
+            HAL_ERROR2("SPI batch transfer of %d blocks failed - %s\n", count, errorMsg);
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of RTIMULib
+//
+//  Copyright (c) 2014-2015, richards-tech, LLC
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+//  The MPU-9250 and SPI driver code is based on code generously supplied by
+//  staslock@gmail.com (www.clickdrive.io)
+
+#ifndef _RTIMUTRANSPORT_H
+#define	_RTIMUTRANSPORT_H
+
+#include "RTIMUHal.h"
+
+//  RTIMUTransport is the interface between RTIMUHal and whatever actually moves bytes
+//  to and from the sensors. RTIMUHal uses the Linux i2c-dev and spidev transports below
+//  unless another one has been installed with RTIMUHal::setTransport().
+
+class RTIMUTransport
+{
+public:
+    RTIMUTransport();
+    virtual ~RTIMUTransport();
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    virtual bool read(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg) = 0;    // normal read with register select
+    virtual bool read(unsigned char slaveAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg) = 0;    // read without register select
+    virtual bool write(unsigned char slaveAddr, unsigned char regAddr,
+                  unsigned char length, unsigned char const *data, const char *errorMsg) = 0;
+
+    //  batch() performs count queued transfers. The default just performs them one at a time.
+
+    virtual bool batch(HAL_BATCH_ENTRY *entries, int count, const char *errorMsg);
+
+    virtual void delayMs(int milliSeconds);
+
+    //  delayUntil() waits until currentUSecs() reaches uSecs. Transports that override
+    //  currentUSecs() override this too.
+
+    virtual void delayUntil(uint64_t uSecs);
+
+    //  maxReadLength() is the longest read the transport can do in one transfer
+
+    virtual int maxReadLength() { return MAX_READ_LEN; }
+
+    //  currentUSecs() is the time drivers use to timestamp samples and pace reads. The
+    //  default is RTMath::currentUSecsMonotonic(). Simulated and replayed buses override
+    //  it so that timing follows the bus rather than the host.
+
+    virtual uint64_t currentUSecs();
+};
+
+//  The Linux i2c-dev transport
+
+class RTIMUI2CTransport : public RTIMUTransport
+{
+public:
+    RTIMUI2CTransport();
+    virtual ~RTIMUI2CTransport();
+
+    void setBus(unsigned char bus) { m_I2CBus = bus; }       // takes effect on the next open()
+    unsigned long getSlaveSelects() { return m_slaveSelects; }  // I2C_SLAVE ioctls issued
+
+    virtual bool open();
+    virtual void close();
+    virtual bool read(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg);
+    virtual bool read(unsigned char slaveAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg);
+    virtual bool write(unsigned char slaveAddr, unsigned char regAddr,
+                  unsigned char length, unsigned char const *data, const char *errorMsg);
+    virtual bool batch(HAL_BATCH_ENTRY *entries, int count, const char *errorMsg);
+
+private:
+    bool selectSlave(unsigned char slaveAddr, const char *errorMsg);
+    bool readRdWr(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg);    // combined write/read in one transaction
+
+    unsigned char m_I2CBus;
+    int m_I2C;
+    bool m_I2CRdWr;                                         // true if adapter supports I2C_RDWR transactions
+    unsigned char m_currentSlave;
+    unsigned long m_slaveSelects;
+};
+
+//  The Linux spidev transport
+
+class RTIMUSPITransport : public RTIMUTransport
+{
+public:
+    RTIMUSPITransport();
+    virtual ~RTIMUSPITransport();
+
+    void setBus(unsigned char bus, unsigned char select, unsigned int speed)
+        { m_SPIBus = bus; m_SPISelect = select; m_SPISpeed = speed; }   // takes effect on the next open()
+
+    virtual bool open();
+    virtual void close();
+    virtual bool read(unsigned char slaveAddr, unsigned char regAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg);
+    virtual bool read(unsigned char slaveAddr, unsigned char length,
+                 unsigned char *data, const char *errorMsg);
+    virtual bool write(unsigned char slaveAddr, unsigned char regAddr,
+                  unsigned char length, unsigned char const *data, const char *errorMsg);
+    virtual bool batch(HAL_BATCH_ENTRY *entries, int count, const char *errorMsg);
+    virtual int maxReadLength() { return m_maxRead; }
+
+private:
+    bool batchMessage(struct spi_ioc_transfer *xfers, int xferCount, int count, const char *errorMsg);
+
+    unsigned char m_SPIBus;
+    unsigned char m_SPISelect;
+    unsigned int m_SPISpeed;
+    int m_SPI;
+    int m_SPIPrev;
+    int m_maxRead;                                          // limited by the spidev buffer size
+};
+
+#endif // _RTIMUTRANSPORT_H
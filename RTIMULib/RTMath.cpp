@@ -43,6 +43,69 @@ uint64_t RTMath::currentUSecsSinceEpoch()
 #endif
 }
 
+#if !defined(WIN32) && !defined(__APPLE__)
+
+#include <time.h>
+#include <errno.h>
+
+static uint64_t monotonicUSecs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static uint64_t monotonicOffset()
+{
+    //  the offset to the epoch is taken once, the first time through
+
+    static const uint64_t offset = RTMath::currentUSecsSinceEpoch() - monotonicUSecs();
+
+    return offset;
+}
+
+uint64_t RTMath::currentUSecsMonotonic()
+{
+    return monotonicUSecs() + monotonicOffset();
+}
+
+void RTMath::sleepUntilUSecsMonotonic(uint64_t time)
+{
+    struct timespec ts;
+    uint64_t offset = monotonicOffset();
+
+    if (time <= offset)
+        return;
+    time -= offset;
+    ts.tv_sec = time / 1000000;
+    ts.tv_nsec = (time % 1000000) * 1000;
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+#else
+
+uint64_t RTMath::currentUSecsMonotonic()
+{
+    return currentUSecsSinceEpoch();
+}
+
+void RTMath::sleepUntilUSecsMonotonic(uint64_t time)
+{
+#if !defined(WIN32)
+    uint64_t now = currentUSecsMonotonic();
+
+    if (time > now)
+        usleep(time - now);
+#else
+    (void)time;
+#endif
+}
+
+#endif
+
 const char *RTMath::displayRadians(const char *label, RTVector3& vec)
 {
     sprintf(m_string, "%s: x:%f, y:%f, z:%f\n", label, vec.x(), vec.y(), vec.z());
@@ -72,6 +135,28 @@ const char *RTMath::display(const char *label, RTMatrix4x4& mat)
     return m_string;
 }
 
+const char *RTMath::simdPath()
+{
+#if defined(RTMATH_DISPATCH_CLONES)
+    //  in the order the clones are chosen
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return "AVX-512";
+    if (__builtin_cpu_supports("avx2"))
+        return "AVX2";
+    if (__builtin_cpu_supports("sse4.2"))
+        return "SSE4.2";
+#endif
+#if defined(RTMATH_SSE)
+    return "SSE";
+#elif defined(RTMATH_NEON)
+    return "NEON";
+#else
+    return "none";
+#endif
+}
+
 //  convertPressureToHeight() - the conversion uses the formula:
 //
 //  h = (T0 / L0) * ((p / P0)**(-(R* * L0) / (g0 * M)) - 1)
@@ -128,7 +213,7 @@ RTVector3 RTMath::poseFromAccelMag(const RTVector3& accel, const RTVector3& mag)
     return result;
 }
 
-void RTMath::convertToVector(unsigned char *rawData, RTVector3& vec, RTFLOAT scale, bool bigEndian)
+RTMATH_DISPATCH void RTMath::convertToVector(unsigned char *rawData, RTVector3& vec, RTFLOAT scale, bool bigEndian)
 {
     if (bigEndian) {
         vec.setX((RTFLOAT)((int16_t)(((uint16_t)rawData[0] << 8) | (uint16_t)rawData[1])) * scale);
@@ -142,6 +227,107 @@ void RTMath::convertToVector(unsigned char *rawData, RTVector3& vec, RTFLOAT sca
 }
 
 
+void RTMath::setRawTriple(RTMATH_RAW_TRIPLE& triple, int offset, RTFLOAT scale, bool bigEndian)
+{
+    triple.offset = offset;
+    triple.bigEndian = bigEndian;
+    for (int i = 0; i < 3; i++) {
+        triple.axis[i] = i;
+        triple.scale[i] = scale;
+    }
+}
+
+//  The SIMD versions convert four samples at a time. SSE loads each triple as 8 bytes
+//  straight into a register, which can't be done for the last sample unless there are
+//  two more bytes after its triple. NEON gathers the triples into a block of 16 bit
+//  x/y/z/unused lanes and deinterleaves them as it loads them.
+
+#if defined(RTMATH_SSE) && (defined(__SSE2__) || defined(_M_X64))
+#define RTMATH_SSE2_BATCH
+#include <emmintrin.h>
+#elif defined(RTMATH_NEON) && !defined(__ARM_BIG_ENDIAN)
+#define RTMATH_NEON_BATCH
+#endif
+
+RTMATH_DISPATCH void RTMath::convertBatch(const unsigned char *samples, int sampleSize, int count,
+        const RTMATH_RAW_TRIPLE *triples, int tripleCount, RTFLOAT *out, int stride)
+{
+    for (int t = 0; t < tripleCount; t++) {
+        const unsigned char *p = samples + triples[t].offset;
+        const bool bigEndian = triples[t].bigEndian;
+        int axis[3];
+        RTFLOAT scale[3];
+        RTFLOAT *dest[3];
+        int n = 0;
+
+        for (int i = 0; i < 3; i++) {
+            axis[i] = triples[t].axis[i];
+            scale[i] = triples[t].scale[i];
+            dest[i] = out + (3 * t + i) * stride;
+        }
+
+#if defined(RTMATH_SSE2_BATCH)
+        int wide = (triples[t].offset + 8 <= sampleSize) ? count : count - 1;
+        __m128 scales[3];
+
+        for (int i = 0; i < 3; i++)
+            scales[i] = _mm_set1_ps(scale[i]);
+
+        for (; n + 4 <= wide; n += 4) {
+            __m128i a = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p),
+                                           _mm_loadl_epi64((const __m128i *)(p + sampleSize)));
+            __m128i b = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(p + 2 * sampleSize)),
+                                           _mm_loadl_epi64((const __m128i *)(p + 3 * sampleSize)));
+            p += 4 * sampleSize;
+            if (bigEndian) {
+                a = _mm_or_si128(_mm_slli_epi16(a, 8), _mm_srli_epi16(a, 8));
+                b = _mm_or_si128(_mm_slli_epi16(b, 8), _mm_srli_epi16(b, 8));
+            }
+            __m128 v[4];
+            v[0] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(a, a), 16));
+            v[1] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(a, a), 16));
+            v[2] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(b, b), 16));
+            v[3] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(b, b), 16));
+            _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+            for (int i = 0; i < 3; i++)
+                _mm_storeu_ps(dest[i] + n, _mm_mul_ps(v[axis[i]], scales[i]));
+        }
+#elif defined(RTMATH_NEON_BATCH)
+        int16_t raw[16];
+
+        memset(raw, 0, sizeof(raw));
+        for (; n + 4 <= count; n += 4) {
+            for (int i = 0; i < 4; i++) {
+                memcpy(raw + 4 * i, p, 6);
+                p += sampleSize;
+            }
+            int16x4x4_t lanes = vld4_s16(raw);
+            float32x4_t v[3];
+            for (int i = 0; i < 3; i++) {
+                int16x4_t data = lanes.val[i];
+                if (bigEndian)
+                    data = vreinterpret_s16_u8(vrev16_u8(vreinterpret_u8_s16(data)));
+                v[i] = vcvtq_f32_s32(vmovl_s16(data));
+            }
+            for (int i = 0; i < 3; i++)
+                vst1q_f32(dest[i] + n, vmulq_n_f32(v[axis[i]], scale[i]));
+        }
+#endif
+        for (; n < count; n++) {
+            RTFLOAT v[3];
+            if (bigEndian) {
+                for (int i = 0; i < 3; i++)
+                    v[i] = (RTFLOAT)((int16_t)(((uint16_t)p[2 * i] << 8) | (uint16_t)p[2 * i + 1]));
+            } else {
+                for (int i = 0; i < 3; i++)
+                    v[i] = (RTFLOAT)((int16_t)(((uint16_t)p[2 * i + 1] << 8) | (uint16_t)p[2 * i]));
+            }
+            for (int i = 0; i < 3; i++)
+                dest[i][n] = v[axis[i]] * scale[i];
+            p += sampleSize;
+        }
+    }
+}
 
 //----------------------------------------------------------
 //
@@ -306,21 +492,6 @@ RTQuaternion& RTQuaternion::operator -=(const RTFLOAT val)
     return *this;
 }
 
-RTQuaternion& RTQuaternion::operator *=(const RTQuaternion& qb)
-{
-    RTQuaternion qa;
-
-    qa = *this;
-
-    m_data[0] = qa.scalar() * qb.scalar() - qa.x() * qb.x() - qa.y() * qb.y() - qa.z() * qb.z();
-    m_data[1] = qa.scalar() * qb.x() + qa.x() * qb.scalar() + qa.y() * qb.z() - qa.z() * qb.y();
-    m_data[2] = qa.scalar() * qb.y() - qa.x() * qb.z() + qa.y() * qb.scalar() + qa.z() * qb.x();
-    m_data[3] = qa.scalar() * qb.z() + qa.x() * qb.y() - qa.y() * qb.x() + qa.z() * qb.scalar();
-
-    return *this;
-}
-
-
 RTQuaternion& RTQuaternion::operator *=(const RTFLOAT val)
 {
     m_data[0] *= val;
@@ -332,13 +503,6 @@ RTQuaternion& RTQuaternion::operator *=(const RTFLOAT val)
 }
 
 
-const RTQuaternion RTQuaternion::operator *(const RTQuaternion& qb) const
-{
-    RTQuaternion result = *this;
-    result *= qb;
-    return result;
-}
-
 const RTQuaternion RTQuaternion::operator *(const RTFLOAT val) const
 {
     RTQuaternion result = *this;
@@ -368,20 +532,6 @@ void RTQuaternion::zero()
         m_data[i] = 0;
 }
 
-void RTQuaternion::normalize()
-{
-    RTFLOAT length = sqrt(m_data[0] * m_data[0] + m_data[1] * m_data[1] +
-            m_data[2] * m_data[2] + m_data[3] * m_data[3]);
-
-    if ((length == 0) || (length == 1))
-        return;
-
-    m_data[0] /= length;
-    m_data[1] /= length;
-    m_data[2] /= length;
-    m_data[3] /= length;
-}
-
 void RTQuaternion::toEuler(RTVector3& vec)
 {
     vec.setX(atan2(2.0 * (m_data[2] * m_data[3] + m_data[0] * m_data[1]),
@@ -522,109 +672,153 @@ const RTMatrix4x4 RTMatrix4x4::operator *(const RTFLOAT val) const
 }
 
 
-const RTMatrix4x4 RTMatrix4x4::operator *(const RTMatrix4x4& mat) const
+void RTMatrix4x4::setToIdentity()
 {
-    RTMatrix4x4 res;
-
-    for (int row = 0; row < 4; row++)
-        for (int col = 0; col < 4; col++)
-            res.m_data[row][col] =
-                    m_data[row][0] * mat.m_data[0][col] +
-                    m_data[row][1] * mat.m_data[1][col] +
-                    m_data[row][2] * mat.m_data[2][col] +
-                    m_data[row][3] * mat.m_data[3][col];
-
-    return res;
+    fill(0);
+    m_data[0][0] = 1;
+    m_data[1][1] = 1;
+    m_data[2][2] = 1;
+    m_data[3][3] = 1;
 }
 
+#if defined(RTMATH_SSE)
 
-const RTQuaternion RTMatrix4x4::operator *(const RTQuaternion& q) const
-{
-    RTQuaternion res;
+//  2x2 matrix helpers for the block inverse. A register holds a 2x2 matrix
+//  in row order and A# is the adjugate of A.
 
-    res.setScalar(m_data[0][0] * q.scalar() + m_data[0][1] * q.x() + m_data[0][2] * q.y() + m_data[0][3] * q.z());
-    res.setX(m_data[1][0] * q.scalar() + m_data[1][1] * q.x() + m_data[1][2] * q.y() + m_data[1][3] * q.z());
-    res.setY(m_data[2][0] * q.scalar() + m_data[2][1] * q.x() + m_data[2][2] * q.y() + m_data[2][3] * q.z());
-    res.setZ(m_data[3][0] * q.scalar() + m_data[3][1] * q.x() + m_data[3][2] * q.y() + m_data[3][3] * q.z());
+//  A * B
 
-    return res;
+static inline __m128 mat2Mul(__m128 a, __m128 b)
+{
+    return _mm_add_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+                      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
 }
 
-void RTMatrix4x4::setToIdentity()
+//  A# * B
+
+static inline __m128 mat2AdjMul(__m128 a, __m128 b)
 {
-    fill(0);
-    m_data[0][0] = 1;
-    m_data[1][1] = 1;
-    m_data[2][2] = 1;
-    m_data[3][3] = 1;
+    return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+                      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
 }
 
-RTMatrix4x4 RTMatrix4x4::transposed()
-{
-    RTMatrix4x4 res;
+//  A * B#
 
-    for (int row = 0; row < 4; row++)
-        for (int col = 0; col < 4; col++)
-            res.m_data[col][row] = m_data[row][col];
-    return res;
+static inline __m128 mat2MulAdj(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+                      _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
 }
 
-//  Note:
-//  The matrix inversion code here was strongly influenced by some old code I found
-//  but I have no idea where it came from. Apologies to whoever wrote it originally!
-//  If it's you, please let me know at info@richards-tech.com so I can credit it correctly.
+#endif
 
-RTMatrix4x4 RTMatrix4x4::inverted()
+RTMATH_DISPATCH RTMatrix4x4 RTMatrix4x4::inverted()
 {
     RTMatrix4x4 res;
 
-    RTFLOAT det = matDet();
-
-    if (det == 0) {
+#if defined(RTMATH_SSE)
+    //  Block inverse: the matrix is split into 2x2 blocks A B / C D, each held in one
+    //  register, and the result is built from their adjugates and determinants.
+
+    __m128 r0 = _mm_loadu_ps(m_data[0]);
+    __m128 r1 = _mm_loadu_ps(m_data[1]);
+    __m128 r2 = _mm_loadu_ps(m_data[2]);
+    __m128 r3 = _mm_loadu_ps(m_data[3]);
+
+    __m128 A = _mm_movelh_ps(r0, r1);
+    __m128 B = _mm_movehl_ps(r1, r0);
+    __m128 C = _mm_movelh_ps(r2, r3);
+    __m128 D = _mm_movehl_ps(r3, r2);
+
+    //  the determinants of A, B, C and D
+
+    __m128 detSub = _mm_sub_ps(
+            _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+            _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+    __m128 detA = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(0, 0, 0, 0));
+    __m128 detB = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 detC = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(2, 2, 2, 2));
+    __m128 detD = _mm_shuffle_ps(detSub, detSub, _MM_SHUFFLE(3, 3, 3, 3));
+
+    __m128 D_C = mat2AdjMul(D, C);
+    __m128 A_B = mat2AdjMul(A, B);
+    __m128 X_ = _mm_sub_ps(_mm_mul_ps(detD, A), mat2Mul(B, D_C));
+    __m128 W_ = _mm_sub_ps(_mm_mul_ps(detA, D), mat2Mul(C, A_B));
+    __m128 Y_ = _mm_sub_ps(_mm_mul_ps(detB, C), mat2MulAdj(D, A_B));
+    __m128 Z_ = _mm_sub_ps(_mm_mul_ps(detC, B), mat2MulAdj(A, D_C));
+
+    //  det = |A||D| + |B||C| - tr((A#B)(D#C))
+
+    __m128 tr = _mm_mul_ps(A_B, _mm_shuffle_ps(D_C, D_C, _MM_SHUFFLE(3, 1, 2, 0)));
+    tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(2, 3, 0, 1)));
+    tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(1, 0, 3, 2)));
+    __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+
+    if (_mm_cvtss_f32(det) == 0) {
         res.setToIdentity();
         return res;
     }
 
-    for (int row = 0; row < 4; row++) {
-        for (int col = 0; col < 4; col++) {
-            if ((row + col) & 1)
-                res.m_data[col][row] = -matMinor(row, col) / det;
-            else
-                res.m_data[col][row] = matMinor(row, col) / det;
-        }
-    }
+    __m128 rDet = _mm_div_ps(_mm_setr_ps(1, -1, -1, 1), det);
 
-    return res;
-}
+    X_ = _mm_mul_ps(X_, rDet);
+    Y_ = _mm_mul_ps(Y_, rDet);
+    Z_ = _mm_mul_ps(Z_, rDet);
+    W_ = _mm_mul_ps(W_, rDet);
 
-RTFLOAT RTMatrix4x4::matDet()
-{
-    RTFLOAT det = 0;
+    _mm_storeu_ps(res.m_data[0], _mm_shuffle_ps(X_, Y_, _MM_SHUFFLE(1, 3, 1, 3)));
+    _mm_storeu_ps(res.m_data[1], _mm_shuffle_ps(X_, Y_, _MM_SHUFFLE(0, 2, 0, 2)));
+    _mm_storeu_ps(res.m_data[2], _mm_shuffle_ps(Z_, W_, _MM_SHUFFLE(1, 3, 1, 3)));
+    _mm_storeu_ps(res.m_data[3], _mm_shuffle_ps(Z_, W_, _MM_SHUFFLE(0, 2, 0, 2)));
+#else
+    //  The inverse is the adjugate over the determinant. Both are built from the twelve
+    //  2x2 determinants of the top two and bottom two rows, which is a lot less work than
+    //  working out every 3x3 minor.
 
-    det += m_data[0][0] * matMinor(0, 0);
-    det -= m_data[0][1] * matMinor(0, 1);
-    det += m_data[0][2] * matMinor(0, 2);
-    det -= m_data[0][3] * matMinor(0, 3);
-    return det;
-}
+    const RTFLOAT (*a)[4] = m_data;
 
-RTFLOAT RTMatrix4x4::matMinor(const int row, const int col)
-{
-    static int map[] = {1, 2, 3, 0, 2, 3, 0, 1, 3, 0, 1, 2};
+    RTFLOAT s0 = a[0][0] * a[1][1] - a[1][0] * a[0][1];
+    RTFLOAT s1 = a[0][0] * a[1][2] - a[1][0] * a[0][2];
+    RTFLOAT s2 = a[0][0] * a[1][3] - a[1][0] * a[0][3];
+    RTFLOAT s3 = a[0][1] * a[1][2] - a[1][1] * a[0][2];
+    RTFLOAT s4 = a[0][1] * a[1][3] - a[1][1] * a[0][3];
+    RTFLOAT s5 = a[0][2] * a[1][3] - a[1][2] * a[0][3];
+
+    RTFLOAT c5 = a[2][2] * a[3][3] - a[3][2] * a[2][3];
+    RTFLOAT c4 = a[2][1] * a[3][3] - a[3][1] * a[2][3];
+    RTFLOAT c3 = a[2][1] * a[3][2] - a[3][1] * a[2][2];
+    RTFLOAT c2 = a[2][0] * a[3][3] - a[3][0] * a[2][3];
+    RTFLOAT c1 = a[2][0] * a[3][2] - a[3][0] * a[2][2];
+    RTFLOAT c0 = a[2][0] * a[3][1] - a[3][0] * a[2][1];
+
+    RTFLOAT det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+
+    if (det == 0) {
+        res.setToIdentity();
+        return res;
+    }
 
-    int *rc;
-    int *cc;
-    RTFLOAT res = 0;
+    RTFLOAT invDet = 1 / det;
 
-    rc = map + row * 3;
-    cc = map + col * 3;
+    res.m_data[0][0] = ( a[1][1] * c5 - a[1][2] * c4 + a[1][3] * c3) * invDet;
+    res.m_data[0][1] = (-a[0][1] * c5 + a[0][2] * c4 - a[0][3] * c3) * invDet;
+    res.m_data[0][2] = ( a[3][1] * s5 - a[3][2] * s4 + a[3][3] * s3) * invDet;
+    res.m_data[0][3] = (-a[2][1] * s5 + a[2][2] * s4 - a[2][3] * s3) * invDet;
 
-    res += m_data[rc[0]][cc[0]] * m_data[rc[1]][cc[1]] * m_data[rc[2]][cc[2]];
-    res -= m_data[rc[0]][cc[0]] * m_data[rc[1]][cc[2]] * m_data[rc[2]][cc[1]];
-    res -= m_data[rc[0]][cc[1]] * m_data[rc[1]][cc[0]] * m_data[rc[2]][cc[2]];
-    res += m_data[rc[0]][cc[1]] * m_data[rc[1]][cc[2]] * m_data[rc[2]][cc[0]];
-    res += m_data[rc[0]][cc[2]] * m_data[rc[1]][cc[0]] * m_data[rc[2]][cc[1]];
-    res -= m_data[rc[0]][cc[2]] * m_data[rc[1]][cc[1]] * m_data[rc[2]][cc[0]];
+    res.m_data[1][0] = (-a[1][0] * c5 + a[1][2] * c2 - a[1][3] * c1) * invDet;
+    res.m_data[1][1] = ( a[0][0] * c5 - a[0][2] * c2 + a[0][3] * c1) * invDet;
+    res.m_data[1][2] = (-a[3][0] * s5 + a[3][2] * s2 - a[3][3] * s1) * invDet;
+    res.m_data[1][3] = ( a[2][0] * s5 - a[2][2] * s2 + a[2][3] * s1) * invDet;
+
+    res.m_data[2][0] = ( a[1][0] * c4 - a[1][1] * c2 + a[1][3] * c0) * invDet;
+    res.m_data[2][1] = (-a[0][0] * c4 + a[0][1] * c2 - a[0][3] * c0) * invDet;
+    res.m_data[2][2] = ( a[3][0] * s4 - a[3][1] * s2 + a[3][3] * s0) * invDet;
+    res.m_data[2][3] = (-a[2][0] * s4 + a[2][1] * s2 - a[2][3] * s0) * invDet;
+
+    res.m_data[3][0] = (-a[1][0] * c3 + a[1][1] * c1 - a[1][2] * c0) * invDet;
+    res.m_data[3][1] = ( a[0][0] * c3 - a[0][1] * c1 + a[0][2] * c0) * invDet;
+    res.m_data[3][2] = (-a[3][0] * s3 + a[3][1] * s1 - a[3][2] * s0) * invDet;
+    res.m_data[3][3] = ( a[2][0] * s3 - a[2][1] * s1 + a[2][2] * s0) * invDet;
+#endif
     return res;
 }
-
@@ -34,6 +34,44 @@ typedef double RTFLOAT;
 typedef float RTFLOAT;
 #endif
 
+//  The quaternion and 4x4 matrix operations that the fusion filters spend their time in
+//  use SSE or NEON when RTFLOAT is float and the compiler targets one of them. Define
+//  RTMATH_NO_SIMD to use plain C++ everywhere.
+
+#if !defined(RTMATH_USE_DOUBLE) && !defined(RTMATH_NO_SIMD)
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define RTMATH_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RTMATH_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+//  The fusion kernels are marked RTMATH_DISPATCH. On x86 Linux they are also compiled for
+//  SSE4.2, AVX2 and AVX-512 and the dynamic linker picks the best version the CPU supports
+//  when the library is loaded, so a library built for the baseline still makes use of newer
+//  CPUs. RTMath::simdPath() says which one is in use. Define RTMATH_NO_DISPATCH to only
+//  build the baseline.
+
+#if !defined(RTMATH_NO_DISPATCH) && defined(__linux__) && defined(__GLIBC__) && \
+        (defined(__x86_64__) || defined(__i386__)) && \
+        ((defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 6)) || (defined(__clang__) && (__clang_major__ >= 14)))
+#define RTMATH_DISPATCH_CLONES
+#define RTMATH_DISPATCH __attribute__((target_clones("default", "sse4.2", "avx2", "avx512f")))
+#else
+#define RTMATH_DISPATCH
+#endif
+
+//  quaternions and matrices are kept 16 byte aligned for the SIMD code, although it
+//  doesn't rely on it as heap allocations aren't always aligned that well
+
+#if defined(_MSC_VER)
+#define RTMATH_ALIGN16 __declspec(align(16))
+#else
+#define RTMATH_ALIGN16 __attribute__((aligned(16)))
+#endif
+
 //  Useful constants
 
 #define	RTMATH_PI					3.1415926535
@@ -44,6 +82,19 @@ class RTVector3;
 class RTMatrix4x4;
 class RTQuaternion;
 
+//  RTMATH_RAW_TRIPLE describes a signed 16 bit x/y/z triple in a raw sample for
+//  RTMath::convertBatch(). Output axis i is input axis axis[i] times scale[i], so a
+//  driver's axis swaps, sign changes and per axis adjustments are done as the
+//  data is converted.
+
+typedef struct
+{
+    int offset;                                             // offset of the triple in the sample
+    bool bigEndian;
+    int axis[3];                                            // the input axis for each output axis
+    RTFLOAT scale[3];                                       // the scale for each output axis
+} RTMATH_RAW_TRIPLE;
+
 class RTMath
 {
 public:
@@ -59,6 +110,16 @@ public:
 
     static uint64_t currentUSecsSinceEpoch();
 
+    //  currentUSecsMonotonic() is in the same units and starts out at the same value but
+    //  never jumps when the system time is set, so it's the one to use for intervals
+
+    static uint64_t currentUSecsMonotonic();
+
+    //  sleepUntilUSecsMonotonic() returns when currentUSecsMonotonic() reaches time, at once
+    //  if it already has. Sleeping to a deadline rather than for an interval doesn't drift.
+
+    static void sleepUntilUSecsMonotonic(uint64_t time);
+
     //  poseFromAccelMag generates pose Euler angles from measured settings
 
     static RTVector3 poseFromAccelMag(const RTVector3& accel, const RTVector3& mag);
@@ -67,10 +128,25 @@ public:
 
     static void convertToVector(unsigned char *rawData, RTVector3& vec, RTFLOAT scale, bool bigEndian);
 
+    //  convertBatch() converts tripleCount triples in each of count samples of sampleSize
+    //  bytes. The results are kept axis by axis: axis a of triple t for sample n is at
+    //  out[(3 * t + a) * stride + n].
+
+    static void convertBatch(const unsigned char *samples, int sampleSize, int count,
+        const RTMATH_RAW_TRIPLE *triples, int tripleCount, RTFLOAT *out, int stride);
+
+    //  setRawTriple() fills in a triple with the same scale for each axis and no remapping
+
+    static void setRawTriple(RTMATH_RAW_TRIPLE& triple, int offset, RTFLOAT scale, bool bigEndian);
+
     //  Takes a pressure in hPa and returns height above sea level in meters
 
     static RTFLOAT convertPressureToHeight(RTFLOAT pressure, RTFLOAT staticPressure = 1013.25);
 
+    //  simdPath() returns the instruction set the math and fusion kernels are using
+
+    static const char *simdPath();
+
 private:
     static char m_string[1000];                             // for the display routines
 };
@@ -81,6 +157,7 @@ class RTVector3
 public:
     RTVector3();
     RTVector3(RTFLOAT x, RTFLOAT y, RTFLOAT z);
+    RTVector3(const RTVector3& vec) = default;
 
     const RTVector3&  operator +=(RTVector3& vec);
     const RTVector3&  operator -=(RTVector3& vec);
@@ -93,7 +170,7 @@ public:
     const char *display();
     const char *displayDegrees();
 
-    static float dotProduct(const RTVector3& a, const RTVector3& b);
+    static RTFLOAT dotProduct(const RTVector3& a, const RTVector3& b);
     static void crossProduct(const RTVector3& a, const RTVector3& b, RTVector3& d);
 
     void accelToEuler(RTVector3& rollPitchYaw) const;
@@ -121,6 +198,7 @@ class RTQuaternion
 public:
     RTQuaternion();
     RTQuaternion(RTFLOAT scalar, RTFLOAT x, RTFLOAT y, RTFLOAT z);
+    RTQuaternion(const RTQuaternion& quat) = default;
 
     RTQuaternion& operator +=(const RTQuaternion& quat);
     RTQuaternion& operator -=(const RTQuaternion& quat);
@@ -159,13 +237,16 @@ public:
     inline void toArray(RTFLOAT *val) const { memcpy(val, m_data, 4 * sizeof(RTFLOAT)); }
 
 private:
-    RTFLOAT m_data[4];
+    RTMATH_ALIGN16 RTFLOAT m_data[4];
+
+    friend class RTMatrix4x4;
 };
 
 class RTMatrix4x4
 {
 public:
     RTMatrix4x4();
+    RTMatrix4x4(const RTMatrix4x4& mat) = default;
 
     RTMatrix4x4& operator +=(const RTMatrix4x4& mat);
     RTMatrix4x4& operator -=(const RTMatrix4x4& mat);
@@ -186,10 +267,200 @@ public:
     RTMatrix4x4 transposed();
 
 private:
-    RTFLOAT m_data[4][4];                                   // row, column
-
-    RTFLOAT matDet();
-    RTFLOAT matMinor(const int row, const int col);
+    RTMATH_ALIGN16 RTFLOAT m_data[4][4];                    // row, column
 };
 
+//----------------------------------------------------------
+//
+//  The operations used on every fusion update are inline
+
+inline RTQuaternion& RTQuaternion::operator *=(const RTQuaternion& qb)
+{
+#if defined(RTMATH_SSE)
+    //  the product is qa.scalar * qb plus qa.x, qa.y and qa.z times qb shuffled and sign changed
+
+    __m128 a = _mm_loadu_ps(m_data);
+    __m128 b = _mm_loadu_ps(qb.m_data);
+    __m128 r = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), b);
+
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)),
+            _mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1)), _mm_setr_ps(-1, 1, -1, 1))));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)),
+            _mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2)), _mm_setr_ps(-1, 1, 1, -1))));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)),
+            _mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 2, 3)), _mm_setr_ps(-1, -1, 1, 1))));
+    _mm_storeu_ps(m_data, r);
+#elif defined(RTMATH_NEON)
+    static const float sign1[4] = {-1, 1, -1, 1};
+    static const float sign2[4] = {-1, 1, 1, -1};
+    static const float sign3[4] = {-1, -1, 1, 1};
+
+    float32x4_t b = vld1q_f32(qb.m_data);
+    float32x4_t b2 = vextq_f32(b, b, 2);
+    float32x4_t r = vmulq_n_f32(b, m_data[0]);
+
+    r = vmlaq_n_f32(r, vmulq_f32(vrev64q_f32(b), vld1q_f32(sign1)), m_data[1]);
+    r = vmlaq_n_f32(r, vmulq_f32(b2, vld1q_f32(sign2)), m_data[2]);
+    r = vmlaq_n_f32(r, vmulq_f32(vrev64q_f32(b2), vld1q_f32(sign3)), m_data[3]);
+    vst1q_f32(m_data, r);
+#else
+    RTQuaternion qa;
+
+    qa = *this;
+
+    m_data[0] = qa.scalar() * qb.scalar() - qa.x() * qb.x() - qa.y() * qb.y() - qa.z() * qb.z();
+    m_data[1] = qa.scalar() * qb.x() + qa.x() * qb.scalar() + qa.y() * qb.z() - qa.z() * qb.y();
+    m_data[2] = qa.scalar() * qb.y() - qa.x() * qb.z() + qa.y() * qb.scalar() + qa.z() * qb.x();
+    m_data[3] = qa.scalar() * qb.z() + qa.x() * qb.y() - qa.y() * qb.x() + qa.z() * qb.scalar();
+#endif
+    return *this;
+}
+
+inline const RTQuaternion RTQuaternion::operator *(const RTQuaternion& qb) const
+{
+    RTQuaternion result = *this;
+    result *= qb;
+    return result;
+}
+
+inline void RTQuaternion::normalize()
+{
+#if defined(RTMATH_SSE)
+    __m128 v = _mm_loadu_ps(m_data);
+    __m128 sq = _mm_mul_ps(v, v);
+
+    sq = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+    sq = _mm_add_ss(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 0, 3, 2)));
+    RTFLOAT length = _mm_cvtss_f32(_mm_sqrt_ss(sq));
+
+    if ((length == 0) || (length == 1))
+        return;
+
+    _mm_storeu_ps(m_data, _mm_div_ps(v, _mm_set1_ps(length)));
+#elif defined(RTMATH_NEON)
+    float32x4_t v = vld1q_f32(m_data);
+    float32x4_t sq = vmulq_f32(v, v);
+    float32x2_t sum = vadd_f32(vget_low_f32(sq), vget_high_f32(sq));
+    RTFLOAT length = sqrt(vget_lane_f32(vpadd_f32(sum, sum), 0));
+
+    if ((length == 0) || (length == 1))
+        return;
+
+    vst1q_f32(m_data, vmulq_n_f32(v, 1.0f / length));
+#else
+    RTFLOAT length = sqrt(m_data[0] * m_data[0] + m_data[1] * m_data[1] +
+            m_data[2] * m_data[2] + m_data[3] * m_data[3]);
+
+    if ((length == 0) || (length == 1))
+        return;
+
+    m_data[0] /= length;
+    m_data[1] /= length;
+    m_data[2] /= length;
+    m_data[3] /= length;
+#endif
+}
+
+inline const RTMatrix4x4 RTMatrix4x4::operator *(const RTMatrix4x4& mat) const
+{
+    RTMatrix4x4 res;
+
+#if defined(RTMATH_SSE)
+    __m128 b0 = _mm_loadu_ps(mat.m_data[0]);
+    __m128 b1 = _mm_loadu_ps(mat.m_data[1]);
+    __m128 b2 = _mm_loadu_ps(mat.m_data[2]);
+    __m128 b3 = _mm_loadu_ps(mat.m_data[3]);
+
+    for (int row = 0; row < 4; row++) {
+        __m128 r = _mm_mul_ps(_mm_set1_ps(m_data[row][0]), b0);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(m_data[row][1]), b1));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(m_data[row][2]), b2));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(m_data[row][3]), b3));
+        _mm_storeu_ps(res.m_data[row], r);
+    }
+#elif defined(RTMATH_NEON)
+    float32x4_t b0 = vld1q_f32(mat.m_data[0]);
+    float32x4_t b1 = vld1q_f32(mat.m_data[1]);
+    float32x4_t b2 = vld1q_f32(mat.m_data[2]);
+    float32x4_t b3 = vld1q_f32(mat.m_data[3]);
+
+    for (int row = 0; row < 4; row++) {
+        float32x4_t r = vmulq_n_f32(b0, m_data[row][0]);
+        r = vmlaq_n_f32(r, b1, m_data[row][1]);
+        r = vmlaq_n_f32(r, b2, m_data[row][2]);
+        r = vmlaq_n_f32(r, b3, m_data[row][3]);
+        vst1q_f32(res.m_data[row], r);
+    }
+#else
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            res.m_data[row][col] =
+                    m_data[row][0] * mat.m_data[0][col] +
+                    m_data[row][1] * mat.m_data[1][col] +
+                    m_data[row][2] * mat.m_data[2][col] +
+                    m_data[row][3] * mat.m_data[3][col];
+#endif
+    return res;
+}
+
+inline const RTQuaternion RTMatrix4x4::operator *(const RTQuaternion& q) const
+{
+    RTQuaternion res;
+
+#if defined(RTMATH_SSE)
+    __m128 qv = _mm_loadu_ps(q.m_data);
+    __m128 p0 = _mm_mul_ps(_mm_loadu_ps(m_data[0]), qv);
+    __m128 p1 = _mm_mul_ps(_mm_loadu_ps(m_data[1]), qv);
+    __m128 p2 = _mm_mul_ps(_mm_loadu_ps(m_data[2]), qv);
+    __m128 p3 = _mm_mul_ps(_mm_loadu_ps(m_data[3]), qv);
+
+    _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+    _mm_storeu_ps(res.m_data, _mm_add_ps(_mm_add_ps(p0, p1), _mm_add_ps(p2, p3)));
+#elif defined(RTMATH_NEON)
+    float32x4x4_t cols = vld4q_f32(&m_data[0][0]);
+    float32x4_t r = vmulq_n_f32(cols.val[0], q.m_data[0]);
+
+    r = vmlaq_n_f32(r, cols.val[1], q.m_data[1]);
+    r = vmlaq_n_f32(r, cols.val[2], q.m_data[2]);
+    r = vmlaq_n_f32(r, cols.val[3], q.m_data[3]);
+    vst1q_f32(res.m_data, r);
+#else
+    res.setScalar(m_data[0][0] * q.scalar() + m_data[0][1] * q.x() + m_data[0][2] * q.y() + m_data[0][3] * q.z());
+    res.setX(m_data[1][0] * q.scalar() + m_data[1][1] * q.x() + m_data[1][2] * q.y() + m_data[1][3] * q.z());
+    res.setY(m_data[2][0] * q.scalar() + m_data[2][1] * q.x() + m_data[2][2] * q.y() + m_data[2][3] * q.z());
+    res.setZ(m_data[3][0] * q.scalar() + m_data[3][1] * q.x() + m_data[3][2] * q.y() + m_data[3][3] * q.z());
+#endif
+    return res;
+}
+
+inline RTMatrix4x4 RTMatrix4x4::transposed()
+{
+    RTMatrix4x4 res;
+
+#if defined(RTMATH_SSE)
+    __m128 r0 = _mm_loadu_ps(m_data[0]);
+    __m128 r1 = _mm_loadu_ps(m_data[1]);
+    __m128 r2 = _mm_loadu_ps(m_data[2]);
+    __m128 r3 = _mm_loadu_ps(m_data[3]);
+
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(res.m_data[0], r0);
+    _mm_storeu_ps(res.m_data[1], r1);
+    _mm_storeu_ps(res.m_data[2], r2);
+    _mm_storeu_ps(res.m_data[3], r3);
+#elif defined(RTMATH_NEON)
+    float32x4x4_t cols = vld4q_f32(&m_data[0][0]);
+
+    vst1q_f32(res.m_data[0], cols.val[0]);
+    vst1q_f32(res.m_data[1], cols.val[1]);
+    vst1q_f32(res.m_data[2], cols.val[2]);
+    vst1q_f32(res.m_data[3], cols.val[3]);
+#else
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            res.m_data[col][row] = m_data[row][col];
+#endif
+    return res;
+}
+
 #endif /* _RTMATH_H_ */